@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2010 Phusion v.o.f.
+ * https://github.com/FooBarWidget/boyer-moore-horspool
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Backward Oracle Matching (Allauzen, Crochemore & Raffinot, 1999).
+ *
+ * Boyer-Moore-Horspool shifts by looking at a single haystack character. For
+ * long needles nearly every byte value occurs somewhere in the needle, so
+ * that shift quickly degenerates to a handful of bytes. Backward Oracle
+ * Matching instead reads the window right-to-left through the factor oracle
+ * of the reversed needle: as soon as the characters read so far are not a
+ * factor of the needle, the window can be shifted past them. On random data
+ * this happens after reading about log(needle_length) characters, so the
+ * shift grows with the needle length.
+ *
+ * The oracle has needle_length + 1 states and at most 2 * needle_length - 1
+ * transitions. It is stored in a compact layout: the "internal" transition of
+ * state i (to state i + 1) is implied by the needle itself and is not stored;
+ * the remaining "external" transitions are stored in a single sorted array
+ * indexed per state. Transitions out of the initial state, which are taken
+ * once per window, are additionally stored in a direct 256-entry table.
+ */
+
+#include <vector>
+#include <cstring>
+#include <climits>
+#include <stdint.h>
+
+struct FactorOracle {
+    /* Transitions from the initial state, indexed by character.
+     * 0 means 'no transition': no transition ever leads to the initial state.
+     */
+    std::vector<uint32_t> initial;
+    /* The external transitions of state s are
+     * external_chars/external_targets[external_offsets[s] .. external_offsets[s + 1]).
+     */
+    std::vector<uint32_t> external_offsets;
+    std::vector<unsigned char> external_chars;
+    std::vector<uint32_t> external_targets;
+};
+
+/* Returns the target state of the transition from 'state' over 'ch',
+ * or 0 if there is no such transition.
+ */
+inline uint32_t
+FactorOracleTransition(const FactorOracle& oracle,
+    const unsigned char* needle, size_t needle_length,
+    uint32_t state, unsigned char ch)
+{
+    if(state == 0) return oracle.initial[ch];
+    /* The internal transition of state i reads character i of the reversed needle. */
+    if(state < needle_length && needle[needle_length - 1 - state] == ch)
+        return state + 1;
+    const uint32_t end = oracle.external_offsets[state + 1];
+    for(uint32_t e = oracle.external_offsets[state]; e < end; ++e)
+    {
+        if(oracle.external_chars[e] == ch)
+            return oracle.external_targets[e];
+    }
+    return 0;
+}
+
+/* This function creates the factor oracle to be used by SearchInBOM(). */
+/* It only needs to be created once per a needle to search. */
+const FactorOracle
+    CreateFactorOracle(const unsigned char* needle, size_t needle_length)
+{
+    FactorOracle oracle;
+    oracle.initial.assign(UCHAR_MAX+1, 0);
+    oracle.external_offsets.assign(needle_length + 2, 0);
+    if(needle_length == 0) return oracle;
+
+    /* External transitions are collected in per-state linked lists while
+     * the oracle is being built, and compacted afterwards.
+     */
+    const uint32_t NO_EDGE = UINT32_MAX;
+    std::vector<uint32_t> head(needle_length + 1, NO_EDGE);
+    std::vector<uint32_t> next;
+    std::vector<unsigned char> chars;
+    std::vector<uint32_t> targets;
+    std::vector<int64_t> supply(needle_length + 1);
+
+    supply[0] = -1;
+    for(size_t i=0; i<needle_length; ++i)
+    {
+        const unsigned char ch = needle[needle_length - 1 - i];
+        int64_t k = supply[i];
+        uint32_t target = 0;
+        while(k > -1)
+        {
+            /* Does state k already have a transition over ch? State k < i, so
+             * its internal transition exists by now.
+             */
+            if(needle[needle_length - 1 - k] == ch)
+                target = uint32_t(k + 1);
+            else
+            {
+                for(uint32_t e = head[k]; e != NO_EDGE; e = next[e])
+                {
+                    if(chars[e] == ch)
+                    {
+                        target = targets[e];
+                        break;
+                    }
+                }
+            }
+            if(target != 0) break;
+
+            /* No: add an external transition from k to i + 1. */
+            next.push_back(head[k]);
+            chars.push_back(ch);
+            targets.push_back(uint32_t(i + 1));
+            head[k] = uint32_t(chars.size() - 1);
+            k = supply[k];
+        }
+        supply[i + 1] = (k == -1) ? 0 : target;
+    }
+
+    /* Compact the external transitions. */
+    for(size_t s=0; s<=needle_length; ++s)
+    {
+        uint32_t count = 0;
+        for(uint32_t e = head[s]; e != NO_EDGE; e = next[e])
+            ++count;
+        oracle.external_offsets[s + 1] = oracle.external_offsets[s] + count;
+    }
+    oracle.external_chars.resize(chars.size());
+    oracle.external_targets.resize(chars.size());
+    for(size_t s=0; s<=needle_length; ++s)
+    {
+        uint32_t pos = oracle.external_offsets[s];
+        for(uint32_t e = head[s]; e != NO_EDGE; e = next[e], ++pos)
+        {
+            oracle.external_chars[pos] = chars[e];
+            oracle.external_targets[pos] = targets[e];
+        }
+    }
+
+    /* Direct table for the initial state, including its internal transition. */
+    for(uint32_t e = oracle.external_offsets[0]; e < oracle.external_offsets[1]; ++e)
+        oracle.initial[oracle.external_chars[e]] = oracle.external_targets[e];
+    oracle.initial[needle[needle_length - 1]] = 1;
+
+    return oracle;
+}
+
+/* A Backward Oracle Matching search algorithm. */
+/* If it finds the needle, it returns an offset to haystack from which
+ * the needle was found. Otherwise, it returns haystack_length.
+ */
+size_t SearchInBOM(const unsigned char* haystack, size_t haystack_length,
+    const FactorOracle& oracle,
+    const unsigned char* needle,
+    const size_t needle_length)
+{
+    if(needle_length > haystack_length) return haystack_length;
+    if(needle_length == 1)
+    {
+        const unsigned char* result = (const unsigned char*)std::memchr(haystack, *needle, haystack_length);
+        return result ? size_t(result-haystack) : haystack_length;
+    }
+
+    const uint32_t* initial = &oracle.initial[0];
+
+    size_t haystack_position=0;
+    while(haystack_position <= haystack_length-needle_length)
+    {
+        /* 'unread' is the number of window characters that have not been
+         * read yet. The window is read right-to-left until the characters
+         * read so far are no longer recognized by the oracle.
+         */
+        const unsigned char* window = haystack + haystack_position;
+        size_t unread = needle_length - 1;
+        uint32_t state = initial[window[unread]];
+        while(state != 0 && unread > 0)
+        {
+            --unread;
+            state = FactorOracleTransition(oracle, needle, needle_length,
+                state, window[unread]);
+        }
+
+        if(state != 0)
+        {
+            /* The oracle recognizes a superset of the needle's factors,
+             * so a fully read window still has to be verified.
+             */
+            if(std::memcmp(needle, window, needle_length) == 0)
+                return haystack_position;
+            haystack_position += 1;
+        }
+        else
+        {
+            /* The characters from window[unread] onwards are not a factor
+             * of the needle, so no match can start at or before window[unread].
+             */
+            haystack_position += unread + 1;
+        }
+    }
+    return haystack_length;
+}
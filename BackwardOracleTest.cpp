@@ -0,0 +1,124 @@
+#include <string>
+
+#include "tut.h"
+#include "BackwardOracle.cpp"
+
+using namespace std;
+
+namespace tut {
+	struct BackwardOracleTest {
+		static int find(const string &needle, const string &haystack) {
+			const FactorOracle oracle = CreateFactorOracle(
+				(const unsigned char *) needle.c_str(),
+				needle.size());
+			size_t result = SearchInBOM(
+				(const unsigned char *) haystack.c_str(), haystack.size(),
+				oracle,
+				(const unsigned char *) needle.c_str(), needle.size());
+			if (result == haystack.size()) {
+				return -1;
+			} else {
+				return (int) result;
+			}
+		}
+		
+		static int reference(const string &needle, const string &haystack) {
+			string::size_type result = haystack.find(needle);
+			if (result == string::npos) {
+				return -1;
+			} else {
+				return (int) result;
+			}
+		}
+		
+		static string randomString(unsigned int &seed, size_t len, int alphabet_size) {
+			string result;
+			result.reserve(len);
+			for (size_t i = 0; i < len; i++) {
+				seed = seed * 1103515245 + 12345;
+				result.push_back(char('a' + (seed >> 16) % alphabet_size));
+			}
+			return result;
+		}
+	};
+	
+	DEFINE_TEST_GROUP(BackwardOracleTest);
+	
+	TEST_METHOD(1) {
+		set_test_name("It returns the haystack length if the needle can't be found.");
+		
+		ensure_equals(find("0", "123456789"), -1);
+		ensure_equals(find("ab", "12a45678aa"), -1);
+		ensure_equals(find("aa", "12a4a678ba"), -1);
+		ensure_equals(find("hello world!", "oh my, hello world"), -1);
+	}
+	
+	TEST_METHOD(2) {
+		set_test_name("Searching in an empty string always fails.");
+		
+		ensure_equals(find("1", ""), -1);
+		ensure_equals(find("abc", ""), -1);
+	}
+	
+	TEST_METHOD(3) {
+		set_test_name("Searching for a needle that's larger than the haystack always fails");
+		
+		ensure_equals(find("ab", "a"), -1);
+		ensure_equals(find("hello my world!", "this is small"), -1);
+	}
+	
+	TEST_METHOD(10) {
+		set_test_name("It returns the position at which the needle is first found");
+		
+		ensure_equals(find("9", "1234567899"), 8);
+		ensure_equals(find("ab", "100456789aabab"), 10);
+		ensure_equals(find("\n\n", "h\nello\n\nworld\n\n"), 6);
+		ensure_equals(find("hello world!", "oh my, hello world!! again, hello world!!"), 7);
+		ensure_equals(find("\r\n--boundary\r\n",
+			"some binary data\r\n"
+			"--boundary\rnot really\r\n"
+			"more binary data\r\n"
+			"--boundary\r\n"),
+			57);
+	}
+	
+	TEST_METHOD(11) {
+		set_test_name("The oracle accepts some non-factors; such windows are verified");
+		
+		// The factor oracle of "abbbaab" (the reversed needle) accepts
+		// "aba", which is not a factor of it.
+		ensure_equals(find("baabbba", "bbbbaba"), -1);
+		ensure_equals(find("baabbba", "aabaabbaaba"), -1);
+		ensure_equals(find("baabbba", "aabaabbaabaxbaabbba"), 12);
+	}
+	
+	TEST_METHOD(12) {
+		set_test_name("It agrees with std::string::find() on random data");
+		
+		unsigned int seed = 1;
+		for (int round = 0; round < 2000; round++) {
+			int alphabet_size = 2 + round % 3;
+			string haystack = randomString(seed, 1 + round % 300, alphabet_size);
+			string needle;
+			if (round % 2 == 0 && haystack.size() > 2) {
+				size_t start = (seed >> 8) % (haystack.size() - 1);
+				needle = haystack.substr(start, 1 + (seed >> 4) % 40);
+			} else {
+				needle = randomString(seed, 1 + round % 12, alphabet_size);
+			}
+			ensure_equals(find(needle, haystack), reference(needle, haystack));
+		}
+	}
+	
+	TEST_METHOD(13) {
+		set_test_name("Long needles");
+		
+		unsigned int seed = 42;
+		string needle = randomString(seed, 4096, 26);
+		string haystack = randomString(seed, 100000, 26);
+		ensure_equals(find(needle, haystack), -1);
+		ensure_equals(find(needle, haystack + needle), 100000);
+		ensure_equals(find(needle, haystack.substr(0, 5000) + needle.substr(0, 4095) + needle),
+			5000 + 4095);
+	}
+}
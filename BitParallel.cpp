@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2010 Phusion v.o.f.
+ * https://github.com/FooBarWidget/boyer-moore-horspool
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Bit-parallel string search algorithms: Shift-Or (Baeza-Yates & Gonnet, 1992)
+ * and Backward Nondeterministic DAWG Matching (BNDM, Navarro & Raffinot, 1998).
+ *
+ * Both algorithms simulate a nondeterministic automaton for the needle in a
+ * single machine word, one bit per needle character. Their running time
+ * does not depend on the needle contents, so they don't suffer from the
+ * worst cases that hit Boyer-Moore-Horspool on repetitive data (e.g. a
+ * needle ending with "\n\n" in a haystack full of newlines).
+ *
+ * The state word is 64 bits wide. Needles longer than 64 bytes are supported
+ * as well: the automaton is then built for the first 64 bytes of the needle
+ * only, and every hit of that prefix is verified with memcmp().
+ */
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <climits>
+#include <cassert>
+#include <stdint.h>
+
+typedef std::vector<uint64_t> bitmasktable_type;
+
+/* The number of needle characters that fit in the automaton state word. */
+static const size_t BIT_PARALLEL_MAX_LENGTH = 64;
+
+/* This function creates a bit mask table to be used by SearchInShiftOr(). */
+/* It only needs to be created once per a needle to search. */
+const bitmasktable_type
+    CreateShiftOrTable(const unsigned char* needle, size_t needle_length)
+{
+    bitmasktable_type masks(UCHAR_MAX+1, ~uint64_t(0));
+    const size_t prefix_length = std::min(needle_length, BIT_PARALLEL_MAX_LENGTH);
+
+    /* Shift-Or uses inverted logic: bit i is cleared if the character
+     * occurs at needle position i.
+     */
+    for(size_t i=0; i<prefix_length; ++i)
+        masks[needle[i]] &= ~(uint64_t(1) << i);
+    return masks;
+}
+
+/* This function creates a bit mask table to be used by SearchInBNDM(). */
+/* It only needs to be created once per a needle to search. */
+const bitmasktable_type
+    CreateBNDMTable(const unsigned char* needle, size_t needle_length)
+{
+    bitmasktable_type masks(UCHAR_MAX+1, 0);
+    const size_t prefix_length = std::min(needle_length, BIT_PARALLEL_MAX_LENGTH);
+
+    /* BNDM reads the window backwards, so the needle is stored reversed:
+     * bit (prefix_length - 1 - i) is set if the character occurs at
+     * needle position i.
+     */
+    for(size_t i=0; i<prefix_length; ++i)
+        masks[needle[i]] |= uint64_t(1) << (prefix_length - 1 - i);
+    return masks;
+}
+
+/* A Shift-Or search algorithm. */
+/* If it finds the needle, it returns an offset to haystack from which
+ * the needle was found. Otherwise, it returns haystack_length.
+ */
+size_t SearchInShiftOr(const unsigned char* haystack, size_t haystack_length,
+    const bitmasktable_type& masks,
+    const unsigned char* needle,
+    const size_t needle_length)
+{
+    if(needle_length > haystack_length) return haystack_length;
+    if(needle_length == 1)
+    {
+        const unsigned char* result = (const unsigned char*)std::memchr(haystack, *needle, haystack_length);
+        return result ? size_t(result-haystack) : haystack_length;
+    }
+
+    const size_t prefix_length = std::min(needle_length, BIT_PARALLEL_MAX_LENGTH);
+    const uint64_t match_bit = uint64_t(1) << (prefix_length - 1);
+    /* The last position at which a prefix match can still be the start of a
+     * complete needle match.
+     */
+    const size_t last_start = haystack_length - needle_length;
+
+    uint64_t state = ~uint64_t(0);
+    for(size_t i=0; i<haystack_length; ++i)
+    {
+        state = (state << 1) | masks[haystack[i]];
+        if((state & match_bit) == 0)
+        {
+            const size_t start = i + 1 - prefix_length;
+            if(start > last_start) break;
+            if(prefix_length == needle_length
+            || std::memcmp(needle + prefix_length, haystack + start + prefix_length,
+                   needle_length - prefix_length) == 0)
+            {
+                return start;
+            }
+        }
+    }
+    return haystack_length;
+}
+
+/* A Backward Nondeterministic DAWG Matching search algorithm. */
+/* If it finds the needle, it returns an offset to haystack from which
+ * the needle was found. Otherwise, it returns haystack_length.
+ */
+size_t SearchInBNDM(const unsigned char* haystack, size_t haystack_length,
+    const bitmasktable_type& masks,
+    const unsigned char* needle,
+    const size_t needle_length)
+{
+    if(needle_length > haystack_length) return haystack_length;
+    if(needle_length == 1)
+    {
+        const unsigned char* result = (const unsigned char*)std::memchr(haystack, *needle, haystack_length);
+        return result ? size_t(result-haystack) : haystack_length;
+    }
+
+    const size_t prefix_length = std::min(needle_length, BIT_PARALLEL_MAX_LENGTH);
+    const uint64_t prefix_bit = uint64_t(1) << (prefix_length - 1);
+
+    size_t haystack_position=0;
+    while(haystack_position <= haystack_length-needle_length)
+    {
+        /* Read the window right-to-left. 'state' has a bit set for every
+         * needle position at which the characters read so far occur as a
+         * factor. Whenever the highest bit is set, the characters read so
+         * far are a prefix of the needle and thus a possible start of the
+         * next match.
+         */
+        size_t j = prefix_length;
+        size_t last = prefix_length;
+        uint64_t state = ~uint64_t(0);
+        do
+        {
+            state &= masks[haystack[haystack_position + j - 1]];
+            --j;
+            if(state & prefix_bit)
+            {
+                if(j == 0)
+                {
+                    if(prefix_length == needle_length
+                    || std::memcmp(needle + prefix_length,
+                           haystack + haystack_position + prefix_length,
+                           needle_length - prefix_length) == 0)
+                    {
+                        return haystack_position;
+                    }
+                    break;
+                }
+                last = j;
+            }
+            state <<= 1;
+        } while(state != 0);
+
+        haystack_position += last;
+    }
+    return haystack_length;
+}
+
+/* Streaming Shift-Or state. Shift-Or never looks back at haystack data,
+ * so unlike StreamBMH this needs no lookbehind buffer: the entire search
+ * state between two FeedShiftOrStream() calls is a single word.
+ * The streaming variant only supports needles of up to
+ * BIT_PARALLEL_MAX_LENGTH bytes.
+ */
+struct ShiftOrStream {
+    bool     found;
+    uint64_t state;
+};
+
+inline void
+ResetShiftOrStream(ShiftOrStream& stream)
+{
+    stream.found = false;
+    stream.state = ~uint64_t(0);
+}
+
+/* Feeds haystack data to a streaming Shift-Or search. The return value
+ * has the same meaning as that of sbmh_feed(): if the needle has now been
+ * found then the position right after the last needle character in 'data'
+ * is returned and 'found' is set. Otherwise 'data_length' is returned.
+ * If the needle was already found then 0 is returned.
+ */
+size_t FeedShiftOrStream(ShiftOrStream& stream,
+    const bitmasktable_type& masks,
+    const size_t needle_length,
+    const unsigned char* data, size_t data_length)
+{
+    if(stream.found) return 0;
+    assert(needle_length > 0 && needle_length <= BIT_PARALLEL_MAX_LENGTH);
+
+    const uint64_t match_bit = uint64_t(1) << (needle_length - 1);
+    uint64_t state = stream.state;
+    for(size_t i=0; i<data_length; ++i)
+    {
+        state = (state << 1) | masks[data[i]];
+        if((state & match_bit) == 0)
+        {
+            stream.found = true;
+            stream.state = state;
+            return i + 1;
+        }
+    }
+    stream.state = state;
+    return data_length;
+}
@@ -8,9 +8,10 @@ typedef std::vector<size_t> skiptable_type;
  * of both strings.
  * It is an utility function used by the actual Boyer-Moore algorithms.
  */
+template<typename Symbol>
 size_t backwards_match_len(
-    const unsigned char* ptr1,
-    const unsigned char* ptr2,
+    const Symbol* ptr1,
+    const Symbol* ptr2,
     size_t strlen,
     size_t maxlen,
     size_t minlen)
@@ -18,13 +19,15 @@ size_t backwards_match_len(
     size_t result = minlen;
     while(result < maxlen && ptr1[strlen-1-result] == ptr2[strlen-1-result])
         ++result;
+    SEARCH_STATS_COMPARISONS(search_stats(), result - minlen + (result < maxlen ? 1 : 0));
     return result;
 }
 
 /* This function creates a skip table to be used by the search algorithms. */
 /* It only needs to be created once per a needle to search. */
+template<typename Symbol>
 const skiptable_type
-    CreateSkipTable(const unsigned char* needle, size_t needle_length)
+    CreateSkipTable(const Symbol* needle, size_t needle_length)
 {
     skiptable_type skip(needle_length, needle_length); // initialize a table of needle_length elements to value needle_length
  
@@ -94,24 +97,18 @@ const skiptable_type
     return skip;
 }
 
-/* A Boyer-Moore search algorithm. */
-/* If it finds the needle, it returns an offset to haystack from which
- * the needle was found. Otherwise, it returns haystack_length.
- */
-size_t SearchIn(const unsigned char* haystack, size_t haystack_length,
-    const occtable_type& occ,
-    const skiptable_type& skip,
-    const unsigned char* needle,
+/* The Boyer-Moore search itself; SearchIn() wraps it with trace probes. */
+template<typename Symbol, typename OccTable, typename SkipTable>
+size_t SearchInImpl(const Symbol* haystack, size_t haystack_length,
+    const OccTable& occ,
+    const SkipTable& skip,
+    const Symbol* needle,
     const size_t needle_length)
 {
     if(needle_length > haystack_length) return haystack_length;
  
     if(needle_length == 1)
-    {
-        const unsigned char* result =
-            (const unsigned char*)std::memchr(haystack, *needle, haystack_length);
-        return result ? size_t(result-haystack) : haystack_length;
-    }
+        return FindSymbol(haystack, haystack_length, *needle);
  
     const size_t needle_length_minus_1 = needle_length-1;
  
@@ -125,41 +122,56 @@ size_t SearchIn(const unsigned char* haystack, size_t haystack_length,
             needle_length, // maximum match length
             0 // assumed minimum match length
            );
+        SEARCH_STATS_WINDOW(search_stats());
+        SEARCH_STATS_BACKWARDS_MATCH(search_stats(), match_len, needle_length);
         if(match_len == needle_length) return haystack_position;
  
         const size_t mismatch_position = needle_length_minus_1 - match_len;
  
-        const unsigned char occ_char = haystack[haystack_position + mismatch_position];
+        const Symbol occ_char = haystack[haystack_position + mismatch_position];
  
         const ssize_t bcShift = occ[occ_char] - match_len;
         const ssize_t gcShift = skip[mismatch_position];
  
         size_t shift = std::max(gcShift, bcShift);
  
+        SEARCH_STATS_SHIFT(search_stats(), shift);
         haystack_position += shift;
     }
     return haystack_length;
 }
 
 
-/* A Turbo Boyer-Moore search algorithm. */
+/* A Boyer-Moore search algorithm. */
 /* If it finds the needle, it returns an offset to haystack from which
  * the needle was found. Otherwise, it returns haystack_length.
  */
-size_t SearchInTurbo(const unsigned char* haystack, size_t haystack_length,
-    const occtable_type& occ,
-    const skiptable_type& skip,
-    const unsigned char* needle,
+template<typename Symbol, typename OccTable, typename SkipTable>
+size_t SearchIn(const Symbol* haystack, size_t haystack_length,
+    const OccTable& occ,
+    const SkipTable& skip,
+    const Symbol* needle,
+    const size_t needle_length)
+{
+    SEARCH_PROBE2(bm_entry, haystack_length, needle_length);
+    const size_t result = SearchInImpl(haystack, haystack_length, occ, skip, needle, needle_length);
+    SEARCH_PROBE2(bm_return, result, haystack_length);
+    return result;
+}
+
+
+/* The Turbo Boyer-Moore search itself; SearchInTurbo() wraps it with trace probes. */
+template<typename Symbol, typename OccTable, typename SkipTable>
+size_t SearchInTurboImpl(const Symbol* haystack, size_t haystack_length,
+    const OccTable& occ,
+    const SkipTable& skip,
+    const Symbol* needle,
     const size_t needle_length)
 {
     if(needle_length > haystack_length) return haystack_length;
  
     if(needle_length == 1)
-    {
-        const unsigned char* result =
-            (const unsigned char*)std::memchr(haystack, *needle, haystack_length);
-        return result ? size_t(result-haystack) : haystack_length;
-    }
+        return FindSymbol(haystack, haystack_length, *needle);
  
     const size_t needle_length_minus_1 = needle_length-1;
  
@@ -168,6 +180,7 @@ size_t SearchInTurbo(const unsigned char* haystack, size_t haystack_length,
     while(haystack_position <= haystack_length-needle_length)
     {
         size_t match_len;
+        SEARCH_STATS_WINDOW(search_stats());
         if(ignore_num == 0)
         {
             match_len = backwards_match_len(
@@ -177,6 +190,7 @@ size_t SearchInTurbo(const unsigned char* haystack, size_t haystack_length,
                 needle_length, // maximum match length
                 0 // assumed minimum match length
                );
+            SEARCH_STATS_BACKWARDS_MATCH(search_stats(), match_len, needle_length);
             if(match_len == needle_length) return haystack_position;
         }
         else
@@ -197,12 +211,13 @@ size_t SearchInTurbo(const unsigned char* haystack, size_t haystack_length,
                         shift + ignore_num // assumed minimum match length
                       );
             }
+            SEARCH_STATS_BACKWARDS_MATCH(search_stats(), match_len, needle_length);
             if(match_len >= needle_length) return haystack_position;
         }
  
         const size_t mismatch_position = needle_length_minus_1 - match_len;
  
-        const unsigned char occ_char = haystack[haystack_position + mismatch_position];
+        const Symbol occ_char = haystack[haystack_position + mismatch_position];
  
         const ssize_t bcShift = occ[occ_char] - match_len;
         const size_t gcShift  = skip[mismatch_position];
@@ -218,7 +233,25 @@ size_t SearchInTurbo(const unsigned char* haystack, size_t haystack_length,
                 shift = ignore_num + 1;
             ignore_num = 0;
         }
+        SEARCH_STATS_SHIFT(search_stats(), shift);
         haystack_position += shift;
     }
     return haystack_length;
 }
+
+/* A Turbo Boyer-Moore search algorithm. */
+/* If it finds the needle, it returns an offset to haystack from which
+ * the needle was found. Otherwise, it returns haystack_length.
+ */
+template<typename Symbol, typename OccTable, typename SkipTable>
+size_t SearchInTurbo(const Symbol* haystack, size_t haystack_length,
+    const OccTable& occ,
+    const SkipTable& skip,
+    const Symbol* needle,
+    const size_t needle_length)
+{
+    SEARCH_PROBE2(turbo_entry, haystack_length, needle_length);
+    const size_t result = SearchInTurboImpl(haystack, haystack_length, occ, skip, needle, needle_length);
+    SEARCH_PROBE2(turbo_return, result, haystack_length);
+    return result;
+}
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2010 Phusion v.o.f.
+ * https://github.com/FooBarWidget/boyer-moore-horspool
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _COMPACT_OCC_TABLE_
+#define _COMPACT_OCC_TABLE_
+
+/*
+ * A compact occ table, for programs that keep the tables of very many
+ * needles in memory. An occtable_type takes 2 KB and a StreamBMH_Occ 512
+ * bytes, but most of their entries hold the needle length, because a needle
+ * only contains a few distinct bytes. A CompactOccTable only stores the
+ * shifts of the bytes that occur in the needle:
+ *
+ *   CompactOccTable *occ = (CompactOccTable *) malloc(CompactOccTableSize(needle, needle_len));
+ *   CreateCompactOccTable(occ, needle, needle_len);
+ *
+ *   SearchInHorspool(haystack, len, *occ, needle, needle_len);
+ *   SearchIn(haystack, len, *occ, skip, needle, needle_len);
+ *   sbmh_feed(ctx, occ, needle, needle_len, data, len);
+ *
+ * The sbmh_feed() overload is only available if StreamBoyerMooreHorspool.h
+ * is included before this file.
+ *
+ * The table has a variable size, so that many of them can be packed into
+ * one buffer; CompactOccTableSize() is a multiple of 8 bytes. For a needle
+ * of 15 bytes it's about 56 bytes.
+ *
+ * == How it works
+ *
+ * A 256-bit mask tells which bytes occur in the needle, ignoring its last
+ * byte. Their shifts follow the header, one byte each, in the order of the
+ * byte values. Looking up byte c takes the number of bits set below bit c in
+ * the mask (a popcount of one 64-bit word plus a precomputed count for the
+ * preceding words) as the index of its shift. Bytes that don't occur get the
+ * needle length, without a branch.
+ *
+ * Shifts larger than 255 are stored as 255. That is safe, because a shorter
+ * shift never skips a match, but it can make searching for needles longer
+ * than 256 bytes a little slower. Shifts of bytes that don't occur are not
+ * limited.
+ *
+ * The popcount uses the popcnt instruction if the compiler may use it, for
+ * example with -mpopcnt or -march=native; otherwise a few bit operations.
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+
+#define COMPACT_OCC_MAX_SHIFT 255
+
+struct CompactOccTable {
+	/* Bit c is set if byte c occurs in the needle, ignoring its last byte. */
+	uint64_t present[4];
+	/* The needle length: the shift of bytes that don't occur. */
+	uint32_t default_shift;
+	/* The number of bits set in the preceding words of 'present'. */
+	unsigned char rank[4];
+	/* After this field come the shifts of the bytes that occur, and one
+	 * padding byte.
+	 */
+
+	const unsigned char *shifts() const {
+		return (const unsigned char *) (this + 1);
+	}
+
+	size_t operator[](unsigned char c) const;
+};
+
+inline unsigned int
+_compact_occ_popcount(uint64_t x) {
+	#if defined(__POPCNT__) && (defined(__GNUC__) || defined(__clang__))
+		return __builtin_popcountll(x);
+	#else
+		x = x - ((x >> 1) & 0x5555555555555555ULL);
+		x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+		x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+		return (unsigned int) ((x * 0x0101010101010101ULL) >> 56);
+	#endif
+}
+
+inline size_t
+CompactOccTable::operator[](unsigned char c) const {
+	const uint64_t word = present[c >> 6];
+	const unsigned int bit = c & 63;
+	/* For bytes that don't occur, this reads the shift of the next byte
+	 * that does, or the padding byte.
+	 */
+	const size_t shift = shifts()[rank[c >> 6]
+		+ _compact_occ_popcount(word & ((uint64_t(1) << bit) - 1))];
+	return ((word >> bit) & 1) ? shift : default_shift;
+}
+
+/* Returns the number of bytes that the compact occ table of the needle takes. */
+inline size_t
+CompactOccTableSize(const unsigned char *needle, size_t needle_length)
+{
+	bool seen[256] = { false };
+	size_t distinct = 0;
+	for (size_t i = 0; i + 1 < needle_length; i++) {
+		if (!seen[needle[i]]) {
+			seen[needle[i]] = true;
+			distinct++;
+		}
+	}
+	return (sizeof(CompactOccTable) + distinct + 1 + 7) & ~size_t(7);
+}
+
+/* Creates the compact occ table of the needle in 'table', which must be
+ * CompactOccTableSize() bytes and aligned to 8 bytes. The needle may be at
+ * most 4 GB.
+ */
+inline void
+CreateCompactOccTable(CompactOccTable *table, const unsigned char *needle, size_t needle_length)
+{
+	size_t shifts[256];
+	memset(table->present, 0, sizeof(table->present));
+	for (size_t i = 0; i + 1 < needle_length; i++) {
+		table->present[needle[i] >> 6] |= uint64_t(1) << (needle[i] & 63);
+		shifts[needle[i]] = needle_length - 1 - i;
+	}
+	table->default_shift = (uint32_t) needle_length;
+
+	unsigned char *out = (unsigned char *) (table + 1);
+	size_t count = 0;
+	for (unsigned int word = 0; word < 4; word++) {
+		table->rank[word] = (unsigned char) count;
+		for (unsigned int bit = 0; bit < 64; bit++) {
+			if ((table->present[word] >> bit) & 1) {
+				const size_t shift = shifts[word * 64 + bit];
+				out[count++] = shift > COMPACT_OCC_MAX_SHIFT ? COMPACT_OCC_MAX_SHIFT : shift;
+			}
+		}
+	}
+	/* The padding byte, and the rest of the last 8 bytes. */
+	const size_t size = (sizeof(CompactOccTable) + count + 1 + 7) & ~size_t(7);
+	memset(out + count, 0, size - sizeof(CompactOccTable) - count);
+}
+
+#ifdef _STREAM_BOYER_MOORE_HORSPOOL_
+	/* sbmh_feed() with a compact occ table instead of a StreamBMH_Occ. */
+	inline size_t
+	sbmh_feed(struct StreamBMH *restrict ctx, const struct CompactOccTable *restrict occtable,
+		const unsigned char *restrict needle, sbmh_size_t needle_len,
+		const unsigned char *restrict data, size_t len)
+	{
+		SEARCH_PROBE3(feed_entry, ctx, len, ctx->lookbehind_size);
+		size_t analyzed = _sbmh_feed(ctx, *occtable, StreamBMH_DefaultGuards(),
+			needle, needle_len, data, len);
+		SEARCH_PROBE4(feed_return, ctx, analyzed, ctx->found, ctx->lookbehind_size);
+		return analyzed;
+	}
+#endif
+
+#endif /* _COMPACT_OCC_TABLE_ */
@@ -0,0 +1,108 @@
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <alloca.h>
+
+#include "tut.h"
+#include "Horspool.cpp"
+#include "BoyerMooreAndTurbo.cpp"
+#include "StreamBoyerMooreHorspool.h"
+#include "CompactOccTable.h"
+
+using namespace std;
+
+namespace tut {
+	struct CompactOccTableTest {
+		vector<uint64_t> storage;
+
+		const CompactOccTable &create(const string &needle) {
+			const unsigned char *n = (const unsigned char *) needle.data();
+			storage.assign(CompactOccTableSize(n, needle.size()) / 8, 0xFFFFFFFFFFFFFFFFULL);
+			CreateCompactOccTable((CompactOccTable *) &storage[0], n, needle.size());
+			return *(const CompactOccTable *) &storage[0];
+		}
+	};
+
+	DEFINE_TEST_GROUP(CompactOccTableTest);
+
+	TEST_METHOD(1) {
+		set_test_name("It has the same shifts as a full occ table");
+
+		const char *needles[] = { "x", "ab", "I have control\n", "abracadabra",
+			"\xff\x80\x3f\x40\xc0\x7f\xff\x01\x02" };
+		for (size_t i = 0; i < sizeof(needles) / sizeof(needles[0]); i++) {
+			const string needle = needles[i];
+			const occtable_type occ = CreateOccTable((const unsigned char *) needle.data(), needle.size());
+			const CompactOccTable &compact = create(needle);
+			for (unsigned int c = 0; c < 256; c++) {
+				ensure_equals(compact[(unsigned char) c], occ[c]);
+			}
+		}
+	}
+
+	TEST_METHOD(2) {
+		set_test_name("It is much smaller than a full occ table");
+
+		const string needle = "I have control\n";
+		const size_t size = CompactOccTableSize((const unsigned char *) needle.data(), needle.size());
+		ensure_equals(size % 8, 0u);
+		ensure("small", size <= 64);
+
+		/* All 256 byte values, plus the last byte. */
+		string all;
+		for (unsigned int c = 0; c < 256; c++) {
+			all.push_back((char) (255 - c));
+		}
+		all.push_back('x');
+		const occtable_type occ = CreateOccTable((const unsigned char *) all.data(), all.size());
+		const CompactOccTable &compact = create(all);
+		for (unsigned int c = 0; c < 256; c++) {
+			ensure_equals(compact[(unsigned char) c], min<size_t>(occ[c], COMPACT_OCC_MAX_SHIFT));
+		}
+	}
+
+	TEST_METHOD(3) {
+		set_test_name("Shifts of long needles are limited to 255, which still finds all matches");
+
+		string needle = "A";
+		needle.append(1000, 'b');
+		needle.append("Z");
+		const occtable_type occ = CreateOccTable((const unsigned char *) needle.data(), needle.size());
+		const CompactOccTable &compact = create(needle);
+		ensure_equals(occ['A'], 1001u);
+		ensure_equals(compact['A'], 255u);
+		ensure_equals(compact['b'], 1u);
+		ensure_equals(compact['x'], 1002u);
+
+		string haystack(3000, 'b');
+		haystack.append(needle);
+		haystack.append(100, 'A');
+		const unsigned char *h = (const unsigned char *) haystack.data();
+		const unsigned char *n = (const unsigned char *) needle.data();
+		ensure_equals(SearchInHorspool(h, haystack.size(), compact, n, needle.size()), 3000u);
+		const skiptable_type skip = CreateSkipTable(n, needle.size());
+		ensure_equals(SearchIn(h, haystack.size(), compact, skip, n, needle.size()), 3000u);
+		ensure_equals(SearchInTurbo(h, haystack.size(), compact, skip, n, needle.size()), 3000u);
+	}
+
+	TEST_METHOD(4) {
+		set_test_name("StreamBMH can use it");
+
+		const string needle = "I have control\n";
+		const unsigned char *n = (const unsigned char *) needle.data();
+		const CompactOccTable &compact = create(needle);
+		const string haystack = "Twinkle, twinkle, little bat! I have contI have control\nxx";
+		StreamBMH *ctx = (StreamBMH *) alloca(SBMH_SIZE(needle.size()));
+		sbmh_init(ctx, NULL, n, needle.size());
+		size_t pos = 0;
+		size_t analyzed = 0;
+		while (pos < haystack.size() && !ctx->found) {
+			const size_t len = min<size_t>(7, haystack.size() - pos);
+			analyzed = sbmh_feed(ctx, &compact, n, needle.size(),
+				(const unsigned char *) haystack.data() + pos, len);
+			pos += analyzed;
+		}
+		ensure("found", ctx->found);
+		ensure_equals(pos - needle.size(), haystack.find(needle));
+	}
+}
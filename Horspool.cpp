@@ -25,14 +25,56 @@
  */
 
 #include <vector>
+#include <algorithm>
 #include <cstring>
 #include <climits>
+#include <stdint.h>
+
+#include "SearchStats.h"
+#include "SearchProbes.h"
  
+/*
+ * The search algorithms are templates on the symbol type, so that they can
+ * search not only in byte strings but also in e.g. UTF-16 text (uint16_t) or
+ * arrays of 32-bit token IDs (uint32_t). Searching those as reinterpreted
+ * bytes would be slower (shorter shifts) and could report matches that are
+ * not aligned to a symbol boundary.
+ *
+ * Byte strings use a direct occ table of UCHAR_MAX+1 entries. Wider symbols
+ * use a WideOccTable.
+ */
+
 typedef std::vector<size_t> occtable_type;
 
+/* An occ table for symbols that are wider than a byte, for which a table
+ * with an entry for every possible symbol would be far too big.
+ *
+ * Symbols are hashed into a small power-of-two sized table. When several
+ * needle symbols hash to the same entry, the entry holds the smallest of
+ * their shifts. A haystack symbol that does not occur in the needle may thus
+ * get a shorter shift than it deserves, but never a longer one, so no match
+ * is ever skipped. The table size is chosen relative to the needle length
+ * to keep such collisions rare.
+ */
+template<typename Symbol>
+struct WideOccTable {
+    std::vector<size_t> shifts;
+    /* The number of bits of the table index. */
+    unsigned int bits;
+
+    size_t bucket(Symbol symbol) const {
+        /* Fibonacci hashing: the high bits of the product are well mixed. */
+        return size_t((uint64_t(symbol) * 0x9E3779B97F4A7C15ULL) >> (64 - bits));
+    }
+
+    size_t operator[](Symbol symbol) const {
+        return shifts[bucket(symbol)];
+    }
+};
+
 /* This function creates an occ table to be used by the search algorithms. */
 /* It only needs to be created once per a needle to search. */
-const occtable_type
+inline const occtable_type
     CreateOccTable(const unsigned char* needle, size_t needle_length)
 {
     occtable_type occ(UCHAR_MAX+1, needle_length); // initialize a table of UCHAR_MAX+1 elements to value needle_length
@@ -48,43 +90,254 @@ const occtable_type
     return occ;
 }
 
-/* A Boyer-Moore-Horspool search algorithm. */
-/* If it finds the needle, it returns an offset to haystack from which
- * the needle was found. Otherwise, it returns haystack_length.
+/* This function creates an occ table for symbols wider than a byte. */
+/* It only needs to be created once per a needle to search. */
+template<typename Symbol>
+const WideOccTable<Symbol>
+    CreateOccTable(const Symbol* needle, size_t needle_length)
+{
+    WideOccTable<Symbol> occ;
+
+    /* Aim for a table that is at most 25% occupied, between 256 and 16384 entries. */
+    occ.bits = 8;
+    while(occ.bits < 14 && (size_t(1) << occ.bits) < needle_length * 4)
+        ++occ.bits;
+    occ.shifts.assign(size_t(1) << occ.bits, needle_length);
+
+    /* Populate it with the analysis of the needle */
+    /* But ignoring the last letter */
+    if(needle_length >= 1)
+    {
+        const size_t needle_length_minus_1 = needle_length-1;
+        for(size_t a=0; a<needle_length_minus_1; ++a)
+        {
+            /* Later needle positions have smaller shifts, so this keeps the
+             * smallest shift of all colliding symbols.
+             */
+            occ.shifts[occ.bucket(needle[a])] = needle_length_minus_1 - a;
+        }
+    }
+    return occ;
+}
+
+/* Returns the position of the first occurrence of 'symbol' in the haystack,
+ * or haystack_length if there is none.
+ */
+inline size_t FindSymbol(const unsigned char* haystack, size_t haystack_length,
+    unsigned char symbol)
+{
+    const unsigned char* result = (const unsigned char*)std::memchr(haystack, symbol, haystack_length);
+    return result ? size_t(result-haystack) : haystack_length;
+}
+
+template<typename Symbol>
+size_t FindSymbol(const Symbol* haystack, size_t haystack_length, Symbol symbol)
+{
+    return std::find(haystack, haystack + haystack_length, symbol) - haystack;
+}
+
+/* The Boyer-Moore-Horspool search itself; SearchInHorspool() wraps it with
+ * trace probes.
  */
-size_t SearchInHorspool(const unsigned char* haystack, size_t haystack_length,
-    const occtable_type& occ,
-    const unsigned char* needle,
+template<typename Symbol, typename OccTable>
+size_t SearchInHorspoolImpl(const Symbol* haystack, size_t haystack_length,
+    const OccTable& occ,
+    const Symbol* needle,
     const size_t needle_length)
 {
     if(needle_length > haystack_length) return haystack_length;
     if(needle_length == 1)
-    {
-        const unsigned char* result = (const unsigned char*)std::memchr(haystack, *needle, haystack_length);
-        return result ? size_t(result-haystack) : haystack_length;
-    }
+        return FindSymbol(haystack, haystack_length, *needle);
  
     const size_t needle_length_minus_1 = needle_length-1;
  
-    const unsigned char last_needle_char = needle[needle_length_minus_1];
+    const Symbol last_needle_char = needle[needle_length_minus_1];
  
     size_t haystack_position=0;
     while(haystack_position <= haystack_length-needle_length)
     {
-        const unsigned char occ_char = haystack[haystack_position + needle_length_minus_1];
+        const Symbol occ_char = haystack[haystack_position + needle_length_minus_1];
+        SEARCH_STATS_WINDOW(search_stats());
  
         // The author modified this part. Original algorithm matches needle right-to-left.
         // This code calls memcmp() (usually matches left-to-right) after matching the last
         // character, thereby incorporating some ideas from
         // "Tuning the Boyer-Moore-Horspool String Searching Algorithm"
         // by Timo Raita, 1992.
-        if(last_needle_char == occ_char
-        && std::memcmp(needle, haystack+haystack_position, needle_length_minus_1) == 0)
+        if(SEARCH_STATS_HIT(search_stats(), last_needle_char == occ_char)
+        && SEARCH_STATS_VERIFY(search_stats(),
+               SEARCH_STATS_MEMCMP(search_stats(), needle, haystack+haystack_position,
+                   needle_length_minus_1 * sizeof(Symbol)) == 0))
         {
             return haystack_position;
         }
  
+        SEARCH_STATS_SHIFT(search_stats(), occ[occ_char]);
         haystack_position += occ[occ_char];
     }
     return haystack_length;
 }
+
+/* A Boyer-Moore-Horspool search algorithm. */
+/* If it finds the needle, it returns an offset to haystack from which
+ * the needle was found. Otherwise, it returns haystack_length.
+ */
+template<typename Symbol, typename OccTable>
+size_t SearchInHorspool(const Symbol* haystack, size_t haystack_length,
+    const OccTable& occ,
+    const Symbol* needle,
+    const size_t needle_length)
+{
+    SEARCH_PROBE2(horspool_entry, haystack_length, needle_length);
+    const size_t result = SearchInHorspoolImpl(haystack, haystack_length, occ, needle, needle_length);
+    SEARCH_PROBE2(horspool_return, result, haystack_length);
+    return result;
+}
+
+/* This function returns the smallest period of the needle: the smallest p
+ * such that needle[i] == needle[i+p] for all i. Two occurrences of the
+ * needle in a haystack are always at least that far apart.
+ * It only needs to be computed once per a needle to search.
+ */
+template<typename Symbol>
+size_t ComputePeriod(const Symbol* needle, size_t needle_length)
+{
+    if(needle_length == 0) return 0;
+
+    /* border[i] is the length of the longest proper prefix of needle[0..i]
+     * that is also a suffix of it (the KMP failure function).
+     */
+    std::vector<size_t> border(needle_length, 0);
+    for(size_t i=1; i<needle_length; ++i)
+    {
+        size_t b = border[i-1];
+        while(b > 0 && needle[i] != needle[b])
+            b = border[b-1];
+        border[i] = (needle[i] == needle[b]) ? b+1 : 0;
+    }
+    return needle_length - border[needle_length-1];
+}
+
+/* Collects the matches of SearchAllInHorspool() for CountInHorspool(). */
+struct HorspoolCountSink {
+    size_t count;
+
+    bool add(size_t) {
+        ++count;
+        return true;
+    }
+};
+
+/* Collects the matches of SearchAllInHorspool() for SearchFirstNInHorspool(). */
+struct HorspoolFirstNSink {
+    size_t* positions;
+    size_t count;
+    size_t max_count;
+
+    bool add(size_t position) {
+        positions[count++] = position;
+        return count < max_count;
+    }
+};
+
+/* Passes the position of every occurrence of the needle to sink.add(), until
+ * it returns false. The sink is a template parameter so that every kind of
+ * sink gets an inner loop of its own: counting compiles to an increment.
+ *
+ * After a match at position i, the next possible match is at i+needle_period,
+ * and its first needle_length-needle_period symbols are known to match
+ * already, so only the last needle_period symbols are compared: the last
+ * one first, like in the search loop. Runs of overlapping matches such as
+ * "\n\n" in "\n\n\n\n" thus take one comparison per match instead of a new
+ * search. needle_period must not be 0.
+ */
+template<typename Symbol, typename OccTable, typename Sink>
+void SearchAllInHorspool(const Symbol* haystack, size_t haystack_length,
+    const OccTable& occ,
+    const Symbol* needle,
+    const size_t needle_length,
+    const size_t needle_period,
+    Sink& sink)
+{
+    if(needle_length == 0 || needle_length > haystack_length) return;
+    if(needle_length == 1)
+    {
+        size_t haystack_position = 0;
+        while((haystack_position += FindSymbol(haystack + haystack_position,
+            haystack_length - haystack_position, *needle)) < haystack_length)
+        {
+            if(!sink.add(haystack_position)) return;
+            ++haystack_position;
+        }
+        return;
+    }
+
+    const size_t needle_length_minus_1 = needle_length-1;
+    const size_t period_offset = needle_length - needle_period;
+    const Symbol last_needle_char = needle[needle_length_minus_1];
+    const size_t last_position = haystack_length-needle_length;
+
+    size_t haystack_position=0;
+    while(haystack_position <= last_position)
+    {
+        const Symbol occ_char = haystack[haystack_position + needle_length_minus_1];
+        SEARCH_STATS_WINDOW(search_stats());
+
+        if(SEARCH_STATS_HIT(search_stats(), last_needle_char == occ_char)
+        && SEARCH_STATS_VERIFY(search_stats(),
+               SEARCH_STATS_MEMCMP(search_stats(), needle, haystack+haystack_position,
+                   needle_length_minus_1 * sizeof(Symbol)) == 0))
+        {
+            do
+            {
+                if(!sink.add(haystack_position)) return;
+                haystack_position += needle_period;
+            }
+            while(haystack_position <= last_position
+               && haystack[haystack_position + needle_length_minus_1] == last_needle_char
+               && (needle_period == 1
+                   || SEARCH_STATS_MEMCMP(search_stats(), needle + period_offset,
+                          haystack + haystack_position + period_offset,
+                          (needle_period-1) * sizeof(Symbol)) == 0));
+            continue;
+        }
+
+        SEARCH_STATS_SHIFT(search_stats(), occ[occ_char]);
+        haystack_position += occ[occ_char];
+    }
+}
+
+/* Returns the number of occurrences of the needle, including overlapping
+ * ones. needle_period is ComputePeriod() of the needle; pass needle_length
+ * instead to count non-overlapping occurrences.
+ */
+template<typename Symbol, typename OccTable>
+size_t CountInHorspool(const Symbol* haystack, size_t haystack_length,
+    const OccTable& occ,
+    const Symbol* needle,
+    const size_t needle_length,
+    const size_t needle_period)
+{
+    HorspoolCountSink sink = { 0 };
+    SearchAllInHorspool(haystack, haystack_length, occ, needle, needle_length, needle_period, sink);
+    return sink.count;
+}
+
+/* Stores the positions of the first max_count occurrences of the needle,
+ * including overlapping ones, in 'positions', and returns their number.
+ * needle_period is as in CountInHorspool().
+ */
+template<typename Symbol, typename OccTable>
+size_t SearchFirstNInHorspool(const Symbol* haystack, size_t haystack_length,
+    const OccTable& occ,
+    const Symbol* needle,
+    const size_t needle_length,
+    const size_t needle_period,
+    size_t* positions,
+    size_t max_count)
+{
+    if(max_count == 0) return 0;
+    HorspoolFirstNSink sink = { positions, 0, max_count };
+    SearchAllInHorspool(haystack, haystack_length, occ, needle, needle_length, needle_period, sink);
+    return sink.count;
+}
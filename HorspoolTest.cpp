@@ -1,4 +1,6 @@
 #include <string>
+#include <vector>
+#include <cstdlib>
 
 #include "tut.h"
 #include "Horspool.cpp"
@@ -21,6 +23,48 @@ namespace tut {
 				return (int) result;
 			}
 		}
+
+		static size_t period(const string &needle) {
+			return ComputePeriod((const unsigned char *) needle.c_str(), needle.size());
+		}
+
+		static size_t count(const string &needle, const string &haystack, bool overlapping = true) {
+			const occtable_type occ = CreateOccTable(
+				(const unsigned char *) needle.c_str(),
+				needle.size());
+			return CountInHorspool(
+				(const unsigned char *) haystack.c_str(), haystack.size(),
+				occ,
+				(const unsigned char *) needle.c_str(), needle.size(),
+				overlapping ? period(needle) : needle.size());
+		}
+
+		static vector<size_t> findFirst(const string &needle, const string &haystack, size_t max_count) {
+			const occtable_type occ = CreateOccTable(
+				(const unsigned char *) needle.c_str(),
+				needle.size());
+			vector<size_t> positions(max_count + 1, (size_t) -1);
+			size_t found = SearchFirstNInHorspool(
+				(const unsigned char *) haystack.c_str(), haystack.size(),
+				occ,
+				(const unsigned char *) needle.c_str(), needle.size(),
+				period(needle),
+				&positions[0], max_count);
+			ensure("It writes at most max_count positions",
+				found <= max_count && positions[max_count] == (size_t) -1);
+			positions.resize(found);
+			return positions;
+		}
+
+		static size_t bruteForceCount(const string &needle, const string &haystack, bool overlapping) {
+			size_t result = 0;
+			size_t pos = haystack.find(needle);
+			while (pos != string::npos) {
+				result++;
+				pos = haystack.find(needle, pos + (overlapping ? 1 : needle.size()));
+			}
+			return result;
+		}
 	};
 	
 	DEFINE_TEST_GROUP(HorspoolTest);
@@ -137,4 +181,81 @@ namespace tut {
 			"--boundary\r\n"),
 			57);
 	}
+	
+	TEST_METHOD(14) {
+		set_test_name("ComputePeriod() returns the smallest period of the needle");
+		
+		ensure_equals(period("a"), 1u);
+		ensure_equals(period("\n\n"), 1u);
+		ensure_equals(period("ab"), 2u);
+		ensure_equals(period("abab"), 2u);
+		ensure_equals(period("aba"), 2u);
+		ensure_equals(period("abcab"), 3u);
+		ensure_equals(period("aabaa"), 3u);
+		ensure_equals(period("\r\n\r\n"), 2u);
+		ensure_equals(period("hello"), 5u);
+	}
+	
+	TEST_METHOD(15) {
+		set_test_name("CountInHorspool() counts overlapping or non-overlapping occurrences");
+		
+		ensure_equals(count("\n\n", "\n\n\n\n"), 3u);
+		ensure_equals(count("\n\n", "\n\n\n\n", false), 2u);
+		ensure_equals(count("\n\n", "\n\n\n\n\n"), 4u);
+		ensure_equals(count("\n\n", "\n\n\n\n\n", false), 2u);
+		ensure_equals(count("\n\n", "a\n\nb\n\n\nc\n"), 3u);
+		ensure_equals(count("abab", "ababababxabab"), 4u);
+		ensure_equals(count("abab", "ababababxabab", false), 3u);
+		ensure_equals(count("x", "xaxxbx"), 4u);
+		ensure_equals(count("hello", "hello world"), 1u);
+		ensure_equals(count("hello", "helo world"), 0u);
+		ensure_equals(count("hello world!", "hello"), 0u);
+		ensure_equals(count("", "hello"), 0u);
+	}
+	
+	TEST_METHOD(16) {
+		set_test_name("CountInHorspool() agrees with a brute force count on random haystacks");
+		
+		const char *needles[] = { "a", "aa", "ab", "aaa", "aba", "abab", "aabaa", "abaab", "baaab" };
+		srand(1234);
+		for (int round = 0; round < 200; round++) {
+			string haystack;
+			size_t len = rand() % 64;
+			for (size_t i = 0; i < len; i++) {
+				haystack.push_back("ab"[rand() % 2]);
+			}
+			for (size_t i = 0; i < sizeof(needles) / sizeof(needles[0]); i++) {
+				const string message = haystack + " / " + needles[i];
+				ensure_equals(message.c_str(),
+					count(needles[i], haystack),
+					bruteForceCount(needles[i], haystack, true));
+				ensure_equals(message.c_str(),
+					count(needles[i], haystack, false),
+					bruteForceCount(needles[i], haystack, false));
+			}
+		}
+	}
+	
+	TEST_METHOD(17) {
+		set_test_name("SearchFirstNInHorspool() returns the first N occurrences");
+		
+		vector<size_t> positions = findFirst("\n\n", "a\n\n\n\nb\n\nc\n\n", 3);
+		ensure_equals(positions.size(), 3u);
+		ensure_equals(positions[0], 1u);
+		ensure_equals(positions[1], 2u);
+		ensure_equals(positions[2], 3u);
+		
+		positions = findFirst("\n\n", "a\n\n\n\nb\n\nc\n\n", 10);
+		ensure_equals(positions.size(), 5u);
+		ensure_equals(positions[3], 6u);
+		ensure_equals(positions[4], 9u);
+		
+		positions = findFirst("abab", "xxababab", 1);
+		ensure_equals(positions.size(), 1u);
+		ensure_equals(positions[0], 2u);
+		
+		ensure_equals(findFirst("x", "axbxx", 2).size(), 2u);
+		ensure_equals(findFirst("ab", "abab", 0).size(), 0u);
+		ensure_equals(findFirst("ab", "hello", 5).size(), 0u);
+	}
 }
@@ -0,0 +1,363 @@
+/*
+ * Copyright (c) 2010 Phusion v.o.f.
+ * https://github.com/FooBarWidget/boyer-moore-horspool
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _MULTIPART_PARSER_
+#define _MULTIPART_PARSER_
+
+// Expecting StreamBoyerMooreHorspool.h to be included before this file.
+
+/*
+ * A streaming multipart/form-data (RFC 2046, RFC 7578) parser that finds the
+ * boundaries with StreamBMH.
+ *
+ *   static const struct MultipartCallbacks callbacks = {
+ *      on_part_begin, on_header_field, on_header_value, on_headers_complete,
+ *      on_part_data, on_part_end, on_body_end
+ *   };
+ *
+ *   struct MultipartParser parser;
+ *   if (!multipart_parser_init(&parser, &callbacks, boundary, boundary_len)) {
+ *      // error: the boundary is empty or longer than 70 bytes
+ *   }
+ *   parser.user_data = ...;
+ *   while (... read data ...) {
+ *      if (multipart_parser_feed(&parser, data, len) != len) {
+ *         // error, see parser.error
+ *      }
+ *   }
+ *   ... parser.finished tells whether the closing boundary was seen ...
+ *
+ * The data is fed in pieces of any size. The parser invokes:
+ *
+ * - on_part_begin() after every boundary that starts a part;
+ * - on_header_field() and on_header_value() with the name and the value of
+ *   every part header. Either may be called several times per header with
+ *   consecutive pieces, if the header was fed in pieces. on_header_value() is
+ *   called at least once per header, so an empty value is reported with a
+ *   length of 0. Whitespace after the colon is skipped;
+ *   the value ends at the CRLF.
+ * - on_headers_complete() after the empty line that ends the part headers;
+ * - on_part_data() with consecutive pieces of the part body;
+ * - on_part_end() when the boundary after the part body was found;
+ * - on_body_end() when the closing boundary was found. Any data after it is
+ *   ignored.
+ *
+ * Every callback may be NULL. The data passed to on_header_field(),
+ * on_header_value() and on_part_data() points into the data passed to
+ * multipart_parser_feed(), with one exception: body data that looked like the
+ * start of a boundary at the end of a feed is kept in the lookbehind buffer
+ * of the StreamBMH context, and passed from there once it turns out not to
+ * be a boundary. Only those bytes are copied. Like with the StreamBMH
+ * callback, the data is only valid during the callback.
+ *
+ * multipart_parser_feed() returns the number of bytes that were parsed, which
+ * is less than the given length if the data is malformed. 'error' then
+ * describes the problem, and further calls parse nothing.
+ *
+ * The parser doesn't allocate memory; it takes about 750 bytes.
+ */
+
+#include <cstddef>
+#include <cstring>
+
+/* RFC 2046 limits boundaries to 70 characters. */
+#define MULTIPART_MAX_BOUNDARY_SIZE 70
+/* Maximum size of the headers of one part, including the line ends. */
+#define MULTIPART_MAX_HEADER_SIZE (16 * 1024)
+
+struct MultipartParser;
+
+typedef void (*multipart_cb)(struct MultipartParser *parser);
+typedef void (*multipart_data_cb)(struct MultipartParser *parser, const char *data, size_t len);
+
+struct MultipartCallbacks {
+	multipart_cb      on_part_begin;
+	multipart_data_cb on_header_field;
+	multipart_data_cb on_header_value;
+	multipart_cb      on_headers_complete;
+	multipart_data_cb on_part_data;
+	multipart_cb      on_part_end;
+	multipart_cb      on_body_end;
+};
+
+enum MultipartParserState {
+	MULTIPART_PREAMBLE,
+	MULTIPART_AFTER_BOUNDARY,
+	MULTIPART_AFTER_BOUNDARY_HYPHEN,
+	MULTIPART_AFTER_BOUNDARY_PADDING,
+	MULTIPART_AFTER_BOUNDARY_CR,
+	MULTIPART_HEADER_FIELD_START,
+	MULTIPART_HEADER_FIELD,
+	MULTIPART_HEADER_VALUE_START,
+	MULTIPART_HEADER_VALUE,
+	MULTIPART_HEADER_VALUE_CR,
+	MULTIPART_HEADERS_END_CR,
+	MULTIPART_BODY,
+	MULTIPART_EPILOGUE,
+	MULTIPART_ERROR
+};
+
+struct MultipartParser {
+	/***** Public but read-only fields *****/
+	/* Whether the closing boundary was found. */
+	bool           finished;
+	/* A description of the error, or NULL. */
+	const char    *error;
+
+	/***** Public fields; feel free to populate *****/
+	void          *user_data;
+
+	/***** Internal fields, do not access. *****/
+	const struct MultipartCallbacks *callbacks;
+	enum MultipartParserState state;
+	bool           value_reported;
+	size_t         header_size;
+	sbmh_size_t    delimiter_len;
+	/* CRLF, two hyphens and the boundary. */
+	unsigned char  delimiter[4 + MULTIPART_MAX_BOUNDARY_SIZE];
+	struct StreamBMH_Occ occ;
+	/* Must be last: the lookbehind buffer of 'ctx' follows it. */
+	struct StreamBMH ctx;
+	unsigned char  _lookbehind[4 + MULTIPART_MAX_BOUNDARY_SIZE - 1];
+};
+
+inline void
+_multipart_forward_data(const struct StreamBMH *ctx, const unsigned char *data, size_t len) {
+	struct MultipartParser *parser = (struct MultipartParser *) ctx->user_data;
+	/* Preamble data is ignored. */
+	if (parser->state == MULTIPART_BODY && parser->callbacks->on_part_data != NULL) {
+		parser->callbacks->on_part_data(parser, (const char *) data, len);
+	}
+}
+
+inline void
+_multipart_parser_start(struct MultipartParser *parser) {
+	parser->finished = false;
+	parser->error = NULL;
+	parser->state = MULTIPART_PREAMBLE;
+	parser->value_reported = false;
+	parser->header_size = 0;
+	sbmh_reset(&parser->ctx);
+	/* The first boundary may be at the start of the body, without a
+	 * preceding CRLF.
+	 */
+	sbmh_feed(&parser->ctx, &parser->occ, parser->delimiter, parser->delimiter_len,
+		(const unsigned char *) "\r\n", 2);
+}
+
+/* Returns false if the boundary is empty or longer than MULTIPART_MAX_BOUNDARY_SIZE. */
+inline bool
+multipart_parser_init(struct MultipartParser *parser, const struct MultipartCallbacks *callbacks,
+	const char *boundary, size_t boundary_len)
+{
+	if (boundary_len == 0 || boundary_len > MULTIPART_MAX_BOUNDARY_SIZE) {
+		return false;
+	}
+	parser->user_data = NULL;
+	parser->callbacks = callbacks;
+	parser->delimiter_len = 4 + boundary_len;
+	memcpy(parser->delimiter, "\r\n--", 4);
+	memcpy(parser->delimiter + 4, boundary, boundary_len);
+	sbmh_init(&parser->ctx, &parser->occ, parser->delimiter, parser->delimiter_len);
+	parser->ctx.callback = _multipart_forward_data;
+	parser->ctx.user_data = parser;
+	_multipart_parser_start(parser);
+	return true;
+}
+
+/* Prepares the parser for parsing another body with the same boundary. */
+inline void
+multipart_parser_reset(struct MultipartParser *parser) {
+	_multipart_parser_start(parser);
+}
+
+inline size_t
+_multipart_fail(struct MultipartParser *parser, const char *error, size_t pos) {
+	parser->state = MULTIPART_ERROR;
+	parser->error = error;
+	return pos;
+}
+
+inline size_t
+multipart_parser_feed(struct MultipartParser *parser, const char *data, size_t len) {
+	const struct MultipartCallbacks *callbacks = parser->callbacks;
+	/* Start of the header name or value that is being parsed. */
+	size_t mark = 0;
+	size_t pos = 0;
+
+	while (pos < len) {
+		const char ch = data[pos];
+
+		switch (parser->state) {
+		case MULTIPART_PREAMBLE:
+		case MULTIPART_BODY:
+			pos += sbmh_feed(&parser->ctx, &parser->occ, parser->delimiter, parser->delimiter_len,
+				(const unsigned char *) data + pos, len - pos);
+			if (parser->ctx.found) {
+				if (parser->state == MULTIPART_BODY && callbacks->on_part_end != NULL) {
+					callbacks->on_part_end(parser);
+				}
+				sbmh_reset(&parser->ctx);
+				parser->state = MULTIPART_AFTER_BOUNDARY;
+			}
+			break;
+
+		case MULTIPART_AFTER_BOUNDARY:
+			if (ch == '-') {
+				parser->state = MULTIPART_AFTER_BOUNDARY_HYPHEN;
+				pos++;
+			} else {
+				parser->state = MULTIPART_AFTER_BOUNDARY_PADDING;
+			}
+			break;
+
+		case MULTIPART_AFTER_BOUNDARY_HYPHEN:
+			if (ch != '-') {
+				return _multipart_fail(parser, "Malformed boundary", pos);
+			}
+			parser->finished = true;
+			parser->state = MULTIPART_EPILOGUE;
+			if (callbacks->on_body_end != NULL) {
+				callbacks->on_body_end(parser);
+			}
+			pos++;
+			break;
+
+		case MULTIPART_AFTER_BOUNDARY_PADDING:
+			/* RFC 2046 allows whitespace between the boundary and the CRLF. */
+			if (ch == '\r') {
+				parser->state = MULTIPART_AFTER_BOUNDARY_CR;
+			} else if (ch != ' ' && ch != '\t') {
+				return _multipart_fail(parser, "Malformed boundary", pos);
+			}
+			pos++;
+			break;
+
+		case MULTIPART_AFTER_BOUNDARY_CR:
+			if (ch != '\n') {
+				return _multipart_fail(parser, "Malformed boundary", pos);
+			}
+			parser->state = MULTIPART_HEADER_FIELD_START;
+			parser->header_size = 0;
+			if (callbacks->on_part_begin != NULL) {
+				callbacks->on_part_begin(parser);
+			}
+			pos++;
+			break;
+
+		case MULTIPART_HEADER_FIELD_START:
+			if (ch == '\r') {
+				parser->state = MULTIPART_HEADERS_END_CR;
+				pos++;
+				parser->header_size++;
+			} else {
+				parser->state = MULTIPART_HEADER_FIELD;
+				mark = pos;
+			}
+			break;
+
+		case MULTIPART_HEADER_FIELD:
+			while (pos < len && data[pos] != ':' && data[pos] != '\r' && data[pos] != '\n') {
+				pos++;
+			}
+			parser->header_size += pos - mark;
+			if (pos < len && data[pos] != ':') {
+				return _multipart_fail(parser, "Malformed part header", pos);
+			}
+			if (pos > mark && callbacks->on_header_field != NULL) {
+				callbacks->on_header_field(parser, data + mark, pos - mark);
+			}
+			if (pos < len) {
+				parser->state = MULTIPART_HEADER_VALUE_START;
+				parser->value_reported = false;
+				pos++;
+				parser->header_size++;
+			}
+			break;
+
+		case MULTIPART_HEADER_VALUE_START:
+			if (ch == ' ' || ch == '\t') {
+				pos++;
+				parser->header_size++;
+			} else {
+				parser->state = MULTIPART_HEADER_VALUE;
+				mark = pos;
+			}
+			break;
+
+		case MULTIPART_HEADER_VALUE:
+			while (pos < len && data[pos] != '\r' && data[pos] != '\n') {
+				pos++;
+			}
+			parser->header_size += pos - mark;
+			if (pos < len && data[pos] == '\n') {
+				return _multipart_fail(parser, "Malformed part header", pos);
+			}
+			if ((pos > mark || (pos < len && !parser->value_reported))
+			 && callbacks->on_header_value != NULL)
+			{
+				callbacks->on_header_value(parser, data + mark, pos - mark);
+			}
+			parser->value_reported = true;
+			if (pos < len) {
+				parser->state = MULTIPART_HEADER_VALUE_CR;
+				pos++;
+				parser->header_size++;
+			}
+			break;
+
+		case MULTIPART_HEADER_VALUE_CR:
+			if (ch != '\n') {
+				return _multipart_fail(parser, "Malformed part header", pos);
+			}
+			parser->state = MULTIPART_HEADER_FIELD_START;
+			pos++;
+			parser->header_size++;
+			break;
+
+		case MULTIPART_HEADERS_END_CR:
+			if (ch != '\n') {
+				return _multipart_fail(parser, "Malformed part header", pos);
+			}
+			parser->state = MULTIPART_BODY;
+			if (callbacks->on_headers_complete != NULL) {
+				callbacks->on_headers_complete(parser);
+			}
+			pos++;
+			break;
+
+		case MULTIPART_EPILOGUE:
+			pos = len;
+			break;
+
+		case MULTIPART_ERROR:
+			return 0;
+		}
+
+		if (parser->header_size > MULTIPART_MAX_HEADER_SIZE) {
+			return _multipart_fail(parser, "Part headers too large", pos);
+		}
+	}
+	return pos;
+}
+
+#endif /* _MULTIPART_PARSER_ */
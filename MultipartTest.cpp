@@ -0,0 +1,197 @@
+#include <string>
+#include <vector>
+
+#include "tut.h"
+#include "StreamBoyerMooreHorspool.h"
+#include "MultipartParser.h"
+
+using namespace std;
+
+namespace tut {
+	struct MultipartTest {
+		MultipartParser parser;
+		/* The events, with consecutive pieces of data merged. */
+		vector<string> events;
+		/* Whether all part data pointed into the fed data. */
+		bool zero_copy;
+		const char *fed_begin, *fed_end;
+
+		static MultipartTest *self(MultipartParser *parser) {
+			return (MultipartTest *) parser->user_data;
+		}
+
+		void add(const string &kind, const char *data, size_t len) {
+			if (!events.empty() && events.back().compare(0, kind.size(), kind) == 0) {
+				events.back().append(data, len);
+			} else {
+				events.push_back(kind + string(data, len));
+			}
+		}
+
+		static void on_part_begin(MultipartParser *parser) {
+			self(parser)->events.push_back("begin");
+		}
+
+		static void on_header_field(MultipartParser *parser, const char *data, size_t len) {
+			self(parser)->add("field:", data, len);
+		}
+
+		static void on_header_value(MultipartParser *parser, const char *data, size_t len) {
+			self(parser)->add("value:", data, len);
+		}
+
+		static void on_headers_complete(MultipartParser *parser) {
+			self(parser)->events.push_back("headers");
+		}
+
+		static void on_part_data(MultipartParser *parser, const char *data, size_t len) {
+			MultipartTest *test = self(parser);
+			test->add("data:", data, len);
+			if (data < test->fed_begin || data + len > test->fed_end) {
+				test->zero_copy = false;
+			}
+		}
+
+		static void on_part_end(MultipartParser *parser) {
+			self(parser)->events.push_back("end");
+		}
+
+		static void on_body_end(MultipartParser *parser) {
+			self(parser)->events.push_back("body end");
+		}
+
+		/* Parses the body in chunks of the given size. Returns the number of
+		 * bytes parsed.
+		 */
+		size_t parse(const string &body, size_t chunk_size, const string &boundary = "xyz") {
+			static const MultipartCallbacks callbacks = {
+				on_part_begin, on_header_field, on_header_value, on_headers_complete,
+				on_part_data, on_part_end, on_body_end
+			};
+			ensure(multipart_parser_init(&parser, &callbacks, boundary.data(), boundary.size()));
+			parser.user_data = this;
+			events.clear();
+			zero_copy = true;
+			size_t pos = 0;
+			while (pos < body.size()) {
+				size_t len = min(chunk_size, body.size() - pos);
+				fed_begin = body.data() + pos;
+				fed_end = fed_begin + len;
+				size_t parsed = multipart_parser_feed(&parser, body.data() + pos, len);
+				pos += parsed;
+				if (parsed != len) {
+					break;
+				}
+			}
+			return pos;
+		}
+
+		string joined() const {
+			string result;
+			for (size_t i = 0; i < events.size(); i++) {
+				result += events[i] + "|";
+			}
+			return result;
+		}
+	};
+
+	DEFINE_TEST_GROUP(MultipartTest);
+
+	static const string form =
+		"This is the preamble.\r\n"
+		"--xyz\r\n"
+		"Content-Disposition: form-data; name=\"field1\"\r\n"
+		"\r\n"
+		"value1\r\n"
+		"--xyz  \r\n"
+		"Content-Disposition: form-data; name=\"file\"; filename=\"a.txt\"\r\n"
+		"Content-Type:text/plain\r\n"
+		"X-Empty:\r\n"
+		"\r\n"
+		"line 1\r\n--xy\r\nnot a boundary: --xyz\r\n"
+		"\r\n"
+		"--xyz--\r\n"
+		"This is the epilogue.\r\n--xyz\r\n";
+
+	static const string expected_events =
+		"begin|field:Content-Disposition|value:form-data; name=\"field1\"|headers|"
+		"data:value1|end|"
+		"begin|field:Content-Disposition|value:form-data; name=\"file\"; filename=\"a.txt\"|"
+		"field:Content-Type|value:text/plain|field:X-Empty|value:|headers|"
+		"data:line 1\r\n--xy\r\nnot a boundary: --xyz\r\n|end|body end|";
+
+	TEST_METHOD(1) {
+		set_test_name("It parses the parts of a form");
+		ensure_equals(parse(form, form.size()), form.size());
+		ensure_equals(joined(), expected_events);
+		ensure("finished", parser.finished);
+		ensure("no error", parser.error == NULL);
+		ensure("part data points into the fed data", zero_copy);
+	}
+
+	TEST_METHOD(2) {
+		set_test_name("It parses the same events when fed in chunks of any size");
+		for (size_t chunk_size = 1; chunk_size < form.size(); chunk_size++) {
+			ensure_equals(parse(form, chunk_size), form.size());
+			ensure_equals(("chunk size " + to_string(chunk_size)).c_str(), joined(), expected_events);
+			ensure("finished", parser.finished);
+		}
+	}
+
+	TEST_METHOD(3) {
+		set_test_name("The first boundary may start the body, and a body may be empty");
+		string body = "--b\r\n\r\n\r\n--b\r\nA: 1\r\n\r\nx\r\n--b--";
+		ensure_equals(parse(body, body.size(), "b"), body.size());
+		ensure_equals(joined(), "begin|headers|end|begin|field:A|value:1|headers|data:x|end|body end|");
+	}
+
+	TEST_METHOD(4) {
+		set_test_name("Only data that could be the start of a boundary is copied");
+		string body = "--xyz\r\n\r\n" + string(1000, 'a') + "\r\n--x";
+		parse(body, body.size());
+		ensure("zero copy", zero_copy);
+		ensure_equals(events.back(), "data:" + string(1000, 'a'));
+		ensure("not finished", !parser.finished);
+
+		fed_begin = fed_end = NULL;
+		zero_copy = true;
+		ensure_equals(multipart_parser_feed(&parser, "y!", 2), 2u);
+		ensure("the lookbehind data was copied", !zero_copy);
+		ensure_equals(events.back(), "data:" + string(1000, 'a') + "\r\n--xy!");
+	}
+
+	TEST_METHOD(5) {
+		set_test_name("Malformed input is reported");
+		string body = "--xyz\r\nNo colon\r\n\r\n";
+		ensure_equals(parse(body, body.size()), 15u);
+		ensure("error", parser.error != NULL);
+		ensure_equals(multipart_parser_feed(&parser, "more", 4), 0u);
+
+		body = "--xyz-x\r\n";
+		ensure_equals(parse(body, 3), 6u);
+		ensure("error", parser.error != NULL);
+
+		body = "--xyz\r\nA: " + string(MULTIPART_MAX_HEADER_SIZE, 'a') + "\r\n\r\n";
+		ensure(parse(body, 100) < body.size());
+		ensure_equals(string(parser.error), "Part headers too large");
+
+		static const MultipartCallbacks callbacks = { };
+		ensure("empty boundary", !multipart_parser_init(&parser, &callbacks, "", 0));
+		string boundary(MULTIPART_MAX_BOUNDARY_SIZE + 1, 'b');
+		ensure("long boundary", !multipart_parser_init(&parser, &callbacks, boundary.data(), boundary.size()));
+		boundary.resize(MULTIPART_MAX_BOUNDARY_SIZE);
+		ensure("longest boundary", multipart_parser_init(&parser, &callbacks, boundary.data(), boundary.size()));
+	}
+
+	TEST_METHOD(6) {
+		set_test_name("A reset parser parses another body");
+		ensure_equals(parse(form, 7), form.size());
+		events.clear();
+		multipart_parser_reset(&parser);
+		ensure("not finished", !parser.finished);
+		fed_begin = form.data();
+		fed_end = fed_begin + form.size();
+		ensure_equals(multipart_parser_feed(&parser, form.data(), form.size()), form.size());
+		ensure_equals(joined(), expected_events);
+	}
+}
@@ -0,0 +1,621 @@
+/*
+ * Copyright (c) 2010 Phusion v.o.f.
+ * https://github.com/FooBarWidget/boyer-moore-horspool
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _NEEDLE_CACHE_
+#define _NEEDLE_CACHE_
+
+// Expecting Horspool.cpp, BoyerMooreAndTurbo.cpp and StreamBoyerMooreHorspool.h
+// to be included before this file.
+
+/*
+ * A cache of prepared needles that is shared by all threads, for programs
+ * that search for needles from a large working set and would otherwise
+ * create the tables on every search:
+ *
+ *   NeedleCache cache(16 * 1024 * 1024);   // At most 16 MB of tables.
+ *
+ *   // In any thread:
+ *   {
+ *      NeedleCache::Handle prepared = cache.lookup(needle, needle_len);
+ *      if (!prepared) {
+ *         // out of memory...
+ *      }
+ *      SearchInHorspool(haystack, len, prepared->occ, needle, needle_len);
+ *      SearchIn(haystack, len, prepared->occ, prepared->skip, needle, needle_len);
+ *      sbmh_feed(ctx, &prepared->sbmh_occ, needle, needle_len, data, len);
+ *   }
+ *
+ * A PreparedNeedle holds the occ table for Horspool, Boyer-Moore and Turbo
+ * Boyer-Moore, the skip table for the latter two, and a StreamBMH_Occ. The
+ * StreamBMH_Occ is only valid for needles that fit in a sbmh_size_t. A
+ * cache that is only used with some of the algorithms can be told to only
+ * create the tables they need, which makes misses cheaper and lets more
+ * needles fit in the same memory:
+ *
+ *   NeedleCache cache(16 * 1024 * 1024, NEEDLE_CACHE_SBMH_OCC);
+ *
+ * The prepared needle stays valid for as long as the handle exists, even if
+ * it is evicted in the meantime. A handle must be destroyed by the thread
+ * that created it, and should be held for one search only: while a thread
+ * holds a handle, no evicted entry can be freed. A stream that is fed over
+ * several calls can look its needle up again for every call, as the tables
+ * of the same needle are always the same.
+ *
+ * == How it works
+ *
+ * Entries live in an open addressing hash table of atomic pointers. Lookups
+ * take no locks and write no shared memory in the common case: a hit only
+ * sets the entry's 'referenced' flag if it's not already set. Misses create
+ * the tables outside of any lock, and then insert the entry while holding
+ * the cache's mutex; if another thread inserted the same needle in the
+ * meantime, its entry is used instead.
+ *
+ * Memory is bounded by evicting entries with the CLOCK algorithm when the
+ * total size of the entries exceeds the limit: a hand sweeps over the table,
+ * clears the 'referenced' flag of entries that have it and evicts the first
+ * entry that doesn't. Evicted entries leave a tombstone; when there are too
+ * many tombstones the table is rebuilt and the new table is published with
+ * a single pointer swap.
+ *
+ * Evicted entries and old tables are freed with a simple form of RCU
+ * (read-copy-update). Every thread that looks up needles has a reader slot
+ * in which it announces the global epoch when it creates a handle. Retired
+ * objects are tagged with the epoch at the time they were unlinked, and are
+ * only freed once no reader slot holds that epoch or an older one. Creating
+ * a handle thus costs one memory fence, instead of a reference count update
+ * on a shared cache line.
+ *
+ * Hits and misses are counted in per-thread stripes, so that the counters
+ * do not become the contended cache line either.
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <climits>
+#include <string>
+#include <vector>
+#include <new>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+
+#define NEEDLE_CACHE_CACHE_LINE 64
+#define NEEDLE_CACHE_COUNTER_STRIPES 16
+
+/* The tables that a cache creates for every needle. */
+#define NEEDLE_CACHE_OCC 1
+#define NEEDLE_CACHE_SKIP 2
+#define NEEDLE_CACHE_SBMH_OCC 4
+#define NEEDLE_CACHE_ALL_TABLES (NEEDLE_CACHE_OCC | NEEDLE_CACHE_SKIP | NEEDLE_CACHE_SBMH_OCC)
+
+struct PreparedNeedle {
+	std::string needle;
+	uint64_t hash;
+	occtable_type occ;
+	skiptable_type skip;
+	struct StreamBMH_Occ sbmh_occ;
+	/* The number of bytes this entry counts for against the cache limit. */
+	size_t footprint;
+	/* Set by lookups, cleared by the CLOCK hand. */
+	std::atomic<bool> referenced;
+};
+
+struct NeedleCacheStats {
+	unsigned long long hits;
+	unsigned long long misses;
+	unsigned long long evictions;
+	size_t entries;
+	size_t bytes;
+};
+
+
+/***** The RCU domain, shared by all caches *****/
+
+struct alignas(NEEDLE_CACHE_CACHE_LINE) _NeedleCacheReader {
+	/* The epoch in which the current read section started, or 0 if the
+	 * thread is not in a read section.
+	 */
+	std::atomic<uint64_t> epoch;
+	/* The number of handles the thread holds; only accessed by the thread. */
+	unsigned int depth;
+	unsigned int index;
+	/* Protected by the domain lock. */
+	bool abandoned;
+	/* Never changes once the slot has been published. */
+	struct _NeedleCacheReader *next;
+};
+
+struct _NeedleCacheDomain {
+	std::atomic<uint64_t> epoch;
+	std::mutex lock;
+	std::atomic<struct _NeedleCacheReader *> readers;
+	unsigned int reader_count;
+};
+
+inline struct _NeedleCacheDomain &
+_needle_cache_domain() {
+	static _NeedleCacheDomain domain = { { 1 }, {}, { NULL }, 0 };
+	return domain;
+}
+
+/* Hands the reader slot of an exiting thread over to the next new thread. */
+struct _NeedleCacheThreadReader {
+	struct _NeedleCacheReader *reader;
+
+	~_NeedleCacheThreadReader() {
+		if (reader != NULL) {
+			std::lock_guard<std::mutex> guard(_needle_cache_domain().lock);
+			reader->abandoned = true;
+		}
+	}
+};
+
+inline struct _NeedleCacheReader *&
+_needle_cache_current_reader() {
+	static thread_local _NeedleCacheThreadReader thread_reader = { NULL };
+	return thread_reader.reader;
+}
+
+inline struct _NeedleCacheReader *
+_needle_cache_adopt_reader() {
+	_NeedleCacheDomain &domain = _needle_cache_domain();
+	std::lock_guard<std::mutex> guard(domain.lock);
+	_NeedleCacheReader *head = domain.readers.load(std::memory_order_relaxed);
+	for (_NeedleCacheReader *reader = head; reader != NULL; reader = reader->next) {
+		if (reader->abandoned) {
+			reader->abandoned = false;
+			return reader;
+		}
+	}
+
+	_NeedleCacheReader *reader = new _NeedleCacheReader();
+	reader->epoch.store(0, std::memory_order_relaxed);
+	reader->depth = 0;
+	reader->index = domain.reader_count++;
+	reader->abandoned = false;
+	reader->next = head;
+	domain.readers.store(reader, std::memory_order_release);
+	return reader;
+}
+
+inline struct _NeedleCacheReader *
+_needle_cache_read_lock() {
+	_NeedleCacheReader *&reader = _needle_cache_current_reader();
+	if (unlikely(reader == NULL)) {
+		reader = _needle_cache_adopt_reader();
+	}
+	if (reader->depth++ == 0) {
+		reader->epoch.store(_needle_cache_domain().epoch.load(std::memory_order_acquire),
+			std::memory_order_relaxed);
+		/* Makes the epoch visible to writers before anything is read from
+		 * the cache. Pairs with the fence in _needle_cache_oldest_reader().
+		 */
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+	return reader;
+}
+
+inline void
+_needle_cache_read_unlock(struct _NeedleCacheReader *reader) {
+	if (--reader->depth == 0) {
+		reader->epoch.store(0, std::memory_order_release);
+	}
+}
+
+/* Returns the oldest epoch that a reader may still be using. Objects that
+ * were retired in an older epoch can be freed.
+ */
+inline uint64_t
+_needle_cache_oldest_reader() {
+	/* Orders the unlinking of retired objects before reading the reader slots. */
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	_NeedleCacheDomain &domain = _needle_cache_domain();
+	uint64_t oldest = domain.epoch.load(std::memory_order_acquire);
+	for (_NeedleCacheReader *reader = domain.readers.load(std::memory_order_acquire);
+	     reader != NULL; reader = reader->next)
+	{
+		uint64_t epoch = reader->epoch.load(std::memory_order_acquire);
+		if (epoch != 0 && epoch < oldest) {
+			oldest = epoch;
+		}
+	}
+	return oldest;
+}
+
+
+/***** The cache *****/
+
+struct _NeedleCacheTable {
+	size_t mask;
+	std::atomic<PreparedNeedle *> *slots;
+};
+
+class NeedleCache {
+public:
+	/* Keeps a prepared needle alive; see the top of this file. */
+	class Handle {
+	private:
+		struct _NeedleCacheReader *reader;
+		const PreparedNeedle *entry;
+
+		friend class NeedleCache;
+
+		Handle(struct _NeedleCacheReader *reader)
+			: reader(reader),
+			  entry(NULL)
+			{ }
+
+	public:
+		Handle(Handle &&other)
+			: reader(other.reader),
+			  entry(other.entry)
+		{
+			other.reader = NULL;
+			other.entry = NULL;
+		}
+
+		~Handle() {
+			if (reader != NULL) {
+				_needle_cache_read_unlock(reader);
+			}
+		}
+
+		Handle(const Handle &) = delete;
+		Handle &operator=(const Handle &) = delete;
+
+		const PreparedNeedle *get() const {
+			return entry;
+		}
+
+		const PreparedNeedle *operator->() const {
+			return entry;
+		}
+
+		const PreparedNeedle &operator*() const {
+			return *entry;
+		}
+
+		explicit operator bool() const {
+			return entry != NULL;
+		}
+	};
+
+private:
+	struct Counters {
+		alignas(NEEDLE_CACHE_CACHE_LINE) std::atomic<unsigned long long> hits;
+		std::atomic<unsigned long long> misses;
+	};
+
+	struct Retired {
+		uint64_t epoch;
+		PreparedNeedle *entry;
+		_NeedleCacheTable *table;
+	};
+
+	/***** Read by lookups *****/
+	std::atomic<_NeedleCacheTable *> table;
+	const unsigned int tables;
+	Counters counters[NEEDLE_CACHE_COUNTER_STRIPES];
+
+	/***** Protected by 'lock' *****/
+	alignas(NEEDLE_CACHE_CACHE_LINE) std::mutex lock;
+	size_t max_bytes;
+	size_t bytes;
+	size_t entries;
+	/* Entries plus tombstones. */
+	size_t used_slots;
+	size_t clock_hand;
+	unsigned long long evictions;
+	std::vector<Retired> retired;
+
+	/* Marks a slot whose entry has been evicted. Lookups skip it. */
+	static PreparedNeedle *tombstone() {
+		return reinterpret_cast<PreparedNeedle *>(uintptr_t(1));
+	}
+
+	static uint64_t hash(const unsigned char *needle, size_t needle_len) {
+		uint64_t h = needle_len * 0x9E3779B97F4A7C15ULL;
+		size_t i = 0;
+		for (; i + 8 <= needle_len; i += 8) {
+			uint64_t word;
+			memcpy(&word, needle + i, 8);
+			h = (h ^ word) * 0xFF51AFD7ED558CCDULL;
+			h ^= h >> 32;
+		}
+		if (i < needle_len) {
+			uint64_t word = 0;
+			memcpy(&word, needle + i, needle_len - i);
+			h = (h ^ word) * 0xFF51AFD7ED558CCDULL;
+			h ^= h >> 32;
+		}
+		return h ^ (h >> 29);
+	}
+
+	static _NeedleCacheTable *createTable(size_t slots) {
+		_NeedleCacheTable *table = new _NeedleCacheTable();
+		table->mask = slots - 1;
+		table->slots = new std::atomic<PreparedNeedle *>[slots];
+		for (size_t i = 0; i < slots; i++) {
+			table->slots[i].store(NULL, std::memory_order_relaxed);
+		}
+		return table;
+	}
+
+	static void destroyTable(_NeedleCacheTable *table) {
+		delete[] table->slots;
+		delete table;
+	}
+
+	PreparedNeedle *prepare(const unsigned char *needle, size_t needle_len, uint64_t hash) const {
+		PreparedNeedle *entry = new PreparedNeedle();
+		entry->needle.assign((const char *) needle, needle_len);
+		entry->hash = hash;
+		if (tables & NEEDLE_CACHE_OCC) {
+			entry->occ = CreateOccTable(needle, needle_len);
+		}
+		if (tables & NEEDLE_CACHE_SKIP) {
+			entry->skip = CreateSkipTable(needle, needle_len);
+		}
+		if ((tables & NEEDLE_CACHE_SBMH_OCC) && needle_len <= sbmh_size_t(-1)) {
+			sbmh_init(NULL, &entry->sbmh_occ, needle, needle_len);
+		} else {
+			memset(&entry->sbmh_occ, 0, sizeof(entry->sbmh_occ));
+		}
+		entry->footprint = sizeof(PreparedNeedle) + entry->needle.capacity()
+			+ (entry->occ.capacity() + entry->skip.capacity()) * sizeof(size_t);
+		entry->referenced.store(true, std::memory_order_relaxed);
+		return entry;
+	}
+
+	Counters &localCounters(const struct _NeedleCacheReader *reader) {
+		return counters[reader->index % NEEDLE_CACHE_COUNTER_STRIPES];
+	}
+
+	/* Unlinks the entry in the given slot. Called with the lock held. */
+	void evict(_NeedleCacheTable *t, size_t slot, PreparedNeedle *entry) {
+		t->slots[slot].store(tombstone(), std::memory_order_release);
+		bytes -= entry->footprint;
+		entries--;
+		evictions++;
+		retire(entry, NULL);
+	}
+
+	void retire(PreparedNeedle *entry, _NeedleCacheTable *old_table) {
+		Retired r;
+		r.epoch = _needle_cache_domain().epoch.fetch_add(1);
+		r.entry = entry;
+		r.table = old_table;
+		retired.push_back(r);
+	}
+
+	/* Frees the retired objects that no reader can be using anymore.
+	 * Called with the lock held.
+	 */
+	void reclaim() {
+		if (retired.empty()) {
+			return;
+		}
+		const uint64_t oldest = _needle_cache_oldest_reader();
+		size_t kept = 0;
+		for (size_t i = 0; i < retired.size(); i++) {
+			if (retired[i].epoch < oldest) {
+				delete retired[i].entry;
+				if (retired[i].table != NULL) {
+					destroyTable(retired[i].table);
+				}
+			} else {
+				retired[kept++] = retired[i];
+			}
+		}
+		retired.resize(kept);
+	}
+
+	/* Evicts entries until the cache is within its limit. Called with the lock held. */
+	void evictToLimit(_NeedleCacheTable *t) {
+		while (bytes > max_bytes && entries > 0) {
+			const size_t slot = clock_hand;
+			clock_hand = (clock_hand + 1) & t->mask;
+			PreparedNeedle *entry = t->slots[slot].load(std::memory_order_relaxed);
+			if (entry == NULL || entry == tombstone()) {
+				continue;
+			}
+			if (entry->referenced.load(std::memory_order_relaxed)) {
+				entry->referenced.store(false, std::memory_order_relaxed);
+			} else {
+				evict(t, slot, entry);
+			}
+		}
+	}
+
+	/* Replaces the table with one without tombstones. Called with the lock held. */
+	_NeedleCacheTable *rebuild(_NeedleCacheTable *old_table) {
+		_NeedleCacheTable *t = createTable(old_table->mask + 1);
+		for (size_t i = 0; i <= old_table->mask; i++) {
+			PreparedNeedle *entry = old_table->slots[i].load(std::memory_order_relaxed);
+			if (entry == NULL || entry == tombstone()) {
+				continue;
+			}
+			size_t slot = entry->hash & t->mask;
+			while (t->slots[slot].load(std::memory_order_relaxed) != NULL) {
+				slot = (slot + 1) & t->mask;
+			}
+			t->slots[slot].store(entry, std::memory_order_relaxed);
+		}
+		table.store(t, std::memory_order_release);
+		used_slots = entries;
+		clock_hand = 0;
+		retire(NULL, old_table);
+		return t;
+	}
+
+	/* Inserts a newly prepared entry, or returns the entry that another
+	 * thread inserted for the same needle. Returns NULL if out of memory.
+	 */
+	const PreparedNeedle *insert(const unsigned char *needle, size_t needle_len, uint64_t h) {
+		PreparedNeedle *entry;
+		try {
+			entry = prepare(needle, needle_len, h);
+		} catch (const std::bad_alloc &) {
+			return NULL;
+		}
+
+		std::lock_guard<std::mutex> guard(lock);
+		_NeedleCacheTable *t = table.load(std::memory_order_relaxed);
+		size_t free_slot = t->mask + 1;
+		size_t slot = h & t->mask;
+		while (true) {
+			PreparedNeedle *existing = t->slots[slot].load(std::memory_order_relaxed);
+			if (existing == NULL) {
+				break;
+			} else if (existing == tombstone()) {
+				if (free_slot > t->mask) {
+					free_slot = slot;
+				}
+			} else if (existing->hash == h && existing->needle.size() == needle_len
+				&& memcmp(existing->needle.data(), needle, needle_len) == 0)
+			{
+				delete entry;
+				return existing;
+			}
+			slot = (slot + 1) & t->mask;
+		}
+		if (free_slot > t->mask) {
+			free_slot = slot;
+			used_slots++;
+		}
+		t->slots[free_slot].store(entry, std::memory_order_release);
+		bytes += entry->footprint;
+		entries++;
+
+		evictToLimit(t);
+		if (used_slots > (t->mask + 1) / 4 * 3) {
+			try {
+				rebuild(t);
+			} catch (const std::bad_alloc &) {
+				// Try again on the next insert.
+			}
+		}
+		reclaim();
+		return entry;
+	}
+
+public:
+	/* Creates a cache whose entries take up at most about 'max_bytes'
+	 * bytes. Evicted entries that readers may still be using are freed
+	 * later, and are not counted. 'tables' is a combination of the
+	 * NEEDLE_CACHE_* table flags.
+	 */
+	explicit NeedleCache(size_t max_bytes, unsigned int tables = NEEDLE_CACHE_ALL_TABLES)
+		: tables(tables),
+		  max_bytes(max_bytes),
+		  bytes(0),
+		  entries(0),
+		  used_slots(0),
+		  clock_hand(0),
+		  evictions(0)
+	{
+		/* This bounds the number of entries. Keep the table at most half
+		 * full with entries.
+		 */
+		size_t min_footprint = sizeof(PreparedNeedle);
+		if (tables & NEEDLE_CACHE_OCC) {
+			min_footprint += (UCHAR_MAX + 1) * sizeof(size_t);
+		}
+		const size_t max_entries = max_bytes / min_footprint + 1;
+		size_t slots = 16;
+		while (slots < max_entries * 2) {
+			slots *= 2;
+		}
+		table.store(createTable(slots), std::memory_order_relaxed);
+		for (unsigned int i = 0; i < NEEDLE_CACHE_COUNTER_STRIPES; i++) {
+			counters[i].hits.store(0, std::memory_order_relaxed);
+			counters[i].misses.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	/* No thread may be holding a handle of this cache. */
+	~NeedleCache() {
+		_NeedleCacheTable *t = table.load(std::memory_order_relaxed);
+		for (size_t i = 0; i <= t->mask; i++) {
+			PreparedNeedle *entry = t->slots[i].load(std::memory_order_relaxed);
+			if (entry != NULL && entry != tombstone()) {
+				delete entry;
+			}
+		}
+		destroyTable(t);
+		for (size_t i = 0; i < retired.size(); i++) {
+			delete retired[i].entry;
+			if (retired[i].table != NULL) {
+				destroyTable(retired[i].table);
+			}
+		}
+	}
+
+	NeedleCache(const NeedleCache &) = delete;
+	NeedleCache &operator=(const NeedleCache &) = delete;
+
+	/* Returns a handle to the prepared tables of the given needle, creating
+	 * them if they're not in the cache. The handle is empty if out of memory.
+	 */
+	Handle lookup(const unsigned char *needle, size_t needle_len) {
+		Handle handle(_needle_cache_read_lock());
+		const uint64_t h = hash(needle, needle_len);
+		_NeedleCacheTable *t = table.load(std::memory_order_acquire);
+		for (size_t slot = h & t->mask; ; slot = (slot + 1) & t->mask) {
+			PreparedNeedle *entry = t->slots[slot].load(std::memory_order_acquire);
+			if (entry == NULL) {
+				break;
+			}
+			if (entry != tombstone() && entry->hash == h && entry->needle.size() == needle_len
+				&& memcmp(entry->needle.data(), needle, needle_len) == 0)
+			{
+				if (!entry->referenced.load(std::memory_order_relaxed)) {
+					entry->referenced.store(true, std::memory_order_relaxed);
+				}
+				localCounters(handle.reader).hits.fetch_add(1, std::memory_order_relaxed);
+				handle.entry = entry;
+				return handle;
+			}
+		}
+
+		localCounters(handle.reader).misses.fetch_add(1, std::memory_order_relaxed);
+		handle.entry = insert(needle, needle_len, h);
+		return handle;
+	}
+
+	NeedleCacheStats stats() {
+		NeedleCacheStats result;
+		result.hits = 0;
+		result.misses = 0;
+		for (unsigned int i = 0; i < NEEDLE_CACHE_COUNTER_STRIPES; i++) {
+			result.hits += counters[i].hits.load(std::memory_order_relaxed);
+			result.misses += counters[i].misses.load(std::memory_order_relaxed);
+		}
+		std::lock_guard<std::mutex> guard(lock);
+		result.evictions = evictions;
+		result.entries = entries;
+		result.bytes = bytes;
+		return result;
+	}
+};
+
+#endif /* _NEEDLE_CACHE_ */
@@ -0,0 +1,151 @@
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include "tut.h"
+#include "Horspool.cpp"
+#include "BoyerMooreAndTurbo.cpp"
+#include "StreamBoyerMooreHorspool.h"
+#include "NeedleCache.h"
+
+using namespace std;
+
+namespace tut {
+	struct NeedleCacheTest {
+		static NeedleCache::Handle lookup(NeedleCache &cache, const string &needle) {
+			return cache.lookup((const unsigned char *) needle.data(), needle.size());
+		}
+
+		static string numberedNeedle(unsigned int i) {
+			char buf[64];
+			snprintf(buf, sizeof(buf), "needle number %u;", i);
+			return buf;
+		}
+	};
+
+	DEFINE_TEST_GROUP(NeedleCacheTest);
+
+	TEST_METHOD(1) {
+		set_test_name("It returns the same tables as creating them directly");
+
+		NeedleCache cache(1024 * 1024);
+		const string needle = "I have control\n";
+		const unsigned char *n = (const unsigned char *) needle.data();
+		NeedleCache::Handle prepared = lookup(cache, needle);
+		ensure("prepared", (bool) prepared);
+		ensure("needle", prepared->needle == needle);
+		ensure("occ table", prepared->occ == CreateOccTable(n, needle.size()));
+		ensure("skip table", prepared->skip == CreateSkipTable(n, needle.size()));
+		StreamBMH_Occ occ;
+		sbmh_init(NULL, &occ, n, needle.size());
+		ensure("StreamBMH occ table", memcmp(&occ, &prepared->sbmh_occ, sizeof(occ)) == 0);
+
+		const string haystack = "xxxxxxxxI have control\nxx";
+		const unsigned char *h = (const unsigned char *) haystack.data();
+		ensure_equals(SearchInHorspool(h, haystack.size(), prepared->occ, n, needle.size()), 8u);
+		ensure_equals(SearchInTurbo(h, haystack.size(), prepared->occ, prepared->skip,
+			n, needle.size()), 8u);
+	}
+
+	TEST_METHOD(2) {
+		set_test_name("Looking up a cached needle is a hit and returns the same entry");
+
+		NeedleCache cache(1024 * 1024);
+		const PreparedNeedle *first = lookup(cache, "hello").get();
+		const PreparedNeedle *second = lookup(cache, "hello").get();
+		const PreparedNeedle *other = lookup(cache, "hello!").get();
+		const PreparedNeedle *prefix = lookup(cache, "hell").get();
+		ensure("same entry", first == second);
+		ensure("longer needle", other != first);
+		ensure("shorter needle", prefix != first);
+
+		NeedleCacheStats stats = cache.stats();
+		ensure_equals(stats.hits, 1u);
+		ensure_equals(stats.misses, 3u);
+		ensure_equals(stats.entries, 3u);
+		ensure_equals(stats.evictions, 0u);
+	}
+
+	TEST_METHOD(3) {
+		set_test_name("Memory is bounded, and often used needles are not evicted");
+
+		const size_t max_bytes = 64 * 1024;
+		NeedleCache cache(max_bytes);
+		for (unsigned int i = 0; i < 1000; i++) {
+			lookup(cache, "the hot needle");
+			lookup(cache, numberedNeedle(i));
+			ensure("within the limit", cache.stats().bytes <= max_bytes);
+		}
+		NeedleCacheStats stats = cache.stats();
+		ensure("evicted", stats.evictions > 900);
+		ensure_equals(stats.misses, 1001u);
+
+		ensure("still cached", lookup(cache, "the hot needle")->needle == "the hot needle");
+		ensure_equals(cache.stats().misses, 1001u);
+		lookup(cache, numberedNeedle(0));
+		ensure_equals(cache.stats().misses, 1002u);
+	}
+
+	TEST_METHOD(4) {
+		set_test_name("A handle keeps an evicted entry alive");
+
+		NeedleCache cache(16 * 1024);
+		NeedleCache::Handle held = lookup(cache, "held needle");
+		for (unsigned int i = 0; i < 200; i++) {
+			lookup(cache, numberedNeedle(i));
+		}
+		ensure("evicted", cache.stats().evictions > 100);
+		ensure("needle", held->needle == "held needle");
+		ensure("occ table", held->occ == CreateOccTable((const unsigned char *) "held needle", 11));
+
+		/* A new lookup prepares it again. */
+		NeedleCache::Handle again = lookup(cache, "held needle");
+		ensure("needle", again->needle == "held needle");
+	}
+
+	TEST_METHOD(5) {
+		set_test_name("Threads can look up and evict needles concurrently");
+
+		NeedleCache cache(256 * 1024);
+		atomic<unsigned int> failures(0);
+		vector<thread> threads;
+		for (unsigned int t = 0; t < 4; t++) {
+			threads.push_back(thread([&cache, &failures, t]() {
+				unsigned int seed = t + 1;
+				for (unsigned int i = 0; i < 20000; i++) {
+					seed = seed * 1103515245 + 12345;
+					const string needle = numberedNeedle((seed >> 16) % 500);
+					NeedleCache::Handle prepared = lookup(cache, needle);
+					if (!prepared || prepared->needle != needle
+					 || prepared->occ[(unsigned char) 'n'] != needle.size() - 8)
+					{
+						failures++;
+					}
+				}
+			}));
+		}
+		for (size_t i = 0; i < threads.size(); i++) {
+			threads[i].join();
+		}
+
+		NeedleCacheStats stats = cache.stats();
+		ensure_equals(failures.load(), 0u);
+		ensure_equals(stats.hits + stats.misses, 80000u);
+		ensure("evicted", stats.evictions > 0);
+		ensure("within the limit", stats.bytes <= 256 * 1024);
+	}
+
+	TEST_METHOD(6) {
+		set_test_name("It only creates the tables it is asked for");
+
+		NeedleCache cache(1024 * 1024, NEEDLE_CACHE_SBMH_OCC);
+		const string needle = "I have control\n";
+		NeedleCache::Handle prepared = lookup(cache, needle);
+		ensure("no occ table", prepared->occ.empty());
+		ensure("no skip table", prepared->skip.empty());
+		StreamBMH_Occ occ;
+		sbmh_init(NULL, &occ, (const unsigned char *) needle.data(), needle.size());
+		ensure("StreamBMH occ table", memcmp(&occ, &prepared->sbmh_occ, sizeof(occ)) == 0);
+	}
+}
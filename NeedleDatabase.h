@@ -0,0 +1,413 @@
+/*
+ * Copyright (c) 2010 Phusion v.o.f.
+ * https://github.com/FooBarWidget/boyer-moore-horspool
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _NEEDLE_DATABASE_
+#define _NEEDLE_DATABASE_
+
+// Expecting Horspool.cpp, BoyerMooreAndTurbo.cpp and StreamBoyerMooreHorspool.h
+// to be included before this file.
+
+/*
+ * A file of prepared needles that is memory-mapped read-only and used as is,
+ * so that a program that searches for very many needles doesn't have to
+ * prepare them every time it starts, and processes that map the same file
+ * share its tables through the page cache:
+ *
+ *   // Once, when the needles change:
+ *   const unsigned char *needles[] = { ... };
+ *   size_t lengths[] = { ... };
+ *   if (!needle_db_write("needles.db", needles, lengths, count, NEEDLE_DB_SKIP)) {
+ *      // error, see errno...
+ *   }
+ *
+ *   // In every process:
+ *   struct NeedleDB db;
+ *   if (!needle_db_open(&db, "needles.db")) {
+ *      // error, see errno...
+ *   }
+ *   struct NeedleDBEntry entry;
+ *   if (needle_db_find(&db, needle, needle_len, &entry)) {   // Or needle_db_get(&db, i, &entry)
+ *      SearchInHorspool(haystack, len, entry.occ->occ, entry.needle, entry.needle_len);
+ *      SearchIn(haystack, len, entry.occ->occ, entry.skip, entry.needle, entry.needle_len);
+ *      sbmh_feed(ctx, entry.occ, entry.needle, entry.needle_len, data, len);
+ *   }
+ *   needle_db_close(&db);
+ *
+ * Horspool, Boyer-Moore, Turbo Boyer-Moore and StreamBMH all use the same
+ * occ table, so it is stored once per needle, as a StreamBMH_Occ. The search
+ * functions accept any table that can be indexed, so they take the 'occ'
+ * array of the StreamBMH_Occ and the 'skip' array directly. Skip tables are
+ * only stored if NEEDLE_DB_SKIP is passed. Needles are at most as long as a
+ * sbmh_size_t can represent.
+ *
+ * Errors are reported by returning false and setting errno. A file that is
+ * not a needle database, that is truncated, or that was written with a
+ * different byte order or sbmh_size_t, fails with EINVAL.
+ *
+ * == File format
+ *
+ * All integers are in the byte order of the machine that wrote the file,
+ * which the header records. Everything is addressed by its offset from the
+ * start of the file, so the file can be mapped at any address.
+ *
+ *   header            struct NeedleDBHeader
+ *   records           struct NeedleDBRecord[needle_count], one per needle
+ *   hash index        uint32_t[hash_slots]: record index + 1, or 0 if empty
+ *   occ tables        struct StreamBMH_Occ per needle, 64-byte aligned
+ *   skip tables       sbmh_size_t[needle_len] per needle, if any
+ *   needles           the needle bytes
+ *
+ * The hash index is an open addressing table with linear probing, keyed by
+ * the hash in the record. needle_db_open() only checks the header; the
+ * offsets of a record are checked when it is used, so that opening a
+ * database takes constant time and only touches the pages that are used.
+ *
+ * needle_db_write() writes to a temporary file and renames it over the
+ * destination, so processes that have the old file mapped keep using it.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define NEEDLE_DB_MAGIC "NEEDLEDB"
+#define NEEDLE_DB_VERSION 1
+#define NEEDLE_DB_BYTE_ORDER 0x01020304u
+#define NEEDLE_DB_ALIGNMENT 64
+
+/* Flags for needle_db_write(). */
+#define NEEDLE_DB_SKIP 1
+
+struct NeedleDBHeader {
+	char     magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t size_type_size;
+	uint32_t flags;
+	uint64_t file_size;
+	uint64_t needle_count;
+	uint64_t records_offset;
+	uint64_t hash_offset;
+	uint64_t hash_slots;
+};
+
+struct NeedleDBRecord {
+	uint64_t needle_offset;
+	uint32_t needle_len;
+	uint32_t hash;
+	uint64_t occ_offset;
+	/* 0 if the database has no skip tables. */
+	uint64_t skip_offset;
+};
+
+struct NeedleDB {
+	/***** Internal fields, do not access. *****/
+	const unsigned char *base;
+	size_t size;
+};
+
+/* Points into the mapped database; valid until needle_db_close(). */
+struct NeedleDBEntry {
+	const unsigned char *needle;
+	size_t needle_len;
+	const struct StreamBMH_Occ *occ;
+	/* NULL if the database has no skip tables. */
+	const sbmh_size_t *skip;
+};
+
+
+inline uint32_t
+_needle_db_hash(const unsigned char *needle, size_t needle_len) {
+	/* FNV-1a. */
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < needle_len; i++) {
+		hash = (hash ^ needle[i]) * 16777619u;
+	}
+	return hash;
+}
+
+inline uint64_t
+_needle_db_align(uint64_t offset) {
+	return (offset + NEEDLE_DB_ALIGNMENT - 1) & ~uint64_t(NEEDLE_DB_ALIGNMENT - 1);
+}
+
+/* Pads the file with zeroes from 'pos' up to 'offset', and writes 'data'
+ * there. Advances 'pos' past the data.
+ */
+inline bool
+_needle_db_write_at(FILE *f, uint64_t &pos, uint64_t offset, const void *data, size_t len) {
+	static const char zeroes[NEEDLE_DB_ALIGNMENT] = { 0 };
+	if (offset > pos && fwrite(zeroes, 1, offset - pos, f) != offset - pos) {
+		return false;
+	}
+	if (len > 0 && fwrite(data, 1, len, f) != len) {
+		return false;
+	}
+	pos = offset + len;
+	return true;
+}
+
+/* Creates the tables for the given needles and writes them to 'filename'.
+ * 'flags' is 0 or NEEDLE_DB_SKIP.
+ */
+inline bool
+needle_db_write(const char *filename, const unsigned char *const *needles, const size_t *lengths,
+	size_t count, unsigned int flags)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (lengths[i] == 0 || lengths[i] > sbmh_size_t(-1)) {
+			errno = EINVAL;
+			return false;
+		}
+	}
+	if (count >= UINT32_MAX / 2) {
+		errno = EINVAL;
+		return false;
+	}
+
+	/* Lay out the file. */
+	NeedleDBHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, NEEDLE_DB_MAGIC, sizeof(header.magic));
+	header.version = NEEDLE_DB_VERSION;
+	header.byte_order = NEEDLE_DB_BYTE_ORDER;
+	header.size_type_size = sizeof(sbmh_size_t);
+	header.flags = flags;
+	header.needle_count = count;
+	header.records_offset = _needle_db_align(sizeof(header));
+	header.hash_slots = 16;
+	while (header.hash_slots < count * 2) {
+		header.hash_slots *= 2;
+	}
+	header.hash_offset = _needle_db_align(header.records_offset + count * sizeof(NeedleDBRecord));
+
+	std::vector<NeedleDBRecord> records(count);
+	std::vector<uint32_t> hash_index(header.hash_slots, 0);
+	uint64_t offset = _needle_db_align(header.hash_offset + header.hash_slots * sizeof(uint32_t));
+	for (size_t i = 0; i < count; i++) {
+		records[i].needle_len = lengths[i];
+		records[i].hash = _needle_db_hash(needles[i], lengths[i]);
+		records[i].occ_offset = offset;
+		offset = _needle_db_align(offset + sizeof(StreamBMH_Occ));
+
+		size_t slot = records[i].hash & (header.hash_slots - 1);
+		while (hash_index[slot] != 0) {
+			slot = (slot + 1) & (header.hash_slots - 1);
+		}
+		hash_index[slot] = i + 1;
+	}
+	for (size_t i = 0; i < count; i++) {
+		if (flags & NEEDLE_DB_SKIP) {
+			records[i].skip_offset = offset;
+			offset = _needle_db_align(offset + lengths[i] * sizeof(sbmh_size_t));
+		} else {
+			records[i].skip_offset = 0;
+		}
+	}
+	for (size_t i = 0; i < count; i++) {
+		records[i].needle_offset = offset;
+		offset += lengths[i];
+	}
+	header.file_size = offset;
+
+	/* Write it. */
+	const std::string temp_filename = std::string(filename) + ".tmp";
+	FILE *f = fopen(temp_filename.c_str(), "wb");
+	if (f == NULL) {
+		return false;
+	}
+	uint64_t pos = 0;
+	bool ok = _needle_db_write_at(f, pos, 0, &header, sizeof(header))
+		&& _needle_db_write_at(f, pos, header.records_offset, records.data(),
+			count * sizeof(NeedleDBRecord))
+		&& _needle_db_write_at(f, pos, header.hash_offset, hash_index.data(),
+			header.hash_slots * sizeof(uint32_t));
+
+	StreamBMH_Occ occ;
+	for (size_t i = 0; ok && i < count; i++) {
+		sbmh_init(NULL, &occ, needles[i], lengths[i]);
+		ok = _needle_db_write_at(f, pos, records[i].occ_offset, &occ, sizeof(occ));
+	}
+	for (size_t i = 0; ok && i < count && (flags & NEEDLE_DB_SKIP); i++) {
+		const skiptable_type skip = CreateSkipTable(needles[i], lengths[i]);
+		const std::vector<sbmh_size_t> narrow(skip.begin(), skip.end());
+		ok = _needle_db_write_at(f, pos, records[i].skip_offset, narrow.data(),
+			lengths[i] * sizeof(sbmh_size_t));
+	}
+	for (size_t i = 0; ok && i < count; i++) {
+		ok = _needle_db_write_at(f, pos, records[i].needle_offset, needles[i], lengths[i]);
+	}
+
+	if (fclose(f) != 0) {
+		ok = false;
+	}
+	if (ok && rename(temp_filename.c_str(), filename) == 0) {
+		return true;
+	}
+	int e = errno;
+	unlink(temp_filename.c_str());
+	errno = e;
+	return false;
+}
+
+/* Maps the database. 'db' is only modified on success. */
+inline bool
+needle_db_open(struct NeedleDB *db, const char *filename) {
+	int fd = open(filename, O_RDONLY);
+	if (fd == -1) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) == -1) {
+		int e = errno;
+		close(fd);
+		errno = e;
+		return false;
+	}
+	if (size_t(st.st_size) < sizeof(NeedleDBHeader)) {
+		close(fd);
+		errno = EINVAL;
+		return false;
+	}
+	void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	int e = errno;
+	close(fd);
+	if (base == MAP_FAILED) {
+		errno = e;
+		return false;
+	}
+
+	const NeedleDBHeader *header = (const NeedleDBHeader *) base;
+	const uint64_t size = st.st_size;
+	if (memcmp(header->magic, NEEDLE_DB_MAGIC, sizeof(header->magic)) != 0
+	 || header->version != NEEDLE_DB_VERSION
+	 || header->byte_order != NEEDLE_DB_BYTE_ORDER
+	 || header->size_type_size != sizeof(sbmh_size_t)
+	 || header->file_size != size
+	 || header->needle_count >= UINT32_MAX / 2
+	 || header->records_offset > size
+	 || header->needle_count > (size - header->records_offset) / sizeof(NeedleDBRecord)
+	 || header->hash_slots == 0
+	 || (header->hash_slots & (header->hash_slots - 1)) != 0
+	 || header->hash_slots <= header->needle_count
+	 || header->hash_offset > size
+	 || header->hash_slots > (size - header->hash_offset) / sizeof(uint32_t)
+	 || header->records_offset % sizeof(uint64_t) != 0
+	 || header->hash_offset % sizeof(uint32_t) != 0)
+	{
+		munmap(base, st.st_size);
+		errno = EINVAL;
+		return false;
+	}
+
+	db->base = (const unsigned char *) base;
+	db->size = st.st_size;
+	return true;
+}
+
+inline void
+needle_db_close(struct NeedleDB *db) {
+	if (db->base != NULL) {
+		munmap((void *) db->base, db->size);
+		db->base = NULL;
+		db->size = 0;
+	}
+}
+
+inline size_t
+needle_db_count(const struct NeedleDB *db) {
+	return ((const NeedleDBHeader *) db->base)->needle_count;
+}
+
+/* Fills in the entry of the needle with the given index, in the order in
+ * which they were passed to needle_db_write(). Returns false if the index
+ * is out of range or the record is corrupt.
+ */
+inline bool
+needle_db_get(const struct NeedleDB *db, size_t index, struct NeedleDBEntry *entry) {
+	const NeedleDBHeader *header = (const NeedleDBHeader *) db->base;
+	if (index >= header->needle_count) {
+		return false;
+	}
+	const NeedleDBRecord *record = (const NeedleDBRecord *)
+		(db->base + header->records_offset) + index;
+	const uint64_t size = db->size;
+	const uint64_t skip_size = uint64_t(record->needle_len) * sizeof(sbmh_size_t);
+	if (record->needle_len == 0
+	 || record->needle_offset > size || record->needle_len > size - record->needle_offset
+	 || record->occ_offset > size || sizeof(StreamBMH_Occ) > size - record->occ_offset
+	 || record->occ_offset % sizeof(sbmh_size_t) != 0
+	 || (record->skip_offset != 0
+	     && (record->skip_offset > size || skip_size > size - record->skip_offset
+	      || record->skip_offset % sizeof(sbmh_size_t) != 0)))
+	{
+		return false;
+	}
+
+	entry->needle = db->base + record->needle_offset;
+	entry->needle_len = record->needle_len;
+	entry->occ = (const StreamBMH_Occ *) (db->base + record->occ_offset);
+	if (record->skip_offset != 0) {
+		entry->skip = (const sbmh_size_t *) (db->base + record->skip_offset);
+	} else {
+		entry->skip = NULL;
+	}
+	return true;
+}
+
+/* Looks the needle up by its bytes. Returns false if it's not in the database. */
+inline bool
+needle_db_find(const struct NeedleDB *db, const unsigned char *needle, size_t needle_len,
+	struct NeedleDBEntry *entry)
+{
+	const NeedleDBHeader *header = (const NeedleDBHeader *) db->base;
+	const uint32_t *hash_index = (const uint32_t *) (db->base + header->hash_offset);
+	const NeedleDBRecord *records = (const NeedleDBRecord *) (db->base + header->records_offset);
+	const uint64_t mask = header->hash_slots - 1;
+	const uint32_t hash = _needle_db_hash(needle, needle_len);
+
+	/* Stops at an empty slot; there is always one, as the index is at most half full. */
+	for (uint64_t slot = hash & mask, probes = 0; probes <= mask; slot = (slot + 1) & mask, probes++) {
+		const uint32_t index = hash_index[slot];
+		if (index == 0) {
+			return false;
+		}
+		if (index <= header->needle_count && records[index - 1].hash == hash
+		 && records[index - 1].needle_len == needle_len
+		 && needle_db_get(db, index - 1, entry)
+		 && memcmp(entry->needle, needle, needle_len) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+#endif /* _NEEDLE_DATABASE_ */
@@ -0,0 +1,168 @@
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cerrno>
+#include <alloca.h>
+#include <unistd.h>
+
+#include "tut.h"
+#include "Horspool.cpp"
+#include "BoyerMooreAndTurbo.cpp"
+#include "StreamBoyerMooreHorspool.h"
+#include "NeedleDatabase.h"
+
+using namespace std;
+
+namespace tut {
+	struct NeedleDatabaseTest {
+		string filename;
+		vector<string> needles;
+		NeedleDB db;
+
+		NeedleDatabaseTest() {
+			char buf[64];
+			snprintf(buf, sizeof(buf), "/tmp/NeedleDatabaseTest.%d.db", (int) getpid());
+			filename = buf;
+			needles.push_back("I have control\n");
+			needles.push_back("abracadabra");
+			needles.push_back("x");
+			needles.push_back("\r\n--boundary");
+			db.base = NULL;
+		}
+
+		~NeedleDatabaseTest() {
+			needle_db_close(&db);
+			unlink(filename.c_str());
+		}
+
+		bool write(unsigned int flags) {
+			vector<const unsigned char *> pointers;
+			vector<size_t> lengths;
+			for (size_t i = 0; i < needles.size(); i++) {
+				pointers.push_back((const unsigned char *) needles[i].data());
+				lengths.push_back(needles[i].size());
+			}
+			return needle_db_write(filename.c_str(), pointers.data(), lengths.data(),
+				needles.size(), flags);
+		}
+
+		void writeFile(const string &data) {
+			FILE *f = fopen(filename.c_str(), "wb");
+			fwrite(data.data(), 1, data.size(), f);
+			fclose(f);
+		}
+
+		string readFile() {
+			string data;
+			FILE *f = fopen(filename.c_str(), "rb");
+			char buf[4096];
+			size_t ret;
+			while ((ret = fread(buf, 1, sizeof(buf), f)) > 0) {
+				data.append(buf, ret);
+			}
+			fclose(f);
+			return data;
+		}
+	};
+
+	DEFINE_TEST_GROUP(NeedleDatabaseTest);
+
+	TEST_METHOD(1) {
+		set_test_name("It stores the same tables as creating them directly");
+
+		ensure("written", write(NEEDLE_DB_SKIP));
+		ensure("opened", needle_db_open(&db, filename.c_str()));
+		ensure_equals(needle_db_count(&db), needles.size());
+		for (size_t i = 0; i < needles.size(); i++) {
+			const unsigned char *n = (const unsigned char *) needles[i].data();
+			NeedleDBEntry entry;
+			ensure("get", needle_db_get(&db, i, &entry));
+			ensure("needle", string((const char *) entry.needle, entry.needle_len) == needles[i]);
+			ensure("occ aligned", (uintptr_t) entry.occ % NEEDLE_DB_ALIGNMENT == 0);
+
+			StreamBMH_Occ occ;
+			sbmh_init(NULL, &occ, n, needles[i].size());
+			ensure("occ table", memcmp(&occ, entry.occ, sizeof(occ)) == 0);
+			const skiptable_type skip = CreateSkipTable(n, needles[i].size());
+			ensure("skip table", entry.skip != NULL);
+			for (size_t j = 0; j < skip.size(); j++) {
+				ensure_equals("skip", (size_t) entry.skip[j], skip[j]);
+			}
+		}
+		NeedleDBEntry entry;
+		ensure("out of range", !needle_db_get(&db, needles.size(), &entry));
+	}
+
+	TEST_METHOD(2) {
+		set_test_name("The search functions use the mapped tables directly");
+
+		ensure("written", write(NEEDLE_DB_SKIP));
+		ensure("opened", needle_db_open(&db, filename.c_str()));
+		const string haystack = "xxabrabracadabrxxxabracadabraxx";
+		const unsigned char *h = (const unsigned char *) haystack.data();
+		NeedleDBEntry entry;
+		ensure("found", needle_db_find(&db, (const unsigned char *) "abracadabra", 11, &entry));
+
+		ensure_equals(SearchInHorspool(h, haystack.size(), entry.occ->occ, entry.needle, entry.needle_len), 18u);
+		ensure_equals(SearchIn(h, haystack.size(), entry.occ->occ, entry.skip, entry.needle, entry.needle_len), 18u);
+		ensure_equals(SearchInTurbo(h, haystack.size(), entry.occ->occ, entry.skip, entry.needle, entry.needle_len), 18u);
+
+		StreamBMH *ctx = (StreamBMH *) alloca(SBMH_SIZE(entry.needle_len));
+		sbmh_init(ctx, NULL, entry.needle, entry.needle_len);
+		size_t analyzed = sbmh_feed(ctx, entry.occ, entry.needle, entry.needle_len, h, 20);
+		ensure("not found yet", !ctx->found);
+		analyzed = sbmh_feed(ctx, entry.occ, entry.needle, entry.needle_len, h + 20, haystack.size() - 20);
+		ensure("found", ctx->found);
+		ensure_equals(20 + analyzed - entry.needle_len, 18u);
+	}
+
+	TEST_METHOD(3) {
+		set_test_name("Needles can be looked up by their bytes");
+
+		ensure("written", write(0));
+		ensure("opened", needle_db_open(&db, filename.c_str()));
+		for (size_t i = 0; i < needles.size(); i++) {
+			NeedleDBEntry entry;
+			ensure("found", needle_db_find(&db, (const unsigned char *) needles[i].data(),
+				needles[i].size(), &entry));
+			ensure("same needle", string((const char *) entry.needle, entry.needle_len) == needles[i]);
+			ensure("no skip table", entry.skip == NULL);
+		}
+		NeedleDBEntry entry;
+		ensure("prefix", !needle_db_find(&db, (const unsigned char *) "abracadabr", 10, &entry));
+		ensure("unknown", !needle_db_find(&db, (const unsigned char *) "hello", 5, &entry));
+	}
+
+	TEST_METHOD(4) {
+		set_test_name("Invalid and truncated files are rejected");
+
+		ensure("missing", !needle_db_open(&db, "/tmp/does-not-exist.db"));
+		ensure_equals(errno, ENOENT);
+
+		writeFile("hello world");
+		ensure("too small", !needle_db_open(&db, filename.c_str()));
+		ensure_equals(errno, EINVAL);
+
+		ensure("written", write(NEEDLE_DB_SKIP));
+		const string data = readFile();
+		writeFile(data.substr(0, data.size() - 1));
+		ensure("truncated", !needle_db_open(&db, filename.c_str()));
+		ensure_equals(errno, EINVAL);
+
+		string wrong_magic = data;
+		wrong_magic[0] = 'X';
+		writeFile(wrong_magic);
+		ensure("wrong magic", !needle_db_open(&db, filename.c_str()));
+		ensure_equals(errno, EINVAL);
+		ensure("untouched", db.base == NULL);
+	}
+
+	TEST_METHOD(5) {
+		set_test_name("Needles that don't fit in a sbmh_size_t are rejected");
+
+		needles.push_back(string(size_t(sbmh_size_t(-1)) + 1, 'a'));
+		ensure("not written", !write(0));
+		ensure_equals(errno, EINVAL);
+		ensure("no file", access(filename.c_str(), F_OK) != 0);
+	}
+}
@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2010 Phusion v.o.f.
+ * https://github.com/FooBarWidget/boyer-moore-horspool
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Search in 2-bit packed DNA.
+ *
+ * Genomic sequences are usually stored with 2 bits per base, 4 bases per
+ * byte. Searching them with a byte-based algorithm requires unpacking them
+ * first, which quadruples memory usage and memory bandwidth. This algorithm
+ * works directly on the packed data.
+ *
+ * Layout: base i is stored in byte i / 4, in bits
+ * (7 - 2 * (i % 4)) .. (6 - 2 * (i % 4)), i.e. the first base of a byte is in
+ * its two most significant bits. Bases are encoded as A = 0, C = 1, G = 2 and
+ * T = 3. Needles use the same layout, starting at bit 7 of their first byte.
+ *
+ * With a 4-letter alphabet, shifts based on a single base are nearly always
+ * 1, so the shift is looked up by the last q bases of the window (a q-gram,
+ * up to 8 bases, so that the table has at most 65536 entries). Candidate
+ * windows are verified 32 bases at a time: the bases at an arbitrary
+ * position are extracted into a 64-bit word with shifts, whichever of the 4
+ * positions within a byte the window starts at, and compared with masks.
+ */
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
+
+/* The preparation data for SearchInPackedDNA(). */
+struct PackedDNATable {
+    /* The number of bases in the q-grams that index 'shift'. */
+    unsigned int q;
+    /* Shift for each q-gram, indexed by its 2q-bit packed value. */
+    std::vector<uint16_t> shift;
+    /* The packed value of the last q bases of the needle. */
+    uint32_t last_qgram;
+};
+
+/* The number of bytes needed to store the given number of packed bases. */
+inline size_t
+PackedDNASize(size_t bases)
+{
+    return (bases + 3) / 4;
+}
+
+/* Converts the letters A, C, G and T (or a, c, g, t) to packed form. Any other
+ * letter is packed as A. 'packed' must be PackedDNASize(count) bytes big.
+ */
+inline void
+PackDNA(const char* bases, size_t count, unsigned char* packed)
+{
+    std::memset(packed, 0, PackedDNASize(count));
+    for(size_t i=0; i<count; ++i)
+    {
+        unsigned char code;
+        switch(bases[i])
+        {
+        case 'C': case 'c': code = 1; break;
+        case 'G': case 'g': code = 2; break;
+        case 'T': case 't': code = 3; break;
+        default: code = 0; break;
+        }
+        packed[i / 4] |= code << (6 - 2 * (i % 4));
+    }
+}
+
+/* Converts packed bases back to the letters A, C, G and T. */
+inline void
+UnpackDNA(const unsigned char* packed, size_t count, char* bases)
+{
+    static const char letters[4] = { 'A', 'C', 'G', 'T' };
+    for(size_t i=0; i<count; ++i)
+        bases[i] = letters[(packed[i / 4] >> (6 - 2 * (i % 4))) & 3];
+}
+
+/* Returns the 32 bases starting at base 'pos' as a 64-bit word, the first
+ * base in the two most significant bits. Bases past the end of the data
+ * are returned as zero bits.
+ */
+inline uint64_t
+PackedDNAWord(const unsigned char* packed, size_t packed_size, size_t pos)
+{
+    const size_t byte = pos / 4;
+    const unsigned int bit_offset = 2 * (pos % 4);
+    uint64_t word;
+    unsigned char extra;
+    if(byte + 9 <= packed_size)
+    {
+        unsigned char bytes[8];
+        std::memcpy(bytes, packed + byte, 8);
+        #if defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            std::memcpy(&word, bytes, 8);
+            word = __builtin_bswap64(word);
+        #else
+            word = 0;
+            for(int i=0; i<8; ++i)
+                word = (word << 8) | bytes[i];
+        #endif
+        extra = packed[byte + 8];
+    }
+    else
+    {
+        word = 0;
+        for(size_t i=0; i<8; ++i)
+            word = (word << 8) | (byte + i < packed_size ? packed[byte + i] : 0);
+        extra = byte + 8 < packed_size ? packed[byte + 8] : 0;
+    }
+    if(bit_offset != 0)
+        word = (word << bit_offset) | (extra >> (8 - bit_offset));
+    return word;
+}
+
+/* This function creates the table to be used by SearchInPackedDNA(). */
+/* It only needs to be created once per a needle to search. */
+const PackedDNATable
+    CreatePackedDNATable(const unsigned char* needle, size_t needle_bases)
+{
+    PackedDNATable table;
+    const size_t needle_size = PackedDNASize(needle_bases);
+
+    /* Longer q-grams are more selective, but the maximum shift is
+     * needle_bases - q + 1, so don't use more than half of the needle.
+     */
+    table.q = (unsigned int) std::max<size_t>(1, std::min<size_t>(8, needle_bases / 2));
+    table.shift.assign(size_t(1) << (2 * table.q),
+        uint16_t(std::min<size_t>(needle_bases - table.q + 1, UINT16_MAX)));
+    table.last_qgram = 0;
+    if(needle_bases == 0) return table;
+
+    const unsigned int qgram_shift = 64 - 2 * table.q;
+    /* Populate it with the analysis of the needle,
+     * ignoring the q-gram that ends at the last base.
+     */
+    for(size_t end=table.q-1; end<needle_bases-1; ++end)
+    {
+        const uint32_t qgram = uint32_t(PackedDNAWord(needle, needle_size, end + 1 - table.q) >> qgram_shift);
+        table.shift[qgram] = uint16_t(std::min<size_t>(needle_bases - 1 - end, UINT16_MAX));
+    }
+    table.last_qgram = uint32_t(PackedDNAWord(needle, needle_size, needle_bases - table.q) >> qgram_shift);
+    return table;
+}
+
+/* Compares the needle with the haystack bases starting at 'pos'. */
+inline bool
+PackedDNAEqual(const unsigned char* haystack, size_t haystack_size, size_t pos,
+    const unsigned char* needle, size_t needle_size, size_t needle_bases)
+{
+    size_t i = 0;
+    for(; i + 32 <= needle_bases; i += 32)
+    {
+        if(PackedDNAWord(haystack, haystack_size, pos + i) != PackedDNAWord(needle, needle_size, i))
+            return false;
+    }
+    if(i < needle_bases)
+    {
+        const uint64_t mask = ~uint64_t(0) << (64 - 2 * (needle_bases - i));
+        if((PackedDNAWord(haystack, haystack_size, pos + i) ^ PackedDNAWord(needle, needle_size, i)) & mask)
+            return false;
+    }
+    return true;
+}
+
+/* A q-gram Boyer-Moore-Horspool search algorithm on 2-bit packed DNA. */
+/* Positions and lengths are in bases. If it finds the needle, it returns
+ * the base position in the haystack from which the needle was found.
+ * Otherwise, it returns haystack_bases.
+ */
+size_t SearchInPackedDNA(const unsigned char* haystack, size_t haystack_bases,
+    const PackedDNATable& table,
+    const unsigned char* needle,
+    const size_t needle_bases)
+{
+    if(needle_bases > haystack_bases || needle_bases == 0) return haystack_bases;
+
+    const size_t haystack_size = PackedDNASize(haystack_bases);
+    const size_t needle_size = PackedDNASize(needle_bases);
+    const unsigned int qgram_shift = 64 - 2 * table.q;
+    const uint16_t* shift = &table.shift[0];
+    /* Offset from the window start to the start of its last q-gram. */
+    const size_t qgram_offset = needle_bases - table.q;
+
+    size_t haystack_position=0;
+    while(haystack_position <= haystack_bases-needle_bases)
+    {
+        const uint32_t qgram = uint32_t(
+            PackedDNAWord(haystack, haystack_size, haystack_position + qgram_offset) >> qgram_shift);
+
+        if(qgram == table.last_qgram
+        && PackedDNAEqual(haystack, haystack_size, haystack_position,
+               needle, needle_size, needle_bases))
+        {
+            return haystack_position;
+        }
+
+        haystack_position += shift[qgram];
+    }
+    return haystack_bases;
+}
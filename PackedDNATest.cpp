@@ -0,0 +1,115 @@
+#include <string>
+#include <vector>
+
+#include "tut.h"
+#include "PackedDNA.cpp"
+
+using namespace std;
+
+namespace tut {
+	struct PackedDNATest {
+		static vector<unsigned char> pack(const string &bases) {
+			vector<unsigned char> result(PackedDNASize(bases.size()) + 1);
+			PackDNA(bases.c_str(), bases.size(), &result[0]);
+			result.resize(PackedDNASize(bases.size()));
+			return result;
+		}
+
+		static int find(const string &needle, const string &haystack) {
+			vector<unsigned char> packed_needle = pack(needle);
+			vector<unsigned char> packed_haystack = pack(haystack);
+			const unsigned char *needle_data = packed_needle.empty() ? NULL : &packed_needle[0];
+			const unsigned char *haystack_data = packed_haystack.empty() ? NULL : &packed_haystack[0];
+			const PackedDNATable table = CreatePackedDNATable(needle_data, needle.size());
+			size_t result = SearchInPackedDNA(
+				haystack_data, haystack.size(),
+				table,
+				needle_data, needle.size());
+			if (result == haystack.size()) {
+				return -1;
+			} else {
+				return (int) result;
+			}
+		}
+
+		static string randomBases(unsigned int &seed, size_t len, int alphabet_size) {
+			static const char letters[] = "ACGT";
+			string result;
+			result.reserve(len);
+			for (size_t i = 0; i < len; i++) {
+				seed = seed * 1103515245 + 12345;
+				result.push_back(letters[(seed >> 16) % alphabet_size]);
+			}
+			return result;
+		}
+	};
+
+	DEFINE_TEST_GROUP(PackedDNATest);
+
+	TEST_METHOD(1) {
+		set_test_name("PackDNA() and UnpackDNA() convert between letters and 2-bit codes");
+
+		vector<unsigned char> packed = pack("ACGTTGCAg");
+		ensure_equals(packed.size(), 3u);
+		ensure_equals((int) packed[0], 0x1B);
+		ensure_equals((int) packed[1], 0xE4);
+		ensure_equals((int) packed[2], 0x80);
+
+		char unpacked[9];
+		UnpackDNA(&packed[0], 9, unpacked);
+		ensure_equals(string(unpacked, 9), "ACGTTGCAG");
+	}
+
+	TEST_METHOD(2) {
+		set_test_name("It returns the haystack length if the needle can't be found.");
+
+		ensure_equals(find("T", "ACGACGACG"), -1);
+		ensure_equals(find("GT", "AGAGGGCTAGC"), -1);
+		ensure_equals(find("ACGTACGTACGT", "CGTACGTACGTACGA"), -1);
+		ensure_equals(find("A", ""), -1);
+		ensure_equals(find("ACGTACGTACGTACGTA", "ACGTACGTACGTACGT"), -1);
+	}
+
+	TEST_METHOD(3) {
+		set_test_name("It returns the position at which the needle is first found");
+
+		ensure_equals(find("T", "ACGACGACGT"), 9);
+		ensure_equals(find("GT", "GTAAGT"), 0);
+		ensure_equals(find("GATTACA", "GATTAGATTACAGATTACA"), 5);
+		ensure_equals(find("AAAAC", "AAAAAAAAAAAAAAAAAAAAC"), 16);
+	}
+
+	TEST_METHOD(4) {
+		set_test_name("It finds needles at each of the four positions within a byte");
+
+		unsigned int seed = 7;
+		const string needle = randomBases(seed, 45, 4);
+		for (size_t offset = 0; offset < 16; offset++) {
+			string haystack = string(offset, 'A') + needle + "CCCC";
+			ensure_equals(find(needle, haystack), (int) offset);
+			/* A mismatch in the last base, which is compared with a mask. */
+			haystack[offset + needle.size() - 1] ^= 'A' ^ 'T';
+			ensure_equals(find(needle, haystack), -1);
+		}
+	}
+
+	TEST_METHOD(5) {
+		set_test_name("It agrees with std::string::find() on random data");
+
+		unsigned int seed = 1;
+		for (int round = 0; round < 2000; round++) {
+			int alphabet_size = 2 + round % 3;
+			string haystack = randomBases(seed, 1 + round % 300, alphabet_size);
+			string needle;
+			if (round % 2 == 0 && haystack.size() > 2) {
+				size_t start = (seed >> 8) % (haystack.size() - 1);
+				needle = haystack.substr(start, 1 + (seed >> 4) % 80);
+			} else {
+				needle = randomBases(seed, 1 + round % 12, alphabet_size);
+			}
+			string::size_type expected = haystack.find(needle);
+			ensure_equals(find(needle, haystack),
+				expected == string::npos ? -1 : (int) expected);
+		}
+	}
+}
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2010 Phusion v.o.f.
+ * https://github.com/FooBarWidget/boyer-moore-horspool
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _PATTERN_PROGRAM_
+#define _PATTERN_PROGRAM_
+
+// Expecting StreamBoyerMooreHorspool.h to be included before this file.
+
+/*
+ * Searches a stream for a sequence of needles in order: the first needle,
+ * then the second needle after it, and so on. For example "\r\n\r\n" to find
+ * the end of the headers, then a boundary, then a terminator.
+ *
+ * A PatternProgram holds the needles and their occ tables. It's immutable
+ * once created, so it can be shared by many streams and threads. A
+ * PatternRun holds the state of one stream: the needle that is being
+ * searched for (its 'stage') and a StreamBMH context that is large enough
+ * for the longest needle.
+ *
+ *   const unsigned char *needles[] = { ..., ..., ... };
+ *   sbmh_size_t lengths[] = { ..., ..., ... };
+ *   struct PatternProgram *program = pattern_program_new(needles, lengths, 3);
+ *   if (program == NULL) {
+ *      // error...
+ *   }
+ *   struct PatternRun *run = pattern_run_new(program);
+ *   if (run == NULL) {
+ *      // error...
+ *   }
+ *   run->on_match = ...;
+ *   run->on_data = ...;
+ *   run->user_data = ...;
+ *   while (!run->done && ... read data ...) {
+ *      size_t analyzed = pattern_run_feed(run, data, len);
+ *      ...
+ *   }
+ *   pattern_run_free(run);
+ *   pattern_program_free(program);
+ *
+ * pattern_run_feed() searches for the needle of the current stage. When it
+ * finds it, it invokes on_match() with the stage and the offset of the match
+ * in the stream, and continues with the next needle right after the match,
+ * in the same data. The data is only passed over once.
+ *
+ * on_data(), if set, is invoked with all data that is not part of a match,
+ * together with the stage whose needle was being searched for, like the
+ * StreamBMH callback.
+ *
+ * pattern_run_feed() returns the number of bytes analyzed, like sbmh_feed():
+ * all fed data, or up to the end of the last needle if it was found, after
+ * which 'done' is set. Then further calls analyze nothing and return 0.
+ * pattern_run_reset() starts over with the first needle.
+ */
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+struct PatternRun;
+
+typedef void (*pattern_match_cb)(struct PatternRun *run, unsigned int stage, unsigned long long offset);
+typedef void (*pattern_data_cb)(struct PatternRun *run, unsigned int stage,
+	const unsigned char *data, size_t len);
+
+struct PatternProgram {
+	/***** Public but read-only fields *****/
+	unsigned int   count;
+	sbmh_size_t    max_needle_len;
+
+	/***** Internal fields, do not access. *****/
+	struct StreamBMH_Occ *occs;
+	const unsigned char **needles;
+	sbmh_size_t   *lengths;
+};
+
+struct PatternRun {
+	/***** Public but read-only fields *****/
+	/* Index of the needle that is being searched for. */
+	unsigned int   stage;
+	/* Whether all needles were found. */
+	bool           done;
+	/* Number of bytes analyzed so far. */
+	unsigned long long offset;
+
+	/***** Public fields; feel free to populate *****/
+	pattern_match_cb on_match;
+	pattern_data_cb on_data;
+	void          *user_data;
+
+	/***** Internal fields, do not access. *****/
+	const struct PatternProgram *program;
+	/* Must be last: its lookbehind buffer follows it. */
+	struct StreamBMH ctx;
+};
+
+/* Returns NULL if the memory could not be allocated. The needles are copied;
+ * each must be at least 1 byte.
+ */
+inline struct PatternProgram *
+pattern_program_new(const unsigned char *const *needles, const sbmh_size_t *lengths, unsigned int count) {
+	size_t needle_bytes = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		assert(lengths[i] > 0);
+		needle_bytes += lengths[i];
+	}
+	struct PatternProgram *program = (struct PatternProgram *) malloc(sizeof(struct PatternProgram)
+		+ count * (sizeof(struct StreamBMH_Occ) + sizeof(const unsigned char *) + sizeof(sbmh_size_t))
+		+ needle_bytes);
+	if (program == NULL) {
+		return NULL;
+	}
+	program->count = count;
+	program->max_needle_len = 1;
+	program->occs = (struct StreamBMH_Occ *) (program + 1);
+	program->needles = (const unsigned char **) (program->occs + count);
+	program->lengths = (sbmh_size_t *) (program->needles + count);
+	unsigned char *needle_copy = (unsigned char *) (program->lengths + count);
+	for (unsigned int i = 0; i < count; i++) {
+		memcpy(needle_copy, needles[i], lengths[i]);
+		program->needles[i] = needle_copy;
+		program->lengths[i] = lengths[i];
+		program->max_needle_len = std::max(program->max_needle_len, lengths[i]);
+		sbmh_init(NULL, &program->occs[i], needle_copy, lengths[i]);
+		needle_copy += lengths[i];
+	}
+	return program;
+}
+
+inline void
+pattern_program_free(struct PatternProgram *program) {
+	free(program);
+}
+
+/* StreamBMH callback: passes data that's not part of a match on. */
+inline void
+_pattern_run_forward_data(const struct StreamBMH *ctx, const unsigned char *data, size_t len) {
+	struct PatternRun *run = (struct PatternRun *) ctx->user_data;
+	if (run->on_data != NULL) {
+		run->on_data(run, run->stage, data, len);
+	}
+}
+
+inline void
+pattern_run_reset(struct PatternRun *run) {
+	run->stage = 0;
+	run->done = run->program->count == 0;
+	run->offset = 0;
+	sbmh_reset(&run->ctx);
+}
+
+/* Returns NULL if the memory could not be allocated, or if 'program' is
+ * NULL. The program must outlive the run.
+ */
+inline struct PatternRun *
+pattern_run_new(const struct PatternProgram *program) {
+	if (program == NULL) {
+		return NULL;
+	}
+	struct PatternRun *run = (struct PatternRun *) malloc(
+		offsetof(struct PatternRun, ctx) + SBMH_SIZE(program->max_needle_len));
+	if (run == NULL) {
+		return NULL;
+	}
+	run->on_match = NULL;
+	run->on_data = NULL;
+	run->user_data = NULL;
+	run->program = program;
+	sbmh_init(&run->ctx, NULL, NULL, program->max_needle_len);
+	run->ctx.callback = _pattern_run_forward_data;
+	run->ctx.user_data = run;
+	pattern_run_reset(run);
+	return run;
+}
+
+inline void
+pattern_run_free(struct PatternRun *run) {
+	free(run);
+}
+
+inline size_t
+pattern_run_feed(struct PatternRun *run, const unsigned char *data, size_t len) {
+	const struct PatternProgram *program = run->program;
+	size_t pos = 0;
+	while (pos < len && !run->done) {
+		const unsigned int stage = run->stage;
+		const sbmh_size_t needle_len = program->lengths[stage];
+		pos += sbmh_feed(&run->ctx, &program->occs[stage], program->needles[stage], needle_len,
+			data + pos, len - pos);
+		if (run->ctx.found) {
+			sbmh_reset(&run->ctx);
+			run->stage++;
+			run->done = run->stage == program->count;
+			if (run->on_match != NULL) {
+				/* The match may have started in data fed before. */
+				run->on_match(run, stage, run->offset + pos - needle_len);
+			}
+		}
+	}
+	run->offset += pos;
+	return pos;
+}
+
+#endif /* _PATTERN_PROGRAM_ */
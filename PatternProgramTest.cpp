@@ -0,0 +1,146 @@
+#include <string>
+#include <vector>
+
+#include "tut.h"
+#include "StreamBoyerMooreHorspool.h"
+#include "PatternProgram.h"
+
+using namespace std;
+
+namespace tut {
+	struct PatternProgramTest {
+		PatternProgram *program;
+		PatternRun *run;
+		/* The matches as "stage@offset", and the data of every stage. */
+		vector<string> matches;
+		vector<string> data;
+
+		PatternProgramTest() {
+			program = NULL;
+			run = NULL;
+		}
+
+		~PatternProgramTest() {
+			pattern_run_free(run);
+			pattern_program_free(program);
+		}
+
+		static void on_match(PatternRun *run, unsigned int stage, unsigned long long offset) {
+			PatternProgramTest *self = (PatternProgramTest *) run->user_data;
+			self->matches.push_back(to_string(stage) + "@" + to_string(offset));
+		}
+
+		static void on_data(PatternRun *run, unsigned int stage, const unsigned char *data, size_t len) {
+			PatternProgramTest *self = (PatternProgramTest *) run->user_data;
+			self->data[stage].append((const char *) data, len);
+		}
+
+		void init(const vector<string> &needles) {
+			vector<const unsigned char *> pointers;
+			vector<sbmh_size_t> lengths;
+			for (size_t i = 0; i < needles.size(); i++) {
+				pointers.push_back((const unsigned char *) needles[i].data());
+				lengths.push_back(needles[i].size());
+			}
+			pattern_run_free(run);
+			pattern_program_free(program);
+			program = pattern_program_new(&pointers[0], &lengths[0], needles.size());
+			ensure(program != NULL);
+			run = pattern_run_new(program);
+			ensure(run != NULL);
+			run->on_match = on_match;
+			run->on_data = on_data;
+			run->user_data = this;
+			matches.clear();
+			data.assign(needles.size(), "");
+		}
+
+		/* Feeds the stream in chunks of the given size until the program
+		 * is done. Returns the number of bytes analyzed.
+		 */
+		size_t feed(const string &stream, size_t chunk_size) {
+			size_t analyzed = 0;
+			for (size_t pos = 0; pos < stream.size() && !run->done; pos += chunk_size) {
+				size_t len = min(chunk_size, stream.size() - pos);
+				size_t result = pattern_run_feed(run, (const unsigned char *) stream.data() + pos, len);
+				ensure(result == len || run->done);
+				analyzed += result;
+			}
+			return analyzed;
+		}
+	};
+
+	DEFINE_TEST_GROUP(PatternProgramTest);
+
+	static const string message =
+		"POST /upload HTTP/1.1\r\nContent-Type: multipart/form-data; boundary=b\r\n\r\n"
+		"preamble\r\n--b\r\npart\r\n--b--\r\nEND\r\ntrailing data";
+
+	TEST_METHOD(1) {
+		set_test_name("It finds the needles in order in one pass");
+		init({ "\r\n\r\n", "\r\n--b", "END\r\n" });
+		ensure_equals(feed(message, message.size()), message.size() - 13);
+		ensure("done", run->done);
+		ensure_equals(run->stage, 3u);
+		ensure_equals(matches.size(), 3u);
+		ensure_equals(matches[0], "0@" + to_string(message.find("\r\n\r\n")));
+		ensure_equals(matches[1], "1@" + to_string(message.find("\r\n--b")));
+		ensure_equals(matches[2], "2@" + to_string(message.find("END\r\n")));
+		ensure_equals(data[0], "POST /upload HTTP/1.1\r\nContent-Type: multipart/form-data; boundary=b");
+		ensure_equals(data[1], "preamble");
+		ensure_equals(data[2], "\r\npart\r\n--b--\r\n");
+		ensure_equals(run->offset, message.size() - 13);
+
+		ensure_equals("nothing is analyzed when done",
+			pattern_run_feed(run, (const unsigned char *) "more", 4), 0u);
+	}
+
+	TEST_METHOD(2) {
+		set_test_name("It finds the same matches when fed in chunks of any size");
+		for (size_t chunk_size = 1; chunk_size <= message.size(); chunk_size++) {
+			init({ "\r\n\r\n", "\r\n--b", "END\r\n" });
+			ensure_equals(feed(message, chunk_size), message.size() - 13);
+			string context = "chunk size " + to_string(chunk_size);
+			ensure_equals(context.c_str(), matches.size(), 3u);
+			ensure_equals(context.c_str(), matches[1], "1@" + to_string(message.find("\r\n--b")));
+			ensure_equals(context.c_str(), matches[2], "2@" + to_string(message.find("END\r\n")));
+			ensure_equals(context.c_str(), data[2], "\r\npart\r\n--b--\r\n");
+		}
+	}
+
+	TEST_METHOD(3) {
+		set_test_name("A needle only matches after the previous one");
+		init({ "first", "second" });
+		string stream = "second first xx second";
+		ensure_equals(feed(stream, 4), stream.size());
+		ensure_equals(matches.size(), 2u);
+		ensure_equals(matches[0], "0@7");
+		ensure_equals(matches[1], "1@16");
+		ensure_equals(data[0], "second ");
+
+		init({ "ab", "ab" });
+		ensure_equals(feed("abab", 1), 4u);
+		ensure_equals(matches.size(), 2u);
+		ensure_equals(matches[1], "1@2");
+	}
+
+	TEST_METHOD(4) {
+		set_test_name("A reset run starts over with the first needle");
+		init({ "a", "bc" });
+		ensure_equals(feed("xaybcz", 6), 5u);
+		ensure("done", run->done);
+		pattern_run_reset(run);
+		ensure("not done", !run->done);
+		ensure_equals(run->stage, 0u);
+		matches.clear();
+		ensure_equals(feed("bcab", 6), 4u);
+		ensure("not done", !run->done);
+		ensure_equals(matches.size(), 1u);
+		ensure_equals(matches[0], "0@2");
+	}
+	
+	TEST_METHOD(5) {
+		set_test_name("pattern_run_new() returns NULL for a NULL program");
+		ensure("no run", pattern_run_new(NULL) == NULL);
+	}
+}
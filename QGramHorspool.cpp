@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2010 Phusion v.o.f.
+ * https://github.com/FooBarWidget/boyer-moore-horspool
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Boyer-Moore-Horspool with a 2-gram shift table, in the style of
+ * Zhu-Takaoka and of Wu-Manber's single pattern case.
+ *
+ * The shift is looked up by the last *two* characters of the window instead
+ * of only the last one. On data with a small alphabet, or on repetitive data
+ * such as a file full of newlines, nearly every byte value occurs in the
+ * needle so single-byte shifts collapse to 1. Pairs of bytes are much more
+ * selective: searching "I have control\n\n" in newlines only encounters the
+ * pair "\n\n", which only occurs at the very end of the needle, so every
+ * window is shifted by the full needle length.
+ *
+ * The table has 65536 entries of 16 bits each (128 KB), which fits in the L2
+ * cache of current CPUs. Shifts of needles longer than 65535 bytes are
+ * capped; that is safe because a shorter shift never skips a match.
+ */
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
+
+#include "SearchStats.h"
+
+typedef std::vector<uint16_t> qgramtable_type;
+
+/* The largest shift that fits in a table entry. */
+static const size_t QGRAM_MAX_SHIFT = UINT16_MAX;
+
+/* This function creates a 2-gram shift table to be used by SearchInQGramHorspool(). */
+/* It only needs to be created once per a needle to search. */
+const qgramtable_type
+    CreateQGramTable(const unsigned char* needle, size_t needle_length)
+{
+    /* A pair of bytes that does not occur in the needle allows shifting
+     * by the entire needle length...
+     */
+    qgramtable_type shift(65536, uint16_t(std::min(needle_length, QGRAM_MAX_SHIFT)));
+    if(needle_length < 2) return shift;
+
+    /* ...unless its second byte equals the first needle byte: then the
+     * needle may start at the last window position.
+     */
+    const uint16_t first_char_shift = uint16_t(std::min(needle_length - 1, QGRAM_MAX_SHIFT));
+    for(size_t a=0; a<256; ++a)
+        shift[(a << 8) | needle[0]] = first_char_shift;
+
+    /* Populate it with the analysis of the needle,
+     * ignoring the pair that ends at the last letter.
+     */
+    const size_t needle_length_minus_1 = needle_length-1;
+    for(size_t k=1; k<needle_length_minus_1; ++k)
+    {
+        shift[(size_t(needle[k - 1]) << 8) | needle[k]] =
+            uint16_t(std::min(needle_length_minus_1 - k, QGRAM_MAX_SHIFT));
+    }
+    return shift;
+}
+
+/* A Boyer-Moore-Horspool search algorithm with 2-gram shifts. */
+/* If it finds the needle, it returns an offset to haystack from which
+ * the needle was found. Otherwise, it returns haystack_length.
+ */
+size_t SearchInQGramHorspool(const unsigned char* haystack, size_t haystack_length,
+    const qgramtable_type& shift,
+    const unsigned char* needle,
+    const size_t needle_length)
+{
+    if(needle_length > haystack_length) return haystack_length;
+    if(needle_length == 1)
+    {
+        const unsigned char* result = (const unsigned char*)std::memchr(haystack, *needle, haystack_length);
+        return result ? size_t(result-haystack) : haystack_length;
+    }
+
+    const size_t needle_length_minus_1 = needle_length-1;
+    const unsigned char last_needle_char = needle[needle_length_minus_1];
+    const uint16_t* shift_table = &shift[0];
+
+    size_t haystack_position=0;
+    while(haystack_position <= haystack_length-needle_length)
+    {
+        const unsigned char* window_end = haystack + haystack_position + needle_length_minus_1;
+        const unsigned char last_char = window_end[0];
+        SEARCH_STATS_WINDOW(search_stats());
+
+        if(SEARCH_STATS_HIT(search_stats(), last_needle_char == last_char)
+        && SEARCH_STATS_VERIFY(search_stats(),
+               SEARCH_STATS_MEMCMP(search_stats(), needle, haystack+haystack_position, needle_length_minus_1) == 0))
+        {
+            return haystack_position;
+        }
+
+        SEARCH_STATS_SHIFT(search_stats(), shift_table[(size_t(window_end[-1]) << 8) | last_char]);
+        haystack_position += shift_table[(size_t(window_end[-1]) << 8) | last_char];
+    }
+    return haystack_length;
+}
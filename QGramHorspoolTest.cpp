@@ -0,0 +1,90 @@
+#include <string>
+
+#include "tut.h"
+#include "QGramHorspool.cpp"
+
+using namespace std;
+
+namespace tut {
+	struct QGramHorspoolTest {
+		static int find(const string &needle, const string &haystack) {
+			const qgramtable_type shift = CreateQGramTable(
+				(const unsigned char *) needle.c_str(),
+				needle.size());
+			size_t result = SearchInQGramHorspool(
+				(const unsigned char *) haystack.c_str(), haystack.size(),
+				shift,
+				(const unsigned char *) needle.c_str(), needle.size());
+			if (result == haystack.size()) {
+				return -1;
+			} else {
+				return (int) result;
+			}
+		}
+		
+		static string randomString(unsigned int &seed, size_t len, int alphabet_size) {
+			string result;
+			result.reserve(len);
+			for (size_t i = 0; i < len; i++) {
+				seed = seed * 1103515245 + 12345;
+				result.push_back(char('a' + (seed >> 16) % alphabet_size));
+			}
+			return result;
+		}
+	};
+	
+	DEFINE_TEST_GROUP(QGramHorspoolTest);
+	
+	TEST_METHOD(1) {
+		set_test_name("It returns the haystack length if the needle can't be found.");
+		
+		ensure_equals(find("0", "123456789"), -1);
+		ensure_equals(find("ab", "12a45678aa"), -1);
+		ensure_equals(find("aa", "12a4a678ba"), -1);
+		ensure_equals(find("hello world!", "oh my, hello world"), -1);
+		ensure_equals(find("1", ""), -1);
+		ensure_equals(find("hello my world!", "this is small"), -1);
+	}
+	
+	TEST_METHOD(2) {
+		set_test_name("It returns the position at which the needle is first found");
+		
+		ensure_equals(find("9", "1234567899"), 8);
+		ensure_equals(find("ab", "ab3456789ab"), 0);
+		ensure_equals(find("ab", "100456789aabab"), 10);
+		ensure_equals(find("\n\n", "h\nello\n\nworld\n\n"), 6);
+		ensure_equals(find("hello world!", "oh my, hello world!! again, hello world!!"), 7);
+		ensure_equals(find("I have control\n\n", "\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\nI have control\n\n"), 18);
+	}
+	
+	TEST_METHOD(3) {
+		set_test_name("A pair that does not occur in the needle shifts by the needle length");
+		
+		const string needle = "I have control\n\n";
+		const qgramtable_type shift = CreateQGramTable(
+			(const unsigned char *) needle.c_str(), needle.size());
+		ensure_equals(shift[('\n' << 8) | '\n'], needle.size());
+		ensure_equals(shift[('x' << 8) | 'I'], needle.size() - 1);
+		ensure_equals(shift[('o' << 8) | 'l'], 2u);
+	}
+	
+	TEST_METHOD(4) {
+		set_test_name("It agrees with std::string::find() on random data");
+		
+		unsigned int seed = 1;
+		for (int round = 0; round < 2000; round++) {
+			int alphabet_size = 2 + round % 3;
+			string haystack = randomString(seed, 1 + round % 300, alphabet_size);
+			string needle;
+			if (round % 2 == 0 && haystack.size() > 2) {
+				size_t start = (seed >> 8) % (haystack.size() - 1);
+				needle = haystack.substr(start, 1 + (seed >> 4) % 40);
+			} else {
+				needle = randomString(seed, 1 + round % 12, alphabet_size);
+			}
+			string::size_type expected = haystack.find(needle);
+			ensure_equals(find(needle, haystack),
+				expected == string::npos ? -1 : (int) expected);
+		}
+	}
+}
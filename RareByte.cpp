@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2010 Phusion v.o.f.
+ * https://github.com/FooBarWidget/boyer-moore-horspool
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Rare byte search.
+ *
+ * SearchInHorspool() and sbmh_feed() first compare the last needle byte,
+ * and only call memcmp() if it matches. When that byte is common in the
+ * haystack, such as the newline in "I have control\n" or a space, almost
+ * every window ends up in memcmp().
+ *
+ * This algorithm instead looks up, in a byte frequency table, which bytes of
+ * the needle are expected to be the rarest in the haystack. It uses memchr(),
+ * which libc implements with SIMD instructions, to jump straight to the
+ * occurrences of the rarest byte. Each occurrence is checked against the
+ * second rarest byte before the whole needle is compared.
+ *
+ * Built-in frequency tables are provided for text and for binary data. For
+ * other kinds of data, a table can be trained from a sample of the haystack.
+ *
+ * A plan can also be passed to sbmh_feed(), which then tests the rare bytes
+ * of each window instead of its last and first bytes. This overload is only
+ * available if StreamBoyerMooreHorspool.h is included before this file.
+ */
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <climits>
+
+/* A byte frequency table: entry i is a rank between 0 (never occurs)
+ * and 255 (the most common byte) for byte value i.
+ */
+typedef std::vector<unsigned char> bytefreq_type;
+
+/* The positions, within the needle, of the bytes that are used as guards. */
+struct RareBytePlan {
+    /* The rarest byte; memchr() searches for this one. */
+    size_t rare1;
+    /* The second rarest byte, at a different position than rare1
+     * (unless the needle is 1 byte long).
+     */
+    size_t rare2;
+};
+
+/* Byte frequency ranks of English text and HTML, derived from
+ * benchmark_input/alice.html.
+ */
+static const unsigned char TEXT_BYTE_FREQUENCIES[UCHAR_MAX+1] = {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0, 208,   0,   0, 208,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    255, 154, 138,  28,  17,  49, 106, 200, 108, 108, 114,   0, 197, 164, 175, 176,
+     94,  83,  68, 103,  35,  49,  40,  35,  52,  64, 139, 140, 194,  98, 194, 134,
+     28, 163, 119, 136, 134, 131, 112, 120, 137, 167,  71, 109, 112, 135, 124, 128,
+    120, 111, 127, 134, 156, 104,  80, 137,  64, 114,  17,  81,   0,  81,   0,  35,
+      0, 228, 185, 197, 214, 241, 192, 198, 224, 226, 129, 176, 214, 192, 224, 228,
+    204, 125, 218, 222, 234, 206, 171, 197, 136, 196, 112,  28,   0,  28,  17,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0
+};
+
+/* Returns the built-in byte frequency table for English text and HTML. */
+const bytefreq_type
+    CreateTextByteFrequencyTable()
+{
+    return bytefreq_type(TEXT_BYTE_FREQUENCIES, TEXT_BYTE_FREQUENCIES + UCHAR_MAX+1);
+}
+
+/* Returns the built-in byte frequency table for binary data. Most byte
+ * values are about equally common in binary data, except for zero padding,
+ * 0xFF fill bytes and small integers.
+ */
+const bytefreq_type
+    CreateBinaryByteFrequencyTable()
+{
+    bytefreq_type freq(UCHAR_MAX+1, 128);
+    for(size_t i=1; i<0x10; ++i)
+        freq[i] = 160;
+    freq[0xFF] = 200;
+    freq[0x00] = 255;
+    return freq;
+}
+
+/* Creates a byte frequency table from a sample of the data that will be
+ * searched. A few hundred kilobytes is usually plenty.
+ */
+const bytefreq_type
+    CreateByteFrequencyTable(const unsigned char* sample, size_t sample_length)
+{
+    std::vector<size_t> counts(UCHAR_MAX+1, 0);
+    for(size_t i=0; i<sample_length; ++i)
+        ++counts[sample[i]];
+
+    size_t max_count = 0;
+    for(size_t i=0; i<=UCHAR_MAX; ++i)
+        max_count = std::max(max_count, counts[i]);
+
+    /* Use a logarithmic scale so that the ranks of rare bytes stay apart. */
+    bytefreq_type freq(UCHAR_MAX+1, 0);
+    if(max_count == 0) return freq;
+    const double scale = 255.0 / std::log(1.0 + max_count);
+    for(size_t i=0; i<=UCHAR_MAX; ++i)
+        freq[i] = (unsigned char) (std::log(1.0 + counts[i]) * scale + 0.5);
+    return freq;
+}
+
+/* This function selects the guard bytes to be used by SearchInRareByte(). */
+/* It only needs to be created once per a needle to search. */
+const RareBytePlan
+    CreateRareBytePlan(const unsigned char* needle, size_t needle_length,
+        const bytefreq_type& freq)
+{
+    RareBytePlan plan;
+    plan.rare1 = 0;
+    plan.rare2 = 0;
+    if(needle_length == 0) return plan;
+
+    /* Prefer later positions on ties: they are closer to the end of the
+     * window, like the byte that Boyer-Moore-Horspool tests.
+     */
+    for(size_t i=1; i<needle_length; ++i)
+    {
+        if(freq[needle[i]] <= freq[needle[plan.rare1]])
+            plan.rare1 = i;
+    }
+
+    /* The second guard should preferably be a different byte value, as
+     * testing the same value twice tells us little.
+     */
+    bool have_rare2 = false;
+    for(size_t i=0; i<needle_length; ++i)
+    {
+        if(i == plan.rare1) continue;
+        if(!have_rare2)
+        {
+            plan.rare2 = i;
+            have_rare2 = true;
+            continue;
+        }
+        const bool current_differs = needle[plan.rare2] != needle[plan.rare1];
+        const bool candidate_differs = needle[i] != needle[plan.rare1];
+        if(candidate_differs != current_differs)
+        {
+            if(candidate_differs) plan.rare2 = i;
+        }
+        else if(freq[needle[i]] <= freq[needle[plan.rare2]])
+            plan.rare2 = i;
+    }
+    if(!have_rare2) plan.rare2 = plan.rare1;
+    return plan;
+}
+
+/* A rare byte search algorithm. */
+/* If it finds the needle, it returns an offset to haystack from which
+ * the needle was found. Otherwise, it returns haystack_length.
+ */
+size_t SearchInRareByte(const unsigned char* haystack, size_t haystack_length,
+    const RareBytePlan& plan,
+    const unsigned char* needle,
+    const size_t needle_length)
+{
+    if(needle_length > haystack_length) return haystack_length;
+
+    const unsigned char rare1_char = needle[plan.rare1];
+    const unsigned char rare2_char = needle[plan.rare2];
+
+    /* The rarest byte of a match at position p is at p + rare1, for
+     * p from 0 to haystack_length - needle_length.
+     */
+    const unsigned char* scan = haystack + plan.rare1;
+    const unsigned char* const scan_end = haystack + (haystack_length - needle_length) + plan.rare1 + 1;
+    while(scan < scan_end)
+    {
+        const unsigned char* hit = (const unsigned char*)std::memchr(scan, rare1_char, scan_end - scan);
+        if(hit == NULL) break;
+
+        const size_t haystack_position = (hit - haystack) - plan.rare1;
+        if(haystack[haystack_position + plan.rare2] == rare2_char
+        && std::memcmp(needle, haystack + haystack_position, needle_length) == 0)
+        {
+            return haystack_position;
+        }
+        scan = hit + 1;
+    }
+    return haystack_length;
+}
+
+#ifdef _STREAM_BOYER_MOORE_HORSPOOL_
+/* The guards of a RareBytePlan for _sbmh_feed(). */
+inline size_t _sbmh_guard1(const RareBytePlan& plan, sbmh_size_t)
+{
+    return plan.rare1;
+}
+
+inline size_t _sbmh_guard2(const RareBytePlan& plan, sbmh_size_t)
+{
+    return plan.rare2;
+}
+
+/* sbmh_feed() that compares the rarest bytes of each window, as chosen by
+ * the plan, before the rest of it, instead of its last and first bytes.
+ * The shifts still come from the occ table, so this helps when the last
+ * needle byte is common, and the plan must be created for the same needle.
+ */
+inline size_t sbmh_feed(struct StreamBMH *restrict ctx,
+    const struct StreamBMH_Occ *restrict occtable, const RareBytePlan& plan,
+    const unsigned char *restrict needle, sbmh_size_t needle_len,
+    const unsigned char *restrict data, size_t len)
+{
+    SEARCH_PROBE3(feed_entry, ctx, len, ctx->lookbehind_size);
+    size_t analyzed = _sbmh_feed(ctx, occtable->occ, plan, needle, needle_len, data, len);
+    SEARCH_PROBE4(feed_return, ctx, analyzed, ctx->found, ctx->lookbehind_size);
+    return analyzed;
+}
+#endif
@@ -0,0 +1,181 @@
+#include <string>
+
+#include "tut.h"
+#include "StreamBoyerMooreHorspool.h"
+#include "RareByte.cpp"
+
+using namespace std;
+
+namespace tut {
+	struct RareByteTest {
+		static int find(const string &needle, const string &haystack, const bytefreq_type &freq) {
+			const RareBytePlan plan = CreateRareBytePlan(
+				(const unsigned char *) needle.c_str(),
+				needle.size(),
+				freq);
+			size_t result = SearchInRareByte(
+				(const unsigned char *) haystack.c_str(), haystack.size(),
+				plan,
+				(const unsigned char *) needle.c_str(), needle.size());
+			if (result == haystack.size()) {
+				return -1;
+			} else {
+				return (int) result;
+			}
+		}
+		
+		static int find(const string &needle, const string &haystack) {
+			int result = find(needle, haystack, CreateTextByteFrequencyTable());
+			ensure_equals("binary frequency table",
+				find(needle, haystack, CreateBinaryByteFrequencyTable()), result);
+			ensure_equals("trained frequency table",
+				find(needle, haystack, CreateByteFrequencyTable(
+					(const unsigned char *) haystack.c_str(), haystack.size())),
+				result);
+			return result;
+		}
+		
+		/* Feeds the haystack to sbmh_feed() with the plan, in chunks of
+		 * random sizes, and returns where the needle was found.
+		 */
+		static int feed(const string &needle, const string &haystack,
+			const bytefreq_type &freq, unsigned int &seed)
+		{
+			const unsigned char *n = (const unsigned char *) needle.data();
+			const RareBytePlan plan = CreateRareBytePlan(n, needle.size(), freq);
+			string ctx_storage(SBMH_SIZE(needle.size()), '\0');
+			StreamBMH *ctx = (StreamBMH *) &ctx_storage[0];
+			StreamBMH_Occ occ;
+			sbmh_init(ctx, &occ, n, needle.size());
+			
+			size_t pos = 0;
+			while (pos < haystack.size()) {
+				seed = seed * 1103515245 + 12345;
+				size_t chunk = std::min(haystack.size() - pos, size_t(1 + (seed >> 16) % 20));
+				size_t analyzed = sbmh_feed(ctx, &occ, plan, n, needle.size(),
+					(const unsigned char *) haystack.data() + pos, chunk);
+				if (ctx->found) {
+					return (int) (pos + analyzed - needle.size());
+				}
+				pos += analyzed;
+			}
+			return -1;
+		}
+		
+		static string randomString(unsigned int &seed, size_t len, int alphabet_size) {
+			string result;
+			result.reserve(len);
+			for (size_t i = 0; i < len; i++) {
+				seed = seed * 1103515245 + 12345;
+				result.push_back(char('a' + (seed >> 16) % alphabet_size));
+			}
+			return result;
+		}
+	};
+	
+	DEFINE_TEST_GROUP(RareByteTest);
+	
+	TEST_METHOD(1) {
+		set_test_name("It returns the haystack length if the needle can't be found.");
+		
+		ensure_equals(find("0", "123456789"), -1);
+		ensure_equals(find("ab", "12a45678aa"), -1);
+		ensure_equals(find("aa", "12a4a678ba"), -1);
+		ensure_equals(find("hello world!", "oh my, hello world"), -1);
+		ensure_equals(find("1", ""), -1);
+		ensure_equals(find("hello my world!", "this is small"), -1);
+	}
+	
+	TEST_METHOD(2) {
+		set_test_name("It returns the position at which the needle is first found");
+		
+		ensure_equals(find("9", "1234567899"), 8);
+		ensure_equals(find("ab", "100456789aabab"), 10);
+		ensure_equals(find("\n\n", "h\nello\n\nworld\n\n"), 6);
+		ensure_equals(find("hello world!", "oh my, hello world!! again, hello world!!"), 7);
+		ensure_equals(find("I have control\n", "I have no control\nI have control\n"), 18);
+	}
+	
+	TEST_METHOD(3) {
+		set_test_name("It picks the rarest bytes of the needle as guards");
+		
+		const string needle = "I have control\n";
+		RareBytePlan plan = CreateRareBytePlan((const unsigned char *) needle.c_str(),
+			needle.size(), CreateTextByteFrequencyTable());
+		ensure_equals(needle[plan.rare1], 'I');
+		ensure_equals(needle[plan.rare2], 'v');
+		
+		const string sample = "IIIIIIIIIIIIIIIIvvvvvvvvv ave control\n";
+		plan = CreateRareBytePlan((const unsigned char *) needle.c_str(), needle.size(),
+			CreateByteFrequencyTable((const unsigned char *) sample.c_str(), sample.size()));
+		ensure_equals(needle[plan.rare1], 'h');
+		ensure("the second guard differs from the first",
+			needle[plan.rare2] != needle[plan.rare1]);
+	}
+	
+	TEST_METHOD(4) {
+		set_test_name("The second guard is a different byte value if possible");
+		
+		const string needle = "xxxxy";
+		RareBytePlan plan = CreateRareBytePlan((const unsigned char *) needle.c_str(),
+			needle.size(), CreateBinaryByteFrequencyTable());
+		ensure("the guards are at different positions", plan.rare1 != plan.rare2);
+		ensure("the guards have different values", needle[plan.rare1] != needle[plan.rare2]);
+		
+		plan = CreateRareBytePlan((const unsigned char *) "z", 1, CreateBinaryByteFrequencyTable());
+		ensure_equals(plan.rare1, 0u);
+		ensure_equals(plan.rare2, 0u);
+	}
+	
+	TEST_METHOD(5) {
+		set_test_name("It agrees with std::string::find() on random data");
+		
+		unsigned int seed = 1;
+		for (int round = 0; round < 2000; round++) {
+			int alphabet_size = 2 + round % 3;
+			string haystack = randomString(seed, 1 + round % 300, alphabet_size);
+			string needle;
+			if (round % 2 == 0 && haystack.size() > 2) {
+				size_t start = (seed >> 8) % (haystack.size() - 1);
+				needle = haystack.substr(start, 1 + (seed >> 4) % 40);
+			} else {
+				needle = randomString(seed, 1 + round % 12, alphabet_size);
+			}
+			string::size_type expected = haystack.find(needle);
+			ensure_equals(find(needle, haystack),
+				expected == string::npos ? -1 : (int) expected);
+		}
+	}
+	
+	TEST_METHOD(6) {
+		set_test_name("sbmh_feed() with a plan agrees with std::string::find() when fed in chunks");
+		
+		unsigned int seed = 1;
+		for (int round = 0; round < 2000; round++) {
+			int alphabet_size = 2 + round % 3;
+			string haystack = randomString(seed, 1 + round % 300, alphabet_size);
+			string needle;
+			if (round % 2 == 0 && haystack.size() > 2) {
+				size_t start = (seed >> 8) % (haystack.size() - 1);
+				needle = haystack.substr(start, 1 + (seed >> 4) % 40);
+			} else {
+				needle = randomString(seed, 1 + round % 12, alphabet_size);
+			}
+			if (round % 4 == 1) {
+				/* Bytes above 127 must not be sign extended. */
+				for (size_t i = 0; i < haystack.size(); i++) {
+					haystack[i] = char(haystack[i] + 0x80);
+				}
+				for (size_t i = 0; i < needle.size(); i++) {
+					needle[i] = char(needle[i] + 0x80);
+				}
+			}
+			const bytefreq_type freq = round % 3 == 0
+				? CreateTextByteFrequencyTable()
+				: CreateByteFrequencyTable((const unsigned char *) haystack.data(), haystack.size());
+			string::size_type expected = haystack.find(needle);
+			ensure_equals(feed(needle, haystack, freq, seed),
+				expected == string::npos ? -1 : (int) expected);
+		}
+	}
+}
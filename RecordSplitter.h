@@ -0,0 +1,330 @@
+/*
+ * Copyright (c) 2010 Phusion v.o.f.
+ * https://github.com/FooBarWidget/boyer-moore-horspool
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _RECORD_SPLITTER_
+#define _RECORD_SPLITTER_
+
+// Expecting StreamBoyerMooreHorspool.h to be included before this file.
+
+/*
+ * Splits a stream into records that are separated by a delimiter of one or
+ * more bytes, such as "\r\n" or "\0\0", using StreamBMH to find the
+ * delimiters.
+ *
+ *   struct RecordSplitter *splitter = record_splitter_new(
+ *      (const unsigned char *) "\r\n", 2, max_record_size);
+ *   if (splitter == NULL) {
+ *      // error...
+ *   }
+ *   splitter->callback = on_record;
+ *   splitter->user_data = ...;
+ *   while (... read data ...) {
+ *      if (!record_splitter_feed(splitter, data, len)) {
+ *         // out of memory; the current record is discarded
+ *      }
+ *   }
+ *   record_splitter_finish(splitter);   // The last record, if it has no delimiter.
+ *   record_splitter_free(splitter);
+ *
+ * The callback is invoked with every record, without its delimiter. An
+ * empty record between two consecutive delimiters is passed with a length
+ * of 0.
+ *
+ * A record that lies entirely within the fed data is passed as a pointer
+ * into that data, without copying it. A record that straddles the end of the
+ * fed data is gathered in a buffer of the splitter, which is reused for
+ * later records; then the record is passed from there. Either way the data
+ * is only valid during the callback.
+ *
+ * Records longer than max_record_size bytes are discarded and counted in
+ * 'oversized', so that the buffer never grows beyond max_record_size bytes.
+ *
+ * record_splitter_feed() returns false and sets errno to ENOMEM if the buffer
+ * could not be grown. The record that needed it is discarded; splitting
+ * continues with the next record.
+ */
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+
+/* Delimiters up to this length are found with memchr() on their first byte,
+ * because Boyer-Moore-Horspool shifts are too short for them.
+ */
+#define RECORD_SPLITTER_MEMCHR_MAX_DELIMITER 4
+
+struct RecordSplitter;
+
+typedef void (*record_cb)(struct RecordSplitter *splitter, const unsigned char *record, size_t len);
+
+struct RecordSplitter {
+	/***** Public but read-only fields *****/
+	/* Number of records that were discarded because they were too long. */
+	size_t         oversized;
+
+	/***** Public fields; feel free to populate *****/
+	record_cb      callback;
+	void          *user_data;
+
+	/***** Internal fields, do not access. *****/
+	size_t         max_record_size;
+	/* Number of bytes of the current record so far. */
+	size_t         record_len;
+	/* Whether the rest of the current record is dropped. */
+	bool           discarding;
+	bool           out_of_memory;
+	/* The part of the current record that lies in the data being fed. */
+	const unsigned char *span;
+	size_t         span_len;
+	const unsigned char *data;
+	const unsigned char *data_end;
+	/* The part of the current record that was fed before. */
+	unsigned char *buffer;
+	size_t         buffer_size;
+	size_t         buffer_capacity;
+	const unsigned char *delimiter;
+	sbmh_size_t    delimiter_len;
+	struct StreamBMH_Occ occ;
+	/* Must be last: the lookbehind buffer of 'ctx' and the delimiter follow it. */
+	struct StreamBMH ctx;
+};
+
+inline bool
+_record_splitter_append(struct RecordSplitter *splitter, const unsigned char *data, size_t len) {
+	if (splitter->buffer_size + len > splitter->buffer_capacity) {
+		size_t capacity = std::max<size_t>(splitter->buffer_capacity * 2, 256);
+		capacity = std::min(std::max(capacity, splitter->buffer_size + len),
+			splitter->max_record_size);
+		unsigned char *buffer = (unsigned char *) realloc(splitter->buffer, capacity);
+		if (buffer == NULL) {
+			splitter->out_of_memory = true;
+			splitter->discarding = true;
+			splitter->buffer_size = 0;
+			return false;
+		}
+		splitter->buffer = buffer;
+		splitter->buffer_capacity = capacity;
+	}
+	memcpy(splitter->buffer + splitter->buffer_size, data, len);
+	splitter->buffer_size += len;
+	return true;
+}
+
+/* Moves the part of the current record that lies in the fed data to the buffer. */
+inline void
+_record_splitter_save_span(struct RecordSplitter *splitter) {
+	if (splitter->span_len > 0 && !splitter->discarding) {
+		_record_splitter_append(splitter, splitter->span, splitter->span_len);
+	}
+	splitter->span_len = 0;
+}
+
+/* StreamBMH callback: adds non-delimiter data to the current record. */
+inline void
+_record_splitter_collect(const struct StreamBMH *ctx, const unsigned char *data, size_t len) {
+	struct RecordSplitter *splitter = (struct RecordSplitter *) ctx->user_data;
+	splitter->record_len += len;
+	if (splitter->discarding) {
+		return;
+	}
+	if (splitter->record_len > splitter->max_record_size) {
+		splitter->discarding = true;
+		splitter->span_len = 0;
+		splitter->buffer_size = 0;
+	} else if (data >= splitter->data && data < splitter->data_end && splitter->buffer_size == 0
+		&& (splitter->span_len == 0 || splitter->span + splitter->span_len == data))
+	{
+		/* Still contiguous in the fed data. */
+		if (splitter->span_len == 0) {
+			splitter->span = data;
+		}
+		splitter->span_len += len;
+	} else {
+		/* Data from the lookbehind buffer, or from a later feed. */
+		_record_splitter_save_span(splitter);
+		if (!splitter->discarding) {
+			_record_splitter_append(splitter, data, len);
+		}
+	}
+}
+
+/* Passes the current record to the callback, unless it was discarded, and
+ * starts a new one.
+ */
+inline void
+_record_splitter_end_record(struct RecordSplitter *splitter) {
+	if (splitter->record_len > splitter->max_record_size) {
+		splitter->oversized++;
+	} else if (!splitter->discarding && splitter->callback != NULL) {
+		if (splitter->buffer_size == 0) {
+			splitter->callback(splitter, splitter->span_len > 0 ? splitter->span : splitter->data,
+				splitter->span_len);
+		} else {
+			_record_splitter_save_span(splitter);
+			if (!splitter->discarding) {
+				splitter->callback(splitter, splitter->buffer, splitter->buffer_size);
+			}
+		}
+	}
+	splitter->record_len = 0;
+	splitter->discarding = false;
+	splitter->span_len = 0;
+	splitter->buffer_size = 0;
+}
+
+/* Returns NULL if the memory could not be allocated. The delimiter is copied. */
+inline struct RecordSplitter *
+record_splitter_new(const unsigned char *delimiter, sbmh_size_t delimiter_len, size_t max_record_size) {
+	assert(delimiter_len > 0);
+	struct RecordSplitter *splitter = (struct RecordSplitter *) malloc(
+		offsetof(struct RecordSplitter, ctx) + SBMH_SIZE(delimiter_len) + delimiter_len);
+	if (splitter == NULL) {
+		return NULL;
+	}
+	unsigned char *delimiter_copy = _SBMH_LOOKBEHIND(&splitter->ctx) + delimiter_len - 1;
+	memcpy(delimiter_copy, delimiter, delimiter_len);
+	splitter->oversized = 0;
+	splitter->callback = NULL;
+	splitter->user_data = NULL;
+	splitter->max_record_size = max_record_size;
+	splitter->record_len = 0;
+	splitter->discarding = false;
+	splitter->out_of_memory = false;
+	splitter->span = NULL;
+	splitter->span_len = 0;
+	splitter->data = NULL;
+	splitter->data_end = NULL;
+	splitter->buffer = NULL;
+	splitter->buffer_size = 0;
+	splitter->buffer_capacity = 0;
+	splitter->delimiter = delimiter_copy;
+	splitter->delimiter_len = delimiter_len;
+	sbmh_init(&splitter->ctx, &splitter->occ, delimiter_copy, delimiter_len);
+	splitter->ctx.callback = _record_splitter_collect;
+	splitter->ctx.user_data = splitter;
+	return splitter;
+}
+
+inline void
+record_splitter_free(struct RecordSplitter *splitter) {
+	if (splitter != NULL) {
+		free(splitter->buffer);
+		free(splitter);
+	}
+}
+
+/* Returns the offset of the first delimiter in the data, or 'len'. */
+inline size_t
+_record_splitter_find(const struct RecordSplitter *splitter, const unsigned char *data, size_t len) {
+	const unsigned char *delimiter = splitter->delimiter;
+	const size_t delimiter_len = splitter->delimiter_len;
+	const unsigned char *end = data + len;
+	const unsigned char *p = data;
+	while (size_t(end - p) >= delimiter_len
+	    && (p = (const unsigned char *) memchr(p, delimiter[0], end - p - delimiter_len + 1)) != NULL)
+	{
+		if (memcmp(p + 1, delimiter + 1, delimiter_len - 1) == 0) {
+			return p - data;
+		}
+		p++;
+	}
+	return len;
+}
+
+inline bool
+record_splitter_feed(struct RecordSplitter *splitter, const unsigned char *data, size_t len) {
+	const size_t delimiter_len = splitter->delimiter_len;
+	splitter->data = data;
+	splitter->data_end = data + len;
+	splitter->out_of_memory = false;
+	size_t pos = 0;
+	while (pos < len) {
+		if (delimiter_len <= RECORD_SPLITTER_MEMCHR_MAX_DELIMITER) {
+			if (splitter->ctx.lookbehind_size == 0) {
+				const size_t offset = _record_splitter_find(splitter, data + pos, len - pos);
+				if (offset < len - pos) {
+					if (offset > 0) {
+						_record_splitter_collect(&splitter->ctx, data + pos, offset);
+					}
+					_record_splitter_end_record(splitter);
+					pos += offset + delimiter_len;
+					continue;
+				}
+				/* Only the last delimiter_len - 1 bytes can start a delimiter. */
+				const size_t rest = std::min(len - pos, delimiter_len - 1);
+				if (len - pos > rest) {
+					_record_splitter_collect(&splitter->ctx, data + pos, len - pos - rest);
+					pos = len - rest;
+				}
+				if (pos == len) {
+					break;
+				}
+			}
+			/* Let StreamBMH resolve a delimiter that may straddle the end of
+			 * the fed data, a few bytes at a time.
+			 */
+			pos += sbmh_feed(&splitter->ctx, &splitter->occ, splitter->delimiter,
+				delimiter_len, data + pos, std::min(len - pos, delimiter_len - 1));
+		} else {
+			pos += sbmh_feed(&splitter->ctx, &splitter->occ, splitter->delimiter,
+				delimiter_len, data + pos, len - pos);
+		}
+		if (splitter->ctx.found) {
+			_record_splitter_end_record(splitter);
+			sbmh_reset(&splitter->ctx);
+		}
+	}
+	/* The rest of the record will be in a later feed. */
+	_record_splitter_save_span(splitter);
+	splitter->data = NULL;
+	splitter->data_end = NULL;
+	if (splitter->out_of_memory) {
+		errno = ENOMEM;
+		return false;
+	}
+	return true;
+}
+
+/* Passes the data after the last delimiter to the callback as the last
+ * record, if it's not empty, and prepares the splitter for a new stream.
+ */
+inline bool
+record_splitter_finish(struct RecordSplitter *splitter) {
+	splitter->out_of_memory = false;
+	/* A partial delimiter at the end belongs to the record. */
+	if (splitter->ctx.lookbehind_size > 0) {
+		_record_splitter_collect(&splitter->ctx, _SBMH_LOOKBEHIND(&splitter->ctx),
+			splitter->ctx.lookbehind_size);
+	}
+	if (splitter->record_len > 0) {
+		_record_splitter_end_record(splitter);
+	}
+	sbmh_reset(&splitter->ctx);
+	if (splitter->out_of_memory) {
+		errno = ENOMEM;
+		return false;
+	}
+	return true;
+}
+
+#endif /* _RECORD_SPLITTER_ */
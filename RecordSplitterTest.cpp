@@ -0,0 +1,148 @@
+#include <string>
+#include <vector>
+
+#include "tut.h"
+#include "StreamBoyerMooreHorspool.h"
+#include "RecordSplitter.h"
+
+using namespace std;
+
+namespace tut {
+	struct RecordSplitterTest {
+		RecordSplitter *splitter;
+		vector<string> records;
+		/* Whether each record pointed into the fed data. */
+		vector<bool> zero_copy;
+		const unsigned char *fed_begin, *fed_end;
+
+		RecordSplitterTest() {
+			splitter = NULL;
+			fed_begin = fed_end = NULL;
+		}
+
+		~RecordSplitterTest() {
+			record_splitter_free(splitter);
+		}
+
+		static void on_record(RecordSplitter *splitter, const unsigned char *record, size_t len) {
+			RecordSplitterTest *self = (RecordSplitterTest *) splitter->user_data;
+			self->records.push_back(string((const char *) record, len));
+			self->zero_copy.push_back(len == 0
+				|| (record >= self->fed_begin && record + len <= self->fed_end));
+		}
+
+		void init(const string &delimiter, size_t max_record_size = 1024 * 1024) {
+			record_splitter_free(splitter);
+			splitter = record_splitter_new((const unsigned char *) delimiter.data(),
+				delimiter.size(), max_record_size);
+			ensure(splitter != NULL);
+			splitter->callback = on_record;
+			splitter->user_data = this;
+			records.clear();
+			zero_copy.clear();
+		}
+
+		void feed(const string &data) {
+			fed_begin = (const unsigned char *) data.data();
+			fed_end = fed_begin + data.size();
+			ensure(record_splitter_feed(splitter, fed_begin, data.size()));
+			fed_begin = fed_end = NULL;
+		}
+
+		void split(const string &stream, size_t chunk_size) {
+			for (size_t pos = 0; pos < stream.size(); pos += chunk_size) {
+				feed(stream.substr(pos, chunk_size));
+			}
+			ensure(record_splitter_finish(splitter));
+		}
+	};
+
+	DEFINE_TEST_GROUP(RecordSplitterTest);
+
+	TEST_METHOD(1) {
+		set_test_name("It splits records that lie in the fed data without copying them");
+		init("\r\n");
+		feed("GET / HTTP/1.1\r\nHost: example.com\r\n\r\nlast");
+		ensure_equals(records.size(), 3u);
+		ensure_equals(records[0], "GET / HTTP/1.1");
+		ensure_equals(records[1], "Host: example.com");
+		ensure_equals(records[2], "");
+		ensure("zero copy", zero_copy[0] && zero_copy[1] && zero_copy[2]);
+
+		ensure(record_splitter_finish(splitter));
+		ensure_equals(records.size(), 4u);
+		ensure_equals(records[3], "last");
+	}
+
+	TEST_METHOD(2) {
+		set_test_name("Only records that straddle the end of the fed data are copied");
+		init("\r\n");
+		feed("abc\r\nde");
+		feed("f\r");
+		feed("\ng\r\n");
+		ensure_equals(records.size(), 3u);
+		ensure_equals(records[0], "abc");
+		ensure_equals(records[1], "def");
+		ensure_equals(records[2], "g");
+		ensure("abc is not copied", zero_copy[0]);
+		ensure("def is copied", !zero_copy[1]);
+		ensure("g is not copied", zero_copy[2]);
+	}
+
+	TEST_METHOD(3) {
+		set_test_name("It finds the same records when fed in chunks of any size");
+		const char *delimiters[] = { "\r\n", "\0\0", "<record-end>" };
+		const size_t delimiter_lengths[] = { 2, 2, 12 };
+		for (int d = 0; d < 3; d++) {
+			const string delimiter(delimiters[d], delimiter_lengths[d]);
+			string stream;
+			unsigned int seed = d + 1;
+			for (int i = 0; i < 40; i++) {
+				/* Fragments of the delimiter, and other bytes. */
+				seed = seed * 1103515245 + 12345;
+				for (size_t j = 0; j < (seed >> 8) % 30; j++) {
+					seed = seed * 1103515245 + 12345;
+					stream += ((seed >> 16) % 3 == 0) ? char(seed >> 20) : delimiter[(seed >> 16) % (delimiter.size() - 1)];
+				}
+				stream += delimiter;
+			}
+			stream += "tail" + delimiter.substr(0, delimiter.size() - 1);
+
+			vector<string> expected;
+			size_t start = 0, end;
+			while ((end = stream.find(delimiter, start)) != string::npos) {
+				expected.push_back(stream.substr(start, end - start));
+				start = end + delimiter.size();
+			}
+			expected.push_back(stream.substr(start));
+
+			for (size_t chunk_size = 1; chunk_size <= stream.size(); chunk_size++) {
+				init(delimiter);
+				split(stream, chunk_size);
+				ensure_equals("number of records", records.size(), expected.size());
+				for (size_t i = 0; i < records.size(); i++) {
+					ensure_equals(("delimiter " + to_string(d) + ", chunk size "
+						+ to_string(chunk_size)).c_str(), records[i], expected[i]);
+				}
+			}
+		}
+	}
+
+	TEST_METHOD(4) {
+		set_test_name("Records longer than the maximum are discarded");
+		init("\n", 10);
+		split("short\n0123456789\n0123456789a\nshort again\nok\n" + string(100, 'x'), 4);
+		ensure_equals(records.size(), 3u);
+		ensure_equals(records[0], "short");
+		ensure_equals(records[1], "0123456789");
+		ensure_equals(records[2], "ok");
+		ensure_equals(splitter->oversized, 3u);
+		ensure("the buffer is bounded", splitter->buffer_capacity <= 10);
+
+		init("\n", 10);
+		feed(string(100, 'x') + "\nin one feed\nfits\n");
+		ensure_equals(records.size(), 1u);
+		ensure_equals(records[0], "fits");
+		ensure_equals(splitter->oversized, 2u);
+	}
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2010 Phusion v.o.f.
+ * https://github.com/FooBarWidget/boyer-moore-horspool
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _SEARCH_PROBES_H_
+#define _SEARCH_PROBES_H_
+
+/*
+ * Static trace points (USDT probes) at the entry and exit of sbmh_feed(),
+ * SearchInHorspool(), SearchIn() and SearchInTurbo().
+ *
+ * Probes are only compiled in if SEARCH_PROBES is defined when compiling,
+ * e.g. with -DSEARCH_PROBES. A compiled-in probe is a single 'nop'
+ * instruction plus an ELF note that describes where its arguments live, so
+ * it costs next to nothing until a tracer such as bpftrace, perf or
+ * SystemTap attaches to it at runtime. No recompilation is needed to trace.
+ *
+ * If <sys/sdt.h> (SystemTap) is available, it is used. Otherwise, on x86-64
+ * with GCC or Clang, an equivalent built-in implementation emits the same
+ * note format. On other platforms, or without SEARCH_PROBES, the probe
+ * macros expand to nothing.
+ *
+ * All probes belong to the provider 'bmh'. All arguments are unsigned 64-bit:
+ *
+ *   feed_entry(ctx, len, lookbehind_size)
+ *   feed_return(ctx, analyzed, found, lookbehind_size)
+ *   horspool_entry(haystack_length, needle_length)
+ *   horspool_return(result, haystack_length)
+ *   bm_entry(haystack_length, needle_length)
+ *   bm_return(result, haystack_length)
+ *   turbo_entry(haystack_length, needle_length)
+ *   turbo_return(result, haystack_length)
+ *
+ * A search result equal to haystack_length means that the needle was not
+ * found. For example, a latency histogram of sbmh_feed() calls with bpftrace:
+ *
+ *   bpftrace -e '
+ *     usdt:./program:bmh:feed_entry { @start[tid] = nsecs; }
+ *     usdt:./program:bmh:feed_return /@start[tid]/ {
+ *       @ns = hist(nsecs - @start[tid]); delete(@start[tid]); }'
+ *
+ * See probes.bt and probe_demo.cpp.
+ */
+
+#include <stdint.h>
+
+#if defined(SEARCH_PROBES) && defined(__has_include)
+	#if __has_include(<sys/sdt.h>)
+		#include <sys/sdt.h>
+		#define SEARCH_PROBES_SDT
+	#endif
+#endif
+
+#if defined(SEARCH_PROBES_SDT)
+	#define SEARCH_PROBE2(name, a1, a2) \
+		DTRACE_PROBE2(bmh, name, (uint64_t) (a1), (uint64_t) (a2))
+	#define SEARCH_PROBE3(name, a1, a2, a3) \
+		DTRACE_PROBE3(bmh, name, (uint64_t) (a1), (uint64_t) (a2), (uint64_t) (a3))
+	#define SEARCH_PROBE4(name, a1, a2, a3, a4) \
+		DTRACE_PROBE4(bmh, name, (uint64_t) (a1), (uint64_t) (a2), (uint64_t) (a3), (uint64_t) (a4))
+
+#elif defined(SEARCH_PROBES) && defined(__GNUC__) && defined(__x86_64__) && defined(__ELF__)
+	/* A minimal version of the STAP_PROBE macros of <sys/sdt.h>: a 'nop',
+	 * and a version 3 .note.stapsdt entry that contains its address, the
+	 * provider and probe names, and the argument locations ("8@%rdi" means
+	 * an unsigned 8-byte value in register rdi). The .stapsdt.base section
+	 * lets tracers compute the address at which the program was loaded.
+	 */
+	#define _SEARCH_PROBE(name, args, ...) \
+		__asm__ __volatile__( \
+			"990: nop\n" \
+			".pushsection .note.stapsdt,\"\",\"note\"\n" \
+			".balign 4\n" \
+			".4byte 992f-991f, 994f-993f, 3\n" \
+			"991: .asciz \"stapsdt\"\n" \
+			"992: .balign 4\n" \
+			"993: .8byte 990b\n" \
+			".8byte _.stapsdt.base\n" \
+			".8byte 0\n" \
+			".asciz \"bmh\"\n" \
+			".asciz \"" #name "\"\n" \
+			".asciz \"" args "\"\n" \
+			"994: .balign 4\n" \
+			".popsection\n" \
+			".ifndef _.stapsdt.base\n" \
+			".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+			".weak _.stapsdt.base\n" \
+			".hidden _.stapsdt.base\n" \
+			"_.stapsdt.base: .space 1\n" \
+			".size _.stapsdt.base, 1\n" \
+			".popsection\n" \
+			".endif\n" \
+			: : __VA_ARGS__)
+	#define SEARCH_PROBE2(name, x1, x2) \
+		_SEARCH_PROBE(name, "8@%[a1] 8@%[a2]", \
+			[a1] "nor" ((uint64_t) (x1)), [a2] "nor" ((uint64_t) (x2)))
+	#define SEARCH_PROBE3(name, x1, x2, x3) \
+		_SEARCH_PROBE(name, "8@%[a1] 8@%[a2] 8@%[a3]", \
+			[a1] "nor" ((uint64_t) (x1)), [a2] "nor" ((uint64_t) (x2)), \
+			[a3] "nor" ((uint64_t) (x3)))
+	#define SEARCH_PROBE4(name, x1, x2, x3, x4) \
+		_SEARCH_PROBE(name, "8@%[a1] 8@%[a2] 8@%[a3] 8@%[a4]", \
+			[a1] "nor" ((uint64_t) (x1)), [a2] "nor" ((uint64_t) (x2)), \
+			[a3] "nor" ((uint64_t) (x3)), [a4] "nor" ((uint64_t) (x4)))
+
+#else
+	#define SEARCH_PROBE2(name, a1, a2) do { /* nothing */ } while (false)
+	#define SEARCH_PROBE3(name, a1, a2, a3) do { /* nothing */ } while (false)
+	#define SEARCH_PROBE4(name, a1, a2, a3, a4) do { /* nothing */ } while (false)
+#endif
+
+#endif /* _SEARCH_PROBES_H_ */
@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2010 Phusion v.o.f.
+ * https://github.com/FooBarWidget/boyer-moore-horspool
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _SEARCH_STATS_H_
+#define _SEARCH_STATS_H_
+
+/*
+ * Hot-path statistics, for finding out why a particular needle is slow.
+ *
+ * Statistics are only collected if SEARCH_STATS is defined when compiling,
+ * e.g. with -DSEARCH_STATS. Otherwise the SEARCH_STATS_* macros below expand
+ * to nothing (or to the plain expression they wrap), so the algorithms
+ * compile to exactly the same code as without them. Define it consistently
+ * in all translation units of a program: it changes the layout of StreamBMH.
+ *
+ * Where the counters are kept:
+ * - StreamBMH has a 'stats' field, so each context counts for itself. It is
+ *   cleared by sbmh_init() but not by sbmh_reset(), so that it accumulates
+ *   over all haystacks that the context searched.
+ * - SearchInHorspool(), SearchIn(), SearchInTurbo(), SearchInQGramHorspool(),
+ *   SearchInTwoWay() and stw_feed() count into search_stats(), which is per
+ *   thread. Two-Way only counts comparisons. sbmh_lazy_feed() adds the
+ *   counters of its temporary StreamBMH context to search_stats() as well.
+ *   Call search_stats_reset(search_stats()) before searching for a needle to
+ *   get the counters for that needle.
+ */
+
+#ifdef SEARCH_STATS
+
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+
+/* Shift histogram bucket i counts the shifts in [2^i, 2^(i+1)); the last
+ * bucket also counts all larger shifts.
+ */
+#define SEARCH_STATS_HISTOGRAM_SIZE 16
+
+struct SearchStats {
+	/* Number of haystack windows (candidate positions) examined. */
+	unsigned long long windows;
+	/* Number of symbol comparisons with the needle, in any direction.
+	 * A memcmp() counts the bytes that it had to look at: up to and
+	 * including the first difference.
+	 */
+	unsigned long long comparisons;
+	/* Number and sum of the shifts from one window to the next. */
+	unsigned long long shifts;
+	unsigned long long shift_total;
+	unsigned long long shift_histogram[SEARCH_STATS_HISTOGRAM_SIZE];
+	/* Number of windows whose last byte matched the needle. */
+	unsigned long long last_byte_hits;
+	/* Number of times that the rest of a window was compared with the
+	 * needle, and how many of those comparisons failed.
+	 */
+	unsigned long long verifications;
+	unsigned long long verification_failures;
+	/* StreamBMH only: number of copies into the lookbehind buffer and the
+	 * number of bytes copied.
+	 */
+	unsigned long long lookbehind_copies;
+	unsigned long long lookbehind_bytes;
+	/* StreamBMH only: number of callback invocations and the number of
+	 * bytes passed to them.
+	 */
+	unsigned long long callbacks;
+	unsigned long long callback_bytes;
+};
+
+inline void
+search_stats_reset(SearchStats &stats) {
+	memset(&stats, 0, sizeof(stats));
+}
+
+/* The statistics of the in-memory search functions and of lazy StreamBMH
+ * contexts on the calling thread.
+ */
+inline SearchStats &
+search_stats() {
+	static thread_local SearchStats stats;
+	return stats;
+}
+
+inline void
+search_stats_add(SearchStats &total, const SearchStats &stats) {
+	total.windows += stats.windows;
+	total.comparisons += stats.comparisons;
+	total.shifts += stats.shifts;
+	total.shift_total += stats.shift_total;
+	for (unsigned int i = 0; i < SEARCH_STATS_HISTOGRAM_SIZE; i++) {
+		total.shift_histogram[i] += stats.shift_histogram[i];
+	}
+	total.last_byte_hits += stats.last_byte_hits;
+	total.verifications += stats.verifications;
+	total.verification_failures += stats.verification_failures;
+	total.lookbehind_copies += stats.lookbehind_copies;
+	total.lookbehind_bytes += stats.lookbehind_bytes;
+	total.callbacks += stats.callbacks;
+	total.callback_bytes += stats.callback_bytes;
+}
+
+inline void
+search_stats_shift(SearchStats &stats, size_t shift) {
+	unsigned int bucket = 0;
+	while (bucket < SEARCH_STATS_HISTOGRAM_SIZE - 1 && (size_t(2) << bucket) <= shift) {
+		bucket++;
+	}
+	stats.shifts++;
+	stats.shift_total += shift;
+	stats.shift_histogram[bucket]++;
+}
+
+inline bool
+search_stats_hit(SearchStats &stats, bool hit) {
+	stats.comparisons++;
+	if (hit) {
+		stats.last_byte_hits++;
+	}
+	return hit;
+}
+
+inline bool
+search_stats_verify(SearchStats &stats, bool equal) {
+	stats.verifications++;
+	if (!equal) {
+		stats.verification_failures++;
+	}
+	return equal;
+}
+
+inline int
+search_stats_memcmp(SearchStats &stats, const void *a, const void *b, size_t len) {
+	const unsigned char *p = (const unsigned char *) a;
+	const unsigned char *q = (const unsigned char *) b;
+	size_t i = 0;
+	while (i < len && p[i] == q[i]) {
+		i++;
+	}
+	stats.comparisons += (i < len) ? i + 1 : len;
+	return std::memcmp(a, b, len);
+}
+
+/* Boyer-Moore and Turbo Boyer-Moore compare right-to-left, starting with
+ * the last byte. Everything after a matching last byte is a verification.
+ */
+inline void
+search_stats_backwards_match(SearchStats &stats, size_t match_len, size_t needle_len) {
+	if (match_len > 0) {
+		stats.last_byte_hits++;
+		search_stats_verify(stats, match_len >= needle_len);
+	}
+}
+
+inline void
+search_stats_print(const SearchStats &stats, FILE *f) {
+	fprintf(f, "    windows %llu, comparisons %llu, average shift %.2f, last byte hits %llu, "
+		"verifications %llu (%llu failed)\n",
+		stats.windows, stats.comparisons,
+		stats.shifts == 0 ? 0.0 : double(stats.shift_total) / stats.shifts,
+		stats.last_byte_hits, stats.verifications, stats.verification_failures);
+	if (stats.lookbehind_copies > 0 || stats.callbacks > 0) {
+		fprintf(f, "    lookbehind copies %llu (%llu bytes), callbacks %llu (%llu bytes)\n",
+			stats.lookbehind_copies, stats.lookbehind_bytes,
+			stats.callbacks, stats.callback_bytes);
+	}
+	fprintf(f, "    shifts:");
+	for (unsigned int i = 0; i < SEARCH_STATS_HISTOGRAM_SIZE; i++) {
+		if (stats.shift_histogram[i] == 0) {
+			continue;
+		}
+		if (i == SEARCH_STATS_HISTOGRAM_SIZE - 1) {
+			fprintf(f, " %lu+:%llu", 1ul << i, stats.shift_histogram[i]);
+		} else if (i == 0) {
+			fprintf(f, " 1:%llu", stats.shift_histogram[i]);
+		} else {
+			fprintf(f, " %lu-%lu:%llu", 1ul << i, (2ul << i) - 1, stats.shift_histogram[i]);
+		}
+	}
+	fprintf(f, "\n");
+}
+
+#define SEARCH_STATS_RESET(stats) search_stats_reset(stats)
+#define SEARCH_STATS_ADD(total, stats) search_stats_add(total, stats)
+#define SEARCH_STATS_WINDOW(stats) ((stats).windows++)
+#define SEARCH_STATS_SHIFT(stats, shift) search_stats_shift(stats, shift)
+#define SEARCH_STATS_HIT(stats, expr) search_stats_hit(stats, (expr))
+#define SEARCH_STATS_COMPARE(stats, expr) ((stats).comparisons++, (expr))
+#define SEARCH_STATS_COMPARISONS(stats, count) ((stats).comparisons += (count))
+#define SEARCH_STATS_MEMCMP(stats, a, b, len) search_stats_memcmp(stats, a, b, len)
+#define SEARCH_STATS_VERIFY(stats, expr) search_stats_verify(stats, (expr))
+#define SEARCH_STATS_BACKWARDS_MATCH(stats, match_len, needle_len) \
+	search_stats_backwards_match(stats, match_len, needle_len)
+#define SEARCH_STATS_LOOKBEHIND_COPY(stats, len) \
+	do { (stats).lookbehind_copies++; (stats).lookbehind_bytes += (len); } while (false)
+#define SEARCH_STATS_CALLBACK(stats, len) \
+	do { (stats).callbacks++; (stats).callback_bytes += (len); } while (false)
+
+#else
+
+#define SEARCH_STATS_RESET(stats) do { /* nothing */ } while (false)
+#define SEARCH_STATS_ADD(total, stats) do { /* nothing */ } while (false)
+#define SEARCH_STATS_WINDOW(stats) do { /* nothing */ } while (false)
+#define SEARCH_STATS_SHIFT(stats, shift) do { /* nothing */ } while (false)
+#define SEARCH_STATS_HIT(stats, expr) (expr)
+#define SEARCH_STATS_COMPARE(stats, expr) (expr)
+#define SEARCH_STATS_COMPARISONS(stats, count) do { /* nothing */ } while (false)
+#define SEARCH_STATS_MEMCMP(stats, a, b, len) std::memcmp(a, b, len)
+#define SEARCH_STATS_VERIFY(stats, expr) (expr)
+#define SEARCH_STATS_BACKWARDS_MATCH(stats, match_len, needle_len) do { /* nothing */ } while (false)
+#define SEARCH_STATS_LOOKBEHIND_COPY(stats, len) do { /* nothing */ } while (false)
+#define SEARCH_STATS_CALLBACK(stats, len) do { /* nothing */ } while (false)
+
+#endif /* SEARCH_STATS */
+
+#endif /* _SEARCH_STATS_H_ */
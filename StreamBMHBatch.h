@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2010 Phusion v.o.f.
+ * https://github.com/FooBarWidget/boyer-moore-horspool
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _STREAM_BMH_BATCH_
+#define _STREAM_BMH_BATCH_
+
+// Expecting StreamBoyerMooreHorspool.h to be included before this file.
+
+/*
+ * Feeds chunks to many streaming searches at once, for servers that keep a
+ * search per connection and touch each connection only briefly.
+ *
+ * A StreamBMHBatch holds the state of up to 'capacity' searches, which are
+ * identified by their index. The state is stored as a struct of arrays: the
+ * 'found' flags, the lookbehind sizes and the lookbehind buffers each have
+ * an array of their own. The flags and sizes of thousands of searches then
+ * take a few KB that stay in the CPU caches, while separate StreamBMH
+ * contexts take a cache line each that is usually evicted by the time the
+ * connection sends more data.
+ *
+ *   struct StreamBMHBatch batch;
+ *   if (!sbmh_batch_init(&batch, max_connections, max_needle_len)) {
+ *      // error...
+ *   }
+ *
+ *   struct StreamBMHBatchFeed feeds[n];
+ *   feeds[i].context = ...;   // Index of the search, < max_connections
+ *   feeds[i].occ = &occ;      // As initialized by sbmh_init()
+ *   feeds[i].needle = needle;
+ *   feeds[i].needle_len = needle_len;
+ *   feeds[i].data = data;
+ *   feeds[i].len = len;
+ *   sbmh_batch_feed(&batch, feeds, n);
+ *   ... feeds[i].analyzed, batch.found[feeds[i].context] ...
+ *
+ *   sbmh_batch_reset(&batch, context);   // When the connection is reused.
+ *   sbmh_batch_destroy(&batch);
+ *
+ * sbmh_batch_feed() sets feeds[i].analyzed to what sbmh_feed() would have
+ * returned, and invokes the batch's callback, if any, with the same data as
+ * sbmh_feed() would have. A search may only occur once in a call.
+ *
+ * The windows of up to SBMH_BATCH_LANES chunks are examined in turns, so that
+ * the CPU can load the bytes of one chunk while it looks up the shift of
+ * another. A search that starts with a partial match in its lookbehind
+ * buffer is handled on its own, like sbmh_feed() does. Search statistics
+ * and trace points are not available.
+ *
+ * A batch is not thread-safe.
+ */
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <alloca.h>
+
+/* Number of chunks whose windows are examined in turns. */
+#define SBMH_BATCH_LANES 8
+
+#ifdef __GNUC__
+	#define _SBMH_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+	#define _SBMH_PREFETCH(addr) do { /* nothing */ } while (false)
+#endif
+
+struct StreamBMHBatch;
+
+typedef void (*sbmh_batch_data_cb)(const struct StreamBMHBatch *batch, size_t context,
+	const unsigned char *data, size_t len);
+
+struct StreamBMHBatch {
+	/***** Public but read-only fields *****/
+	size_t         capacity;
+	sbmh_size_t    max_needle_len;
+	/* found[i] is whether search i has found its needle. */
+	bool          *found;
+
+	/***** Public fields; feel free to populate *****/
+	sbmh_batch_data_cb callback;
+	void          *user_data;
+
+	/***** Internal fields, do not access. *****/
+	sbmh_size_t   *lookbehind_size;
+	/* max_needle_len - 1 bytes for every search. */
+	unsigned char *lookbehind;
+};
+
+struct StreamBMHBatchFeed {
+	size_t context;
+	const struct StreamBMH_Occ *occ;
+	const unsigned char *needle;
+	sbmh_size_t needle_len;
+	const unsigned char *data;
+	size_t len;
+	/* Set by sbmh_batch_feed(). */
+	size_t analyzed;
+};
+
+/* Returns false if the memory could not be allocated. */
+inline bool
+sbmh_batch_init(struct StreamBMHBatch *batch, size_t capacity, sbmh_size_t max_needle_len) {
+	const size_t stride = std::max<sbmh_size_t>(max_needle_len, 1) - 1;
+	char *memory = (char *) malloc(capacity * (sizeof(sbmh_size_t) + sizeof(bool) + stride));
+	if (memory == NULL && capacity > 0) {
+		return false;
+	}
+	batch->capacity = capacity;
+	batch->max_needle_len = max_needle_len;
+	batch->lookbehind_size = (sbmh_size_t *) memory;
+	batch->found = (bool *) (memory + capacity * sizeof(sbmh_size_t));
+	batch->lookbehind = (unsigned char *) (batch->found + capacity);
+	batch->callback = NULL;
+	batch->user_data = NULL;
+	memset(batch->found, 0, capacity * sizeof(bool));
+	memset(batch->lookbehind_size, 0, capacity * sizeof(sbmh_size_t));
+	return true;
+}
+
+inline void
+sbmh_batch_destroy(struct StreamBMHBatch *batch) {
+	free(batch->lookbehind_size);
+	batch->lookbehind_size = NULL;
+	batch->found = NULL;
+	batch->lookbehind = NULL;
+	batch->capacity = 0;
+}
+
+inline void
+sbmh_batch_reset(struct StreamBMHBatch *batch, size_t context) {
+	batch->found[context] = false;
+	batch->lookbehind_size[context] = 0;
+}
+
+inline unsigned char *
+_sbmh_batch_lookbehind(const struct StreamBMHBatch *batch, size_t context) {
+	return batch->lookbehind + context * (batch->max_needle_len - 1);
+}
+
+struct _SbmhBatchCallbackContext {
+	const struct StreamBMHBatch *batch;
+	size_t context;
+};
+
+inline void
+_sbmh_batch_forward_callback(const struct StreamBMH *ctx, const unsigned char *data, size_t len) {
+	const struct _SbmhBatchCallbackContext *cb = (const struct _SbmhBatchCallbackContext *) ctx->user_data;
+	cb->batch->callback(cb->batch, cb->context, data, len);
+}
+
+/* Feeds a search whose lookbehind buffer is not empty with a regular
+ * StreamBMH context on the stack, like sbmh_lazy_feed() does.
+ */
+inline size_t
+_sbmh_batch_feed_one(struct StreamBMHBatch *batch, const struct StreamBMHBatchFeed *feed) {
+	const size_t context = feed->context;
+	struct StreamBMH *work = (struct StreamBMH *) alloca(SBMH_SIZE(feed->needle_len));
+	struct _SbmhBatchCallbackContext cb = { batch, context };
+	sbmh_init(work, NULL, NULL, feed->needle_len);
+	if (batch->callback != NULL) {
+		work->callback = _sbmh_batch_forward_callback;
+		work->user_data = &cb;
+	}
+	memcpy(_SBMH_LOOKBEHIND(work), _sbmh_batch_lookbehind(batch, context),
+		batch->lookbehind_size[context]);
+	work->lookbehind_size = batch->lookbehind_size[context];
+
+	size_t analyzed = _sbmh_feed(work, feed->occ->occ, StreamBMH_DefaultGuards(),
+		feed->needle, feed->needle_len, feed->data, feed->len);
+
+	batch->found[context] = work->found;
+	batch->lookbehind_size[context] = work->lookbehind_size;
+	memcpy(_sbmh_batch_lookbehind(batch, context), _SBMH_LOOKBEHIND(work),
+		work->lookbehind_size);
+	return analyzed;
+}
+
+/* Finishes a chunk whose windows have all been examined without a match,
+ * like the end of _sbmh_feed(): keeps a trailing partial match.
+ */
+inline void
+_sbmh_batch_finish(struct StreamBMHBatch *batch, struct StreamBMHBatchFeed *feed, size_t pos) {
+	const unsigned char *data = feed->data;
+	const size_t len = feed->len;
+	while (pos < len
+	    && (data[pos] != feed->needle[0] || memcmp(data + pos, feed->needle, len - pos) != 0))
+	{
+		pos++;
+	}
+	if (pos < len) {
+		memcpy(_sbmh_batch_lookbehind(batch, feed->context), data + pos, len - pos);
+		batch->lookbehind_size[feed->context] = len - pos;
+	}
+	if (pos > 0 && batch->callback != NULL) {
+		batch->callback(batch, feed->context, data, std::min(pos, len));
+	}
+	feed->analyzed = len;
+}
+
+/* Feeds feeds[i].data to search feeds[i].context, for all i < count. */
+inline void
+sbmh_batch_feed(struct StreamBMHBatch *restrict batch, struct StreamBMHBatchFeed *feeds, size_t count) {
+	struct StreamBMHBatchFeed *lane_feed[SBMH_BATCH_LANES];
+	size_t lane_pos[SBMH_BATCH_LANES];
+	size_t next = 0;
+
+	while (next < count) {
+		/* Fill the lanes with chunks that start without a partial match. */
+		unsigned int lanes = 0;
+		while (lanes < SBMH_BATCH_LANES && next < count) {
+			struct StreamBMHBatchFeed *feed = &feeds[next++];
+			assert(feed->context < batch->capacity);
+			assert(feed->needle_len > 0 && feed->needle_len <= batch->max_needle_len);
+			if (batch->found[feed->context]) {
+				feed->analyzed = 0;
+			} else if (batch->lookbehind_size[feed->context] > 0) {
+				feed->analyzed = _sbmh_batch_feed_one(batch, feed);
+			} else {
+				_SBMH_PREFETCH(feed->data + feed->needle_len - 1);
+				lane_feed[lanes] = feed;
+				lane_pos[lanes] = 0;
+				lanes++;
+			}
+		}
+
+		/* Examine one window of every lane in turn. A lane that is done is
+		 * replaced by the last one.
+		 */
+		while (lanes > 0) {
+			unsigned int i = 0;
+			while (i < lanes) {
+				struct StreamBMHBatchFeed *feed = lane_feed[i];
+				const sbmh_size_t needle_len = feed->needle_len;
+				const size_t pos = lane_pos[i];
+				if (unlikely( pos + needle_len > feed->len )) {
+					_sbmh_batch_finish(batch, feed, pos);
+				} else {
+					const unsigned char *needle = feed->needle;
+					const unsigned char *data = feed->data;
+					const unsigned char ch = data[pos + needle_len - 1];
+					if (likely( ch != needle[needle_len - 1]
+					         || data[pos] != needle[0]
+					         || memcmp(needle, data + pos, needle_len - 1) != 0 ))
+					{
+						lane_pos[i] = pos + feed->occ->occ[ch];
+						i++;
+						continue;
+					}
+					batch->found[feed->context] = true;
+					if (pos > 0 && batch->callback != NULL) {
+						batch->callback(batch, feed->context, data, pos);
+					}
+					feed->analyzed = pos + needle_len;
+				}
+				lanes--;
+				lane_feed[i] = lane_feed[lanes];
+				lane_pos[i] = lane_pos[lanes];
+			}
+		}
+	}
+}
+
+#endif /* _STREAM_BMH_BATCH_ */
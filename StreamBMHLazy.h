@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2010 Phusion v.o.f.
+ * https://github.com/FooBarWidget/boyer-moore-horspool
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _STREAM_BMH_LAZY_
+#define _STREAM_BMH_LAZY_
+
+// Expecting StreamBoyerMooreHorspool.h to be included before this file.
+
+/*
+ * A StreamBMH variant for servers with very many idle connections.
+ *
+ * A StreamBMH context has room for a lookbehind buffer of needle_len - 1
+ * bytes, but only needs it while the fed data ends with a partial match of
+ * the needle. A StreamBMHLazy context has no buffer of its own: it borrows a
+ * lookbehind buffer from a shared StreamBMH_LookbehindSlab when a partial
+ * match straddles the end of the fed data, and returns it as soon as the
+ * partial match is resolved. An idle context is 16 bytes on 64-bit
+ * platforms, regardless of the needle length.
+ *
+ *   struct StreamBMH_LookbehindSlab slab;
+ *   sbmh_lookbehind_slab_init(&slab, max_needle_len);
+ *
+ *   struct StreamBMHLazy ctx;
+ *   sbmh_lazy_init(&ctx);
+ *   ... sbmh_lazy_feed(&ctx, &slab, &occ, needle, needle_len, data, len,
+ *          callback, user_data) ...
+ *   sbmh_lazy_reset(&ctx, &slab);   // Returns the buffer, if any.
+ *
+ *   sbmh_lookbehind_slab_destroy(&slab);
+ *
+ * sbmh_lazy_feed() behaves like sbmh_feed(). Because the context has no room
+ * for a callback and user data, they are passed to each sbmh_lazy_feed()
+ * call instead. The callback is invoked with a temporary StreamBMH context
+ * whose 'user_data' is the given user data.
+ *
+ * sbmh_lazy_feed() returns 0 without analyzing anything if a lookbehind
+ * buffer might be needed but none could be allocated.
+ *
+ * The context has no room for search statistics either. When compiled with
+ * SEARCH_STATS, sbmh_lazy_feed() adds the counters of the temporary context
+ * to search_stats() of the calling thread, so they add up over all lazy
+ * contexts on that thread. The trace points of sbmh_feed() see the address
+ * of the temporary context, not of the lazy one.
+ *
+ * A slab is not thread-safe: use one per thread, and always return a buffer
+ * to the slab that it was borrowed from. A context that still holds a
+ * buffer must be reset with sbmh_lazy_reset() before it's discarded.
+ */
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <alloca.h>
+
+/* Size of the chunks that lookbehind buffers are carved out of. */
+#define SBMH_LOOKBEHIND_SLAB_CHUNK_SIZE (64 * 1024)
+
+struct StreamBMHLazy {
+	/***** Public but read-only fields *****/
+	bool           found;
+
+	/***** Internal fields, do not access. *****/
+	sbmh_size_t    lookbehind_size;
+	/* Borrowed from the slab while lookbehind_size > 0, NULL otherwise. */
+	unsigned char *lookbehind;
+};
+
+struct _SbmhLookbehindChunk {
+	struct _SbmhLookbehindChunk *next;
+};
+
+struct StreamBMH_LookbehindSlab {
+	/***** Public but read-only fields *****/
+	/* Number of buffers that are currently borrowed. */
+	size_t buffers_in_use;
+	/* Total size of all chunks. */
+	size_t bytes_allocated;
+
+	/***** Internal fields, do not access. *****/
+	size_t buffer_size;
+	void *free_list;
+	char *bump;
+	char *bump_end;
+	struct _SbmhLookbehindChunk *chunks;
+};
+
+inline void
+sbmh_lookbehind_slab_init(struct StreamBMH_LookbehindSlab *slab, sbmh_size_t max_needle_len) {
+	/* A free buffer stores the pointer to the next free buffer. */
+	size_t size = std::max<size_t>(max_needle_len, 2) - 1;
+	slab->buffer_size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+	slab->buffers_in_use = 0;
+	slab->bytes_allocated = 0;
+	slab->free_list = NULL;
+	slab->bump = NULL;
+	slab->bump_end = NULL;
+	slab->chunks = NULL;
+}
+
+/* Frees all memory of the slab, including buffers that are still borrowed. */
+inline void
+sbmh_lookbehind_slab_destroy(struct StreamBMH_LookbehindSlab *slab) {
+	struct _SbmhLookbehindChunk *chunk = slab->chunks;
+	while (chunk != NULL) {
+		struct _SbmhLookbehindChunk *next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
+	sbmh_lookbehind_slab_init(slab, 1);
+}
+
+/* Makes sure that the next _sbmh_lookbehind_take() succeeds. */
+inline bool
+_sbmh_lookbehind_reserve(struct StreamBMH_LookbehindSlab *slab) {
+	if (likely(slab->free_list != NULL || slab->bump != slab->bump_end)) {
+		return true;
+	}
+	const size_t header_size = (sizeof(struct _SbmhLookbehindChunk) + sizeof(void *) - 1)
+		& ~(sizeof(void *) - 1);
+	const size_t buffers = std::max<size_t>(1,
+		(SBMH_LOOKBEHIND_SLAB_CHUNK_SIZE - header_size) / slab->buffer_size);
+	const size_t chunk_size = header_size + buffers * slab->buffer_size;
+	struct _SbmhLookbehindChunk *chunk = (struct _SbmhLookbehindChunk *) malloc(chunk_size);
+	if (chunk == NULL) {
+		return false;
+	}
+	chunk->next = slab->chunks;
+	slab->chunks = chunk;
+	slab->bytes_allocated += chunk_size;
+	slab->bump = (char *) chunk + header_size;
+	slab->bump_end = slab->bump + buffers * slab->buffer_size;
+	return true;
+}
+
+inline unsigned char *
+_sbmh_lookbehind_take(struct StreamBMH_LookbehindSlab *slab) {
+	unsigned char *buffer;
+	if (slab->free_list != NULL) {
+		buffer = (unsigned char *) slab->free_list;
+		slab->free_list = *(void **) buffer;
+	} else {
+		assert(slab->bump != slab->bump_end);
+		buffer = (unsigned char *) slab->bump;
+		slab->bump += slab->buffer_size;
+	}
+	slab->buffers_in_use++;
+	return buffer;
+}
+
+inline void
+_sbmh_lookbehind_give_back(struct StreamBMH_LookbehindSlab *slab, unsigned char *buffer) {
+	*(void **) buffer = slab->free_list;
+	slab->free_list = buffer;
+	slab->buffers_in_use--;
+}
+
+inline void
+sbmh_lazy_init(struct StreamBMHLazy *ctx) {
+	ctx->found = false;
+	ctx->lookbehind_size = 0;
+	ctx->lookbehind = NULL;
+}
+
+inline void
+sbmh_lazy_reset(struct StreamBMHLazy *ctx, struct StreamBMH_LookbehindSlab *slab) {
+	if (ctx->lookbehind != NULL) {
+		_sbmh_lookbehind_give_back(slab, ctx->lookbehind);
+	}
+	sbmh_lazy_init(ctx);
+}
+
+inline size_t
+sbmh_lazy_feed(struct StreamBMHLazy *ctx, struct StreamBMH_LookbehindSlab *slab,
+	const struct StreamBMH_Occ *occtable,
+	const unsigned char *needle, sbmh_size_t needle_len,
+	const unsigned char *data, size_t len,
+	sbmh_data_cb callback = NULL, void *user_data = NULL)
+{
+	if (ctx->found) {
+		return 0;
+	}
+	assert(size_t(needle_len) <= slab->buffer_size + 1);
+	/* Reserve a buffer up front, so that we never fail after having
+	 * invoked the callback.
+	 */
+	if (ctx->lookbehind == NULL && !_sbmh_lookbehind_reserve(slab)) {
+		return 0;
+	}
+
+	/* Run a regular StreamBMH context on the stack. Only the partial
+	 * match, if any, is copied in and out of it.
+	 */
+	struct StreamBMH *work = (struct StreamBMH *) alloca(SBMH_SIZE(needle_len));
+	sbmh_init(work, NULL, NULL, needle_len);
+	work->callback = callback;
+	work->user_data = user_data;
+	if (ctx->lookbehind_size > 0) {
+		memcpy(_SBMH_LOOKBEHIND(work), ctx->lookbehind, ctx->lookbehind_size);
+		work->lookbehind_size = ctx->lookbehind_size;
+	}
+
+	size_t analyzed = sbmh_feed(work, occtable, needle, needle_len, data, len);
+	SEARCH_STATS_ADD(search_stats(), work->stats);
+
+	ctx->found = work->found;
+	ctx->lookbehind_size = work->lookbehind_size;
+	if (work->lookbehind_size > 0) {
+		if (ctx->lookbehind == NULL) {
+			ctx->lookbehind = _sbmh_lookbehind_take(slab);
+		}
+		memcpy(ctx->lookbehind, _SBMH_LOOKBEHIND(work), work->lookbehind_size);
+	} else if (ctx->lookbehind != NULL) {
+		_sbmh_lookbehind_give_back(slab, ctx->lookbehind);
+		ctx->lookbehind = NULL;
+	}
+	return analyzed;
+}
+
+#endif /* _STREAM_BMH_LAZY_ */
@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2010 Phusion v.o.f.
+ * https://github.com/FooBarWidget/boyer-moore-horspool
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _STREAM_BMH_POOL_
+#define _STREAM_BMH_POOL_
+
+// Expecting StreamBoyerMooreHorspool.h to be included before this file.
+
+/*
+ * A pool allocator for StreamBMH structures, for servers that allocate a
+ * context per connection and have very many short-lived connections:
+ *
+ *   struct StreamBMH *ctx = sbmh_pool_alloc(needle_len);
+ *   if (ctx == NULL) {
+ *      // error...
+ *   }
+ *   ... sbmh_feed(ctx, &occ, needle, needle_len, data, len) ...
+ *   sbmh_pool_free(ctx);
+ *
+ * sbmh_pool_alloc() returns a context of at least SBMH_SIZE(needle_len) bytes
+ * that has been initialized as by sbmh_init(ctx, NULL, ...): it is reset, and
+ * its callback and user data are NULL. Contexts are aligned to a cache line,
+ * so that two contexts never share one.
+ *
+ * == How it works
+ *
+ * Contexts are grouped in size classes of powers of two from 64 bytes to
+ * 128 KB, so all needle lengths that have the same class share free slots.
+ * Slots are carved out of 256 KB slabs that are aligned to their size, so
+ * the slab header of a context is found by masking its address.
+ *
+ * Each thread has its own heap of slabs with a free list per size class, so
+ * sbmh_pool_alloc() and sbmh_pool_free() in the same thread take no locks and
+ * use no atomic operations. A context may be freed by a thread other than the
+ * one that allocated it: it is then pushed onto a lock-free "remote free"
+ * stack of the owning heap. The owner takes over the whole stack with a
+ * single atomic exchange once its local free list of that class runs empty.
+ *
+ * When a thread exits, its heap is kept for the next new thread, together
+ * with the contexts that are still in use. Slabs are never returned to the
+ * operating system.
+ */
+
+#include <cstddef>
+#include <cstdlib>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+
+#define SBMH_POOL_CACHE_LINE 64
+#define SBMH_POOL_SLAB_SIZE (256 * 1024)
+/* Size class c holds slots of 2^(c + SBMH_POOL_MIN_SHIFT) bytes. */
+#define SBMH_POOL_MIN_SHIFT 6
+#define SBMH_POOL_CLASSES 12
+
+struct _SbmhPoolHeap;
+
+struct _SbmhPoolFreeSlot {
+	struct _SbmhPoolFreeSlot *next;
+};
+
+/* Stored at the start of every slab, padded to a cache line. */
+struct _SbmhPoolSlab {
+	struct _SbmhPoolHeap *owner;
+	unsigned int size_class;
+};
+
+struct _SbmhPoolHeap {
+	/***** Only accessed by the thread that owns the heap *****/
+	struct _SbmhPoolFreeSlot *free_list[SBMH_POOL_CLASSES];
+	/* Not yet used part of the newest slab of each class. */
+	char *bump[SBMH_POOL_CLASSES];
+	char *bump_end[SBMH_POOL_CLASSES];
+
+	/***** Protected by the registry lock *****/
+	struct _SbmhPoolHeap *next;
+	bool abandoned;
+
+	/***** Pushed onto by other threads *****/
+	alignas(SBMH_POOL_CACHE_LINE) std::atomic<struct _SbmhPoolFreeSlot *> remote_free[SBMH_POOL_CLASSES];
+};
+
+struct _SbmhPoolRegistry {
+	std::mutex lock;
+	struct _SbmhPoolHeap *heaps;
+};
+
+inline struct _SbmhPoolRegistry &
+_sbmh_pool_registry() {
+	static _SbmhPoolRegistry registry;
+	return registry;
+}
+
+/* Hands the heap of an exiting thread over to the next new thread. */
+struct _SbmhPoolThreadHeap {
+	struct _SbmhPoolHeap *heap;
+
+	~_SbmhPoolThreadHeap() {
+		if (heap != NULL) {
+			std::lock_guard<std::mutex> guard(_sbmh_pool_registry().lock);
+			heap->abandoned = true;
+		}
+	}
+};
+
+inline struct _SbmhPoolHeap *&
+_sbmh_pool_current_heap() {
+	static thread_local _SbmhPoolThreadHeap thread_heap = { NULL };
+	return thread_heap.heap;
+}
+
+inline struct _SbmhPoolHeap *
+_sbmh_pool_adopt_heap() {
+	_SbmhPoolRegistry &registry = _sbmh_pool_registry();
+	std::lock_guard<std::mutex> guard(registry.lock);
+	for (_SbmhPoolHeap *heap = registry.heaps; heap != NULL; heap = heap->next) {
+		if (heap->abandoned) {
+			heap->abandoned = false;
+			return heap;
+		}
+	}
+
+	_SbmhPoolHeap *heap = new _SbmhPoolHeap();
+	for (unsigned int i = 0; i < SBMH_POOL_CLASSES; i++) {
+		heap->free_list[i] = NULL;
+		heap->bump[i] = NULL;
+		heap->bump_end[i] = NULL;
+		heap->remote_free[i].store(NULL, std::memory_order_relaxed);
+	}
+	heap->abandoned = false;
+	heap->next = registry.heaps;
+	registry.heaps = heap;
+	return heap;
+}
+
+/* Returns the size class for the given size, or SBMH_POOL_CLASSES if it's too big. */
+inline unsigned int
+_sbmh_pool_size_class(size_t size) {
+	unsigned int size_class = 0;
+	while (size_class < SBMH_POOL_CLASSES
+	    && (size_t(1) << (size_class + SBMH_POOL_MIN_SHIFT)) < size) {
+		size_class++;
+	}
+	return size_class;
+}
+
+/* Takes a never used slot from the newest slab, or from a new slab. */
+inline struct _SbmhPoolFreeSlot *
+_sbmh_pool_carve(struct _SbmhPoolHeap *heap, unsigned int size_class) {
+	const size_t slot_size = size_t(1) << (size_class + SBMH_POOL_MIN_SHIFT);
+	if (heap->bump[size_class] == heap->bump_end[size_class]) {
+		char *slab = (char *) aligned_alloc(SBMH_POOL_SLAB_SIZE, SBMH_POOL_SLAB_SIZE);
+		if (slab == NULL) {
+			return NULL;
+		}
+		_SbmhPoolSlab *header = (_SbmhPoolSlab *) slab;
+		header->owner = heap;
+		header->size_class = size_class;
+		const size_t slots = (SBMH_POOL_SLAB_SIZE - SBMH_POOL_CACHE_LINE) / slot_size;
+		heap->bump[size_class] = slab + SBMH_POOL_CACHE_LINE;
+		heap->bump_end[size_class] = heap->bump[size_class] + slots * slot_size;
+	}
+	_SbmhPoolFreeSlot *slot = (_SbmhPoolFreeSlot *) heap->bump[size_class];
+	heap->bump[size_class] += slot_size;
+	slot->next = NULL;
+	return slot;
+}
+
+inline struct StreamBMH *
+sbmh_pool_alloc(sbmh_size_t needle_len) {
+	const unsigned int size_class = _sbmh_pool_size_class(SBMH_SIZE(needle_len));
+	if (size_class >= SBMH_POOL_CLASSES) {
+		return NULL;
+	}
+	_SbmhPoolHeap *&heap = _sbmh_pool_current_heap();
+	if (unlikely(heap == NULL)) {
+		heap = _sbmh_pool_adopt_heap();
+	}
+
+	_SbmhPoolFreeSlot *slot = heap->free_list[size_class];
+	if (unlikely(slot == NULL)) {
+		slot = heap->remote_free[size_class].exchange(NULL, std::memory_order_acquire);
+		if (slot == NULL) {
+			slot = _sbmh_pool_carve(heap, size_class);
+			if (slot == NULL) {
+				return NULL;
+			}
+		}
+	}
+	heap->free_list[size_class] = slot->next;
+
+	struct StreamBMH *ctx = (struct StreamBMH *) slot;
+	sbmh_init(ctx, NULL, NULL, needle_len);
+	return ctx;
+}
+
+inline void
+sbmh_pool_free(struct StreamBMH *ctx) {
+	if (ctx == NULL) {
+		return;
+	}
+	_SbmhPoolSlab *slab = (_SbmhPoolSlab *)
+		((uintptr_t) ctx & ~(uintptr_t) (SBMH_POOL_SLAB_SIZE - 1));
+	_SbmhPoolFreeSlot *slot = (_SbmhPoolFreeSlot *) ctx;
+	const unsigned int size_class = slab->size_class;
+
+	if (likely(slab->owner == _sbmh_pool_current_heap())) {
+		slot->next = slab->owner->free_list[size_class];
+		slab->owner->free_list[size_class] = slot;
+	} else {
+		std::atomic<_SbmhPoolFreeSlot *> &head = slab->owner->remote_free[size_class];
+		slot->next = head.load(std::memory_order_relaxed);
+		while (!head.compare_exchange_weak(slot->next, slot,
+			std::memory_order_release, std::memory_order_relaxed))
+		{
+			/* slot->next has been updated to the current head; try again. */
+		}
+	}
+}
+
+#endif /* _STREAM_BMH_POOL_ */
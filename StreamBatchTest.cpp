@@ -0,0 +1,177 @@
+#include <string>
+#include <vector>
+
+#include "tut.h"
+#include "StreamBoyerMooreHorspool.h"
+#include "StreamBMHBatch.h"
+
+using namespace std;
+
+namespace tut {
+	struct StreamBatchTest {
+		StreamBMHBatch batch;
+		vector<string> unmatched_data;
+
+		StreamBatchTest() {
+			sbmh_batch_init(&batch, 64, 100);
+			batch.user_data = this;
+			unmatched_data.resize(64);
+		}
+
+		~StreamBatchTest() {
+			sbmh_batch_destroy(&batch);
+		}
+
+		static void append_unmatched_data(const struct StreamBMHBatch *batch, size_t context,
+			const unsigned char *data, size_t len)
+		{
+			StreamBatchTest *self = (StreamBatchTest *) batch->user_data;
+			self->unmatched_data[context].append((const char *) data, len);
+		}
+
+		static void append_reference_data(const struct StreamBMH *ctx,
+			const unsigned char *data, size_t len)
+		{
+			((string *) ctx->user_data)->append((const char *) data, len);
+		}
+
+		StreamBMHBatchFeed makeFeed(size_t context, const StreamBMH_Occ *occ,
+			const string &needle, const string &data)
+		{
+			StreamBMHBatchFeed feed;
+			feed.context = context;
+			feed.occ = occ;
+			feed.needle = (const unsigned char *) needle.data();
+			feed.needle_len = needle.size();
+			feed.data = (const unsigned char *) data.data();
+			feed.len = data.size();
+			feed.analyzed = 12345;
+			return feed;
+		}
+	};
+
+	DEFINE_TEST_GROUP(StreamBatchTest);
+
+	TEST_METHOD(1) {
+		set_test_name("A batch finds the needles in different contexts");
+		string needle = "I have control\n";
+		StreamBMH_Occ occ;
+		sbmh_init(NULL, &occ, (const unsigned char *) needle.data(), needle.size());
+		string chunks[3] = { "hello I have control\n world", "no match here", "I have control\n" };
+		StreamBMHBatchFeed feeds[3];
+		for (int i = 0; i < 3; i++) {
+			feeds[i] = makeFeed(10 + i, &occ, needle, chunks[i]);
+		}
+		sbmh_batch_feed(&batch, feeds, 3);
+		ensure_equals(feeds[0].analyzed, 21u);
+		ensure_equals(feeds[1].analyzed, 13u);
+		ensure_equals(feeds[2].analyzed, 15u);
+		ensure("found 0", batch.found[10]);
+		ensure("not found 1", !batch.found[11]);
+		ensure("found 2", batch.found[12]);
+		ensure("other contexts untouched", !batch.found[13]);
+
+		sbmh_batch_feed(&batch, feeds, 3);
+		ensure_equals("a context that found its needle analyzes nothing", feeds[0].analyzed, 0u);
+		ensure_equals(feeds[1].analyzed, 13u);
+	}
+
+	TEST_METHOD(2) {
+		set_test_name("A partial match is continued in the next batch");
+		string needle = "boundary";
+		StreamBMH_Occ occ;
+		sbmh_init(NULL, &occ, (const unsigned char *) needle.data(), needle.size());
+		batch.callback = append_unmatched_data;
+
+		string first = "xx bound", second = "ary yy";
+		StreamBMHBatchFeed feed = makeFeed(0, &occ, needle, first);
+		sbmh_batch_feed(&batch, &feed, 1);
+		ensure_equals(feed.analyzed, first.size());
+		ensure("not found yet", !batch.found[0]);
+		ensure_equals(unmatched_data[0], "xx ");
+
+		feed = makeFeed(0, &occ, needle, second);
+		sbmh_batch_feed(&batch, &feed, 1);
+		ensure_equals(feed.analyzed, 3u);
+		ensure("found", batch.found[0]);
+		ensure_equals(unmatched_data[0], "xx ");
+
+		sbmh_batch_reset(&batch, 0);
+		ensure("reset", !batch.found[0]);
+		feed = makeFeed(0, &occ, needle, second);
+		sbmh_batch_feed(&batch, &feed, 1);
+		ensure("not found after reset", !batch.found[0]);
+		ensure_equals(unmatched_data[0], "xx ary yy");
+	}
+
+	TEST_METHOD(3) {
+		set_test_name("It finds the same matches and unmatched data as StreamBMH");
+		const string needles[] = { "ab", "abcab", "I have control\n", string(40, 'a') + "b" };
+		StreamBMH_Occ occs[4];
+		for (int n = 0; n < 4; n++) {
+			sbmh_init(NULL, &occs[n], (const unsigned char *) needles[n].data(), needles[n].size());
+		}
+		batch.callback = append_unmatched_data;
+
+		for (unsigned int round = 0; round < 20; round++) {
+			/* Every context searches for one of the needles in a haystack
+			 * of needle fragments, which it's fed in chunks of its own size.
+			 */
+			unsigned int seed = round + 1;
+			const size_t contexts = 64;
+			vector<string> haystacks(contexts);
+			vector<size_t> needle_of(contexts), chunk_size(contexts), fed(contexts, 0);
+			vector<string> reference_data(contexts);
+			vector<vector<char> > reference_memory(contexts);
+			for (size_t c = 0; c < contexts; c++) {
+				seed = seed * 1103515245 + 12345;
+				needle_of[c] = (seed >> 8) % 4;
+				chunk_size[c] = 1 + (seed >> 16) % 50;
+				const string &needle = needles[needle_of[c]];
+				while (haystacks[c].size() < 300) {
+					seed = seed * 1103515245 + 12345;
+					size_t len = 1 + (seed >> 8) % needle.size();
+					haystacks[c] += needle.substr((seed >> 16) % (needle.size() - len + 1), len);
+					if ((seed >> 24) % 50 == 0) {
+						haystacks[c] += needle;
+					}
+				}
+				sbmh_batch_reset(&batch, c);
+				unmatched_data[c].clear();
+				reference_memory[c].resize(SBMH_SIZE(needle.size()));
+				StreamBMH *ref = (StreamBMH *) &reference_memory[c][0];
+				sbmh_init(ref, NULL, NULL, needle.size());
+				ref->callback = append_reference_data;
+				ref->user_data = &reference_data[c];
+			}
+
+			bool remaining = true;
+			while (remaining) {
+				vector<StreamBMHBatchFeed> feeds;
+				vector<string> chunks(contexts);
+				for (size_t c = 0; c < contexts; c++) {
+					if (fed[c] < haystacks[c].size()) {
+						chunks[c] = haystacks[c].substr(fed[c], chunk_size[c]);
+						feeds.push_back(makeFeed(c, &occs[needle_of[c]], needles[needle_of[c]], chunks[c]));
+					}
+				}
+				sbmh_batch_feed(&batch, &feeds[0], feeds.size());
+
+				remaining = false;
+				for (size_t i = 0; i < feeds.size(); i++) {
+					const size_t c = feeds[i].context;
+					const string &needle = needles[needle_of[c]];
+					StreamBMH *ref = (StreamBMH *) &reference_memory[c][0];
+					size_t expected = sbmh_feed(ref, &occs[needle_of[c]],
+						(const unsigned char *) needle.data(), needle.size(),
+						(const unsigned char *) chunks[c].data(), chunks[c].size());
+					ensure_equals("analyzed", feeds[i].analyzed, expected);
+					ensure_equals("found", batch.found[c], ref->found);
+					ensure_equals("unmatched data", unmatched_data[c], reference_data[c]);
+					fed[c] += chunks[c].size();
+					remaining = remaining || fed[c] < haystacks[c].size();
+				}
+			}
+		}
+	}
+}
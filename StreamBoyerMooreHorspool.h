@@ -159,6 +159,18 @@
  * is the case, then consider the data only valid within the callback: once the
  * callback has finished, this code can do arbitrary things to the lookbehind buffer,
  * so to preserve that data you must make your own copy.
+ *
+ *
+ * == Statistics
+ *
+ * When compiled with SEARCH_STATS defined, StreamBMH has a 'stats' field that
+ * counts windows, comparisons, shifts, verifications, lookbehind copies and
+ * callback invocations. See SearchStats.h. Without SEARCH_STATS, there is no such field
+ * and no overhead.
+ *
+ * When compiled with SEARCH_PROBES defined, sbmh_feed() has USDT trace points
+ * at its entry and exit, for measuring the latency of individual calls with
+ * bpftrace or perf. See SearchProbes.h.
  */
 
 /* This implementation is based on sample code originally written by Joel
@@ -195,6 +207,9 @@
 #include <cassert>
 #include <algorithm>
 
+#include "SearchStats.h"
+#include "SearchProbes.h"
+
 
 // namespace Passenger {
 
@@ -224,6 +239,10 @@ struct StreamBMH_Occ {
 struct StreamBMH {
 	/***** Public but read-only fields *****/
 	bool          found;
+	#ifdef SEARCH_STATS
+		/* Hot-path counters; see SearchStats.h. */
+		SearchStats   stats;
+	#endif
 	
 	/***** Public fields; feel free to populate *****/
 	sbmh_data_cb  callback;
@@ -279,6 +298,7 @@ sbmh_init(struct StreamBMH *restrict ctx, struct StreamBMH_Occ *restrict occ,
 		sbmh_reset(ctx);
 		ctx->callback = NULL;
 		ctx->user_data = NULL;
+		SEARCH_STATS_RESET(ctx->stats);
 	}
 	
 	if (occ != NULL) {
@@ -326,14 +346,40 @@ sbmh_memcmp(const struct StreamBMH *restrict ctx,
 		if (data_ch == needle_ch) {
 			i++;
 		} else {
+			SEARCH_STATS_COMPARISONS(((struct StreamBMH *) ctx)->stats, i + 1);
 			return false;
 		}
 	}
+	SEARCH_STATS_COMPARISONS(((struct StreamBMH *) ctx)->stats, len);
 	return true;
 }
 
+/* The guards of a window are the two needle positions whose bytes are
+ * compared before the rest of the window. By default these are the last
+ * byte, which also determines the shift, and the first byte. Other kinds of
+ * guards overload _sbmh_guard1() and _sbmh_guard2(), like RareBytePlan in
+ * RareByte.cpp.
+ */
+struct StreamBMH_DefaultGuards { };
+
 inline size_t
-sbmh_feed(struct StreamBMH *restrict ctx, const struct StreamBMH_Occ *restrict occtable,
+_sbmh_guard1(const StreamBMH_DefaultGuards &, sbmh_size_t needle_len) {
+	return needle_len - 1;
+}
+
+inline size_t
+_sbmh_guard2(const StreamBMH_DefaultGuards &, sbmh_size_t) {
+	return 0;
+}
+
+/* 'occ' is any occ table that can be indexed with a byte: the array in a
+ * StreamBMH_Occ, or a compact table such as a CompactOccTable. 'guards'
+ * is a StreamBMH_DefaultGuards or any other type with _sbmh_guard1() and
+ * _sbmh_guard2() overloads.
+ */
+template<typename OccTable, typename Guards>
+inline size_t
+_sbmh_feed(struct StreamBMH *restrict ctx, const OccTable &occ, const Guards &guards,
 	const unsigned char *restrict needle, sbmh_size_t needle_len,
 	const unsigned char *restrict data, size_t len)
 {
@@ -349,8 +395,12 @@ sbmh_feed(struct StreamBMH *restrict ctx, const struct StreamBMH_Occ *restrict o
 	 *           pos == -2 points to lookbehind[lookbehind_size - 2]
 	 */
 	ssize_t pos = -ctx->lookbehind_size;
-	unsigned char last_needle_char = needle[needle_len - 1];
-	const sbmh_size_t *occ = occtable->occ;
+	const size_t guard1 = _sbmh_guard1(guards, needle_len);
+	const size_t guard2 = _sbmh_guard2(guards, needle_len);
+	const unsigned char guard1_char = needle[guard1];
+	const unsigned char guard2_char = needle[guard2];
+	/* The last byte needs no comparison if it is the first guard. */
+	const sbmh_size_t verify_len = needle_len - (guard1 == size_t(needle_len - 1));
 	unsigned char *lookbehind = _SBMH_LOOKBEHIND(ctx);
 	
 	if (pos < 0) {
@@ -374,19 +424,25 @@ sbmh_feed(struct StreamBMH *restrict ctx, const struct StreamBMH_Occ *restrict o
 		while (pos < 0 && pos <= ssize_t(len) - ssize_t(needle_len)) {
 			 unsigned char ch = sbmh_lookup_char(ctx, data,
 				pos + needle_len - 1);
+			SEARCH_STATS_WINDOW(ctx->stats);
 			
-			if (ch == last_needle_char
-			 && sbmh_memcmp(ctx, needle, data, pos, needle_len - 1)) {
+			if (SEARCH_STATS_HIT(ctx->stats,
+			        (unsigned char) sbmh_lookup_char(ctx, data, pos + guard1) == guard1_char)
+			 && SEARCH_STATS_VERIFY(ctx->stats,
+			        sbmh_memcmp(ctx, needle, data, pos, verify_len))) {
+				sbmh_size_t lookbehind_size = ctx->lookbehind_size;
 				ctx->found = true;
 				ctx->lookbehind_size = 0;
-				if (pos > -ctx->lookbehind_size && ctx->callback != NULL) {
+				if (pos > -ssize_t(lookbehind_size) && ctx->callback != NULL) {
+					SEARCH_STATS_CALLBACK(ctx->stats, lookbehind_size + pos);
 					ctx->callback(ctx, lookbehind,
-						ctx->lookbehind_size + pos);
+						lookbehind_size + pos);
 				}
 				SBMH_DEBUG1("[sbmh] found using lookbehind; end = %d\n",
 					int(pos + needle_len));
 				return pos + needle_len;
 			} else {
+				SEARCH_STATS_SHIFT(ctx->stats, occ[ch]);
 				pos += occ[ch];
 			}
 		}
@@ -414,6 +470,7 @@ sbmh_feed(struct StreamBMH *restrict ctx, const struct StreamBMH_Occ *restrict o
 			/* Discard lookbehind buffer. */
 			SBMH_DEBUG("[sbmh] no match; discarding lookbehind\n");
 			if (ctx->callback != NULL) {
+				SEARCH_STATS_CALLBACK(ctx->stats, ctx->lookbehind_size);
 				ctx->callback(ctx, lookbehind, ctx->lookbehind_size);
 			}
 			ctx->lookbehind_size = 0;
@@ -426,6 +483,7 @@ sbmh_feed(struct StreamBMH *restrict ctx, const struct StreamBMH_Occ *restrict o
 			
 			if (bytesToCutOff > 0 && ctx->callback != NULL) {
 				// The cut off data is guaranteed not to contain the needle.
+				SEARCH_STATS_CALLBACK(ctx->stats, bytesToCutOff);
 				ctx->callback(ctx, lookbehind, bytesToCutOff);
 			}
 			
@@ -435,6 +493,7 @@ sbmh_feed(struct StreamBMH *restrict ctx, const struct StreamBMH_Occ *restrict o
 			ctx->lookbehind_size -= bytesToCutOff;
 			
 			assert(ssize_t(ctx->lookbehind_size + len) < ssize_t(needle_len));
+			SEARCH_STATS_LOOKBEHIND_COPY(ctx->stats, len);
 			memcpy(lookbehind + ctx->lookbehind_size,
 				data, len);
 			ctx->lookbehind_size += len;
@@ -456,19 +515,23 @@ sbmh_feed(struct StreamBMH *restrict ctx, const struct StreamBMH_Occ *restrict o
 	 */
 	while (likely( pos <= ssize_t(len) - ssize_t(needle_len) )) {
 		unsigned char ch = data[pos + needle_len - 1];
+		SEARCH_STATS_WINDOW(ctx->stats);
 		
 		if (unlikely(
-		        unlikely( ch == last_needle_char )
-		     && unlikely( *(data + pos) == needle[0] )
-		     && unlikely( memcmp(needle, data + pos, needle_len - 1) == 0 )
+		        unlikely( SEARCH_STATS_HIT(ctx->stats, data[pos + guard1] == guard1_char) )
+		     && SEARCH_STATS_VERIFY(ctx->stats,
+		           unlikely( SEARCH_STATS_COMPARE(ctx->stats, data[pos + guard2] == guard2_char) )
+		        && unlikely( SEARCH_STATS_MEMCMP(ctx->stats, needle, data + pos, verify_len) == 0 ))
 		)) {
 			SBMH_DEBUG1("[sbmh] found at position %d\n", (int) pos);
 			ctx->found = true;
 			if (pos > 0 && ctx->callback != NULL) {
+				SEARCH_STATS_CALLBACK(ctx->stats, pos);
 				ctx->callback(ctx, data, pos);
 			}
 			return pos + needle_len;
 		} else {
+			SEARCH_STATS_SHIFT(ctx->stats, occ[ch]);
 			pos += occ[ch];
 		}
 	}
@@ -484,12 +547,13 @@ sbmh_feed(struct StreamBMH *restrict ctx, const struct StreamBMH_Occ *restrict o
 	if (size_t(pos) < len) {
 		while (size_t(pos) < len
 		    && (
-		          data[pos] != needle[0]
-		       || memcmp(data + pos, needle, len - pos) != 0
+		          SEARCH_STATS_COMPARE(ctx->stats, data[pos] != needle[0])
+		       || SEARCH_STATS_MEMCMP(ctx->stats, data + pos, needle, len - pos) != 0
 		)) {
 			pos++;
 		}
 		if (size_t(pos) < len) {
+			SEARCH_STATS_LOOKBEHIND_COPY(ctx->stats, len - pos);
 			memcpy(lookbehind, data + pos, len - pos);
 			ctx->lookbehind_size = len - pos;
 			SBMH_DEBUG2("[sbmh] adding %d trailing bytes to lookbehind -> (%s)\n",
@@ -501,12 +565,25 @@ sbmh_feed(struct StreamBMH *restrict ctx, const struct StreamBMH_Occ *restrict o
 	
 	/* Everything until pos is guaranteed not to contain needle data. */
 	if (pos > 0 && ctx->callback != NULL) {
+		SEARCH_STATS_CALLBACK(ctx->stats, std::min(size_t(pos), len));
 		ctx->callback(ctx, data, std::min(size_t(pos), len));
 	}
 	
 	return len;
 }
 
+inline size_t
+sbmh_feed(struct StreamBMH *restrict ctx, const struct StreamBMH_Occ *restrict occtable,
+	const unsigned char *restrict needle, sbmh_size_t needle_len,
+	const unsigned char *restrict data, size_t len)
+{
+	SEARCH_PROBE3(feed_entry, ctx, len, ctx->lookbehind_size);
+	size_t analyzed = _sbmh_feed(ctx, occtable->occ, StreamBMH_DefaultGuards(),
+		needle, needle_len, data, len);
+	SEARCH_PROBE4(feed_return, ctx, analyzed, ctx->found, ctx->lookbehind_size);
+	return analyzed;
+}
+
 // } // namespace Passenger
 
 #endif /* _STREAM_BOYER_MOORE_HORSPOOL_ */
@@ -0,0 +1,137 @@
+#include <string>
+#include <vector>
+#include <alloca.h>
+
+#include "tut.h"
+#include "StreamBoyerMooreHorspool.h"
+#include "StreamBMHLazy.h"
+
+using namespace std;
+
+namespace tut {
+	struct StreamLazyTest {
+		StreamBMH_LookbehindSlab slab;
+		string unmatched_data;
+
+		StreamLazyTest() {
+			sbmh_lookbehind_slab_init(&slab, 100);
+		}
+
+		~StreamLazyTest() {
+			sbmh_lookbehind_slab_destroy(&slab);
+		}
+
+		static void append_unmatched_data(const struct StreamBMH *ctx,
+			const unsigned char *data, size_t len)
+		{
+			StreamLazyTest *self = (StreamLazyTest *) ctx->user_data;
+			self->unmatched_data.append((const char *) data, len);
+		}
+
+		/* Feeds the haystack in chunks of the given size. Returns the position
+		 * of the needle in the haystack, or -1 if not found.
+		 */
+		int find(StreamBMHLazy *ctx, const string &needle, const string &haystack, size_t chunk_size) {
+			StreamBMH_Occ occ;
+			sbmh_init(NULL, &occ, (const unsigned char *) needle.c_str(), needle.size());
+			size_t pos = 0;
+			while (pos < haystack.size() && !ctx->found) {
+				size_t len = min(chunk_size, haystack.size() - pos);
+				size_t analyzed = sbmh_lazy_feed(ctx, &slab, &occ,
+					(const unsigned char *) needle.c_str(), needle.size(),
+					(const unsigned char *) haystack.c_str() + pos, len,
+					append_unmatched_data, this);
+				pos += analyzed;
+			}
+			if (ctx->found) {
+				return pos - needle.size();
+			} else {
+				return -1;
+			}
+		}
+	};
+
+	DEFINE_TEST_GROUP(StreamLazyTest);
+
+	TEST_METHOD(1) {
+		set_test_name("An idle context is as small as its fields");
+		if (sizeof(void *) == 8) {
+			ensure_equals(sizeof(StreamBMHLazy), 16u);
+		}
+	}
+
+	TEST_METHOD(2) {
+		set_test_name("A partial match borrows a buffer until it's resolved");
+		StreamBMHLazy ctx;
+		sbmh_lazy_init(&ctx);
+		StreamBMH_Occ occ;
+		const unsigned char *needle = (const unsigned char *) "I have control\n";
+		sbmh_init(NULL, &occ, needle, 15);
+
+		ensure_equals(sbmh_lazy_feed(&ctx, &slab, &occ, needle, 15,
+			(const unsigned char *) "hello world", 11), 11u);
+		ensure("no buffer while idle", ctx.lookbehind == NULL);
+		ensure_equals(slab.buffers_in_use, 0u);
+
+		ensure_equals(sbmh_lazy_feed(&ctx, &slab, &occ, needle, 15,
+			(const unsigned char *) "xxI have", 8), 8u);
+		ensure("buffer borrowed", ctx.lookbehind != NULL);
+		ensure_equals(ctx.lookbehind_size, 6u);
+		ensure_equals(slab.buffers_in_use, 1u);
+
+		ensure_equals(sbmh_lazy_feed(&ctx, &slab, &occ, needle, 15,
+			(const unsigned char *) " cont", 5), 5u);
+		ensure_equals(slab.buffers_in_use, 1u);
+
+		ensure_equals(sbmh_lazy_feed(&ctx, &slab, &occ, needle, 15,
+			(const unsigned char *) "inent", 5), 5u);
+		ensure("not found", !ctx.found);
+		ensure("buffer returned", ctx.lookbehind == NULL);
+		ensure_equals(slab.buffers_in_use, 0u);
+	}
+
+	TEST_METHOD(3) {
+		set_test_name("It finds the same matches and unmatched data as StreamBMH");
+		string needle = "I have control\n";
+		string haystack = "I have cont I have controlI have control I have control\n tail";
+		for (size_t chunk_size = 1; chunk_size <= haystack.size(); chunk_size++) {
+			StreamBMHLazy ctx;
+			sbmh_lazy_init(&ctx);
+			unmatched_data.clear();
+			ensure_equals(("chunk size " + to_string(chunk_size)).c_str(),
+				find(&ctx, needle, haystack, chunk_size), 41);
+			ensure_equals(unmatched_data, haystack.substr(0, 41));
+			ensure("buffer returned", ctx.lookbehind == NULL);
+		}
+		ensure_equals(slab.buffers_in_use, 0u);
+	}
+
+	TEST_METHOD(4) {
+		set_test_name("Resetting a context returns its buffer");
+		StreamBMHLazy ctx;
+		sbmh_lazy_init(&ctx);
+		ensure_equals(find(&ctx, "boundary", "xxxxbound", 3), -1);
+		ensure_equals(slab.buffers_in_use, 1u);
+		sbmh_lazy_reset(&ctx, &slab);
+		ensure_equals(slab.buffers_in_use, 0u);
+		ensure_equals(ctx.lookbehind_size, 0u);
+		ensure_equals(find(&ctx, "boundary", "ary boundary", 3), 4);
+	}
+
+	TEST_METHOD(5) {
+		set_test_name("Many contexts with partial matches have separate buffers");
+		vector<StreamBMHLazy> contexts(3000);
+		for (size_t i = 0; i < contexts.size(); i++) {
+			sbmh_lazy_init(&contexts[i]);
+			string partial = string("boundary").substr(0, 1 + i % 7);
+			ensure_equals(find(&contexts[i], "boundary", "x" + partial, 100), -1);
+		}
+		ensure_equals(slab.buffers_in_use, contexts.size());
+		for (size_t i = 0; i < contexts.size(); i++) {
+			string rest = string("boundary").substr(1 + i % 7);
+			ensure_equals(find(&contexts[i], "boundary", rest, 100), -1 - int(i % 7));
+			ensure("found", contexts[i].found);
+		}
+		ensure_equals(slab.buffers_in_use, 0u);
+	}
+}
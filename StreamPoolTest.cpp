@@ -0,0 +1,122 @@
+#include <string>
+#include <vector>
+#include <set>
+#include <thread>
+#include <stdint.h>
+
+#include "tut.h"
+#include "StreamBoyerMooreHorspool.h"
+#include "StreamBMHPool.h"
+
+using namespace std;
+
+namespace tut {
+	struct StreamPoolTest {
+		static int find(StreamBMH *ctx, const string &needle, const string &haystack) {
+			StreamBMH_Occ occ;
+			sbmh_init(NULL, &occ, (const unsigned char *) needle.c_str(), needle.size());
+			size_t analyzed = sbmh_feed(ctx, &occ,
+				(const unsigned char *) needle.c_str(), needle.size(),
+				(const unsigned char *) haystack.c_str(), haystack.size());
+			if (ctx->found) {
+				return analyzed - needle.size();
+			} else {
+				return -1;
+			}
+		}
+	};
+
+	DEFINE_TEST_GROUP(StreamPoolTest);
+
+	TEST_METHOD(1) {
+		set_test_name("It hands out cache-aligned, reset contexts");
+
+		const sbmh_size_t lengths[] = { 1, 15, 100, 1000, 60000 };
+		for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+			StreamBMH *ctx = sbmh_pool_alloc(lengths[i]);
+			ensure("allocated", ctx != NULL);
+			ensure_equals("aligned", (uintptr_t) ctx % SBMH_POOL_CACHE_LINE, 0u);
+			ensure("not found", !ctx->found);
+			ensure_equals(ctx->lookbehind_size, 0u);
+			ensure("no callback", ctx->callback == NULL);
+			ensure("no user data", ctx->user_data == NULL);
+			sbmh_pool_free(ctx);
+		}
+	}
+
+	TEST_METHOD(2) {
+		set_test_name("Freed contexts are reset when they are handed out again");
+
+		string needle = "I have control\n";
+		StreamBMH *ctx = sbmh_pool_alloc(needle.size());
+		ensure_equals(find(ctx, needle, "xxxI have con"), -1);
+		ensure("lookbehind used", ctx->lookbehind_size > 0);
+		ctx->user_data = ctx;
+		sbmh_pool_free(ctx);
+
+		StreamBMH *ctx2 = sbmh_pool_alloc(needle.size());
+		ensure("slot reused", ctx2 == ctx);
+		ensure_equals(ctx2->lookbehind_size, 0u);
+		ensure("no user data", ctx2->user_data == NULL);
+		ensure_equals(find(ctx2, needle, "trol\nxxI have control\n"), 7);
+		sbmh_pool_free(ctx2);
+	}
+
+	TEST_METHOD(3) {
+		set_test_name("Needle lengths in the same size class share slots");
+
+		StreamBMH *ctx = sbmh_pool_alloc(20);
+		sbmh_pool_free(ctx);
+		StreamBMH *ctx2 = sbmh_pool_alloc(21);
+		ensure("slot reused", ctx2 == ctx);
+		StreamBMH *ctx3 = sbmh_pool_alloc(2000);
+		ensure("different class", ctx3 != ctx);
+		sbmh_pool_free(ctx2);
+		sbmh_pool_free(ctx3);
+	}
+
+	TEST_METHOD(4) {
+		set_test_name("Contexts that are in use are never handed out twice");
+
+		vector<StreamBMH *> contexts;
+		set<StreamBMH *> unique;
+		for (int i = 0; i < 10000; i++) {
+			StreamBMH *ctx = sbmh_pool_alloc(30 + i % 200);
+			contexts.push_back(ctx);
+			unique.insert(ctx);
+		}
+		ensure_equals(unique.size(), contexts.size());
+		for (size_t i = 0; i < contexts.size(); i++) {
+			sbmh_pool_free(contexts[i]);
+		}
+	}
+
+	TEST_METHOD(5) {
+		set_test_name("Contexts freed by another thread are returned to their owner");
+
+		vector<StreamBMH *> contexts;
+		for (int i = 0; i < 100; i++) {
+			/* A size class that no other test uses, so that its local free list is empty. */
+			contexts.push_back(sbmh_pool_alloc(5000));
+		}
+		std::thread other([&contexts]() {
+			/* The other thread also allocates for itself. */
+			StreamBMH *own = sbmh_pool_alloc(5000);
+			for (size_t i = 0; i < contexts.size(); i++) {
+				sbmh_pool_free(contexts[i]);
+			}
+			sbmh_pool_free(own);
+		});
+		other.join();
+
+		set<StreamBMH *> freed(contexts.begin(), contexts.end());
+		for (size_t i = 0; i < contexts.size(); i++) {
+			StreamBMH *ctx = sbmh_pool_alloc(5000);
+			ensure("reused a remotely freed slot", freed.count(ctx) == 1);
+			contexts[i] = ctx;
+		}
+		for (size_t i = 0; i < contexts.size(); i++) {
+			sbmh_pool_free(contexts[i]);
+		}
+	}
+}
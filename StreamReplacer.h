@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2010 Phusion v.o.f.
+ * https://github.com/FooBarWidget/boyer-moore-horspool
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _STREAM_REPLACER_
+#define _STREAM_REPLACER_
+
+// Expecting StreamBoyerMooreHorspool.h to be included before this file.
+
+/*
+ * Replaces every occurrence of a needle in a stream with a replacement,
+ * without buffering the stream.
+ *
+ *   struct StreamReplacer *replacer = stream_replacer_new(
+ *      needle, needle_len, replacement, replacement_len);
+ *   if (replacer == NULL) {
+ *      // error...
+ *   }
+ *   replacer->output = write_spans;   // e.g. calls writev()
+ *   replacer->user_data = ...;
+ *   while (... read data ...) {
+ *      stream_replacer_feed(replacer, data, len);
+ *   }
+ *   stream_replacer_finish(replacer);
+ *   stream_replacer_free(replacer);
+ *
+ * The output callback is invoked with the transformed data as an array of
+ * spans, in order. Unmatched data is passed as spans of the fed data and
+ * each match as a span of the replacement, so nothing is copied, with one
+ * exception: up to needle_len - 1 bytes at the end of the fed data that
+ * could be the start of a match are held back in the lookbehind buffer of
+ * the StreamBMH context. If they turn out not to be a match, they're copied
+ * once more, into a buffer of the same size, so that they can be output
+ * together with the next fed data.
+ *
+ * All spans that stream_replacer_feed() produces are output before it
+ * returns, in one or more calls. The spans are only valid during the call.
+ * stream_replacer_finish() outputs the held back bytes at the end of the
+ * stream and prepares the replacer for a new stream.
+ *
+ * Matches don't overlap: after a match, searching continues after it.
+ */
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <sys/uio.h>
+
+/* Maximum number of spans that are passed to the output callback at once. */
+#define STREAM_REPLACER_MAX_SPANS 64
+
+struct StreamReplacer;
+
+typedef void (*stream_replacer_output_cb)(struct StreamReplacer *replacer,
+	const struct iovec *spans, int count);
+
+struct StreamReplacer {
+	/***** Public but read-only fields *****/
+	/* Number of matches that were replaced. */
+	size_t         replacements;
+
+	/***** Public fields; feel free to populate *****/
+	stream_replacer_output_cb output;
+	void          *user_data;
+
+	/***** Internal fields, do not access. *****/
+	const unsigned char *needle;
+	sbmh_size_t    needle_len;
+	const unsigned char *replacement;
+	size_t         replacement_len;
+	/* Held back bytes that turned out not to be a match, needle_len - 1 bytes. */
+	unsigned char *released;
+	size_t         released_size;
+	struct iovec   spans[STREAM_REPLACER_MAX_SPANS];
+	int            span_count;
+	struct StreamBMH_Occ occ;
+	/* Must be last: the lookbehind buffer of 'ctx', the released bytes,
+	 * the needle and the replacement follow it.
+	 */
+	struct StreamBMH ctx;
+};
+
+inline void
+_stream_replacer_flush(struct StreamReplacer *replacer) {
+	if (replacer->span_count > 0) {
+		if (replacer->output != NULL) {
+			replacer->output(replacer, replacer->spans, replacer->span_count);
+		}
+		replacer->span_count = 0;
+	}
+}
+
+inline void
+_stream_replacer_add_span(struct StreamReplacer *replacer, const void *data, size_t len) {
+	if (len == 0) {
+		return;
+	}
+	if (replacer->span_count > 0) {
+		struct iovec *last = &replacer->spans[replacer->span_count - 1];
+		if ((const char *) last->iov_base + last->iov_len == (const char *) data) {
+			last->iov_len += len;
+			return;
+		}
+	}
+	if (replacer->span_count == STREAM_REPLACER_MAX_SPANS) {
+		_stream_replacer_flush(replacer);
+	}
+	replacer->spans[replacer->span_count].iov_base = (void *) data;
+	replacer->spans[replacer->span_count].iov_len = len;
+	replacer->span_count++;
+}
+
+/* StreamBMH callback: outputs unmatched data. */
+inline void
+_stream_replacer_pass(const struct StreamBMH *ctx, const unsigned char *data, size_t len) {
+	struct StreamReplacer *replacer = (struct StreamReplacer *) ctx->user_data;
+	const unsigned char *lookbehind = _SBMH_LOOKBEHIND(ctx);
+	if (data >= lookbehind && data < lookbehind + replacer->needle_len - 1) {
+		/* StreamBMH may overwrite its lookbehind buffer before the spans
+		 * are output.
+		 */
+		unsigned char *released = replacer->released + replacer->released_size;
+		memcpy(released, data, len);
+		replacer->released_size += len;
+		data = released;
+	}
+	_stream_replacer_add_span(replacer, data, len);
+}
+
+/* Returns NULL if the memory could not be allocated. The needle and the
+ * replacement are copied.
+ */
+inline struct StreamReplacer *
+stream_replacer_new(const unsigned char *needle, sbmh_size_t needle_len,
+	const unsigned char *replacement, size_t replacement_len)
+{
+	assert(needle_len > 0);
+	struct StreamReplacer *replacer = (struct StreamReplacer *) malloc(
+		offsetof(struct StreamReplacer, ctx) + SBMH_SIZE(needle_len)
+		+ needle_len - 1 + needle_len + replacement_len);
+	if (replacer == NULL) {
+		return NULL;
+	}
+	unsigned char *released = _SBMH_LOOKBEHIND(&replacer->ctx) + needle_len - 1;
+	unsigned char *needle_copy = released + needle_len - 1;
+	unsigned char *replacement_copy = needle_copy + needle_len;
+	memcpy(needle_copy, needle, needle_len);
+	memcpy(replacement_copy, replacement, replacement_len);
+	replacer->replacements = 0;
+	replacer->output = NULL;
+	replacer->user_data = NULL;
+	replacer->needle = needle_copy;
+	replacer->needle_len = needle_len;
+	replacer->replacement = replacement_copy;
+	replacer->replacement_len = replacement_len;
+	replacer->released = released;
+	replacer->released_size = 0;
+	replacer->span_count = 0;
+	sbmh_init(&replacer->ctx, &replacer->occ, needle_copy, needle_len);
+	replacer->ctx.callback = _stream_replacer_pass;
+	replacer->ctx.user_data = replacer;
+	return replacer;
+}
+
+inline void
+stream_replacer_free(struct StreamReplacer *replacer) {
+	free(replacer);
+}
+
+inline void
+stream_replacer_feed(struct StreamReplacer *replacer, const unsigned char *data, size_t len) {
+	size_t pos = 0;
+	while (pos < len) {
+		pos += sbmh_feed(&replacer->ctx, &replacer->occ, replacer->needle, replacer->needle_len,
+			data + pos, len - pos);
+		if (replacer->ctx.found) {
+			_stream_replacer_add_span(replacer, replacer->replacement, replacer->replacement_len);
+			replacer->replacements++;
+			sbmh_reset(&replacer->ctx);
+		}
+	}
+	_stream_replacer_flush(replacer);
+	replacer->released_size = 0;
+}
+
+/* Outputs the bytes that were held back because they could have been the
+ * start of a match, and prepares the replacer for a new stream.
+ */
+inline void
+stream_replacer_finish(struct StreamReplacer *replacer) {
+	_stream_replacer_add_span(replacer, _SBMH_LOOKBEHIND(&replacer->ctx), replacer->ctx.lookbehind_size);
+	_stream_replacer_flush(replacer);
+	sbmh_reset(&replacer->ctx);
+}
+
+#endif /* _STREAM_REPLACER_ */
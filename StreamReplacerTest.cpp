@@ -0,0 +1,157 @@
+#include <string>
+#include <vector>
+
+#include "tut.h"
+#include "StreamBoyerMooreHorspool.h"
+#include "StreamReplacer.h"
+
+using namespace std;
+
+namespace tut {
+	struct StreamReplacerTest {
+		StreamReplacer *replacer;
+		string output;
+		/* Number of output bytes that were not in the fed data or the replacement. */
+		size_t copied;
+		int output_calls;
+		const unsigned char *fed_begin, *fed_end;
+
+		StreamReplacerTest() {
+			replacer = NULL;
+			fed_begin = fed_end = NULL;
+		}
+
+		~StreamReplacerTest() {
+			stream_replacer_free(replacer);
+		}
+
+		static void on_output(StreamReplacer *replacer, const struct iovec *spans, int count) {
+			StreamReplacerTest *self = (StreamReplacerTest *) replacer->user_data;
+			self->output_calls++;
+			for (int i = 0; i < count; i++) {
+				const unsigned char *data = (const unsigned char *) spans[i].iov_base;
+				self->output.append((const char *) data, spans[i].iov_len);
+				bool in_fed_data = data >= self->fed_begin && data + spans[i].iov_len <= self->fed_end;
+				bool in_replacement = data >= replacer->replacement
+					&& data + spans[i].iov_len <= replacer->replacement + replacer->replacement_len;
+				if (!in_fed_data && !in_replacement) {
+					self->copied += spans[i].iov_len;
+				}
+			}
+		}
+
+		void init(const string &needle, const string &replacement) {
+			stream_replacer_free(replacer);
+			replacer = stream_replacer_new((const unsigned char *) needle.data(), needle.size(),
+				(const unsigned char *) replacement.data(), replacement.size());
+			ensure(replacer != NULL);
+			replacer->output = on_output;
+			replacer->user_data = this;
+			output.clear();
+			copied = 0;
+			output_calls = 0;
+		}
+
+		void feed(const string &data) {
+			fed_begin = (const unsigned char *) data.data();
+			fed_end = fed_begin + data.size();
+			stream_replacer_feed(replacer, fed_begin, data.size());
+			fed_begin = fed_end = NULL;
+		}
+
+		string replace(const string &stream, size_t chunk_size) {
+			for (size_t pos = 0; pos < stream.size(); pos += chunk_size) {
+				feed(stream.substr(pos, chunk_size));
+			}
+			stream_replacer_finish(replacer);
+			return output;
+		}
+
+		static string reference(const string &stream, const string &needle, const string &replacement) {
+			string result;
+			size_t pos = 0, match;
+			while ((match = stream.find(needle, pos)) != string::npos) {
+				result.append(stream, pos, match - pos);
+				result += replacement;
+				pos = match + needle.size();
+			}
+			result.append(stream, pos, string::npos);
+			return result;
+		}
+	};
+
+	DEFINE_TEST_GROUP(StreamReplacerTest);
+
+	TEST_METHOD(1) {
+		set_test_name("It replaces matches without copying the fed data");
+		init("http://internal", "https://www");
+		feed("<a href=\"http://internal/a\">x</a> <a href=\"http://internal/b\">");
+		ensure_equals(output, "<a href=\"https://www/a\">x</a> <a href=\"https://www/b\">");
+		ensure_equals(replacer->replacements, 2u);
+		ensure_equals(copied, 0u);
+		ensure_equals(output_calls, 1);
+	}
+
+	TEST_METHOD(2) {
+		set_test_name("Only held back bytes that are no match are copied");
+		init("secret-token", "[REDACTED]");
+		feed("a secret");
+		ensure_equals("the possible match is held back", output, "a ");
+		feed("-toke");
+		ensure_equals(output, "a ");
+		feed("n! secret-tok");
+		ensure_equals(output, "a [REDACTED]! ");
+		ensure_equals(copied, 0u);
+		feed("en? secret-tok");
+		ensure_equals(output, "a [REDACTED]! [REDACTED]? ");
+		feed("x");
+		ensure_equals(output, "a [REDACTED]! [REDACTED]? secret-tokx");
+		ensure_equals(copied, 10u);
+
+		feed("secret-t");
+		stream_replacer_finish(replacer);
+		ensure_equals(output, "a [REDACTED]! [REDACTED]? secret-tokxsecret-t");
+		ensure_equals(replacer->replacements, 2u);
+	}
+
+	TEST_METHOD(3) {
+		set_test_name("It produces the same output when fed in chunks of any size");
+		const char *needles[] = { "ab", "aab", "abab", "I have control\n" };
+		const char *replacements[] = { "", "X", "a much longer replacement", "ab" };
+		for (int n = 0; n < 4; n++) {
+			const string needle = needles[n];
+			string stream;
+			unsigned int seed = n + 1;
+			while (stream.size() < 400) {
+				seed = seed * 1103515245 + 12345;
+				size_t len = 1 + (seed >> 8) % needle.size();
+				stream += needle.substr((seed >> 16) % (needle.size() - len + 1), len);
+				if ((seed >> 24) % 4 == 0) {
+					stream += 'z';
+				}
+			}
+			for (int r = 0; r < 4; r++) {
+				const string expected = reference(stream, needle, replacements[r]);
+				for (size_t chunk_size = 1; chunk_size <= stream.size(); chunk_size++) {
+					init(needle, replacements[r]);
+					ensure_equals(("needle " + to_string(n) + ", replacement " + to_string(r)
+						+ ", chunk size " + to_string(chunk_size)).c_str(),
+						replace(stream, chunk_size), expected);
+				}
+			}
+		}
+	}
+
+	TEST_METHOD(4) {
+		set_test_name("Many spans are output in several calls");
+		init("x", "yy");
+		string stream;
+		for (int i = 0; i < 1000; i++) {
+			stream += "ab x";
+		}
+		ensure_equals(replace(stream, stream.size()), reference(stream, "x", "yy"));
+		ensure(output_calls > 1);
+		ensure_equals(replacer->replacements, 1000u);
+		ensure_equals(copied, 0u);
+	}
+}
@@ -848,4 +848,13 @@ namespace tut {
 			"I hive control\n");
 		ensure_equals(lookbehind, "");
 	}
+	
+	TEST_METHOD(54) {
+		set_test_name("Unmatched data before a match that starts in the lookbehind buffer is passed to the callback");
+		
+		ensure_equals(feed_in_chunks_and_find("aab", "aaab", 2), 1);
+		ensure_equals(unmatched_data, "a");
+		ensure_equals(feed_in_chunks_and_find("abcabd", "xxabcabcabd", 5), 5);
+		ensure_equals(unmatched_data, "xxabc");
+	}
 }
@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2010 Phusion v.o.f.
+ * https://github.com/FooBarWidget/boyer-moore-horspool
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _STREAM_TWO_WAY_
+#define _STREAM_TWO_WAY_
+
+// Expecting TwoWay.cpp to be included before this file.
+
+/*
+ * Two-Way string search with streaming support. The API mirrors that of
+ * StreamBoyerMooreHorspool.h: initialize a StreamTwoWay structure with
+ * stw_init(), feed haystack data with stw_feed() and reuse the structure
+ * for another haystack with stw_reset().
+ *
+ * Unlike StreamBMH, a StreamTwoWay structure has a fixed size regardless of
+ * the needle length, and it needs no lookbehind buffer. Data at the end of a
+ * fed chunk can only be held back if it is a prefix of the needle, so instead
+ * of copying that data we only remember its length: the bytes themselves can
+ * be read back from the needle. The preparation data (TwoWayFactorization) is
+ * a few words as well and can be shared between threads, just like
+ * StreamBMH_Occ.
+ *
+ * stw_feed() returns the same values as sbmh_feed(), and the callback is
+ * invoked with non-needle data in the same way. Data that was held back is
+ * passed to the callback as a pointer into the needle.
+ *
+ * The search takes linear time in the total amount of data fed, no matter
+ * how it is split into chunks. Windows that lie entirely inside a chunk are
+ * examined by the Two-Way algorithm. A partial match at the end of a chunk
+ * is continued by a KMP-style matcher: after a mismatch, it shifts by the
+ * smallest period of the matched needle prefix, so that the rest of that
+ * prefix is known to match without comparing it again. The period is
+ * derived from the critical factorization of the prefix, which takes no
+ * memory, and is remembered in the context while the prefix grows. When the
+ * prefix turns out not to be periodic, the factorization still gives a
+ * shift of at least half of its length.
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+
+struct StreamTwoWay;
+
+typedef void (*stw_data_cb)(const struct StreamTwoWay *ctx, const unsigned char *data, size_t len);
+
+struct StreamTwoWay {
+	/***** Public but read-only fields *****/
+	bool          found;
+
+	/***** Public fields; feel free to populate *****/
+	stw_data_cb   callback;
+	void         *user_data;
+
+	/***** Internal fields, do not access. *****/
+	/* The last 'prefix_len' bytes that were fed are equal to
+	 * needle[0 .. prefix_len), and no longer tail is a needle prefix.
+	 */
+	size_t        prefix_len;
+	/* needle[0 .. n) has the smallest period 'prefix_period' for every n
+	 * from 'prefix_period_start' up to and including 'prefix_period_end'.
+	 * 0 if not known yet.
+	 */
+	size_t        prefix_period;
+	size_t        prefix_period_start;
+	size_t        prefix_period_end;
+};
+
+/* A view of the held back needle prefix followed by the current chunk. */
+struct _StwHaystack {
+	const unsigned char *needle;
+	size_t prefix_len;
+	const unsigned char *data;
+
+	unsigned char operator[](size_t pos) const {
+		if (pos < prefix_len) {
+			return needle[pos];
+		} else {
+			return data[pos - prefix_len];
+		}
+	}
+};
+
+
+inline void
+stw_reset(struct StreamTwoWay *ctx) {
+	ctx->found = false;
+	ctx->prefix_len = 0;
+	ctx->prefix_period = 0;
+}
+
+inline void
+stw_init(struct StreamTwoWay *ctx, struct TwoWayFactorization *factorization,
+	const unsigned char *needle, size_t needle_len)
+{
+	if (ctx != NULL) {
+		stw_reset(ctx);
+		ctx->callback = NULL;
+		ctx->user_data = NULL;
+	}
+	if (factorization != NULL) {
+		assert(needle_len > 0);
+		*factorization = CreateTwoWayFactorization(needle, needle_len);
+	}
+}
+
+/* Passes haystack[0 .. len) to the callback, where haystack is the held back
+ * needle prefix followed by 'data'.
+ */
+inline void
+_stw_emit(const struct StreamTwoWay *ctx, const unsigned char *needle,
+	const unsigned char *data, size_t len)
+{
+	if (ctx->callback == NULL || len == 0) {
+		return;
+	}
+	size_t from_prefix = std::min(len, ctx->prefix_len);
+	if (from_prefix > 0) {
+		ctx->callback(ctx, needle, from_prefix);
+	}
+	if (len > from_prefix) {
+		ctx->callback(ctx, data, len - from_prefix);
+	}
+}
+
+/* Returns how far a partial match of needle[0 .. matched) can be shifted
+ * without skipping a match. If the prefix is periodic, that is its smallest
+ * period and 'keep' is set: the first matched - shift bytes still match
+ * after the shift. Otherwise it is a lower bound of the smallest period
+ * that is more than half of 'matched', and the bytes must be compared again.
+ */
+inline size_t
+_stw_prefix_shift(struct StreamTwoWay *ctx, const unsigned char *needle, size_t matched,
+	bool &keep)
+{
+	if (ctx->prefix_period != 0 && matched >= ctx->prefix_period_start) {
+		/* A longer prefix has the same smallest period as long as it
+		 * repeats with that period.
+		 */
+		const size_t period = ctx->prefix_period;
+		while (ctx->prefix_period_end < matched
+		    && needle[ctx->prefix_period_end] == needle[ctx->prefix_period_end - period]) {
+			ctx->prefix_period_end++;
+		}
+		if (matched <= ctx->prefix_period_end) {
+			keep = true;
+			return period;
+		}
+	}
+
+	const TwoWayFactorization factorization = CreateTwoWayFactorization(needle, matched);
+	keep = factorization.periodic;
+	if (keep) {
+		/* The critical factorization stays critical, with the same local
+		 * period, for all prefixes that contain one full period after it.
+		 */
+		ctx->prefix_period = factorization.period;
+		ctx->prefix_period_start = factorization.suffix + factorization.period;
+		ctx->prefix_period_end = matched;
+	}
+	return factorization.period;
+}
+
+/* Continues the partial match of needle[0 .. matched) at 'position' of the
+ * haystack, up to 'end'. Returns true if the needle was found at 'position'.
+ * Otherwise, 'needle[0 .. matched)' equals 'haystack[position .. end)' when
+ * the end is reached, and all earlier positions have been ruled out. If
+ * 'until_unmatched' is set, it also returns as soon as nothing matches
+ * anymore, with 'matched' set to 0.
+ *
+ * Haystack bytes before position + matched are only compared again after a
+ * shift of more than half of 'matched', so this takes linear time.
+ */
+template<typename Haystack>
+inline bool
+_stw_match_prefix(struct StreamTwoWay *ctx, const Haystack &haystack,
+	size_t &position, size_t &matched, size_t end,
+	const unsigned char *needle, size_t needle_len, bool until_unmatched)
+{
+	for (;;) {
+		while (matched < needle_len && position + matched < end
+		    && SEARCH_STATS_COMPARE(search_stats(), needle[matched] == haystack[position + matched])) {
+			matched++;
+		}
+		if (matched == needle_len) {
+			return true;
+		} else if (position + matched == end) {
+			return false;
+		}
+
+		if (matched == 0) {
+			position++;
+		} else {
+			bool keep;
+			const size_t shift = _stw_prefix_shift(ctx, needle, matched, keep);
+			position += shift;
+			matched = keep ? matched - shift : 0;
+		}
+		if (until_unmatched && matched == 0) {
+			return false;
+		}
+	}
+}
+
+inline size_t
+stw_feed(struct StreamTwoWay *ctx, const struct TwoWayFactorization *factorization,
+	const unsigned char *needle, size_t needle_len,
+	const unsigned char *data, size_t len)
+{
+	if (ctx->found) {
+		return 0;
+	}
+
+	/* Positions are relative to the start of the held back prefix. */
+	const size_t prefix_len = ctx->prefix_len;
+	const size_t total = prefix_len + len;
+	const _StwHaystack haystack = { needle, prefix_len, data };
+	size_t pos = 0;
+	size_t matched = prefix_len;
+	bool found = false;
+
+	/* Continue the partial match of the held back prefix until it either
+	 * completes or nothing matches anymore.
+	 */
+	if (matched > 0) {
+		found = _stw_match_prefix(ctx, haystack, pos, matched, total,
+			needle, needle_len, true);
+	}
+
+	if (!found && matched == 0) {
+		if (total >= needle_len && pos <= total - needle_len) {
+			const size_t last = total - needle_len;
+
+			/* Windows that start inside the held back prefix. */
+			if (pos < prefix_len) {
+				found = TwoWayScan(haystack, pos, std::min(last, prefix_len - 1),
+					*factorization, needle, needle_len);
+			}
+
+			/* Windows that lie entirely inside 'data'. */
+			if (!found && pos <= last) {
+				size_t data_pos = pos - prefix_len;
+				found = TwoWayScan(data, data_pos, last - prefix_len,
+					*factorization, needle, needle_len);
+				pos = data_pos + prefix_len;
+			}
+		}
+
+		/* The remaining windows extend past the end of the data. Find
+		 * the longest tail that is a needle prefix.
+		 */
+		if (!found) {
+			pos = std::min(pos, total);
+			found = _stw_match_prefix(ctx, haystack, pos, matched, total,
+				needle, needle_len, false);
+		}
+	}
+
+	if (found) {
+		_stw_emit(ctx, needle, data, pos);
+		ctx->found = true;
+		ctx->prefix_len = 0;
+		return pos + needle_len - prefix_len;
+	}
+
+	/* No match. haystack[pos .. total) is needle[0 .. matched), the
+	 * longest tail that is a needle prefix; hold it back.
+	 */
+	_stw_emit(ctx, needle, data, pos);
+	ctx->prefix_len = matched;
+	return len;
+}
+
+#endif /* _STREAM_TWO_WAY_ */
@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2010 Phusion v.o.f.
+ * https://github.com/FooBarWidget/boyer-moore-horspool
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Two-Way string search algorithm (Crochemore & Perrin, 1991), as used by
+ * glibc's memmem() and strstr().
+ *
+ * Two-Way splits the needle at a "critical factorization" u.v and matches v
+ * left-to-right, then u right-to-left. It runs in linear time in the worst
+ * case (at most 2 * haystack_length comparisons) and needs only a few words
+ * of preparation data, which are computed without any memory allocation.
+ * On average it is slower than Boyer-Moore-Horspool because it shifts by
+ * at most the number of characters compared instead of using an occurrence
+ * table, but it has no bad cases.
+ */
+
+#include <cstring>
+#include <algorithm>
+#include <stdint.h>
+
+#include "SearchStats.h"
+
+/* The preparation data for the Two-Way algorithm. Unlike the occ and skip
+ * tables of the other algorithms, this is a small fixed-size structure.
+ */
+struct TwoWayFactorization {
+    /* Position of the critical factorization: the needle is split into
+     * needle[0 .. suffix) and needle[suffix .. needle_length).
+     */
+    size_t suffix;
+    /* The shift to apply when the right half matched but the left half did not. */
+    size_t period;
+    /* Whether the needle is periodic, in which case the algorithm remembers
+     * how much of the needle is known to match after shifting by the period.
+     */
+    bool   periodic;
+};
+
+/* Computes the maximal suffix of the needle, either according to the normal
+ * character ordering or according to the reversed ordering. Returns its
+ * starting position minus one (SIZE_MAX meaning -1), and stores the period
+ * of that suffix in 'period'.
+ */
+static size_t
+TwoWayMaximalSuffix(const unsigned char* needle, size_t needle_length,
+    bool reversed, size_t& period)
+{
+    size_t max_suffix = SIZE_MAX;
+    size_t j = 0;
+    size_t k = 1;
+    size_t p = 1;
+    while(j + k < needle_length)
+    {
+        const unsigned char a = needle[j + k];
+        const unsigned char b = needle[max_suffix + k];
+        if(reversed ? (b < a) : (a < b))
+        {
+            /* Suffix is smaller, period is entire prefix so far. */
+            j += k;
+            k = 1;
+            p = j - max_suffix;
+        }
+        else if(a == b)
+        {
+            /* Advance through repetition of the current period. */
+            if(k != p)
+                ++k;
+            else
+            {
+                j += p;
+                k = 1;
+            }
+        }
+        else
+        {
+            /* Suffix is larger, start over from current location. */
+            max_suffix = j++;
+            k = p = 1;
+        }
+    }
+    period = p;
+    return max_suffix;
+}
+
+/* This function computes the factorization to be used by SearchInTwoWay(). */
+/* It only needs to be computed once per a needle to search. */
+const TwoWayFactorization
+    CreateTwoWayFactorization(const unsigned char* needle, size_t needle_length)
+{
+    TwoWayFactorization result;
+    if(needle_length < 3)
+    {
+        /* Any factorization is critical for such short needles. */
+        result.suffix = needle_length > 0 ? needle_length - 1 : 0;
+        result.period = 1;
+    }
+    else
+    {
+        /* The critical factorization is the later of the two maximal suffixes. */
+        size_t period, period_reversed;
+        const size_t max_suffix = TwoWayMaximalSuffix(needle, needle_length, false, period);
+        const size_t max_suffix_reversed = TwoWayMaximalSuffix(needle, needle_length, true, period_reversed);
+        if(max_suffix_reversed + 1 < max_suffix + 1)
+        {
+            result.suffix = max_suffix + 1;
+            result.period = period;
+        }
+        else
+        {
+            result.suffix = max_suffix_reversed + 1;
+            result.period = period_reversed;
+        }
+    }
+
+    result.periodic = result.period + result.suffix <= needle_length
+        && std::memcmp(needle, needle + result.period, result.suffix) == 0;
+    if(!result.periodic)
+    {
+        /* Without a period, any mismatch in the left half allows us to
+         * shift past the longer of the two halves.
+         */
+        result.period = std::max(result.suffix, needle_length - result.suffix) + 1;
+    }
+    return result;
+}
+
+/* The Two-Way search loop. Examines the windows that start at
+ * 'position' up to and including 'last_position'. 'haystack' can be
+ * anything that supports operator[].
+ *
+ * Returns true if the needle was found, in which case 'position' is set to
+ * the position of the match. Otherwise returns false, and sets 'position'
+ * to the first window position, past 'last_position', that has not been
+ * ruled out.
+ */
+template<typename Haystack>
+inline bool
+TwoWayScan(const Haystack& haystack, size_t& position, size_t last_position,
+    const TwoWayFactorization& factorization,
+    const unsigned char* needle,
+    const size_t needle_length)
+{
+    const size_t suffix = factorization.suffix;
+    const size_t period = factorization.period;
+    size_t j = position;
+
+    if(factorization.periodic)
+    {
+        /* The needle is periodic: after shifting by the period, the first
+         * 'memory' characters of the needle are known to match already.
+         */
+        size_t memory = 0;
+        while(j <= last_position)
+        {
+            /* Scan for matches in right half. */
+            size_t i = std::max(suffix, memory);
+            while(i < needle_length
+               && SEARCH_STATS_COMPARE(search_stats(), needle[i] == haystack[i + j]))
+                ++i;
+            if(needle_length <= i)
+            {
+                /* Scan for matches in left half. */
+                i = suffix - 1;
+                while(memory < i + 1
+                   && SEARCH_STATS_COMPARE(search_stats(), needle[i] == haystack[i + j]))
+                    --i;
+                if(i + 1 < memory + 1)
+                {
+                    position = j;
+                    return true;
+                }
+                j += period;
+                memory = needle_length - period;
+            }
+            else
+            {
+                j += i - suffix + 1;
+                memory = 0;
+            }
+        }
+    }
+    else
+    {
+        while(j <= last_position)
+        {
+            /* Scan for matches in right half. */
+            size_t i = suffix;
+            while(i < needle_length
+               && SEARCH_STATS_COMPARE(search_stats(), needle[i] == haystack[i + j]))
+                ++i;
+            if(needle_length <= i)
+            {
+                /* Scan for matches in left half. */
+                i = suffix - 1;
+                while(i != SIZE_MAX
+                   && SEARCH_STATS_COMPARE(search_stats(), needle[i] == haystack[i + j]))
+                    --i;
+                if(i == SIZE_MAX)
+                {
+                    position = j;
+                    return true;
+                }
+                j += period;
+            }
+            else
+                j += i - suffix + 1;
+        }
+    }
+
+    position = j;
+    return false;
+}
+
+/* A Two-Way search algorithm. */
+/* If it finds the needle, it returns an offset to haystack from which
+ * the needle was found. Otherwise, it returns haystack_length.
+ */
+size_t SearchInTwoWay(const unsigned char* haystack, size_t haystack_length,
+    const TwoWayFactorization& factorization,
+    const unsigned char* needle,
+    const size_t needle_length)
+{
+    if(needle_length > haystack_length) return haystack_length;
+    if(needle_length == 1)
+    {
+        const unsigned char* result = (const unsigned char*)std::memchr(haystack, *needle, haystack_length);
+        return result ? size_t(result-haystack) : haystack_length;
+    }
+
+    size_t position = 0;
+    if(TwoWayScan(haystack, position, haystack_length - needle_length,
+           factorization, needle, needle_length))
+    {
+        return position;
+    }
+    return haystack_length;
+}
@@ -0,0 +1,237 @@
+#include <string>
+#include <algorithm>
+
+#include "tut.h"
+#include "TwoWay.cpp"
+#include "StreamTwoWay.h"
+
+using namespace std;
+
+namespace tut {
+	struct TwoWayTest {
+		string unmatched_data;
+		string held_back;
+		
+		static void append_unmatched_data(const struct StreamTwoWay *ctx,
+			const unsigned char *data, size_t len)
+		{
+			TwoWayTest *self = (TwoWayTest *) ctx->user_data;
+			self->unmatched_data.append((const char *) data, len);
+		}
+		
+		static int find(const string &needle, const string &haystack) {
+			const TwoWayFactorization factorization = CreateTwoWayFactorization(
+				(const unsigned char *) needle.c_str(),
+				needle.size());
+			size_t result = SearchInTwoWay(
+				(const unsigned char *) haystack.c_str(), haystack.size(),
+				factorization,
+				(const unsigned char *) needle.c_str(), needle.size());
+			if (result == haystack.size()) {
+				return -1;
+			} else {
+				return (int) result;
+			}
+		}
+		
+		int feed_in_chunks_and_find(const string &needle, const string &haystack, int chunkSize) {
+			StreamTwoWay ctx;
+			TwoWayFactorization factorization;
+			
+			unmatched_data.clear();
+			held_back.clear();
+			
+			stw_init(&ctx, &factorization, (const unsigned char *) needle.c_str(), needle.size());
+			ctx.callback = append_unmatched_data;
+			ctx.user_data = this;
+			
+			size_t analyzed = 0;
+			for (string::size_type i = 0; i < haystack.size(); i += chunkSize) {
+				analyzed += stw_feed(&ctx, &factorization,
+					(const unsigned char *) needle.c_str(), needle.size(),
+					(const unsigned char *) haystack.c_str() + i,
+					std::min((int) chunkSize, (int) (haystack.size() - i)));
+			}
+			
+			held_back = needle.substr(0, ctx.prefix_len);
+			if (ctx.found) {
+				return analyzed - needle.size();
+			} else {
+				return -1;
+			}
+		}
+		
+		static int reference(const string &needle, const string &haystack) {
+			string::size_type result = haystack.find(needle);
+			if (result == string::npos) {
+				return -1;
+			} else {
+				return (int) result;
+			}
+		}
+		
+		/* The longest tail of the haystack that is a proper needle prefix. */
+		static string longestHeldBack(const string &needle, const string &haystack) {
+			size_t len = std::min(needle.size() - 1, haystack.size());
+			while (len > 0 && haystack.compare(haystack.size() - len, len, needle, 0, len) != 0) {
+				len--;
+			}
+			return needle.substr(0, len);
+		}
+		
+		static string randomString(unsigned int &seed, size_t len, int alphabet_size) {
+			string result;
+			result.reserve(len);
+			for (size_t i = 0; i < len; i++) {
+				seed = seed * 1103515245 + 12345;
+				result.push_back(char('a' + (seed >> 16) % alphabet_size));
+			}
+			return result;
+		}
+	};
+	
+	DEFINE_TEST_GROUP(TwoWayTest);
+	
+	TEST_METHOD(1) {
+		set_test_name("It returns the haystack length if the needle can't be found.");
+		
+		ensure_equals(find("0", "123456789"), -1);
+		ensure_equals(find("ab", "12a45678aa"), -1);
+		ensure_equals(find("aa", "12a4a678ba"), -1);
+		ensure_equals(find("hello world!", "oh my, hello world"), -1);
+		ensure_equals(find("1", ""), -1);
+		ensure_equals(find("hello my world!", "this is small"), -1);
+	}
+	
+	TEST_METHOD(2) {
+		set_test_name("It returns the position at which the needle is first found");
+		
+		ensure_equals(find("9", "1234567899"), 8);
+		ensure_equals(find("ab", "100456789aabab"), 10);
+		ensure_equals(find("\n\n", "h\nello\n\nworld\n\n"), 6);
+		ensure_equals(find("hello world!", "oh my, hello world!! again, hello world!!"), 7);
+		ensure_equals(find("abcabcabd", "abcabcabcabcabdabcabcabd"), 6);
+		ensure_equals(find("I have control\n\n", "\n\n\n\n\n\n\nI have control\n\n"), 7);
+	}
+	
+	TEST_METHOD(3) {
+		set_test_name("It agrees with std::string::find() on random data");
+		
+		unsigned int seed = 1;
+		for (int round = 0; round < 2000; round++) {
+			int alphabet_size = 2 + round % 3;
+			string haystack = randomString(seed, 1 + round % 300, alphabet_size);
+			string needle;
+			if (round % 2 == 0 && haystack.size() > 2) {
+				size_t start = (seed >> 8) % (haystack.size() - 1);
+				needle = haystack.substr(start, 1 + (seed >> 4) % 40);
+			} else {
+				needle = randomString(seed, 1 + round % 12, alphabet_size);
+			}
+			ensure_equals(find(needle, haystack), reference(needle, haystack));
+		}
+	}
+	
+	TEST_METHOD(10) {
+		set_test_name("Streaming: it holds back a trailing needle prefix without a lookbehind buffer");
+		
+		ensure_equals(feed_in_chunks_and_find("ab", "12a45678a", 9), -1);
+		ensure_equals(unmatched_data, "12a45678");
+		ensure_equals(held_back, "a");
+		
+		ensure_equals(feed_in_chunks_and_find("hello", "oh hell", 1), -1);
+		ensure_equals(unmatched_data, "oh ");
+		ensure_equals(held_back, "hell");
+		
+		ensure_equals(feed_in_chunks_and_find("hello", "oh hellhello", 3), 7);
+		ensure_equals(unmatched_data, "oh hell");
+		ensure_equals(held_back, "");
+	}
+	
+	TEST_METHOD(11) {
+		set_test_name("Streaming: it agrees with std::string::find() for all chunk sizes");
+		
+		unsigned int seed = 7;
+		for (int round = 0; round < 600; round++) {
+			int alphabet_size = 2 + round % 3;
+			string haystack = randomString(seed, 1 + round % 100, alphabet_size);
+			string needle = randomString(seed, 1 + round % 9, alphabet_size);
+			int expected = reference(needle, haystack);
+			for (int chunkSize = 1; chunkSize <= 5; chunkSize++) {
+				ensure_equals(feed_in_chunks_and_find(needle, haystack, chunkSize), expected);
+				if (expected == -1) {
+					ensure("held back data is a suffix of the haystack",
+						haystack.size() >= held_back.size()
+						&& haystack.compare(haystack.size() - held_back.size(),
+							held_back.size(), held_back) == 0);
+					ensure_equals(unmatched_data,
+						haystack.substr(0, haystack.size() - held_back.size()));
+				} else {
+					ensure_equals(unmatched_data, haystack.substr(0, expected));
+				}
+			}
+		}
+	}
+	
+	TEST_METHOD(12) {
+		set_test_name("Streaming: it holds back the longest tail that is a needle prefix");
+		
+		unsigned int seed = 11;
+		for (int round = 0; round < 1500; round++) {
+			int alphabet_size = 2 + round % 2;
+			string needle;
+			if (round % 3 == 0) {
+				/* Periodic needles with a different last symbol. */
+				needle = randomString(seed, 1 + round % 4, alphabet_size);
+				while (needle.size() < 8 + (size_t) round % 20) {
+					needle += needle;
+				}
+				needle.resize(8 + round % 20);
+				needle.push_back('c');
+			} else {
+				needle = randomString(seed, 2 + round % 24, alphabet_size);
+			}
+			string haystack = randomString(seed, 1 + round % 150, alphabet_size);
+			if (round % 2 == 0) {
+				haystack += needle.substr(0, (seed >> 8) % needle.size());
+			}
+			int expected = reference(needle, haystack);
+			seed = seed * 1103515245 + 12345;
+			int chunkSize = 1 + (seed >> 16) % 40;
+			ensure_equals(feed_in_chunks_and_find(needle, haystack, chunkSize), expected);
+			if (expected == -1) {
+				ensure_equals(held_back, longestHeldBack(needle, haystack));
+				ensure_equals(unmatched_data,
+					haystack.substr(0, haystack.size() - held_back.size()));
+			}
+		}
+	}
+	
+	TEST_METHOD(13) {
+		set_test_name("Streaming: chunks that end in a long almost-match are searched in linear time");
+		
+		/* Every chunk matches all but the last byte of the needle. Finding
+		 * the bytes to hold back used to take quadratic time in the needle
+		 * length per chunk; this would take minutes then.
+		 */
+		const size_t m = 4000;
+		const string needle = string(m - 1, 'a') + "b";
+		const string chunk = string(m - 1, 'a') + "c";
+		StreamTwoWay ctx;
+		TwoWayFactorization factorization;
+		stw_init(&ctx, &factorization, (const unsigned char *) needle.data(), m);
+		for (int i = 0; i < 2000; i++) {
+			stw_feed(&ctx, &factorization, (const unsigned char *) needle.data(), m,
+				(const unsigned char *) chunk.data(), chunk.size());
+			ensure_equals(ctx.prefix_len, 0u);
+		}
+		stw_feed(&ctx, &factorization, (const unsigned char *) needle.data(), m,
+			(const unsigned char *) chunk.data(), m - 1);
+		ensure_equals(ctx.prefix_len, m - 1);
+		
+		/* Chunks of 1 byte while a long prefix is held back. */
+		ensure_equals(feed_in_chunks_and_find(needle, string(3 * m, 'a') + "b", 1), (int) (2 * m + 1));
+		ensure_equals(feed_in_chunks_and_find(needle, string(20 * m, 'a'), 1), -1);
+		ensure_equals(held_back, string(m - 1, 'a'));
+	}
+}
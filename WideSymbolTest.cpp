@@ -0,0 +1,134 @@
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+#include "tut.h"
+#include "Horspool.cpp"
+#include "BoyerMooreAndTurbo.cpp"
+
+using namespace std;
+
+namespace tut {
+	struct WideSymbolTest {
+		template<typename Symbol>
+		static int toResult(size_t result, const vector<Symbol> &haystack) {
+			if (result == haystack.size()) {
+				return -1;
+			} else {
+				return (int) result;
+			}
+		}
+		
+		/* Runs Horspool, Boyer-Moore and Turbo Boyer-Moore and checks that they agree. */
+		template<typename Symbol>
+		static int find(const vector<Symbol> &needle, const vector<Symbol> &haystack) {
+			const WideOccTable<Symbol> occ = CreateOccTable(&needle[0], needle.size());
+			const skiptable_type skip = CreateSkipTable(&needle[0], needle.size());
+			const Symbol *h = haystack.empty() ? NULL : &haystack[0];
+			
+			int result = toResult(SearchInHorspool(h, haystack.size(), occ,
+				&needle[0], needle.size()), haystack);
+			ensure_equals("Boyer-Moore", toResult(SearchIn(h, haystack.size(), occ, skip,
+				&needle[0], needle.size()), haystack), result);
+			ensure_equals("Turbo Boyer-Moore", toResult(SearchInTurbo(h, haystack.size(), occ, skip,
+				&needle[0], needle.size()), haystack), result);
+			return result;
+		}
+		
+		template<typename Symbol>
+		static int reference(const vector<Symbol> &needle, const vector<Symbol> &haystack) {
+			typename vector<Symbol>::const_iterator it = std::search(
+				haystack.begin(), haystack.end(), needle.begin(), needle.end());
+			if (it == haystack.end()) {
+				return -1;
+			} else {
+				return (int) (it - haystack.begin());
+			}
+		}
+		
+		/* Generates symbols from a small set of values that are spread out
+		 * over the entire range of the symbol type.
+		 */
+		template<typename Symbol>
+		static vector<Symbol> randomSymbols(unsigned int &seed, size_t len, int alphabet_size) {
+			vector<Symbol> result;
+			result.reserve(len);
+			for (size_t i = 0; i < len; i++) {
+				seed = seed * 1103515245 + 12345;
+				unsigned int value = (seed >> 16) % alphabet_size;
+				result.push_back(Symbol(value * 0x9E3779B1u));
+			}
+			return result;
+		}
+		
+		template<typename Symbol>
+		static void compareWithReference(unsigned int seed) {
+			for (int round = 0; round < 1000; round++) {
+				int alphabet_size = 2 + round % 5;
+				vector<Symbol> haystack = randomSymbols<Symbol>(seed, 1 + round % 200, alphabet_size);
+				vector<Symbol> needle;
+				if (round % 2 == 0 && haystack.size() > 2) {
+					size_t start = (seed >> 8) % (haystack.size() - 1);
+					size_t len = std::min<size_t>(1 + (seed >> 4) % 40, haystack.size() - start);
+					needle.assign(haystack.begin() + start, haystack.begin() + start + len);
+				} else {
+					needle = randomSymbols<Symbol>(seed, 1 + round % 12, alphabet_size);
+				}
+				ensure_equals(find(needle, haystack), reference(needle, haystack));
+			}
+		}
+	};
+	
+	DEFINE_TEST_GROUP(WideSymbolTest);
+	
+	TEST_METHOD(1) {
+		set_test_name("16-bit symbols agree with std::search()");
+		compareWithReference<uint16_t>(1);
+	}
+	
+	TEST_METHOD(2) {
+		set_test_name("32-bit symbols agree with std::search()");
+		compareWithReference<uint32_t>(2);
+	}
+	
+	TEST_METHOD(3) {
+		set_test_name("64-bit symbols agree with std::search()");
+		compareWithReference<uint64_t>(3);
+	}
+	
+	TEST_METHOD(4) {
+		set_test_name("Matches are always aligned to symbol boundaries");
+		
+		// As bytes (little endian) the haystack contains 01 02 at byte offset 1,
+		// but there's no symbol 0x0201.
+		uint16_t haystack_data[] = { 0x0100, 0x0002, 0x0201 };
+		uint16_t needle_data[] = { 0x0201 };
+		vector<uint16_t> haystack(haystack_data, haystack_data + 3);
+		vector<uint16_t> needle(needle_data, needle_data + 1);
+		ensure_equals(find(needle, haystack), 2);
+		
+		uint16_t needle2_data[] = { 0x0002, 0x0201 };
+		vector<uint16_t> needle2(needle2_data, needle2_data + 2);
+		ensure_equals(find(needle2, haystack), 1);
+		haystack.pop_back();
+		ensure_equals(find(needle2, haystack), -1);
+	}
+	
+	TEST_METHOD(5) {
+		set_test_name("Symbols that collide in the occ table don't cause matches to be skipped");
+		
+		// Create a needle with many more distinct symbols than the
+		// minimum table size, so that some of them share an entry.
+		vector<uint32_t> needle;
+		for (uint32_t i = 0; i < 5000; i++) {
+			needle.push_back(i * 7919);
+		}
+		vector<uint32_t> haystack;
+		for (uint32_t i = 0; i < 20000; i++) {
+			haystack.push_back(i * 104729);
+		}
+		ensure_equals(find(needle, haystack), -1);
+		haystack.insert(haystack.begin() + 12345, needle.begin(), needle.end());
+		ensure_equals(find(needle, haystack), 12345);
+	}
+}
@@ -0,0 +1,118 @@
+#ifndef _ADVERSARIAL_INPUTS_H_
+#define _ADVERSARIAL_INPUTS_H_
+
+/*
+ * Generates worst-case needle/haystack pairs for the search algorithms, for
+ * finding out how far hostile input can slow them down. None of the
+ * haystacks contain the needle, so a search always scans all of it. 'a'
+ * stands for the repeated byte below.
+ *
+ * - Horspool: needle a^(m-3) b a a in a^n. Every window's last byte
+ *   matches, memcmp() gets to the 'b' before failing, and the shift is 1:
+ *   about m comparisons per byte.
+ * - Boyer-Moore: needle a a b a^k b a^(m-k-4) with k = (m-4)/2, in
+ *   (a b a^k)*. Approaches the 3n comparison bound of Boyer-Moore.
+ * - Turbo Boyer-Moore: needle b a^(m/2+1) b a^(m/2-3), in (b a^(m/2+2))*.
+ *   Approaches the 2n comparison bound of Turbo Boyer-Moore.
+ * - StreamBMH: needle a^(m-1) b in a^n takes 1 comparison per byte when
+ *   fed in large chunks, but about m/chunk_size when fed in chunks shorter
+ *   than the needle, because every chunk boundary restarts the partial
+ *   match in the lookbehind buffer. Needle a^(m-2) b a in 1 byte chunks
+ *   takes about 2m comparisons per byte.
+ * - StreamTwoWay: needle a^(m-1) b, fed (a^(m-1) c)* one period per chunk.
+ *   Every chunk ends in a long partial match that fails on the next byte;
+ *   finding the tail to hold back must not compare it again per position.
+ *
+ * The families were found by searching over needles and periodic haystacks
+ * made of two symbols; see SearchStats.h for how comparisons are counted.
+ */
+
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+struct AdversarialInput {
+	std::string name;
+	/* The algorithm that this input is aimed at. */
+	std::string target;
+	std::string needle;
+	std::string haystack;
+	/* Size of the chunks in which streaming searchers are fed the haystack. */
+	size_t chunk_size;
+};
+
+/* Returns 'period' repeated up to 'size' bytes. */
+inline std::string
+repeatToSize(const std::string &period, size_t size) {
+	std::string result;
+	result.reserve(size + period.size());
+	while (result.size() < size) {
+		result.append(period);
+	}
+	result.resize(size);
+	return result;
+}
+
+inline AdversarialInput
+createAdversarialInput(const std::string &name, const std::string &target,
+	const std::string &needle, const std::string &haystack, size_t chunk_size)
+{
+	AdversarialInput input;
+	input.name = name;
+	input.target = target;
+	input.needle = needle;
+	input.haystack = haystack;
+	input.chunk_size = chunk_size;
+	return input;
+}
+
+/* Creates all worst-case inputs for the given haystack size and needle
+ * length. The needle length must be at least 8.
+ */
+inline std::vector<AdversarialInput>
+createAdversarialInputs(size_t haystack_size, size_t m) {
+	const size_t large_chunk = 64 * 1024;
+	const size_t k = (m - 4) / 2;
+	const std::string all_a(haystack_size, 'a');
+	std::vector<AdversarialInput> inputs;
+
+	/* For comparison: a random needle in random bytes. */
+	std::string random_haystack(haystack_size, '\0');
+	std::string random_needle(m, '\0');
+	srand(1234);
+	for (size_t i = 0; i < haystack_size; i++) {
+		random_haystack[i] = (char) (rand() & 0xFF);
+	}
+	for (size_t i = 0; i < m; i++) {
+		random_needle[i] = (char) (rand() & 0xFF);
+	}
+	inputs.push_back(createAdversarialInput("Random bytes", "(none)",
+		random_needle, random_haystack, large_chunk));
+
+	inputs.push_back(createAdversarialInput("Periodic, shift 1", "Horspool",
+		std::string(m - 3, 'a') + "baa", all_a, large_chunk));
+	inputs.push_back(createAdversarialInput("Two-period 3n", "Boyer-Moore",
+		"aab" + std::string(k, 'a') + "b" + std::string(m - k - 4, 'a'),
+		repeatToSize("ab" + std::string(k, 'a'), haystack_size), large_chunk));
+	inputs.push_back(createAdversarialInput("Two-period 2n", "Turbo BM",
+		"b" + std::string(m / 2 + 1, 'a') + "b" + std::string(m - m / 2 - 3, 'a'),
+		repeatToSize("b" + std::string(m / 2 + 2, 'a'), haystack_size), large_chunk));
+
+	const size_t chunk_sizes[] = { 1, m / 2, m - 1 };
+	for (size_t i = 0; i < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); i++) {
+		inputs.push_back(createAdversarialInput(
+			"Prefix, " + std::to_string(chunk_sizes[i]) + " byte chunks", "StreamBMH",
+			std::string(m - 1, 'a') + "b", all_a, chunk_sizes[i]));
+	}
+	inputs.push_back(createAdversarialInput("Periodic, 1 byte chunks", "StreamBMH",
+		std::string(m - 2, 'a') + "ba", all_a, 1));
+	/* Every chunk ends in all but the last byte of the needle, followed by a
+	 * byte that doesn't occur in it.
+	 */
+	inputs.push_back(createAdversarialInput("Almost-match chunks", "StreamTwoWay",
+		std::string(m - 1, 'a') + "b",
+		repeatToSize(std::string(m - 1, 'a') + "c", haystack_size), m));
+	return inputs;
+}
+
+#endif /* _ADVERSARIAL_INPUTS_H_ */
@@ -2,21 +2,31 @@
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
-#include <sys/time.h>
 #include <alloca.h>
 
+#include "benchmark_support.h"
 #include "Horspool.cpp"
 #include "BoyerMooreAndTurbo.cpp"
 #include "StreamBoyerMooreHorspool.h"
+#include "BitParallel.cpp"
+#include "BackwardOracle.cpp"
+#include "TwoWay.cpp"
+#include "StreamTwoWay.h"
+#include "RareByte.cpp"
+#include "QGramHorspool.cpp"
 
 using namespace std;
 
-unsigned long long
-getTime() {
-	struct timeval tv;
-	gettimeofday(&tv, NULL);
-	return (unsigned long long) tv.tv_sec * 1000 + (unsigned long long) tv.tv_usec / 1000;
-}
+/* When compiled with -DSEARCH_STATS (the benchmark_stats program), print
+ * the hot-path counters of the algorithms that collect them.
+ */
+#ifdef SEARCH_STATS
+	#define RESET_STATS() search_stats_reset(search_stats())
+	#define PRINT_STATS(stats) search_stats_print(stats, stdout)
+#else
+	#define RESET_STATS() do { /* nothing */ } while (false)
+	#define PRINT_STATS(stats) do { /* nothing */ } while (false)
+#endif
 
 const char *
 memmem2(const char *haystack, size_t haystack_len, const char *needle, size_t needle_len) {
@@ -72,46 +82,66 @@ main(int argc, char *argv[]) {
 	needle_len = strlen((const char *) needle);
 	
 	string data;
-	FILE *f = fopen(filename, "rb");
-	if (f == NULL) {
+	if (!readFile(filename, data)) {
 		printf("Cannot open %s\n", filename);
 		return 1;
 	}
-	while (!feof(f)) {
-		char buf[1024 * 8];
-		size_t ret = fread(buf, 1, sizeof(buf), f);
-		data.append(buf, ret);
-	}
-	fclose(f);
 	data.append(":");
 	data.append((const char *) needle);
 	
 	const occtable_type occ = CreateOccTable(needle, needle_len);
 	const skiptable_type skip = CreateSkipTable(needle, needle_len);
+	const bitmasktable_type shift_or_masks = CreateShiftOrTable(needle, needle_len);
+	const bitmasktable_type bndm_masks = CreateBNDMTable(needle, needle_len);
+	const FactorOracle oracle = CreateFactorOracle(needle, needle_len);
+	const TwoWayFactorization factorization = CreateTwoWayFactorization(needle, needle_len);
+	const qgramtable_type qgram = CreateQGramTable(needle, needle_len);
+	const RareBytePlan text_plan = CreateRareBytePlan(needle, needle_len,
+		CreateTextByteFrequencyTable());
+	const RareBytePlan trained_plan = CreateRareBytePlan(needle, needle_len,
+		CreateByteFrequencyTable((const unsigned char *) data.c_str(),
+			std::min(data.size(), (size_t) 256 * 1024)));
 	
 	unsigned long long t1, t2;
 	size_t found = 0;
 	int i;
 	
+	RESET_STATS();
 	t1 = getTime();
 	for (i = 0; i < iterations; i++) {
+		clobberMemory();
 		found = SearchIn((const unsigned char *) data.c_str(), data.size(), occ, skip, needle, needle_len);
 	}
 	t2 = getTime();
 	printf("Boyer-Moore         : found at position %d in %d msec\n", int(found), int(t2 - t1));
+	PRINT_STATS(search_stats());
 	
+	RESET_STATS();
 	t1 = getTime();
 	for (i = 0; i < iterations; i++) {
+		clobberMemory();
 		found = SearchInHorspool((const unsigned char *) data.c_str(), data.size(), occ, needle, needle_len);
 	}
 	t2 = getTime();
 	printf("Boyer-Moore-Horspool: found at position %d in %d msec\n", int(found), int(t2 - t1));
+	PRINT_STATS(search_stats());
+	
+	RESET_STATS();
+	t1 = getTime();
+	for (i = 0; i < iterations; i++) {
+		clobberMemory();
+		found = SearchInQGramHorspool((const unsigned char *) data.c_str(), data.size(), qgram, needle, needle_len);
+	}
+	t2 = getTime();
+	printf("2-gram Horspool     : found at position %d in %d msec\n", int(found), int(t2 - t1));
+	PRINT_STATS(search_stats());
 	
 	t1 = getTime();
 	StreamBMH *ctx = (StreamBMH *) alloca(SBMH_SIZE(needle_len));
 	StreamBMH_Occ sbmh_occ;
 	sbmh_init(ctx, &sbmh_occ, needle, needle_len);
 	for (i = 0; i < iterations; i++) {
+		clobberMemory();
 		sbmh_reset(ctx);
 		size_t analyzed = sbmh_feed(ctx, &sbmh_occ, needle, needle_len,
 			(const unsigned char *) data.c_str(), data.size());
@@ -123,17 +153,121 @@ main(int argc, char *argv[]) {
 	}
 	t2 = getTime();
 	printf("Stream Horspool     : found at position %d in %d msec\n", int(found), int(t2 - t1));
+	PRINT_STATS(ctx->stats);
+	
+	t1 = getTime();
+	sbmh_init(ctx, NULL, needle, needle_len);
+	for (i = 0; i < iterations; i++) {
+		clobberMemory();
+		sbmh_reset(ctx);
+		size_t analyzed = sbmh_feed(ctx, &sbmh_occ, text_plan, needle, needle_len,
+			(const unsigned char *) data.c_str(), data.size());
+		if (ctx->found) {
+			found = analyzed - needle_len;
+		} else {
+			found = analyzed;
+		}
+	}
+	t2 = getTime();
+	printf("Stream rare byte    : found at position %d in %d msec\n", int(found), int(t2 - t1));
+	PRINT_STATS(ctx->stats);
 	
+	RESET_STATS();
 	t1 = getTime();
 	for (i = 0; i < iterations; i++) {
+		clobberMemory();
 		found = SearchInTurbo((const unsigned char *) data.c_str(), data.size(), occ, skip, needle, needle_len);
 	}
 	t2 = getTime();
 	printf("Turbo Boyer-Moore   : found at position %d in %d msec\n", int(found), int(t2 - t1));
+	PRINT_STATS(search_stats());
+	
+	t1 = getTime();
+	for (i = 0; i < iterations; i++) {
+		clobberMemory();
+		found = SearchInTwoWay((const unsigned char *) data.c_str(), data.size(), factorization, needle, needle_len);
+	}
+	t2 = getTime();
+	printf("Two-Way             : found at position %d in %d msec\n", int(found), int(t2 - t1));
+	
+	t1 = getTime();
+	for (i = 0; i < iterations; i++) {
+		clobberMemory();
+		StreamTwoWay stw;
+		stw_init(&stw, NULL, needle, needle_len);
+		size_t analyzed = stw_feed(&stw, &factorization, needle, needle_len,
+			(const unsigned char *) data.c_str(), data.size());
+		if (stw.found) {
+			found = analyzed - needle_len;
+		} else {
+			found = analyzed;
+		}
+	}
+	t2 = getTime();
+	printf("Stream Two-Way      : found at position %d in %d msec\n", int(found), int(t2 - t1));
+	
+	t1 = getTime();
+	for (i = 0; i < iterations; i++) {
+		clobberMemory();
+		found = SearchInShiftOr((const unsigned char *) data.c_str(), data.size(), shift_or_masks, needle, needle_len);
+	}
+	t2 = getTime();
+	printf("Shift-Or            : found at position %d in %d msec\n", int(found), int(t2 - t1));
+	
+	if (needle_len <= BIT_PARALLEL_MAX_LENGTH) {
+		t1 = getTime();
+		for (i = 0; i < iterations; i++) {
+			clobberMemory();
+			ShiftOrStream stream;
+			ResetShiftOrStream(stream);
+			size_t analyzed = FeedShiftOrStream(stream, shift_or_masks, needle_len,
+				(const unsigned char *) data.c_str(), data.size());
+			if (stream.found) {
+				found = analyzed - needle_len;
+			} else {
+				found = analyzed;
+			}
+		}
+		t2 = getTime();
+		printf("Stream Shift-Or     : found at position %d in %d msec\n", int(found), int(t2 - t1));
+	}
+	
+	t1 = getTime();
+	for (i = 0; i < iterations; i++) {
+		clobberMemory();
+		found = SearchInBNDM((const unsigned char *) data.c_str(), data.size(), bndm_masks, needle, needle_len);
+	}
+	t2 = getTime();
+	printf("BNDM                : found at position %d in %d msec\n", int(found), int(t2 - t1));
+	
+	t1 = getTime();
+	for (i = 0; i < iterations; i++) {
+		clobberMemory();
+		found = SearchInBOM((const unsigned char *) data.c_str(), data.size(), oracle, needle, needle_len);
+	}
+	t2 = getTime();
+	printf("Backward Oracle     : found at position %d in %d msec\n", int(found), int(t2 - t1));
+	
+	t1 = getTime();
+	for (i = 0; i < iterations; i++) {
+		clobberMemory();
+		found = SearchInRareByte((const unsigned char *) data.c_str(), data.size(), text_plan, needle, needle_len);
+	}
+	t2 = getTime();
+	printf("Rare byte (text)    : found at position %d in %d msec\n", int(found), int(t2 - t1));
+	
+	t1 = getTime();
+	for (i = 0; i < iterations; i++) {
+		clobberMemory();
+		found = SearchInRareByte((const unsigned char *) data.c_str(), data.size(), trained_plan, needle, needle_len);
+	}
+	t2 = getTime();
+	printf("Rare byte (trained) : found at position %d in %d msec\n", int(found), int(t2 - t1));
 	
 	if (data.find('\0') == string::npos) {
 		t1 = getTime();
 		for (i = 0; i < iterations; i++) {
+			clobberMemory();
 			const char *result = strstr(data.c_str(), (const char *) needle);
 			if (result == NULL) {
 				found = data.size();
@@ -147,6 +281,7 @@ main(int argc, char *argv[]) {
 	
 	t1 = getTime();
 	for (i = 0; i < iterations; i++) {
+		clobberMemory();
 		const char *result = memmem2(data.c_str(), data.size(), (const char *) needle, needle_len);
 		if (result == NULL) {
 			found = data.size();
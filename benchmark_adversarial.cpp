@@ -0,0 +1,173 @@
+/*
+ * Benchmarks the search algorithms on the worst-case inputs of
+ * adversarial_inputs.h, so that complexity regressions become visible.
+ *
+ * Prints the throughput of every algorithm on every input, measured over
+ * repeated searches of at least 200 msec. When compiled
+ * with -DSEARCH_STATS (the benchmark_adversarial_stats program), prints the
+ * number of symbol comparisons per haystack byte instead: the statistics
+ * themselves slow the algorithms down too much for meaningful timings.
+ *
+ * Usage: ./benchmark_adversarial [HAYSTACK_SIZE] [NEEDLE_LENGTH]
+ */
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <alloca.h>
+
+#include "benchmark_support.h"
+#include "adversarial_inputs.h"
+#include "Horspool.cpp"
+#include "BoyerMooreAndTurbo.cpp"
+#include "StreamBoyerMooreHorspool.h"
+#include "TwoWay.cpp"
+#include "StreamTwoWay.h"
+
+using namespace std;
+
+enum { HORSPOOL, BOYER_MOORE, TURBO, STREAM, STREAM_TWO_WAY, ALGORITHMS };
+static const char *algorithm_names[ALGORITHMS] = { "Horspool", "BM", "Turbo BM", "StreamBMH", "StreamTW" };
+
+static size_t
+feedInChunks(StreamBMH *ctx, const StreamBMH_Occ *occ, const AdversarialInput &input) {
+	const unsigned char *needle = (const unsigned char *) input.needle.data();
+	const unsigned char *data = (const unsigned char *) input.haystack.data();
+	const size_t size = input.haystack.size();
+	size_t pos = 0;
+	while (pos < size && !ctx->found) {
+		pos += sbmh_feed(ctx, occ, needle, input.needle.size(),
+			data + pos, min(input.chunk_size, size - pos));
+	}
+	return ctx->found ? pos - input.needle.size() : size;
+}
+
+static size_t
+feedInChunks(StreamTwoWay *ctx, const TwoWayFactorization *factorization,
+	const AdversarialInput &input)
+{
+	const unsigned char *needle = (const unsigned char *) input.needle.data();
+	const unsigned char *data = (const unsigned char *) input.haystack.data();
+	const size_t size = input.haystack.size();
+	size_t pos = 0;
+	while (pos < size && !ctx->found) {
+		pos += stw_feed(ctx, factorization, needle, input.needle.size(),
+			data + pos, min(input.chunk_size, size - pos));
+	}
+	return ctx->found ? pos - input.needle.size() : size;
+}
+
+/* Runs the algorithm once and returns the search result. Sets 'comparisons'
+ * when statistics are compiled in.
+ */
+static size_t
+run(int algorithm, const AdversarialInput &input, const occtable_type &occ,
+	const skiptable_type &skip, const StreamBMH_Occ *stream_occ,
+	const TwoWayFactorization &factorization, double &comparisons)
+{
+	const unsigned char *needle = (const unsigned char *) input.needle.data();
+	const unsigned char *haystack = (const unsigned char *) input.haystack.data();
+	const size_t needle_len = input.needle.size();
+	const size_t size = input.haystack.size();
+	size_t result;
+
+	comparisons = 0;
+	#ifdef SEARCH_STATS
+		search_stats_reset(search_stats());
+	#endif
+	switch (algorithm) {
+	case HORSPOOL:
+		result = SearchInHorspool(haystack, size, occ, needle, needle_len);
+		break;
+	case BOYER_MOORE:
+		result = SearchIn(haystack, size, occ, skip, needle, needle_len);
+		break;
+	case TURBO:
+		result = SearchInTurbo(haystack, size, occ, skip, needle, needle_len);
+		break;
+	case STREAM_TWO_WAY: {
+		StreamTwoWay ctx;
+		stw_init(&ctx, NULL, needle, needle_len);
+		result = feedInChunks(&ctx, &factorization, input);
+		break;
+	}
+	default: {
+		StreamBMH *ctx = (StreamBMH *) alloca(SBMH_SIZE(needle_len));
+		sbmh_init(ctx, NULL, needle, needle_len);
+		result = feedInChunks(ctx, stream_occ, input);
+		#ifdef SEARCH_STATS
+			comparisons = ctx->stats.comparisons;
+		#endif
+		return result;
+	}
+	}
+	#ifdef SEARCH_STATS
+		comparisons = search_stats().comparisons;
+	#endif
+	return result;
+}
+
+int
+main(int argc, char *argv[]) {
+	size_t haystack_size = (argc >= 2) ? strtoul(argv[1], NULL, 10) : 16 * 1024 * 1024;
+	size_t needle_len = (argc >= 3) ? strtoul(argv[2], NULL, 10) : 64;
+	if (needle_len < 8) {
+		printf("The needle must be at least 8 bytes.\n");
+		return 1;
+	}
+	const vector<AdversarialInput> inputs = createAdversarialInputs(haystack_size, needle_len);
+
+	#ifdef SEARCH_STATS
+		printf("# Comparisons per haystack byte, %d MB haystacks, %d byte needles\n",
+			int(haystack_size >> 20), int(needle_len));
+	#else
+		printf("# Throughput in MB/sec, %d MB haystacks, %d byte needles\n",
+			int(haystack_size >> 20), int(needle_len));
+	#endif
+	printf("%-28s %-12s", "input", "aimed at");
+	for (int a = 0; a < ALGORITHMS; a++) {
+		printf(" %10s", algorithm_names[a]);
+	}
+	printf("\n");
+
+	for (size_t i = 0; i < inputs.size(); i++) {
+		const AdversarialInput &input = inputs[i];
+		const unsigned char *needle = (const unsigned char *) input.needle.data();
+		const occtable_type occ = CreateOccTable(needle, input.needle.size());
+		const skiptable_type skip = CreateSkipTable(needle, input.needle.size());
+		StreamBMH_Occ stream_occ;
+		sbmh_init(NULL, &stream_occ, needle, input.needle.size());
+		const TwoWayFactorization factorization = CreateTwoWayFactorization(needle, input.needle.size());
+
+		printf("%-28s %-12s", input.name.c_str(), input.target.c_str());
+		fflush(stdout);
+		for (int a = 0; a < ALGORITHMS; a++) {
+			double comparisons;
+			size_t result = run(a, input, occ, skip, &stream_occ, factorization, comparisons);
+			if (result != input.haystack.size()) {
+				printf("\n*** %s found the needle at %d, but it doesn't occur\n",
+					algorithm_names[a], int(result));
+				return 1;
+			}
+			#ifdef SEARCH_STATS
+				printf(" %10.2f", comparisons / input.haystack.size());
+			#else
+				/* Repeat for at least 200 msec, for a more accurate timing. */
+				unsigned long long t1 = getTime(), t2;
+				unsigned int runs = 0;
+				do {
+					clobberMemory();
+					run(a, input, occ, skip, &stream_occ, factorization, comparisons);
+					runs++;
+					t2 = getTime();
+				} while (t2 - t1 < 200);
+				printf(" %10.0f", double(runs) * input.haystack.size() / 1024.0 / 1024.0
+					/ ((t2 - t1) / 1000.0));
+			#endif
+			fflush(stdout);
+		}
+		printf("\n");
+	}
+	return 0;
+}
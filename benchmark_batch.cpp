@@ -0,0 +1,163 @@
+/*
+ * Benchmarks feeding chunks to many connections with sbmh_batch_feed(),
+ * compared with calling sbmh_feed() once per connection.
+ *
+ * Each round, a batch of different connections out of many receives a chunk
+ * each. The chunks are taken from random positions of the haystack file, so
+ * with a large file they're not in the CPU caches, like data that was
+ * received a while ago. Every connection searches for one of a few needles,
+ * and starts over when it finds it.
+ *
+ * Usage: ./benchmark_batch [options] [HAYSTACK_FILE]
+ *   --connections=N   Number of connections (default 100000).
+ *   --chunk=N         Size of the chunks in bytes (default 512).
+ *   --batch=N         Number of chunks per batch (default 64).
+ */
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "benchmark_support.h"
+#include "StreamBoyerMooreHorspool.h"
+#include "StreamBMHBatch.h"
+
+using namespace std;
+
+/* Amount of data fed by each benchmark. */
+static const size_t TOTAL_BYTES = 1024ull * 1024 * 1024;
+
+static string haystack;
+static size_t connections = 100000;
+static size_t chunk_size = 512;
+static size_t batch_size = 64;
+
+static const char *needle_strings[] = {
+	"I have control\n",
+	"\r\n--------------------------3f1a9c0b7e2d4f6a",
+	"the Mock Turtle"
+};
+static const size_t NEEDLES = sizeof(needle_strings) / sizeof(needle_strings[0]);
+static StreamBMH_Occ occs[NEEDLES];
+
+/* Calls 'feed' with the connection and chunk of every feed, in batches. */
+template<typename Feed>
+static void
+benchmark(const char *title, const Feed &feed) {
+	const size_t rounds = max<size_t>(1, TOTAL_BYTES / (batch_size * chunk_size));
+	unsigned int seed = 1;
+	vector<size_t> batch_connections(batch_size);
+	vector<const unsigned char *> batch_chunks(batch_size);
+	unsigned long long t1 = getNanoTime();
+	size_t found = 0;
+	for (size_t round = 0; round < rounds; round++) {
+		seed = seed * 1103515245 + 12345;
+		size_t c = (seed >> 8) % connections;
+		for (size_t i = 0; i < batch_size; i++) {
+			seed = seed * 1103515245 + 12345;
+			batch_connections[i] = c;
+			batch_chunks[i] = (const unsigned char *) haystack.data()
+				+ ((seed >> 4) * 64ull) % (haystack.size() - chunk_size);
+			/* A stride that is coprime with typical connection counts
+			 * makes the connections of a batch different.
+			 */
+			c = (c + 7919) % connections;
+		}
+		found += feed(batch_connections, batch_chunks);
+	}
+	double secs = (getNanoTime() - t1) / 1e9;
+	printf("%-26s %8.0f MB/sec  %6.2f M chunks/sec  (%d found)\n", title,
+		rounds * batch_size * chunk_size / 1024.0 / 1024.0 / secs,
+		rounds * batch_size / secs / 1e6, int(found));
+}
+
+int
+main(int argc, char *argv[]) {
+	const char *filename = "benchmark_input/alice-large.html";
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--connections=", 14) == 0) {
+			connections = max<size_t>(1, strtoul(argv[i] + 14, NULL, 10));
+		} else if (strncmp(argv[i], "--chunk=", 8) == 0) {
+			chunk_size = max<size_t>(1, strtoul(argv[i] + 8, NULL, 10));
+		} else if (strncmp(argv[i], "--batch=", 8) == 0) {
+			batch_size = max<size_t>(1, strtoul(argv[i] + 8, NULL, 10));
+		} else {
+			filename = argv[i];
+		}
+	}
+	if (!readFile(filename, haystack) || haystack.size() <= chunk_size) {
+		printf("Cannot read %s, or it's not larger than a chunk\n", filename);
+		return 1;
+	}
+	batch_size = min(batch_size, connections);
+
+	sbmh_size_t max_needle_len = 0;
+	for (size_t n = 0; n < NEEDLES; n++) {
+		sbmh_init(NULL, &occs[n], (const unsigned char *) needle_strings[n], strlen(needle_strings[n]));
+		max_needle_len = max<sbmh_size_t>(max_needle_len, strlen(needle_strings[n]));
+	}
+
+	/* One StreamBMH context per connection, allocated separately. */
+	vector<StreamBMH *> contexts(connections);
+	for (size_t c = 0; c < connections; c++) {
+		contexts[c] = (StreamBMH *) malloc(SBMH_SIZE(max_needle_len));
+		sbmh_init(contexts[c], NULL, NULL, max_needle_len);
+	}
+	StreamBMHBatch batch;
+	if (!sbmh_batch_init(&batch, connections, max_needle_len)) {
+		printf("Cannot allocate the batch\n");
+		return 1;
+	}
+	vector<StreamBMHBatchFeed> feeds(batch_size);
+
+	printf("# %d connections, chunks of %d bytes, %d chunks per batch, haystack %s (%d MB)\n",
+		int(connections), int(chunk_size), int(batch_size), filename,
+		int(haystack.size() / 1024 / 1024));
+	for (int round = 0; round < 2; round++) {
+		benchmark("sbmh_feed per connection",
+			[&](const vector<size_t> &conns, const vector<const unsigned char *> &chunks) {
+				size_t found = 0;
+				for (size_t i = 0; i < conns.size(); i++) {
+					StreamBMH *ctx = contexts[conns[i]];
+					const char *needle = needle_strings[conns[i] % NEEDLES];
+					sbmh_feed(ctx, &occs[conns[i] % NEEDLES],
+						(const unsigned char *) needle, strlen(needle),
+						chunks[i], chunk_size);
+					if (ctx->found) {
+						found++;
+						sbmh_reset(ctx);
+					}
+				}
+				return found;
+			});
+		benchmark("sbmh_batch_feed",
+			[&](const vector<size_t> &conns, const vector<const unsigned char *> &chunks) {
+				for (size_t i = 0; i < conns.size(); i++) {
+					const char *needle = needle_strings[conns[i] % NEEDLES];
+					feeds[i].context = conns[i];
+					feeds[i].occ = &occs[conns[i] % NEEDLES];
+					feeds[i].needle = (const unsigned char *) needle;
+					feeds[i].needle_len = strlen(needle);
+					feeds[i].data = chunks[i];
+					feeds[i].len = chunk_size;
+				}
+				sbmh_batch_feed(&batch, &feeds[0], conns.size());
+				size_t found = 0;
+				for (size_t i = 0; i < conns.size(); i++) {
+					if (batch.found[conns[i]]) {
+						found++;
+						sbmh_batch_reset(&batch, conns[i]);
+					}
+				}
+				return found;
+			});
+	}
+
+	sbmh_batch_destroy(&batch);
+	for (size_t c = 0; c < connections; c++) {
+		free(contexts[c]);
+	}
+	return 0;
+}
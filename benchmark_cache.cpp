@@ -0,0 +1,245 @@
+/*
+ * Benchmarks searching with tables from a shared NeedleCache, compared with
+ * creating the tables on every search, in a simulation of request handlers
+ * that search requests for needles from a large working set.
+ *
+ * Every thread handles requests: it picks a random needle from the working
+ * set, uniformly or with Zipf-distributed popularity, and searches a small
+ * request for it. Throughput is printed in
+ * requests per second over all threads, for 1, 2, 4, ... up to MAX_THREADS
+ * threads, together with the cache's hit rate. Every algorithm has its own
+ * cache that only creates the tables it needs. The caches are warmed up
+ * before the first run; if one is smaller than the working set, needles are
+ * evicted and prepared again during the runs.
+ *
+ * Creating an occ table is cheap compared with fetching a cached one from
+ * main memory, so the cache mostly pays off when the hot needles fit in the
+ * CPU caches, or when the tables are expensive, as the skip tables of long
+ * needles are.
+ *
+ * Usage: ./benchmark_cache [options] [MAX_THREADS]
+ *   --needles=N    Number of needles in the working set (default 20000).
+ *   --lengths=A-B  Needle lengths (default 8-64).
+ *   --zipf=S       Pick needles with a Zipf distribution with exponent S
+ *                  (default 1), or uniformly with --zipf=0.
+ *   --mb=N         Cache size in MB (default 64).
+ *   --request=N    Request size in bytes (default 1024).
+ *   --requests=N   Requests per thread per run (default 500000).
+ */
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <alloca.h>
+
+#include "benchmark_support.h"
+#include "Horspool.cpp"
+#include "BoyerMooreAndTurbo.cpp"
+#include "StreamBoyerMooreHorspool.h"
+#include "NeedleCache.h"
+
+using namespace std;
+
+enum Algorithm {
+	HORSPOOL, BOYER_MOORE, STREAM, ALGORITHMS
+};
+static const char *algorithm_names[ALGORITHMS] = {
+	"Horspool", "BM", "StreamBMH"
+};
+/* Every algorithm has a cache with only the tables it needs. */
+static const unsigned int algorithm_tables[ALGORITHMS] = {
+	NEEDLE_CACHE_OCC, NEEDLE_CACHE_OCC | NEEDLE_CACHE_SKIP, NEEDLE_CACHE_SBMH_OCC
+};
+
+static vector<string> needles;
+/* Cumulative probabilities of picking each needle; empty for uniform. */
+static vector<double> popularity;
+static string request;
+
+static unsigned int
+nextRandom(unsigned int &seed) {
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+static const string &
+pickNeedle(unsigned int &seed) {
+	if (popularity.empty()) {
+		return needles[nextRandom(seed) % needles.size()];
+	}
+	double r = (nextRandom(seed) & 0xFFFFFF) / double(0x1000000);
+	size_t i = lower_bound(popularity.begin(), popularity.end(), r) - popularity.begin();
+	return needles[min(i, needles.size() - 1)];
+}
+
+static size_t
+search(Algorithm algorithm, const occtable_type &occ, const skiptable_type &skip,
+	const StreamBMH_Occ &sbmh_occ, const string &needle)
+{
+	const unsigned char *n = (const unsigned char *) needle.data();
+	const unsigned char *h = (const unsigned char *) request.data();
+	switch (algorithm) {
+	case HORSPOOL:
+		return SearchInHorspool(h, request.size(), occ, n, needle.size());
+	case BOYER_MOORE:
+		return SearchIn(h, request.size(), occ, skip, n, needle.size());
+	default: {
+		StreamBMH *ctx = (StreamBMH *) alloca(SBMH_SIZE(needle.size()));
+		sbmh_init(ctx, NULL, n, needle.size());
+		return sbmh_feed(ctx, &sbmh_occ, n, needle.size(), h, request.size());
+	}
+	}
+}
+
+/* Creates the tables that the algorithm needs, like a handler without a cache would. */
+static void
+rebuildPerRequest(Algorithm algorithm, unsigned int seed, size_t count, size_t *result) {
+	size_t total = 0;
+	for (size_t i = 0; i < count; i++) {
+		const string &needle = pickNeedle(seed);
+		const unsigned char *n = (const unsigned char *) needle.data();
+		const occtable_type occ = (algorithm == STREAM) ? occtable_type() : CreateOccTable(n, needle.size());
+		const skiptable_type skip = (algorithm == BOYER_MOORE) ? CreateSkipTable(n, needle.size()) : skiptable_type();
+		StreamBMH_Occ sbmh_occ;
+		if (algorithm == STREAM) {
+			sbmh_init(NULL, &sbmh_occ, n, needle.size());
+		}
+		total += search(algorithm, occ, skip, sbmh_occ, needle);
+	}
+	*result = total;
+}
+
+static void
+lookupPerRequest(Algorithm algorithm, NeedleCache *cache, unsigned int seed, size_t count, size_t *result) {
+	size_t total = 0;
+	for (size_t i = 0; i < count; i++) {
+		const string &needle = pickNeedle(seed);
+		NeedleCache::Handle prepared = cache->lookup((const unsigned char *) needle.data(), needle.size());
+		total += search(algorithm, prepared->occ, prepared->skip, prepared->sbmh_occ, needle);
+	}
+	*result = total;
+}
+
+/* Returns the number of requests per second. */
+static double
+run(Algorithm algorithm, NeedleCache *cache, unsigned int threads, size_t count) {
+	vector<thread> workers;
+	vector<size_t> results(threads);
+	unsigned long long t1 = getTime();
+	for (unsigned int i = 0; i < threads; i++) {
+		if (cache == NULL) {
+			workers.push_back(thread(rebuildPerRequest, algorithm, i + 1, count, &results[i]));
+		} else {
+			workers.push_back(thread(lookupPerRequest, algorithm, cache, i + 1, count, &results[i]));
+		}
+	}
+	for (unsigned int i = 0; i < threads; i++) {
+		workers[i].join();
+	}
+	unsigned long long t2 = getTime();
+	return double(threads) * count * 1000 / max(1ull, t2 - t1);
+}
+
+int
+main(int argc, char *argv[]) {
+	unsigned int max_threads = max(2u, thread::hardware_concurrency());
+	size_t needle_count = 20000;
+	size_t min_len = 8, max_len = 64;
+	double zipf = 1;
+	size_t megabytes = 64;
+	size_t request_size = 1024;
+	size_t count = 500000;
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--needles=", 10) == 0) {
+			needle_count = max<size_t>(1, strtoul(argv[i] + 10, NULL, 10));
+		} else if (strncmp(argv[i], "--lengths=", 10) == 0) {
+			char *end;
+			min_len = max<size_t>(2, strtoul(argv[i] + 10, &end, 10));
+			max_len = (*end == '-') ? max(min_len, (size_t) strtoul(end + 1, NULL, 10)) : min_len;
+		} else if (strncmp(argv[i], "--zipf=", 7) == 0) {
+			zipf = atof(argv[i] + 7);
+		} else if (strncmp(argv[i], "--mb=", 5) == 0) {
+			megabytes = strtoul(argv[i] + 5, NULL, 10);
+		} else if (strncmp(argv[i], "--request=", 10) == 0) {
+			request_size = strtoul(argv[i] + 10, NULL, 10);
+		} else if (strncmp(argv[i], "--requests=", 11) == 0) {
+			count = strtoul(argv[i] + 11, NULL, 10);
+		} else {
+			max_threads = max(1, atoi(argv[i]));
+		}
+	}
+
+	/* Needles that do not occur in the request: the
+	 * needles consist of letters and the request of letters and digits,
+	 * and every needle contains a digit.
+	 */
+	unsigned int seed = 42;
+	for (size_t i = 0; i < needle_count; i++) {
+		string needle;
+		size_t len = min_len + nextRandom(seed) % (max_len - min_len + 1);
+		for (size_t j = 0; j < len; j++) {
+			needle.push_back('a' + nextRandom(seed) % 26);
+		}
+		needle[nextRandom(seed) % len] = '0';
+		needles.push_back(needle);
+	}
+	if (zipf > 0) {
+		double sum = 0;
+		for (size_t i = 0; i < needles.size(); i++) {
+			sum += 1 / pow(double(i + 1), zipf);
+			popularity.push_back(sum);
+		}
+		for (size_t i = 0; i < needles.size(); i++) {
+			popularity[i] /= sum;
+		}
+	}
+	for (size_t i = 0; i < request_size; i++) {
+		unsigned int r = nextRandom(seed) % 32;
+		request.push_back(r < 26 ? char('a' + r) : char('1' + r - 26));
+	}
+
+	printf("# %d needles of %d-%d bytes", int(needles.size()), int(min_len), int(max_len));
+	if (zipf > 0) {
+		printf(" (Zipf, s=%.2f)", zipf);
+	}
+	printf(", %d byte requests, caches of %d MB\n", int(request_size), int(megabytes));
+	NeedleCache *caches[ALGORITHMS];
+	for (int a = 0; a < ALGORITHMS; a++) {
+		caches[a] = new NeedleCache(megabytes * 1024 * 1024, algorithm_tables[a]);
+		for (size_t i = 0; i < needles.size(); i++) {
+			caches[a]->lookup((const unsigned char *) needles[i].data(), needles[i].size());
+		}
+		NeedleCacheStats stats = caches[a]->stats();
+		printf("# %s cache holds %d needles (%d KB)\n", algorithm_names[a],
+			int(stats.entries), int(stats.bytes / 1024));
+	}
+	printf("%-8s %-10s %14s %14s %8s %9s\n", "threads", "algorithm", "rebuild req/s",
+		"cached req/s", "speedup", "hit rate");
+
+	for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+		for (int a = 0; a < ALGORITHMS; a++) {
+			const double rebuild = run(Algorithm(a), NULL, threads, count);
+			const NeedleCacheStats before = caches[a]->stats();
+			const double cached = run(Algorithm(a), caches[a], threads, count);
+			const NeedleCacheStats after = caches[a]->stats();
+			const unsigned long long hits = after.hits - before.hits;
+			const unsigned long long misses = after.misses - before.misses;
+			printf("%-8u %-10s %14.0f %14.0f %7.1fx %8.1f%%\n", threads, algorithm_names[a],
+				rebuild, cached, cached / rebuild, 100.0 * hits / max(1ull, hits + misses));
+			fflush(stdout);
+		}
+		if (threads < max_threads && threads * 2 > max_threads) {
+			threads = max_threads / 2;
+		}
+	}
+
+	for (int a = 0; a < ALGORITHMS; a++) {
+		delete caches[a];
+	}
+	return 0;
+}
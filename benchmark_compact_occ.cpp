@@ -0,0 +1,206 @@
+/*
+ * Compares CompactOccTable with occtable_type and StreamBMH_Occ: the memory
+ * that a registry of very many needles takes, and the search throughput.
+ *
+ * Needles of 8 to 64 bytes are taken from random positions of the haystack
+ * file, so that they contain as many distinct bytes as real needles do.
+ * Then:
+ *
+ *  - the memory per needle and in total is printed for every table type;
+ *  - a few needles are searched for in the haystack with every table type,
+ *    with Horspool and StreamBMH;
+ *  - requests of 1 KB are searched for a random needle from the registry
+ *    each. Here the tables no longer fit in the CPU caches, so the smaller
+ *    tables may win back what their lookups cost.
+ *
+ * The popcount of CompactOccTable uses the popcnt instruction only if the
+ * program is compiled with -mpopcnt or -march=native.
+ *
+ * Usage: ./benchmark_compact_occ [options] [HAYSTACK_FILE]
+ *   --needles=N   Number of needles in the registry (default 1000000).
+ *   --mb=N        Use the first N MB of the haystack file (default 32).
+ */
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <alloca.h>
+
+#include "benchmark_support.h"
+#include "Horspool.cpp"
+#include "StreamBoyerMooreHorspool.h"
+#include "CompactOccTable.h"
+
+using namespace std;
+
+static string haystack;
+
+static unsigned int
+nextRandom(unsigned int &seed) {
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+static double
+throughput(size_t bytes, unsigned long long start) {
+	return bytes / 1024.0 / 1024.0 / ((getNanoTime() - start) / 1e9);
+}
+
+template<typename OccTable>
+static void
+horspool(const char *title, const OccTable &occ, const string &needle, size_t expected) {
+	const unsigned char *h = (const unsigned char *) haystack.data();
+	unsigned long long t1 = getNanoTime();
+	size_t result = SearchInHorspool(h, haystack.size(), occ,
+		(const unsigned char *) needle.data(), needle.size());
+	double speed = throughput(haystack.size(), t1);
+	printf("  %-28s %8.0f MB/sec%s\n", title, speed, result == expected ? "" : "   *** WRONG RESULT");
+}
+
+template<typename OccTable>
+static void
+stream(const char *title, const OccTable *occ, const string &needle, size_t expected) {
+	const unsigned char *n = (const unsigned char *) needle.data();
+	StreamBMH *ctx = (StreamBMH *) alloca(SBMH_SIZE(needle.size()));
+	sbmh_init(ctx, NULL, n, needle.size());
+	unsigned long long t1 = getNanoTime();
+	size_t pos = 0;
+	while (pos < haystack.size() && !ctx->found) {
+		const size_t len = min<size_t>(64 * 1024, haystack.size() - pos);
+		pos += sbmh_feed(ctx, occ, n, needle.size(), (const unsigned char *) haystack.data() + pos, len);
+	}
+	double speed = throughput(haystack.size(), t1);
+	size_t result = ctx->found ? pos - needle.size() : haystack.size();
+	printf("  %-28s %8.0f MB/sec%s\n", title, speed, result == expected ? "" : "   *** WRONG RESULT");
+}
+
+/* Searches 1 KB requests for random needles from the registry. */
+template<typename Lookup>
+static void
+registry(const char *title, const vector<string> &needles, const Lookup &lookup) {
+	const size_t requests = 1000000;
+	const size_t request_size = 1024;
+	unsigned int seed = 7;
+	size_t total = 0;
+	unsigned long long t1 = getNanoTime();
+	for (size_t i = 0; i < requests; i++) {
+		const size_t n = nextRandom(seed) % needles.size();
+		const size_t offset = (nextRandom(seed) * 64ull) % (haystack.size() - request_size);
+		total += lookup(n, (const unsigned char *) haystack.data() + offset, request_size);
+	}
+	double secs = (getNanoTime() - t1) / 1e9;
+	clobberMemory();
+	printf("  %-28s %8.2f M requests/sec (%d)\n", title, requests / secs / 1e6, int(total % 10));
+}
+
+int
+main(int argc, char *argv[]) {
+	const char *filename = "benchmark_input/alice-large.html";
+	size_t needle_count = 1000000;
+	size_t megabytes = 32;
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--needles=", 10) == 0) {
+			needle_count = max<size_t>(1, strtoul(argv[i] + 10, NULL, 10));
+		} else if (strncmp(argv[i], "--mb=", 5) == 0) {
+			megabytes = max<size_t>(1, strtoul(argv[i] + 5, NULL, 10));
+		} else {
+			filename = argv[i];
+		}
+	}
+	if (!readFile(filename, haystack) || haystack.size() < 64 * 1024) {
+		printf("Cannot read %s, or it's smaller than 64 KB\n", filename);
+		return 1;
+	}
+	if (haystack.size() > megabytes * 1024 * 1024) {
+		haystack.resize(megabytes * 1024 * 1024);
+	}
+
+	/* The registry. */
+	unsigned int seed = 42;
+	vector<string> needles;
+	for (size_t i = 0; i < needle_count; i++) {
+		const size_t len = 8 + nextRandom(seed) % 57;
+		const size_t offset = (nextRandom(seed) * 16ull) % (haystack.size() - len);
+		needles.push_back(haystack.substr(offset, len));
+	}
+	vector<size_t> compact_offsets;
+	size_t compact_bytes = 0;
+	for (size_t i = 0; i < needles.size(); i++) {
+		compact_offsets.push_back(compact_bytes / 8);
+		compact_bytes += CompactOccTableSize((const unsigned char *) needles[i].data(), needles[i].size());
+	}
+	vector<uint64_t> compact_arena(compact_bytes / 8);
+	for (size_t i = 0; i < needles.size(); i++) {
+		CreateCompactOccTable((CompactOccTable *) &compact_arena[compact_offsets[i]],
+			(const unsigned char *) needles[i].data(), needles[i].size());
+	}
+
+	printf("# %d needles of 8-64 bytes from %s; popcnt instruction: %s\n",
+		int(needles.size()), filename,
+	#ifdef __POPCNT__
+		"yes"
+	#else
+		"no"
+	#endif
+		);
+	printf("Memory per needle, and for all needles:\n");
+	const double mb = 1024.0 * 1024.0;
+	printf("  %-28s %8.1f bytes   %8.1f MB\n", "occtable_type",
+		double(sizeof(occtable_type) + 256 * sizeof(size_t)),
+		needles.size() * (sizeof(occtable_type) + 256 * sizeof(size_t)) / mb);
+	printf("  %-28s %8.1f bytes   %8.1f MB\n", "StreamBMH_Occ",
+		double(sizeof(StreamBMH_Occ)), needles.size() * sizeof(StreamBMH_Occ) / mb);
+	printf("  %-28s %8.1f bytes   %8.1f MB\n", "CompactOccTable",
+		double(compact_bytes) / needles.size(), compact_bytes / mb);
+
+	/* Single needles. */
+	string long_needle = haystack.substr(haystack.size() - 300, 200);
+	const char *single[] = { "I have control\n", "I have control\n\n", long_needle.c_str() };
+	for (size_t i = 0; i < sizeof(single) / sizeof(single[0]); i++) {
+		const string needle = single[i];
+		const unsigned char *n = (const unsigned char *) needle.data();
+		size_t expected = haystack.find(needle);
+		if (expected == string::npos) {
+			expected = haystack.size();
+		}
+		const occtable_type occ = CreateOccTable(n, needle.size());
+		StreamBMH_Occ sbmh_occ;
+		sbmh_init(NULL, &sbmh_occ, n, needle.size());
+		vector<uint64_t> storage(CompactOccTableSize(n, needle.size()) / 8);
+		CompactOccTable *compact = (CompactOccTable *) &storage[0];
+		CreateCompactOccTable(compact, n, needle.size());
+
+		printf("\nSearching %d MB for a %d byte needle%s:\n", int(haystack.size() / 1024 / 1024),
+			int(needle.size()), i == 0 ? " (found early)" : "");
+		horspool("Horspool, occtable_type", occ, needle, expected);
+		horspool("Horspool, StreamBMH_Occ", sbmh_occ.occ, needle, expected);
+		horspool("Horspool, CompactOccTable", *compact, needle, expected);
+		stream("StreamBMH, StreamBMH_Occ", &sbmh_occ, needle, expected);
+		stream("StreamBMH, CompactOccTable", compact, needle, expected);
+	}
+
+	/* The registry. */
+	printf("\nSearching 1 million 1 KB requests for a random needle from the registry each:\n");
+	if (needles.size() * sizeof(StreamBMH_Occ) <= 1024 * 1024 * 1024) {
+		vector<StreamBMH_Occ> sbmh_occs(needles.size());
+		for (size_t i = 0; i < needles.size(); i++) {
+			sbmh_init(NULL, &sbmh_occs[i], (const unsigned char *) needles[i].data(), needles[i].size());
+		}
+		registry("Horspool, StreamBMH_Occ", needles,
+			[&](size_t n, const unsigned char *request, size_t len) {
+				return SearchInHorspool(request, len, sbmh_occs[n].occ,
+					(const unsigned char *) needles[n].data(), needles[n].size());
+			});
+	} else {
+		printf("  Skipping StreamBMH_Occ, which would take more than 1 GB\n");
+	}
+	registry("Horspool, CompactOccTable", needles,
+		[&](size_t n, const unsigned char *request, size_t len) {
+			return SearchInHorspool(request, len,
+				*(const CompactOccTable *) &compact_arena[compact_offsets[n]],
+				(const unsigned char *) needles[n].data(), needles[n].size());
+		});
+	return 0;
+}
@@ -0,0 +1,197 @@
+/*
+ * Benchmarks CountInHorspool() and SearchFirstNInHorspool() against finding
+ * every occurrence by calling SearchInHorspool() again after each match,
+ * on inputs with many matches such as benchmark_input/newlines.txt.
+ *
+ * For counting, the re-calling loop stores every offset in a vector, like a
+ * caller that materializes the results and then takes their number. Counts
+ * are overlapping, except in the "non-overlapping" row. For the first 10
+ * occurrences, the searches start at many different offsets in the haystack,
+ * each in a window of at most 16 KB so that rare needles don't scan the
+ * whole haystack every time, and the time per search is reported.
+ *
+ * Usage: ./benchmark_count [--mb=N] HAYSTACK_FILE...
+ *   --mb=N      Use the first N MB of every haystack file (default 64). The
+ *               re-calling loop stores 8 bytes per match, so on newlines.txt
+ *               it needs 8 times as much memory.
+ */
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "benchmark_support.h"
+#include "Horspool.cpp"
+
+using namespace std;
+
+static const size_t FIRST_N = 10;
+static const size_t FIRST_N_SEARCHES = 20 * 1000;
+static const size_t FIRST_N_WINDOW = 16 * 1024;
+
+struct Input {
+	const unsigned char *haystack;
+	size_t size;
+	const unsigned char *needle;
+	size_t needle_len;
+	size_t period;
+	occtable_type occ;
+};
+
+static size_t
+collectAll(const Input &in, vector<size_t> &positions) {
+	positions.clear();
+	size_t pos = 0;
+	while (pos < in.size) {
+		size_t result = SearchInHorspool(in.haystack + pos, in.size - pos,
+			in.occ, in.needle, in.needle_len);
+		if (result == in.size - pos) {
+			break;
+		}
+		positions.push_back(pos + result);
+		pos += result + 1;
+	}
+	return positions.size();
+}
+
+static size_t
+collectFirstN(const Input &in, size_t start, size_t end, size_t *positions) {
+	size_t count = 0;
+	size_t pos = start;
+	while (count < FIRST_N && pos < end) {
+		size_t result = SearchInHorspool(in.haystack + pos, end - pos,
+			in.occ, in.needle, in.needle_len);
+		if (result == end - pos) {
+			break;
+		}
+		positions[count++] = pos + result;
+		pos += result + 1;
+	}
+	return count;
+}
+
+static void
+report(const char *title, const Input &in, size_t count, unsigned long long msec) {
+	printf("  %-34s: %10lu matches, %5d msec, %7.1f MB/s\n", title, (unsigned long) count,
+		int(msec), in.size / 1024.0 / 1024.0 / max(1ull, msec) * 1000);
+}
+
+static void
+benchmarkCount(const Input &in) {
+	vector<size_t> positions;
+	unsigned long long t1 = getTime();
+	size_t all = collectAll(in, positions);
+	unsigned long long t2 = getTime();
+	report("SearchInHorspool loop", in, all, t2 - t1);
+	positions = vector<size_t>();
+
+	t1 = getTime();
+	size_t count = CountInHorspool(in.haystack, in.size, in.occ,
+		in.needle, in.needle_len, in.period);
+	clobberMemory();
+	t2 = getTime();
+	report("CountInHorspool", in, count, t2 - t1);
+	if (count != all) {
+		fprintf(stderr, "*** CountInHorspool() returned %lu, expected %lu\n",
+			(unsigned long) count, (unsigned long) all);
+		exit(1);
+	}
+
+	t1 = getTime();
+	count = CountInHorspool(in.haystack, in.size, in.occ,
+		in.needle, in.needle_len, in.needle_len);
+	clobberMemory();
+	t2 = getTime();
+	report("CountInHorspool, non-overlapping", in, count, t2 - t1);
+}
+
+static void
+benchmarkFirstN(const Input &in) {
+	size_t positions[FIRST_N], expected[FIRST_N];
+	size_t stride = in.size / FIRST_N_SEARCHES + 1;
+	size_t total = 0;
+
+	unsigned long long t1 = getNanoTime();
+	for (size_t i = 0; i < FIRST_N_SEARCHES; i++) {
+		size_t start = (i * stride) % in.size;
+		total += collectFirstN(in, start, min(in.size, start + FIRST_N_WINDOW), positions);
+		clobberMemory();
+	}
+	unsigned long long t2 = getNanoTime();
+	printf("  %-34s: %10lu matches, %9.1f nsec/search\n", "first 10, SearchInHorspool loop",
+		(unsigned long) total, double(t2 - t1) / FIRST_N_SEARCHES);
+
+	size_t total2 = 0;
+	t1 = getNanoTime();
+	for (size_t i = 0; i < FIRST_N_SEARCHES; i++) {
+		size_t start = (i * stride) % in.size;
+		total2 += SearchFirstNInHorspool(in.haystack + start,
+			min(in.size - start, FIRST_N_WINDOW), in.occ,
+			in.needle, in.needle_len, in.period, positions, FIRST_N);
+		clobberMemory();
+	}
+	t2 = getNanoTime();
+	printf("  %-34s: %10lu matches, %9.1f nsec/search\n", "first 10, SearchFirstNInHorspool",
+		(unsigned long) total2, double(t2 - t1) / FIRST_N_SEARCHES);
+
+	/* Verify one search against the re-calling loop. */
+	size_t n = collectFirstN(in, 0, in.size, expected);
+	if (total2 != total || SearchFirstNInHorspool(in.haystack, in.size, in.occ,
+		in.needle, in.needle_len, in.period, positions, FIRST_N) != n
+	 || !equal(positions, positions + n, expected))
+	{
+		fprintf(stderr, "*** SearchFirstNInHorspool() disagrees with SearchInHorspool()\n");
+		exit(1);
+	}
+}
+
+int
+main(int argc, char *argv[]) {
+	vector<const char *> filenames;
+	size_t megabytes = 64;
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--mb=", 5) == 0) {
+			megabytes = strtoul(argv[i] + 5, NULL, 10);
+		} else {
+			filenames.push_back(argv[i]);
+		}
+	}
+	if (filenames.empty()) {
+		fprintf(stderr, "Usage: ./benchmark_count [--mb=N] HAYSTACK_FILE...\n");
+		return 1;
+	}
+
+	const char *needles[] = { "\n\n", "\n\n\n\n\n\n\n\n", "\r\n\r\n", "the", "Alice" };
+	const char *needle_titles[] = { "\\n\\n", "\\n x 8", "\\r\\n\\r\\n", "the", "Alice" };
+
+	for (size_t f = 0; f < filenames.size(); f++) {
+		string haystack;
+		if (!readFile(filenames[f], haystack)) {
+			fprintf(stderr, "Cannot open %s\n", filenames[f]);
+			return 1;
+		}
+		if (haystack.size() > megabytes * 1024 * 1024) {
+			haystack.resize(megabytes * 1024 * 1024);
+		}
+		printf("# %s (%.1f MB)\n", filenames[f], haystack.size() / 1024.0 / 1024.0);
+
+		for (size_t j = 0; j < sizeof(needles) / sizeof(needles[0]); j++) {
+			Input in;
+			in.haystack = (const unsigned char *) haystack.data();
+			in.size = haystack.size();
+			in.needle = (const unsigned char *) needles[j];
+			in.needle_len = strlen(needles[j]);
+			in.period = ComputePeriod(in.needle, in.needle_len);
+			in.occ = CreateOccTable(in.needle, in.needle_len);
+
+			printf("Needle \"%s\" (period %lu):\n", needle_titles[j], (unsigned long) in.period);
+			benchmarkCount(in);
+			benchmarkFirstN(in);
+		}
+		printf("\n");
+	}
+	return 0;
+}
@@ -0,0 +1,127 @@
+/*
+ * Benchmarks searching in a synthetic 2-bit packed genome.
+ *
+ * The packed genome is searched directly with SearchInPackedDNA(), and, for
+ * comparison, by unpacking it to one byte per base and searching that with
+ * Boyer-Moore-Horspool. Unpacking a multi-GB genome in one go needs 4 times
+ * as much memory as the packed genome, so the latter unpacks it in blocks,
+ * like a real application would, with needle_length - 1 bases of overlap.
+ *
+ * Usage: ./benchmark_dna [GENOME_BASES] [ITERATIONS]
+ */
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <stdint.h>
+
+#include "benchmark_support.h"
+#include "Horspool.cpp"
+#include "PackedDNA.cpp"
+
+using namespace std;
+
+static const size_t UNPACK_BLOCK_BASES = 1024 * 1024;
+
+static void
+setBase(vector<unsigned char> &packed, size_t pos, unsigned char code) {
+	const unsigned int shift = 6 - 2 * (pos % 4);
+	packed[pos / 4] = (packed[pos / 4] & ~(3 << shift)) | (code << shift);
+}
+
+/* Unpacks the genome block by block and searches each block with Horspool. */
+static size_t
+searchUnpacked(const vector<unsigned char> &genome, size_t genome_bases,
+	const occtable_type &occ, const string &needle, vector<char> &block)
+{
+	const size_t overlap = needle.size() - 1;
+	for (size_t start = 0; start + overlap < genome_bases; start += UNPACK_BLOCK_BASES) {
+		const size_t end = min(genome_bases, start + UNPACK_BLOCK_BASES + overlap);
+		/* UnpackDNA() works on whole bytes; 'start' is a multiple of 4. */
+		UnpackDNA(&genome[start / 4], end - start, &block[0]);
+		size_t result = SearchInHorspool((const unsigned char *) &block[0], end - start,
+			occ, (const unsigned char *) needle.data(), needle.size());
+		if (result != end - start) {
+			return start + result;
+		}
+	}
+	return genome_bases;
+}
+
+static void
+benchmark(const vector<unsigned char> &genome, size_t genome_bases, const string &needle,
+	int iterations)
+{
+	vector<unsigned char> packed_needle(PackedDNASize(needle.size()));
+	PackDNA(needle.data(), needle.size(), &packed_needle[0]);
+	const PackedDNATable table = CreatePackedDNATable(&packed_needle[0], needle.size());
+	const occtable_type occ = CreateOccTable((const unsigned char *) needle.data(), needle.size());
+	vector<char> block(UNPACK_BLOCK_BASES + needle.size());
+	unsigned long long t1, t2;
+	size_t found = 0;
+	int i;
+
+	printf("\n# Matching %d bases in a %.2f G base genome, %d iterations\n",
+		int(needle.size()), genome_bases / 1e9, iterations);
+
+	t1 = getTime();
+	for (i = 0; i < iterations; i++) {
+		clobberMemory();
+		found = SearchInPackedDNA(&genome[0], genome_bases, table,
+			&packed_needle[0], needle.size());
+	}
+	t2 = getTime();
+	printf("Packed q-gram Horspool  : found at position %llu in %d msec\n",
+		(unsigned long long) found, int(t2 - t1));
+
+	t1 = getTime();
+	for (i = 0; i < iterations; i++) {
+		clobberMemory();
+		found = searchUnpacked(genome, genome_bases, occ, needle, block);
+	}
+	t2 = getTime();
+	printf("Unpack + Horspool       : found at position %llu in %d msec\n",
+		(unsigned long long) found, int(t2 - t1));
+}
+
+int
+main(int argc, char *argv[]) {
+	size_t genome_bases = (argc >= 2) ? strtoull(argv[1], NULL, 10) : size_t(4) << 30;
+	int iterations = (argc >= 3) ? atoi(argv[2]) : 3;
+
+	printf("Generating a genome of %llu bases (%llu MB packed)...\n",
+		(unsigned long long) genome_bases,
+		(unsigned long long) (PackedDNASize(genome_bases) >> 20));
+	vector<unsigned char> genome(PackedDNASize(genome_bases));
+	uint64_t state = 88172645463325252ULL;
+	for (size_t i = 0; i < genome.size(); i++) {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		genome[i] = (unsigned char) (state >> 24);
+	}
+
+	static const int needle_lengths[] = { 20, 32, 100 };
+	for (size_t n = 0; n < sizeof(needle_lengths) / sizeof(int); n++) {
+		/* Plant the needle near the end, at an odd base position so that
+		 * it does not start on a byte boundary.
+		 */
+		string needle;
+		for (int i = 0; i < needle_lengths[n]; i++) {
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			needle.push_back("ACGT"[state >> 62]);
+		}
+		const size_t position = (genome_bases - needle.size() - 4) | 1;
+		vector<unsigned char> packed_needle(PackedDNASize(needle.size()));
+		PackDNA(needle.data(), needle.size(), &packed_needle[0]);
+		for (size_t i = 0; i < needle.size(); i++) {
+			setBase(genome, position + i, (packed_needle[i / 4] >> (6 - 2 * (i % 4))) & 3);
+		}
+		benchmark(genome, genome_bases, needle, iterations);
+	}
+
+	return 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * Benchmarks the memory footprint of very many idle stream search contexts:
+ * regular StreamBMH contexts, which each have room for a lookbehind buffer,
+ * compared with StreamBMHLazy contexts, which borrow one from a shared slab
+ * only while they hold a partial match.
+ *
+ * Every session is fed one chunk of a multipart body. One in
+ * PARTIAL_MATCH_INTERVAL chunks ends with the start of the boundary, so that
+ * session must keep a lookbehind buffer.
+ *
+ * Usage: ./benchmark_footprint [SESSIONS] [PARTIAL_MATCH_INTERVAL]
+ */
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#include "benchmark_support.h"
+#include "StreamBoyerMooreHorspool.h"
+#include "StreamBMHLazy.h"
+
+using namespace std;
+
+static const char BOUNDARY[] =
+	"\r\n--------------------------------------------------------------4f2a9c";
+
+/* Returns the resident set size of this process in bytes, or 0 if unknown. */
+static size_t
+residentSetSize() {
+	FILE *f = fopen("/proc/self/statm", "r");
+	if (f == NULL) {
+		return 0;
+	}
+	unsigned long size, resident;
+	int ret = fscanf(f, "%lu %lu", &size, &resident);
+	fclose(f);
+	if (ret != 2) {
+		return 0;
+	}
+	return resident * sysconf(_SC_PAGESIZE);
+}
+
+static void
+report(const char *title, size_t sessions, size_t bytes, size_t rss_growth,
+	unsigned long long msec)
+{
+	printf("%-20s: %7.1f MB (%5.1f bytes/session), RSS +%7.1f MB, feeding took %d msec\n",
+		title, bytes / 1024.0 / 1024.0, double(bytes) / sessions,
+		rss_growth / 1024.0 / 1024.0, int(msec));
+}
+
+int
+main(int argc, char *argv[]) {
+	size_t sessions = (argc >= 2) ? strtoul(argv[1], NULL, 10) : 10 * 1000 * 1000;
+	size_t interval = (argc >= 3) ? strtoul(argv[2], NULL, 10) : 100;
+	const unsigned char *needle = (const unsigned char *) BOUNDARY;
+	const sbmh_size_t needle_len = sizeof(BOUNDARY) - 1;
+
+	string chunk = "Content-Disposition: form-data; name=\"field\"\r\n\r\nvalue value value";
+	string partial_chunk = chunk + string(BOUNDARY, 20);
+	StreamBMH_Occ occ;
+	sbmh_init(NULL, &occ, needle, needle_len);
+
+	printf("# %lu sessions, %d byte boundary, 1 in %lu with a partial match\n",
+		(unsigned long) sessions, (int) needle_len, (unsigned long) interval);
+
+	{
+		size_t rss_before = residentSetSize();
+		StreamBMH_LookbehindSlab slab;
+		sbmh_lookbehind_slab_init(&slab, needle_len);
+		vector<StreamBMHLazy> contexts(sessions);
+
+		unsigned long long t1 = getTime();
+		for (size_t i = 0; i < sessions; i++) {
+			const string &data = (i % interval == 0) ? partial_chunk : chunk;
+			sbmh_lazy_init(&contexts[i]);
+			sbmh_lazy_feed(&contexts[i], &slab, &occ, needle, needle_len,
+				(const unsigned char *) data.data(), data.size());
+		}
+		unsigned long long t2 = getTime();
+
+		report("StreamBMHLazy", sessions,
+			sessions * sizeof(StreamBMHLazy) + slab.bytes_allocated,
+			residentSetSize() - rss_before, t2 - t1);
+		printf("%-20s  %lu buffers borrowed, %.1f MB of slab chunks\n", "",
+			(unsigned long) slab.buffers_in_use, slab.bytes_allocated / 1024.0 / 1024.0);
+
+		for (size_t i = 0; i < sessions; i++) {
+			sbmh_lazy_reset(&contexts[i], &slab);
+		}
+		sbmh_lookbehind_slab_destroy(&slab);
+	}
+
+	{
+		size_t rss_before = residentSetSize();
+		vector<StreamBMH *> contexts(sessions);
+
+		unsigned long long t1 = getTime();
+		for (size_t i = 0; i < sessions; i++) {
+			const string &data = (i % interval == 0) ? partial_chunk : chunk;
+			contexts[i] = (StreamBMH *) malloc(SBMH_SIZE(needle_len));
+			sbmh_init(contexts[i], NULL, needle, needle_len);
+			sbmh_feed(contexts[i], &occ, needle, needle_len,
+				(const unsigned char *) data.data(), data.size());
+		}
+		unsigned long long t2 = getTime();
+
+		/* The pointer array is not counted, but malloc() overhead is only
+		 * visible in the RSS.
+		 */
+		report("StreamBMH (malloc)", sessions, sessions * SBMH_SIZE(needle_len),
+			residentSetSize() - rss_before - sessions * sizeof(StreamBMH *), t2 - t1);
+
+		for (size_t i = 0; i < sessions; i++) {
+			free(contexts[i]);
+		}
+	}
+	return 0;
+}
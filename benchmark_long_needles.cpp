@@ -0,0 +1,111 @@
+/*
+ * Benchmarks the search algorithms with long needles (256 bytes to 64 KB).
+ *
+ * For every needle length, a pseudo-random needle is generated and appended
+ * to the end of the haystack, so every algorithm has to scan the entire
+ * haystack before finding it.
+ *
+ * Usage: ./benchmark_long_needles [HAYSTACK_FILE] [ITERATIONS]
+ */
+
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+#include "benchmark_support.h"
+#include "Horspool.cpp"
+#include "BoyerMooreAndTurbo.cpp"
+#include "BitParallel.cpp"
+#include "BackwardOracle.cpp"
+
+using namespace std;
+
+static string
+createNeedle(size_t len, unsigned int seed) {
+	string needle;
+	needle.reserve(len);
+	for (size_t i = 0; i < len; i++) {
+		seed = seed * 1103515245 + 12345;
+		needle.push_back(char(seed >> 16));
+	}
+	return needle;
+}
+
+int
+main(int argc, char *argv[]) {
+	const char *filename = (argc >= 2) ? argv[1] : "benchmark_input/binary.dat";
+	int iterations = (argc >= 3) ? atoi(argv[2]) : 3;
+	
+	string input;
+	if (!readFile(filename, input)) {
+		printf("Cannot open %s\n", filename);
+		return 1;
+	}
+	
+	printf("%-8s %10s %10s %10s %10s %10s %10s   (msec for %d iterations)\n",
+		"needle", "BM", "Horspool", "Turbo BM", "BNDM", "BOM", "memmem", iterations);
+	
+	for (size_t needle_len = 256; needle_len <= 64 * 1024; needle_len *= 2) {
+		const string needle_str = createNeedle(needle_len, (unsigned int) needle_len);
+		const unsigned char *needle = (const unsigned char *) needle_str.data();
+		string data = input;
+		data.append(":");
+		data.append(needle_str);
+		const unsigned char *haystack = (const unsigned char *) data.data();
+		const size_t expected = input.size() + 1;
+		
+		unsigned long long t0, t1, t2, t3, t4, t5, t6;
+		size_t found[6];
+		int i;
+		
+		const occtable_type occ = CreateOccTable(needle, needle_len);
+		const skiptable_type skip = CreateSkipTable(needle, needle_len);
+		const bitmasktable_type bndm_masks = CreateBNDMTable(needle, needle_len);
+		const FactorOracle oracle = CreateFactorOracle(needle, needle_len);
+		
+		t0 = getTime();
+		for (i = 0; i < iterations; i++) {
+			clobberMemory();
+			found[0] = SearchIn(haystack, data.size(), occ, skip, needle, needle_len);
+		}
+		t1 = getTime();
+		for (i = 0; i < iterations; i++) {
+			clobberMemory();
+			found[1] = SearchInHorspool(haystack, data.size(), occ, needle, needle_len);
+		}
+		t2 = getTime();
+		for (i = 0; i < iterations; i++) {
+			clobberMemory();
+			found[2] = SearchInTurbo(haystack, data.size(), occ, skip, needle, needle_len);
+		}
+		t3 = getTime();
+		for (i = 0; i < iterations; i++) {
+			clobberMemory();
+			found[3] = SearchInBNDM(haystack, data.size(), bndm_masks, needle, needle_len);
+		}
+		t4 = getTime();
+		for (i = 0; i < iterations; i++) {
+			clobberMemory();
+			found[4] = SearchInBOM(haystack, data.size(), oracle, needle, needle_len);
+		}
+		t5 = getTime();
+		for (i = 0; i < iterations; i++) {
+			clobberMemory();
+			const void *result = memmem(haystack, data.size(), needle, needle_len);
+			found[5] = result ? (const unsigned char *) result - haystack : data.size();
+		}
+		t6 = getTime();
+		
+		printf("%-8d %10d %10d %10d %10d %10d %10d\n", int(needle_len),
+			int(t1 - t0), int(t2 - t1), int(t3 - t2), int(t4 - t3), int(t5 - t4), int(t6 - t5));
+		for (i = 0; i < 6; i++) {
+			if (found[i] != expected) {
+				printf("*** Algorithm %d found the needle at %d instead of %d\n",
+					i, int(found[i]), int(expected));
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * Benchmarks MultipartParser on synthetic multipart/form-data uploads, with
+ * small text parts, large binary parts, and a mix of both.
+ *
+ * An upload of about 64 MB is generated in memory and parsed repeatedly in
+ * chunks of 64 KB, like data read from a socket, until the given amount of
+ * data has been parsed. The part data is counted but not copied. For
+ * comparison, the time of copying the same amount of data with memcpy() is
+ * printed as well.
+ *
+ * Usage: ./benchmark_multipart [GB]
+ */
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "benchmark_support.h"
+#include "StreamBoyerMooreHorspool.h"
+#include "MultipartParser.h"
+
+using namespace std;
+
+static const char BOUNDARY[] = "------------------------3f1a9c0b7e2d4f6a";
+static const size_t UPLOAD_SIZE = 64 * 1024 * 1024;
+static const size_t CHUNK_SIZE = 64 * 1024;
+
+struct Counts {
+	size_t parts;
+	size_t data_bytes;
+};
+
+static void
+countPart(MultipartParser *parser) {
+	((Counts *) parser->user_data)->parts++;
+}
+
+static void
+countData(MultipartParser *parser, const char *data, size_t len) {
+	(void) data;
+	((Counts *) parser->user_data)->data_bytes += len;
+}
+
+/* Generates an upload whose parts are between min_size and max_size bytes.
+ * Returns the number of parts and their total size in 'expected'.
+ */
+static string
+generateUpload(size_t min_size, size_t max_size, Counts &expected) {
+	unsigned int seed = 1;
+	string upload;
+	expected.parts = 0;
+	expected.data_bytes = 0;
+	while (upload.size() < UPLOAD_SIZE) {
+		seed = seed * 1103515245 + 12345;
+		const size_t size = min_size + (seed >> 8) % (max_size - min_size + 1);
+		const bool binary = size > 64 * 1024;
+		char header[256];
+		snprintf(header, sizeof(header),
+			"--%s\r\n"
+			"Content-Disposition: form-data; name=\"part%d\"%s\r\n"
+			"Content-Type: %s\r\n"
+			"\r\n",
+			BOUNDARY, int(expected.parts), binary ? "; filename=\"upload.bin\"" : "",
+			binary ? "application/octet-stream" : "text/plain");
+		upload += header;
+		for (size_t i = 0; i < size; i++) {
+			seed = seed * 1103515245 + 12345;
+			upload += binary ? char(seed >> 16) : char('a' + (seed >> 16) % 26);
+		}
+		upload += "\r\n";
+		expected.parts++;
+		expected.data_bytes += size;
+	}
+	upload += "--";
+	upload += BOUNDARY;
+	upload += "--\r\n";
+	return upload;
+}
+
+static void
+benchmark(const char *title, size_t min_size, size_t max_size, size_t total) {
+	static const MultipartCallbacks callbacks = {
+		countPart, NULL, NULL, NULL, countData, NULL, NULL
+	};
+	Counts expected;
+	const string upload = generateUpload(min_size, max_size, expected);
+	const size_t rounds = max<size_t>(1, total / upload.size());
+
+	MultipartParser parser;
+	multipart_parser_init(&parser, &callbacks, BOUNDARY, strlen(BOUNDARY));
+	Counts counts = { 0, 0 };
+	parser.user_data = &counts;
+
+	unsigned long long t1 = getNanoTime();
+	for (size_t round = 0; round < rounds; round++) {
+		multipart_parser_reset(&parser);
+		for (size_t pos = 0; pos < upload.size(); pos += CHUNK_SIZE) {
+			const size_t len = min(CHUNK_SIZE, upload.size() - pos);
+			if (multipart_parser_feed(&parser, upload.data() + pos, len) != len) {
+				printf("%s: parse error: %s\n", title, parser.error);
+				return;
+			}
+		}
+	}
+	double secs = (getNanoTime() - t1) / 1e9;
+	bool correct = parser.finished
+		&& counts.parts == expected.parts * rounds
+		&& counts.data_bytes == expected.data_bytes * rounds;
+
+	vector<char> copy(CHUNK_SIZE);
+	t1 = getNanoTime();
+	for (size_t round = 0; round < rounds; round++) {
+		for (size_t pos = 0; pos < upload.size(); pos += CHUNK_SIZE) {
+			const size_t len = min(CHUNK_SIZE, upload.size() - pos);
+			memcpy(&copy[0], upload.data() + pos, len);
+			clobberMemory();
+		}
+	}
+	double copy_secs = (getNanoTime() - t1) / 1e9;
+
+	const double mb = rounds * upload.size() / 1024.0 / 1024.0;
+	printf("%-30s %8.0f MB/sec  %10.0f parts/sec   (memcpy: %6.0f MB/sec)%s\n", title,
+		mb / secs, counts.parts / secs, mb / copy_secs,
+		correct ? "" : "   *** WRONG RESULT");
+}
+
+int
+main(int argc, char *argv[]) {
+	const double gb = (argc >= 2) ? atof(argv[1]) : 4;
+	const size_t total = size_t(gb * 1024 * 1024 * 1024);
+	printf("# Parsing %.1f GB per upload type, fed in chunks of %d KB\n", gb, int(CHUNK_SIZE / 1024));
+	benchmark("Small parts (100 B - 4 KB)", 100, 4 * 1024, total);
+	benchmark("Large parts (1 MB - 16 MB)", 1024 * 1024, 16 * 1024 * 1024, total);
+	benchmark("Mixed parts (100 B - 1 MB)", 100, 1024 * 1024, total);
+	return 0;
+}
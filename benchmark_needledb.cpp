@@ -0,0 +1,202 @@
+/*
+ * Benchmarks starting up with a NeedleDatabase, compared with preparing
+ * the tables of every needle at startup.
+ *
+ * A scanner with very many needles first prepares an occ table and a skip
+ * table for each of them. With a needle database, it maps a file instead,
+ * and the tables are paged in when they're used. This program measures:
+ *
+ *  - preparing the tables of all needles, as a scanner does on startup;
+ *  - writing the database, which is done once, when the needles change;
+ *  - opening the database, with the file in the page cache and, if the
+ *    page cache can be dropped for the file, without it;
+ *  - searching a small request once for every needle, right after
+ *    startup, which pages in all tables of a database.
+ *
+ * Prepared tables are private memory of each process, while the pages of a
+ * mapped database are shared by all processes that map it.
+ *
+ * Usage: ./benchmark_needledb [options] [DATABASE_FILE]
+ *   --needles=N    Number of needles (default 100000).
+ *   --lengths=A-B  Needle lengths (default 8-64).
+ */
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "benchmark_support.h"
+#include "Horspool.cpp"
+#include "BoyerMooreAndTurbo.cpp"
+#include "StreamBoyerMooreHorspool.h"
+#include "NeedleDatabase.h"
+
+using namespace std;
+
+struct PreparedTables {
+	StreamBMH_Occ occ;
+	skiptable_type skip;
+};
+
+static vector<string> needles;
+static string request;
+
+static unsigned int
+nextRandom(unsigned int &seed) {
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+static double
+msecSince(unsigned long long start) {
+	return (getNanoTime() - start) / 1e6;
+}
+
+/* Searches the request once for every needle; returns a checksum of the results. */
+static size_t
+searchPrepared(const vector<PreparedTables> &tables) {
+	size_t total = 0;
+	const unsigned char *h = (const unsigned char *) request.data();
+	for (size_t i = 0; i < needles.size(); i++) {
+		const unsigned char *n = (const unsigned char *) needles[i].data();
+		total += SearchIn(h, request.size(), tables[i].occ.occ, tables[i].skip, n, needles[i].size());
+	}
+	return total;
+}
+
+static size_t
+searchDatabase(const NeedleDB &db) {
+	size_t total = 0;
+	const unsigned char *h = (const unsigned char *) request.data();
+	for (size_t i = 0; i < needle_db_count(&db); i++) {
+		NeedleDBEntry entry;
+		if (needle_db_get(&db, i, &entry)) {
+			total += SearchIn(h, request.size(), entry.occ->occ, entry.skip, entry.needle, entry.needle_len);
+		}
+	}
+	return total;
+}
+
+/* Evicts the file from the page cache, if the OS allows it. */
+static bool
+dropFromPageCache(const char *filename) {
+	#ifdef POSIX_FADV_DONTNEED
+		int fd = open(filename, O_RDONLY);
+		if (fd == -1) {
+			return false;
+		}
+		fdatasync(fd);
+		bool ok = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+		close(fd);
+		return ok;
+	#else
+		return false;
+	#endif
+}
+
+static void
+startFromDatabase(const char *title, const char *filename, size_t expected) {
+	NeedleDB db;
+	unsigned long long t1 = getNanoTime();
+	if (!needle_db_open(&db, filename)) {
+		perror(filename);
+		exit(1);
+	}
+	double open_time = msecSince(t1);
+	t1 = getNanoTime();
+	size_t result = searchDatabase(db);
+	double search_time = msecSince(t1);
+	needle_db_close(&db);
+	if (result != expected) {
+		printf("*** Database search results differ\n");
+		exit(1);
+	}
+	printf("%-36s %10.3f ms   then searching with every needle: %8.1f ms\n",
+		title, open_time, search_time);
+}
+
+int
+main(int argc, char *argv[]) {
+	const char *filename = "benchmark_input/needles.db";
+	size_t needle_count = 100000;
+	size_t min_len = 8, max_len = 64;
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--needles=", 10) == 0) {
+			needle_count = max<size_t>(1, strtoul(argv[i] + 10, NULL, 10));
+		} else if (strncmp(argv[i], "--lengths=", 10) == 0) {
+			char *end;
+			min_len = max<size_t>(1, strtoul(argv[i] + 10, &end, 10));
+			max_len = (*end == '-') ? max(min_len, (size_t) strtoul(end + 1, NULL, 10)) : min_len;
+		} else {
+			filename = argv[i];
+		}
+	}
+
+	unsigned int seed = 42;
+	for (size_t i = 0; i < needle_count; i++) {
+		string needle;
+		size_t len = min_len + nextRandom(seed) % (max_len - min_len + 1);
+		for (size_t j = 0; j < len; j++) {
+			needle.push_back('a' + nextRandom(seed) % 26);
+		}
+		needles.push_back(needle);
+	}
+	for (size_t i = 0; i < 256; i++) {
+		request.push_back('a' + nextRandom(seed) % 26);
+	}
+	printf("# %d needles of %d-%d bytes, occ and skip tables, 256 byte requests\n",
+		int(needle_count), int(min_len), int(max_len));
+
+	/* Prepare on startup. */
+	unsigned long long t1 = getNanoTime();
+	vector<PreparedTables> tables(needles.size());
+	size_t table_bytes = 0;
+	for (size_t i = 0; i < needles.size(); i++) {
+		const unsigned char *n = (const unsigned char *) needles[i].data();
+		sbmh_init(NULL, &tables[i].occ, n, needles[i].size());
+		tables[i].skip = CreateSkipTable(n, needles[i].size());
+		table_bytes += sizeof(PreparedTables) + tables[i].skip.capacity() * sizeof(size_t);
+	}
+	double prepare_time = msecSince(t1);
+	t1 = getNanoTime();
+	const size_t expected = searchPrepared(tables);
+	double search_time = msecSince(t1);
+	printf("%-36s %10.3f ms   then searching with every needle: %8.1f ms\n",
+		"Preparing all tables:", prepare_time, search_time);
+	printf("%-36s %10.1f MB of private memory per process\n", "", table_bytes / 1024.0 / 1024.0);
+
+	/* Write the database. */
+	vector<const unsigned char *> pointers;
+	vector<size_t> lengths;
+	for (size_t i = 0; i < needles.size(); i++) {
+		pointers.push_back((const unsigned char *) needles[i].data());
+		lengths.push_back(needles[i].size());
+	}
+	t1 = getNanoTime();
+	if (!needle_db_write(filename, pointers.data(), lengths.data(), needles.size(), NEEDLE_DB_SKIP)) {
+		perror(filename);
+		return 1;
+	}
+	double write_time = msecSince(t1);
+	NeedleDB db;
+	if (!needle_db_open(&db, filename)) {
+		perror(filename);
+		return 1;
+	}
+	printf("%-36s %10.3f ms   %.1f MB, shared through the page cache\n",
+		"Writing the database (once):", write_time, db.size / 1024.0 / 1024.0);
+	needle_db_close(&db);
+
+	startFromDatabase("Opening the database (warm):", filename, expected);
+	if (dropFromPageCache(filename)) {
+		startFromDatabase("Opening the database (cold):", filename, expected);
+	} else {
+		printf("Cannot drop the database from the page cache; skipping the cold start\n");
+	}
+	startFromDatabase("Opening the database (warm again):", filename, expected);
+	return 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * Benchmarks allocating StreamBMH contexts with sbmh_pool_alloc() compared
+ * with malloc(), in a simulation of a server with many short-lived
+ * connections.
+ *
+ * Each thread repeatedly "opens a connection": it allocates a context for
+ * one of a few needles, feeds it a small request, and stores it in a random
+ * slot of a table of open connections that is shared by all threads. The
+ * connection that previously occupied the slot is closed: its context is
+ * freed, usually by a different thread than the one that allocated it.
+ *
+ * Usage: ./benchmark_pool [THREADS] [CONNECTIONS_PER_THREAD]
+ */
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "benchmark_support.h"
+#include "StreamBoyerMooreHorspool.h"
+#include "StreamBMHPool.h"
+
+using namespace std;
+
+static const size_t OPEN_CONNECTIONS = 64 * 1024;
+
+struct Needle {
+	string data;
+	StreamBMH_Occ occ;
+};
+
+static vector<Needle> needles;
+static atomic<StreamBMH *> connections[OPEN_CONNECTIONS];
+
+static StreamBMH *
+mallocAlloc(sbmh_size_t needle_len) {
+	StreamBMH *ctx = (StreamBMH *) malloc(SBMH_SIZE(needle_len));
+	if (ctx != NULL) {
+		sbmh_init(ctx, NULL, NULL, needle_len);
+	}
+	return ctx;
+}
+
+template<StreamBMH *(*Alloc)(sbmh_size_t), void (*Free)(StreamBMH *)>
+static void
+churn(unsigned int seed, size_t count) {
+	static const char request[] = "GET /index.html HTTP/1.1\r\nHost: example.com\r\n";
+	for (size_t i = 0; i < count; i++) {
+		seed = seed * 1103515245 + 12345;
+		const Needle &needle = needles[(seed >> 16) % needles.size()];
+		StreamBMH *ctx = Alloc(needle.data.size());
+		sbmh_feed(ctx, &needle.occ,
+			(const unsigned char *) needle.data.data(), needle.data.size(),
+			(const unsigned char *) request, sizeof(request) - 1);
+
+		seed = seed * 1103515245 + 12345;
+		StreamBMH *old = connections[(seed >> 8) % OPEN_CONNECTIONS].exchange(ctx);
+		if (old != NULL) {
+			Free(old);
+		}
+	}
+}
+
+template<StreamBMH *(*Alloc)(sbmh_size_t), void (*Free)(StreamBMH *)>
+static void
+benchmark(const char *title, unsigned int threads, size_t count) {
+	unsigned long long t1 = getTime();
+	vector<thread> workers;
+	for (unsigned int i = 0; i < threads; i++) {
+		workers.push_back(thread(churn<Alloc, Free>, i + 1, count));
+	}
+	for (unsigned int i = 0; i < threads; i++) {
+		workers[i].join();
+	}
+	unsigned long long t2 = getTime();
+
+	for (size_t i = 0; i < OPEN_CONNECTIONS; i++) {
+		Free(connections[i].exchange(NULL));
+	}
+	printf("%-20s: %d msec, %.1f M connections/sec\n", title, int(t2 - t1),
+		double(threads) * count / 1000.0 / max(1ull, t2 - t1));
+}
+
+static void
+mallocFree(StreamBMH *ctx) {
+	free(ctx);
+}
+
+int
+main(int argc, char *argv[]) {
+	unsigned int threads = (argc >= 2) ? atoi(argv[1]) : max(2u, thread::hardware_concurrency());
+	size_t count = (argc >= 3) ? strtoul(argv[2], NULL, 10) : 2 * 1000 * 1000;
+
+	/* A few needles of different lengths, like multipart boundaries. */
+	const char *needle_strings[] = {
+		"\r\n\r\n",
+		"I have control\n",
+		"\r\n--------------------------3f1a9c0b7e2d4f6a",
+		"\r\n--boundary-boundary-boundary-boundary-boundary-boundary-boundary-boundary"
+	};
+	needles.resize(sizeof(needle_strings) / sizeof(needle_strings[0]));
+	for (size_t i = 0; i < needles.size(); i++) {
+		needles[i].data = needle_strings[i];
+		sbmh_init(NULL, &needles[i].occ,
+			(const unsigned char *) needles[i].data.data(), needles[i].data.size());
+	}
+
+	printf("# %u threads, %lu connections per thread, up to %lu open connections\n",
+		threads, (unsigned long) count, (unsigned long) OPEN_CONNECTIONS);
+	for (int round = 0; round < 2; round++) {
+		benchmark<mallocAlloc, mallocFree>("malloc/free", threads, count);
+		benchmark<sbmh_pool_alloc, sbmh_pool_free>("sbmh_pool", threads, count);
+	}
+	return 0;
+}
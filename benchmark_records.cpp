@@ -0,0 +1,172 @@
+/*
+ * Benchmarks splitting a stream into records with RecordSplitter, compared
+ * with std::getline() and with the common approach of wrapping sbmh_feed()
+ * and copying every record into a std::string.
+ *
+ * A stream of about 256 MB is generated in memory, with short text records
+ * (10-120 bytes) and long text records (1-8 KB) separated by "\r\n", binary
+ * records separated by "\0\0" and text records separated by a longer
+ * delimiter. The splitters are fed chunks of 64 KB. std::getline() can only
+ * split on one byte, so it only runs on the "\r\n" records: it splits on
+ * '\n' and strips the '\r'.
+ *
+ * Usage: ./benchmark_records
+ */
+
+#include <string>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <alloca.h>
+
+#include "benchmark_support.h"
+#include "StreamBoyerMooreHorspool.h"
+#include "RecordSplitter.h"
+
+using namespace std;
+
+static const size_t STREAM_SIZE = 256 * 1024 * 1024;
+static const size_t CHUNK_SIZE = 64 * 1024;
+
+struct Totals {
+	size_t records;
+	size_t bytes;
+};
+
+static string
+generateStream(size_t min_size, size_t max_size, bool binary, const string &delimiter) {
+	unsigned int seed = 1;
+	string stream;
+	stream.reserve(STREAM_SIZE + max_size + delimiter.size());
+	while (stream.size() < STREAM_SIZE) {
+		seed = seed * 1103515245 + 12345;
+		const size_t size = min_size + (seed >> 8) % (max_size - min_size + 1);
+		for (size_t i = 0; i < size; i++) {
+			seed = seed * 1103515245 + 12345;
+			/* Binary records have no zero bytes, so they never contain the delimiter. */
+			stream += binary ? char(1 + (seed >> 16) % 255) : char(' ' + (seed >> 16) % 95);
+		}
+		stream += delimiter;
+	}
+	return stream;
+}
+
+static void
+report(const char *title, const string &stream, unsigned long long start, const Totals &totals,
+	const Totals &expected)
+{
+	double secs = (getNanoTime() - start) / 1e9;
+	bool correct = totals.records == expected.records && totals.bytes == expected.bytes;
+	printf("  %-30s %8.0f MB/sec  %7.2f M records/sec%s\n", title,
+		stream.size() / 1024.0 / 1024.0 / secs, totals.records / secs / 1e6,
+		correct ? "" : "   *** WRONG RESULT");
+}
+
+static Totals
+splitWithGetline(const string &stream) {
+	Totals totals = { 0, 0 };
+	istringstream input(stream);
+	string line;
+	while (getline(input, line)) {
+		if (!line.empty() && line[line.size() - 1] == '\r') {
+			line.resize(line.size() - 1);
+		}
+		totals.records++;
+		totals.bytes += line.size();
+	}
+	return totals;
+}
+
+struct CopyingSplitter {
+	Totals totals;
+	string record;
+
+	static void append(const struct StreamBMH *ctx, const unsigned char *data, size_t len) {
+		((CopyingSplitter *) ctx->user_data)->record.append((const char *) data, len);
+	}
+};
+
+/* Wraps sbmh_feed(), resets on each delimiter and copies every record. */
+static Totals
+splitWithCopies(const string &stream, const string &delimiter) {
+	CopyingSplitter splitter;
+	splitter.totals.records = 0;
+	splitter.totals.bytes = 0;
+	const unsigned char *needle = (const unsigned char *) delimiter.data();
+	StreamBMH_Occ occ;
+	StreamBMH *ctx = (StreamBMH *) alloca(SBMH_SIZE(delimiter.size()));
+	sbmh_init(ctx, &occ, needle, delimiter.size());
+	ctx->callback = CopyingSplitter::append;
+	ctx->user_data = &splitter;
+	for (size_t chunk = 0; chunk < stream.size(); chunk += CHUNK_SIZE) {
+		const unsigned char *data = (const unsigned char *) stream.data() + chunk;
+		const size_t len = min(CHUNK_SIZE, stream.size() - chunk);
+		size_t pos = 0;
+		while (pos < len) {
+			pos += sbmh_feed(ctx, &occ, needle, delimiter.size(), data + pos, len - pos);
+			if (ctx->found) {
+				splitter.totals.records++;
+				splitter.totals.bytes += splitter.record.size();
+				splitter.record.clear();
+				sbmh_reset(ctx);
+			}
+		}
+	}
+	return splitter.totals;
+}
+
+static void
+countRecord(RecordSplitter *splitter, const unsigned char *record, size_t len) {
+	(void) record;
+	Totals *totals = (Totals *) splitter->user_data;
+	totals->records++;
+	totals->bytes += len;
+}
+
+static Totals
+splitWithRecordSplitter(const string &stream, const string &delimiter) {
+	Totals totals = { 0, 0 };
+	RecordSplitter *splitter = record_splitter_new((const unsigned char *) delimiter.data(),
+		delimiter.size(), 1024 * 1024);
+	splitter->callback = countRecord;
+	splitter->user_data = &totals;
+	for (size_t chunk = 0; chunk < stream.size(); chunk += CHUNK_SIZE) {
+		record_splitter_feed(splitter, (const unsigned char *) stream.data() + chunk,
+			min(CHUNK_SIZE, stream.size() - chunk));
+	}
+	record_splitter_finish(splitter);
+	record_splitter_free(splitter);
+	return totals;
+}
+
+static void
+benchmark(const char *title, size_t min_size, size_t max_size, bool binary, const string &delimiter) {
+	const string stream = generateStream(min_size, max_size, binary, delimiter);
+	Totals expected = { 0, 0 };
+	for (size_t pos = 0, end; (end = stream.find(delimiter, pos)) != string::npos; pos = end + delimiter.size()) {
+		expected.records++;
+		expected.bytes += end - pos;
+	}
+
+	printf("%s:\n", title);
+	unsigned long long t1;
+	if (delimiter == "\r\n") {
+		t1 = getNanoTime();
+		report("std::getline", stream, t1, splitWithGetline(stream), expected);
+	}
+	t1 = getNanoTime();
+	report("sbmh_feed + std::string copies", stream, t1, splitWithCopies(stream, delimiter), expected);
+	t1 = getNanoTime();
+	report("RecordSplitter", stream, t1, splitWithRecordSplitter(stream, delimiter), expected);
+}
+
+int
+main() {
+	printf("# Splitting %d MB, fed in chunks of %d KB\n", int(STREAM_SIZE / 1024 / 1024), int(CHUNK_SIZE / 1024));
+	benchmark("Short text records (10-120 bytes), \"\\r\\n\"", 10, 120, false, "\r\n");
+	benchmark("Long text records (1-8 KB), \"\\r\\n\"", 1024, 8 * 1024, false, "\r\n");
+	benchmark("Binary records (100-2000 bytes), \"\\0\\0\"", 100, 2000, true, string("\0\0", 2));
+	benchmark("Text records (100-2000 bytes), \"\\n--record--\\n\"", 100, 2000, false, "\n--record--\n");
+	return 0;
+}
@@ -0,0 +1,137 @@
+/*
+ * Benchmarks StreamReplacer, which writes the transformed stream with
+ * writev() as it's fed, compared with buffering the whole body, replacing
+ * with memmem() into a new string and writing that.
+ *
+ * A body of about 64 MB of HTML-like text is generated, and fed repeatedly
+ * in chunks of 64 KB, like a proxied response. Both write their output to
+ * /dev/null. Two cases are measured: rewriting a URL that occurs every few
+ * KB, and redacting a token that occurs every few hundred KB.
+ *
+ * Usage: ./benchmark_replace [GB]
+ */
+
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "benchmark_support.h"
+#include "StreamBoyerMooreHorspool.h"
+#include "StreamReplacer.h"
+
+using namespace std;
+
+static const size_t BODY_SIZE = 64 * 1024 * 1024;
+static const size_t CHUNK_SIZE = 64 * 1024;
+
+static int devnull;
+
+static string
+generateBody(const string &needle, size_t every) {
+	static const char *words[] = { "<p>", "</p>", "the", "Rabbit", "Alice", "said", "<a href=\"/",
+		"\">", "</a>", "and", "of", "a", "curious", "Queen", "http://www.example.org/" };
+	unsigned int seed = 1;
+	string body;
+	body.reserve(BODY_SIZE + 1024);
+	size_t next = every;
+	while (body.size() < BODY_SIZE) {
+		seed = seed * 1103515245 + 12345;
+		body += words[(seed >> 16) % (sizeof(words) / sizeof(words[0]))];
+		body += ' ';
+		if (body.size() >= next) {
+			body += needle;
+			next += every / 2 + (seed >> 8) % every;
+		}
+	}
+	return body;
+}
+
+static void
+writeSpans(StreamReplacer *replacer, const struct iovec *spans, int count) {
+	ssize_t written = writev(devnull, spans, count);
+	*(size_t *) replacer->user_data += written > 0 ? written : 0;
+}
+
+static size_t
+streamingReplace(const string &body, StreamReplacer *replacer) {
+	size_t written = 0;
+	replacer->output = writeSpans;
+	replacer->user_data = &written;
+	for (size_t pos = 0; pos < body.size(); pos += CHUNK_SIZE) {
+		stream_replacer_feed(replacer, (const unsigned char *) body.data() + pos,
+			min(CHUNK_SIZE, body.size() - pos));
+	}
+	stream_replacer_finish(replacer);
+	return written;
+}
+
+static size_t
+bufferedReplace(const string &body, const string &needle, const string &replacement) {
+	string buffer;
+	for (size_t pos = 0; pos < body.size(); pos += CHUNK_SIZE) {
+		buffer.append(body, pos, CHUNK_SIZE);
+	}
+	string result;
+	const char *data = buffer.data();
+	const char *end = data + buffer.size();
+	const char *match;
+	while ((match = (const char *) memmem(data, end - data, needle.data(), needle.size())) != NULL) {
+		result.append(data, match);
+		result += replacement;
+		data = match + needle.size();
+	}
+	result.append(data, end);
+	ssize_t written = write(devnull, result.data(), result.size());
+	return written > 0 ? written : 0;
+}
+
+static void
+benchmark(const char *title, const string &needle, const string &replacement, size_t every, size_t total) {
+	const string body = generateBody(needle, every);
+	const size_t rounds = max<size_t>(1, total / body.size());
+	StreamReplacer *replacer = stream_replacer_new((const unsigned char *) needle.data(), needle.size(),
+		(const unsigned char *) replacement.data(), replacement.size());
+
+	printf("%s:\n", title);
+	size_t streaming_output = 0, buffered_output = 0;
+	unsigned long long t1 = getNanoTime();
+	for (size_t round = 0; round < rounds; round++) {
+		streaming_output += streamingReplace(body, replacer);
+	}
+	double secs = (getNanoTime() - t1) / 1e9;
+	printf("  %-28s %6.2f GB/sec\n", "StreamReplacer + writev",
+		rounds * body.size() / 1024.0 / 1024.0 / 1024.0 / secs);
+
+	t1 = getNanoTime();
+	for (size_t round = 0; round < rounds; round++) {
+		buffered_output += bufferedReplace(body, needle, replacement);
+	}
+	secs = (getNanoTime() - t1) / 1e9;
+	printf("  %-28s %6.2f GB/sec%s\n", "Buffer, memmem and rebuild",
+		rounds * body.size() / 1024.0 / 1024.0 / 1024.0 / secs,
+		streaming_output == buffered_output ? "" : "   *** DIFFERENT OUTPUT SIZE");
+	printf("  %d replacements per body\n", int(replacer->replacements / rounds));
+	stream_replacer_free(replacer);
+}
+
+int
+main(int argc, char *argv[]) {
+	const double gb = (argc >= 2) ? atof(argv[1]) : 2;
+	const size_t total = size_t(gb * 1024 * 1024 * 1024);
+	devnull = open("/dev/null", O_WRONLY);
+	if (devnull == -1) {
+		perror("Cannot open /dev/null");
+		return 1;
+	}
+	printf("# Transforming %.1f GB per case, fed in chunks of %d KB\n", gb, int(CHUNK_SIZE / 1024));
+	benchmark("Rewriting a URL every ~4 KB", "http://internal.example.com:8080/",
+		"https://www.example.com/", 4096, total);
+	benchmark("Redacting a token every ~256 KB", "tok_3f1a9c0b7e2d4f6a8b5c1d0e9f2a7b6c",
+		"[REDACTED]", 256 * 1024, total);
+	close(devnull);
+	return 0;
+}
@@ -0,0 +1,177 @@
+/*
+ * Benchmarks StreamBMH the way network code uses it: the haystack arrives
+ * in chunks, so needle candidates regularly straddle a chunk boundary and
+ * go through the lookbehind buffer.
+ *
+ * The haystack is fed in chunks of 1 byte to 1 MB, either all of the same
+ * size or of random sizes between 1 and twice the given size. For every
+ * chunk size it prints the throughput, the share of sbmh_feed() calls that
+ * started with a non-empty lookbehind buffer, and the 50th, 99th and 99.9th
+ * percentile latency of a single sbmh_feed() call.
+ *
+ * Throughput is measured in a separate pass without per-call timing.
+ * Latencies include the overhead of reading the clock, which is printed
+ * first so that it can be subtracted mentally.
+ *
+ * Usage: ./benchmark_stream [HAYSTACK_FILE] [NEEDLE] [MEGABYTES]
+ * Only the first MEGABYTES (default 32) of the haystack file are used.
+ */
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#include <alloca.h>
+
+#include "benchmark_support.h"
+#include "StreamBoyerMooreHorspool.h"
+
+using namespace std;
+
+/* Returns the chunk sizes to feed 'size' bytes with: all equal to
+ * 'chunk_size', or random between 1 and 2 * chunk_size - 1.
+ */
+static vector<uint32_t>
+createChunkSizes(size_t size, size_t chunk_size, bool randomized) {
+	vector<uint32_t> result;
+	unsigned int seed = (unsigned int) chunk_size;
+	size_t pos = 0;
+	while (pos < size) {
+		size_t len = chunk_size;
+		if (randomized) {
+			seed = seed * 1103515245 + 12345;
+			len = 1 + (size_t(seed >> 1) % (2 * chunk_size - 1));
+		}
+		len = min(len, size - pos);
+		result.push_back((uint32_t) len);
+		pos += len;
+	}
+	return result;
+}
+
+struct FeedResult {
+	size_t found;
+	size_t feeds_with_lookbehind;
+};
+
+/* Feeds the haystack in the given chunks. If 'latencies' is not NULL,
+ * times every sbmh_feed() call.
+ */
+static FeedResult
+feedAll(StreamBMH *ctx, const StreamBMH_Occ *occ, const unsigned char *needle, size_t needle_len,
+	const string &data, const vector<uint32_t> &chunk_sizes, vector<uint32_t> *latencies)
+{
+	const unsigned char *haystack = (const unsigned char *) data.data();
+	FeedResult result = { data.size(), 0 };
+	size_t pos = 0;
+
+	sbmh_reset(ctx);
+	for (size_t i = 0; i < chunk_sizes.size() && !ctx->found; i++) {
+		if (ctx->lookbehind_size > 0) {
+			result.feeds_with_lookbehind++;
+		}
+		size_t analyzed;
+		if (latencies != NULL) {
+			unsigned long long t1 = getNanoTime();
+			analyzed = sbmh_feed(ctx, occ, needle, needle_len, haystack + pos, chunk_sizes[i]);
+			unsigned long long t2 = getNanoTime();
+			latencies->push_back((uint32_t) min(t2 - t1, 0xFFFFFFFFull));
+		} else {
+			analyzed = sbmh_feed(ctx, occ, needle, needle_len, haystack + pos, chunk_sizes[i]);
+		}
+		pos += analyzed;
+	}
+	if (ctx->found) {
+		result.found = pos - needle_len;
+	}
+	return result;
+}
+
+static uint32_t
+percentile(vector<uint32_t> &values, double p) {
+	size_t index = min(values.size() - 1, size_t(values.size() * p));
+	nth_element(values.begin(), values.begin() + index, values.end());
+	return values[index];
+}
+
+static bool
+benchmark(const unsigned char *needle, size_t needle_len, const string &data,
+	size_t chunk_size, bool randomized)
+{
+	StreamBMH *ctx = (StreamBMH *) alloca(SBMH_SIZE(needle_len));
+	StreamBMH_Occ occ;
+	sbmh_init(ctx, &occ, needle, needle_len);
+	const vector<uint32_t> chunk_sizes = createChunkSizes(data.size(), chunk_size, randomized);
+	const size_t expected = data.size() - needle_len;
+
+	/* Throughput: repeat for at least 200 msec. */
+	FeedResult result;
+	unsigned long long t1 = getTime(), t2;
+	unsigned int runs = 0;
+	do {
+		clobberMemory();
+		result = feedAll(ctx, &occ, needle, needle_len, data, chunk_sizes, NULL);
+		runs++;
+		t2 = getTime();
+	} while (t2 - t1 < 200);
+
+	vector<uint32_t> latencies;
+	latencies.reserve(chunk_sizes.size());
+	feedAll(ctx, &occ, needle, needle_len, data, chunk_sizes, &latencies);
+
+	char title[32];
+	snprintf(title, sizeof(title), "%s%lu", randomized ? "~" : "", (unsigned long) chunk_size);
+	printf("%-10s %10.1f %11.1f%% %9u %9u %9u\n", title,
+		double(runs) * data.size() / 1024 / 1024 / ((t2 - t1) / 1000.0),
+		100.0 * result.feeds_with_lookbehind / chunk_sizes.size(),
+		percentile(latencies, 0.5), percentile(latencies, 0.99),
+		percentile(latencies, 0.999));
+	if (result.found != expected) {
+		printf("*** Found the needle at %lu instead of %lu\n",
+			(unsigned long) result.found, (unsigned long) expected);
+		return false;
+	}
+	return true;
+}
+
+int
+main(int argc, char *argv[]) {
+	const char *filename = (argc >= 2) ? argv[1] : "benchmark_input/alice-large.html";
+	const unsigned char *needle = (const unsigned char *) ((argc >= 3) ? argv[2] : "I have control\n");
+	const size_t megabytes = (argc >= 4) ? strtoul(argv[3], NULL, 10) : 32;
+	const size_t needle_len = strlen((const char *) needle);
+
+	string data;
+	if (!readFile(filename, data)) {
+		printf("Cannot open %s\n", filename);
+		return 1;
+	}
+	if (data.size() > megabytes * 1024 * 1024) {
+		data.resize(megabytes * 1024 * 1024);
+	}
+	data.append(":");
+	data.append((const char *) needle);
+
+	unsigned long long t1 = getNanoTime();
+	for (int i = 0; i < 1000; i++) {
+		clobberMemory();
+		getNanoTime();
+	}
+	unsigned long long t2 = getNanoTime();
+	printf("# %d MB haystack, clock overhead %d ns; ~N means random chunk sizes with mean N\n",
+		int(data.size() >> 20), int((t2 - t1) / 1000));
+	printf("%-10s %10s %12s %9s %9s %9s\n", "chunk", "MB/sec", "lookbehind", "p50 ns",
+		"p99 ns", "p999 ns");
+
+	for (int randomized = 0; randomized <= 1; randomized++) {
+		for (size_t chunk_size = 1; chunk_size <= 1024 * 1024; chunk_size *= 4) {
+			if (!benchmark(needle, needle_len, data, chunk_size, randomized)) {
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,52 @@
+#ifndef _BENCHMARK_SUPPORT_H_
+#define _BENCHMARK_SUPPORT_H_
+
+/* Helper functions shared by the benchmark programs. */
+
+#include <string>
+#include <cstdio>
+#include <chrono>
+#include <sys/time.h>
+
+inline unsigned long long
+getTime() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (unsigned long long) tv.tv_sec * 1000 + (unsigned long long) tv.tv_usec / 1000;
+}
+
+/* A monotonic clock in nanoseconds, for timing short operations. */
+inline unsigned long long
+getNanoTime() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Forces the compiler to assume that all memory may have changed. Call this
+ * once per benchmark iteration; otherwise the optimizer may notice that the
+ * same search is performed every iteration and only perform it once.
+ */
+inline void
+clobberMemory() {
+	#ifdef __GNUC__
+		__asm__ __volatile__("" : : : "memory");
+	#endif
+}
+
+/* Reads the entire file into 'data'. Returns false if the file cannot be opened. */
+inline bool
+readFile(const char *filename, std::string &data) {
+	FILE *f = fopen(filename, "rb");
+	if (f == NULL) {
+		return false;
+	}
+	while (!feof(f)) {
+		char buf[1024 * 8];
+		size_t ret = fread(buf, 1, sizeof(buf), f);
+		data.append(buf, ret);
+	}
+	fclose(f);
+	return true;
+}
+
+#endif /* _BENCHMARK_SUPPORT_H_ */
@@ -0,0 +1,320 @@
+/*
+ * Sweeps needle lengths from 1 to 4096 bytes and haystack alignments from
+ * 0 to 63 for every algorithm, and reports which algorithm is fastest for
+ * which needle lengths on each input. By default the needle lengths are
+ * sampled: the powers of two and the midpoints between them (1, 2, 3, 4, 6,
+ * 8, 12, ... 3072, 4096). --all-lengths tests every length instead, which
+ * takes about 170 times as long.
+ *
+ * Needles are taken from the haystack itself, near its end, so that the
+ * match position is controlled: of a number of candidate positions, the
+ * one whose first occurrence is furthest into the haystack is used. Short
+ * needles may still occur early in the haystack; the 'scanned' column shows
+ * how much of the haystack is searched before the match. Throughput is
+ * measured over the scanned part.
+ *
+ * For every input, a row per needle length shows the mean throughput over
+ * all alignments per algorithm, the winner, and how much the winner's
+ * throughput depends on the alignment. It is followed by a crossover table
+ * with the needle length bands in which each algorithm wins.
+ *
+ * Usage: ./benchmark_sweep [options] HAYSTACK_FILE...
+ *   --mb=N      Use the first N MB of every haystack file (default 4).
+ *   --step=N    Only test every N-th alignment (default 1: all 64).
+ *   --all-lengths
+ *               Test every needle length from 1 to 4096.
+ */
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <alloca.h>
+
+#include "benchmark_support.h"
+#include "Horspool.cpp"
+#include "BoyerMooreAndTurbo.cpp"
+#include "StreamBoyerMooreHorspool.h"
+#include "BitParallel.cpp"
+#include "BackwardOracle.cpp"
+#include "TwoWay.cpp"
+#include "RareByte.cpp"
+#include "QGramHorspool.cpp"
+
+using namespace std;
+
+enum Algorithm {
+	HORSPOOL, QGRAM_HORSPOOL, STREAM, BOYER_MOORE, TURBO, TWO_WAY, SHIFT_OR, BNDM,
+	BOM, RARE_BYTE, MEMMEM, ALGORITHMS
+};
+static const char *algorithm_names[ALGORITHMS] = {
+	"Horspool", "2-gram", "StreamBMH", "BM", "Turbo BM", "Two-Way", "Shift-Or", "BNDM",
+	"BOM", "Rare byte", "memmem"
+};
+
+/* Tables for one needle, created before timing. */
+struct Prepared {
+	const unsigned char *needle;
+	size_t needle_len;
+	occtable_type occ;
+	skiptable_type skip;
+	qgramtable_type qgram;
+	StreamBMH_Occ sbmh_occ;
+	TwoWayFactorization factorization;
+	bitmasktable_type shift_or_masks;
+	bitmasktable_type bndm_masks;
+	FactorOracle oracle;
+	RareBytePlan rare_byte_plan;
+};
+
+static void
+prepare(Prepared &p, const unsigned char *needle, size_t needle_len, const bytefreq_type &frequencies) {
+	p.needle = needle;
+	p.needle_len = needle_len;
+	p.occ = CreateOccTable(needle, needle_len);
+	p.skip = CreateSkipTable(needle, needle_len);
+	p.qgram = CreateQGramTable(needle, needle_len);
+	sbmh_init(NULL, &p.sbmh_occ, needle, needle_len);
+	p.factorization = CreateTwoWayFactorization(needle, needle_len);
+	p.shift_or_masks = CreateShiftOrTable(needle, needle_len);
+	p.bndm_masks = CreateBNDMTable(needle, needle_len);
+	p.oracle = CreateFactorOracle(needle, needle_len);
+	p.rare_byte_plan = CreateRareBytePlan(needle, needle_len, frequencies);
+}
+
+static size_t
+search(Algorithm algorithm, const Prepared &p, const unsigned char *haystack, size_t size) {
+	const unsigned char *needle = p.needle;
+	const size_t needle_len = p.needle_len;
+	switch (algorithm) {
+	case HORSPOOL:
+		return SearchInHorspool(haystack, size, p.occ, needle, needle_len);
+	case QGRAM_HORSPOOL:
+		return SearchInQGramHorspool(haystack, size, p.qgram, needle, needle_len);
+	case STREAM: {
+		StreamBMH *ctx = (StreamBMH *) alloca(SBMH_SIZE(needle_len));
+		sbmh_init(ctx, NULL, needle, needle_len);
+		size_t analyzed = sbmh_feed(ctx, &p.sbmh_occ, needle, needle_len, haystack, size);
+		return ctx->found ? analyzed - needle_len : size;
+	}
+	case BOYER_MOORE:
+		return SearchIn(haystack, size, p.occ, p.skip, needle, needle_len);
+	case TURBO:
+		return SearchInTurbo(haystack, size, p.occ, p.skip, needle, needle_len);
+	case TWO_WAY:
+		return SearchInTwoWay(haystack, size, p.factorization, needle, needle_len);
+	case SHIFT_OR:
+		return SearchInShiftOr(haystack, size, p.shift_or_masks, needle, needle_len);
+	case BNDM:
+		return SearchInBNDM(haystack, size, p.bndm_masks, needle, needle_len);
+	case BOM:
+		return SearchInBOM(haystack, size, p.oracle, needle, needle_len);
+	case RARE_BYTE:
+		return SearchInRareByte(haystack, size, p.rare_byte_plan, needle, needle_len);
+	default: {
+		const void *result = memmem(haystack, size, needle, needle_len);
+		return result ? (const unsigned char *) result - haystack : size;
+	}
+	}
+}
+
+/* Returns the position of a needle of the given length, taken from the last
+ * eighth of the haystack, whose first occurrence is as late as possible.
+ * Sets 'first_occurrence'.
+ */
+static size_t
+pickNeedle(const string &data, size_t needle_len, size_t &first_occurrence) {
+	size_t best = 0;
+	first_occurrence = 0;
+	const size_t candidates = 32;
+	const size_t region_start = data.size() - data.size() / 8;
+	const size_t region_size = data.size() / 8 - needle_len;
+	for (size_t i = 0; i < candidates; i++) {
+		size_t pos = region_start + region_size / candidates * i;
+		const void *result = memmem(data.data(), data.size(), data.data() + pos, needle_len);
+		size_t first = (const char *) result - data.data();
+		if (first > first_occurrence || i == 0) {
+			best = pos;
+			first_occurrence = first;
+			if (first == pos) {
+				break;
+			}
+		}
+	}
+	return best;
+}
+
+struct Row {
+	size_t needle_len;
+	/* Percentage of the haystack that is searched before the match. */
+	double scanned;
+	/* Throughput in MB/s per algorithm: mean, minimum and maximum over alignments. */
+	double mean[ALGORITHMS];
+	double min[ALGORITHMS];
+	double max[ALGORITHMS];
+	int winner;
+};
+
+static bool
+sweepLength(const string &data, unsigned char *buffer, size_t needle_len, size_t step,
+	const bytefreq_type &frequencies, Row &row)
+{
+	size_t first_occurrence;
+	const size_t needle_pos = pickNeedle(data, needle_len, first_occurrence);
+	const string needle_str = data.substr(needle_pos, needle_len);
+	Prepared prepared;
+	prepare(prepared, (const unsigned char *) needle_str.data(), needle_len, frequencies);
+
+	row.needle_len = needle_len;
+	const size_t scanned = first_occurrence + needle_len;
+	row.scanned = 100.0 * scanned / data.size();
+	for (int a = 0; a < ALGORITHMS; a++) {
+		row.mean[a] = 0;
+		row.min[a] = 1e30;
+		row.max[a] = 0;
+	}
+
+	unsigned int alignments = 0;
+	for (size_t alignment = 0; alignment < 64; alignment += step, alignments++) {
+		unsigned char *haystack = buffer + alignment;
+		memcpy(haystack, data.data(), data.size());
+		for (int a = 0; a < ALGORITHMS; a++) {
+			/* Repeat for at least 2 msec. */
+			unsigned long long t1 = getNanoTime(), t2;
+			unsigned int runs = 0;
+			size_t result;
+			do {
+				clobberMemory();
+				result = search(Algorithm(a), prepared, haystack, data.size());
+				runs++;
+				t2 = getNanoTime();
+			} while (t2 - t1 < 2000000);
+
+			if (result != first_occurrence) {
+				printf("*** %s found a %d byte needle at %d instead of %d\n",
+					algorithm_names[a], int(needle_len), int(result), int(first_occurrence));
+				return false;
+			}
+			double throughput = double(runs) * scanned / 1024 / 1024 / ((t2 - t1) / 1e9);
+			row.mean[a] += throughput;
+			row.min[a] = std::min(row.min[a], throughput);
+			row.max[a] = std::max(row.max[a], throughput);
+		}
+	}
+
+	row.winner = 0;
+	for (int a = 0; a < ALGORITHMS; a++) {
+		row.mean[a] /= alignments;
+		if (row.mean[a] > row.mean[row.winner]) {
+			row.winner = a;
+		}
+	}
+	return true;
+}
+
+static void
+printRow(const Row &row) {
+	printf("%-7d %8.1f%%", int(row.needle_len), row.scanned);
+	for (int a = 0; a < ALGORITHMS; a++) {
+		printf(" %9.0f", row.mean[a]);
+	}
+	const int w = row.winner;
+	printf("  %-10s %5.1f%%\n", algorithm_names[w],
+		100.0 * (row.max[w] - row.min[w]) / row.mean[w]);
+	fflush(stdout);
+}
+
+static void
+printCrossovers(const vector<Row> &rows) {
+	printf("\nWinner by needle length:\n");
+	size_t band_start = 0;
+	for (size_t i = 1; i <= rows.size(); i++) {
+		if (i == rows.size() || rows[i].winner != rows[band_start].winner) {
+			printf("  %5d - %-5d %s\n", int(rows[band_start].needle_len),
+				int(rows[i - 1].needle_len), algorithm_names[rows[band_start].winner]);
+			band_start = i;
+		}
+	}
+}
+
+static vector<size_t>
+needleLengths(bool all_lengths) {
+	vector<size_t> lengths;
+	if (all_lengths) {
+		for (size_t len = 1; len <= 4096; len++) {
+			lengths.push_back(len);
+		}
+		return lengths;
+	}
+	for (size_t len = 1; len <= 4096; len *= 2) {
+		lengths.push_back(len);
+		if (len >= 2 && len < 4096) {
+			lengths.push_back(len + len / 2);
+		}
+	}
+	return lengths;
+}
+
+int
+main(int argc, char *argv[]) {
+	vector<const char *> filenames;
+	size_t megabytes = 4;
+	size_t step = 1;
+	bool all_lengths = false;
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--mb=", 5) == 0) {
+			megabytes = strtoul(argv[i] + 5, NULL, 10);
+		} else if (strncmp(argv[i], "--step=", 7) == 0) {
+			step = max<size_t>(1, strtoul(argv[i] + 7, NULL, 10));
+		} else if (strcmp(argv[i], "--all-lengths") == 0) {
+			all_lengths = true;
+		} else {
+			filenames.push_back(argv[i]);
+		}
+	}
+	if (filenames.empty()) {
+		filenames.push_back("benchmark_input/binary.dat");
+	}
+	const vector<size_t> lengths = needleLengths(all_lengths);
+
+	for (size_t f = 0; f < filenames.size(); f++) {
+		string data;
+		if (!readFile(filenames[f], data)) {
+			printf("Cannot open %s\n", filenames[f]);
+			return 1;
+		}
+		if (data.size() > megabytes * 1024 * 1024) {
+			data.resize(megabytes * 1024 * 1024);
+		}
+		if (data.size() < 64 * 1024) {
+			printf("%s is too small\n", filenames[f]);
+			return 1;
+		}
+		const bytefreq_type frequencies = CreateByteFrequencyTable(
+			(const unsigned char *) data.data(), std::min(data.size(), (size_t) 256 * 1024));
+		vector<unsigned char> storage(data.size() + 128);
+		/* Aligned to 64 bytes, so that 'buffer + alignment' has that alignment. */
+		unsigned char *buffer = &storage[0] + (64 - (uintptr_t) &storage[0] % 64) % 64;
+
+		printf("%s# %s, %d KB, alignments 0-63 in steps of %d; mean MB/sec over alignments\n",
+			f == 0 ? "" : "\n", filenames[f], int(data.size() / 1024), int(step));
+		printf("%-7s %9s", "length", "scanned");
+		for (int a = 0; a < ALGORITHMS; a++) {
+			printf(" %9s", algorithm_names[a]);
+		}
+		printf("  %-10s %6s\n", "winner", "spread");
+
+		vector<Row> rows;
+		for (size_t i = 0; i < lengths.size(); i++) {
+			Row row;
+			if (!sweepLength(data, buffer, lengths[i], step, frequencies, row)) {
+				return 1;
+			}
+			printRow(row);
+			rows.push_back(row);
+		}
+		printCrossovers(rows);
+	}
+	return 0;
+}
@@ -0,0 +1,137 @@
+/*
+ * Benchmarks searching in arrays of symbols wider than a byte: arrays of
+ * 32-bit token IDs and UTF-16 text.
+ *
+ * Every array is searched with the symbol-typed algorithms, and, for
+ * comparison, with byte-based Boyer-Moore-Horspool on the same memory
+ * reinterpreted as bytes. The latter has to skip the hits that are not
+ * aligned to a symbol boundary.
+ *
+ * Usage: ./benchmark_symbols [TEXT_FILE] [TOKEN_COUNT] [ITERATIONS]
+ */
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <stdint.h>
+
+#include "benchmark_support.h"
+#include "Horspool.cpp"
+#include "BoyerMooreAndTurbo.cpp"
+
+using namespace std;
+
+/* Byte-based Horspool on symbol arrays, skipping unaligned hits. */
+template<typename Symbol>
+static size_t
+searchAsBytes(const vector<Symbol> &haystack, const occtable_type &occ,
+	const vector<Symbol> &needle)
+{
+	const unsigned char *h = (const unsigned char *) &haystack[0];
+	const unsigned char *n = (const unsigned char *) &needle[0];
+	const size_t h_len = haystack.size() * sizeof(Symbol);
+	const size_t n_len = needle.size() * sizeof(Symbol);
+	size_t offset = 0;
+	while (true) {
+		size_t result = SearchInHorspool(h + offset, h_len - offset, occ, n, n_len);
+		if (result == h_len - offset) {
+			return haystack.size();
+		} else if ((offset + result) % sizeof(Symbol) == 0) {
+			return (offset + result) / sizeof(Symbol);
+		} else {
+			offset += result + 1;
+		}
+	}
+}
+
+template<typename Symbol>
+static void
+benchmark(const char *title, const vector<Symbol> &haystack, const vector<Symbol> &needle,
+	int iterations)
+{
+	const WideOccTable<Symbol> occ = CreateOccTable(&needle[0], needle.size());
+	const skiptable_type skip = CreateSkipTable(&needle[0], needle.size());
+	const occtable_type byte_occ = CreateOccTable((const unsigned char *) &needle[0],
+		needle.size() * sizeof(Symbol));
+	unsigned long long t1, t2;
+	size_t found = 0;
+	int i;
+	
+	printf("\n# Matching %d symbols in \"%s\" (%d symbols), %d iterations\n",
+		int(needle.size()), title, int(haystack.size()), iterations);
+	
+	t1 = getTime();
+	for (i = 0; i < iterations; i++) {
+		clobberMemory();
+		found = SearchIn(&haystack[0], haystack.size(), occ, skip, &needle[0], needle.size());
+	}
+	t2 = getTime();
+	printf("Boyer-Moore             : found at position %d in %d msec\n", int(found), int(t2 - t1));
+	
+	t1 = getTime();
+	for (i = 0; i < iterations; i++) {
+		clobberMemory();
+		found = SearchInHorspool(&haystack[0], haystack.size(), occ, &needle[0], needle.size());
+	}
+	t2 = getTime();
+	printf("Boyer-Moore-Horspool    : found at position %d in %d msec\n", int(found), int(t2 - t1));
+	
+	t1 = getTime();
+	for (i = 0; i < iterations; i++) {
+		clobberMemory();
+		found = SearchInTurbo(&haystack[0], haystack.size(), occ, skip, &needle[0], needle.size());
+	}
+	t2 = getTime();
+	printf("Turbo Boyer-Moore       : found at position %d in %d msec\n", int(found), int(t2 - t1));
+	
+	t1 = getTime();
+	for (i = 0; i < iterations; i++) {
+		clobberMemory();
+		found = searchAsBytes(haystack, byte_occ, needle);
+	}
+	t2 = getTime();
+	printf("Horspool on raw bytes   : found at position %d in %d msec\n", int(found), int(t2 - t1));
+}
+
+int
+main(int argc, char *argv[]) {
+	const char *filename = (argc >= 2) ? argv[1] : "benchmark_input/alice-large.html";
+	size_t token_count = (argc >= 3) ? strtoul(argv[2], NULL, 10) : 50 * 1000 * 1000;
+	int iterations = (argc >= 4) ? atoi(argv[3]) : 5;
+	
+	/* Token IDs with a Zipf-like distribution over a 50000 word vocabulary,
+	 * like the output of a tokenizer.
+	 */
+	vector<uint32_t> tokens;
+	tokens.reserve(token_count + 64);
+	unsigned int seed = 1;
+	for (size_t i = 0; i < token_count; i++) {
+		seed = seed * 1103515245 + 12345;
+		double u = ((seed >> 8) & 0xFFFF) / 65536.0;
+		tokens.push_back(uint32_t(pow(50000.0, u)) - 1);
+	}
+	vector<uint32_t> needle;
+	for (int i = 0; i < 16; i++) {
+		seed = seed * 1103515245 + 12345;
+		needle.push_back((seed >> 8) % 50000);
+	}
+	tokens.insert(tokens.end(), needle.begin(), needle.end());
+	benchmark("Zipf-distributed token IDs", tokens, needle, iterations);
+	
+	/* UTF-16 text. */
+	string text;
+	if (!readFile(filename, text)) {
+		printf("Cannot open %s\n", filename);
+		return 1;
+	}
+	vector<uint16_t> utf16(text.begin(), text.end());
+	const char *needle_str = "I have control\n";
+	vector<uint16_t> utf16_needle(needle_str, needle_str + strlen(needle_str));
+	utf16.push_back(':');
+	utf16.insert(utf16.end(), utf16_needle.begin(), utf16_needle.end());
+	benchmark(filename, utf16, utf16_needle, iterations);
+	
+	return 0;
+}
@@ -0,0 +1,287 @@
+/*
+ * Benchmarks how the search algorithms scale with the number of threads,
+ * to tell whether many concurrent searches are bound by compute or by
+ * memory bandwidth.
+ *
+ * For 1, 2, 4, ... up to MAX_THREADS threads, every thread searches a
+ * haystack ITERATIONS times, using prepared tables that are shared by all
+ * threads. The aggregate throughput in GB/s is printed next to two
+ * baselines that do almost no computation: memchr() scanning for the
+ * rarest byte, and memcpy() of the haystack into a small per-thread buffer.
+ * Once an algorithm stops scaling where the baselines stop scaling too,
+ * it's bound by memory bandwidth.
+ *
+ * By default, all threads search the same haystack. With --private, every
+ * thread searches its own copy, which it allocates itself, so that it is
+ * local to the thread's NUMA node. With --pin, thread i is pinned to the
+ * i-th CPU that the process may run on (Linux only).
+ *
+ * Usage: ./benchmark_threads [options] [HAYSTACK_FILE] [NEEDLE] [MAX_THREADS] [ITERATIONS]
+ *   --private   Every thread searches its own copy of the haystack.
+ *   --pin       Pin threads to CPUs.
+ *   --mb=N      Use the first N MB of the haystack file (default 64).
+ */
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <alloca.h>
+#ifdef __linux__
+	#include <pthread.h>
+	#include <sched.h>
+#endif
+
+#include "benchmark_support.h"
+#include "Horspool.cpp"
+#include "BoyerMooreAndTurbo.cpp"
+#include "QGramHorspool.cpp"
+#include "StreamBoyerMooreHorspool.h"
+
+using namespace std;
+
+enum Algorithm {
+	MEMCHR, MEMCPY, HORSPOOL, QGRAM_HORSPOOL, BOYER_MOORE, TURBO, STREAM, ALGORITHMS
+};
+static const char *algorithm_names[ALGORITHMS] = {
+	"memchr", "memcpy", "Horspool", "2-gram", "BM", "Turbo BM", "StreamBMH"
+};
+
+/* Needle and prepared tables, shared by all threads. */
+struct Shared {
+	const unsigned char *needle;
+	size_t needle_len;
+	occtable_type occ;
+	skiptable_type skip;
+	qgramtable_type qgram;
+	StreamBMH_Occ sbmh_occ;
+	unsigned char rare_byte;
+
+	string haystack;
+	bool private_haystacks;
+	bool pin;
+	int iterations;
+
+	atomic<unsigned int> ready;
+	atomic<bool> go;
+};
+
+static Shared shared;
+
+/* Searches the haystack once and returns the result, so that the search
+ * cannot be optimized away.
+ */
+static size_t
+runOnce(Algorithm algorithm, const string &data, unsigned char *copy_buffer, size_t copy_buffer_size) {
+	const unsigned char *haystack = (const unsigned char *) data.data();
+	const size_t size = data.size();
+	const unsigned char *needle = shared.needle;
+	const size_t needle_len = shared.needle_len;
+
+	switch (algorithm) {
+	case MEMCHR: {
+		size_t count = 0;
+		const unsigned char *pos = haystack;
+		const unsigned char *end = haystack + size;
+		while ((pos = (const unsigned char *) memchr(pos, shared.rare_byte, end - pos)) != NULL) {
+			count++;
+			pos++;
+		}
+		return count;
+	}
+	case MEMCPY:
+		for (size_t pos = 0; pos < size; pos += copy_buffer_size) {
+			memcpy(copy_buffer, haystack + pos, min(copy_buffer_size, size - pos));
+			clobberMemory();
+		}
+		return copy_buffer[0];
+	case HORSPOOL:
+		return SearchInHorspool(haystack, size, shared.occ, needle, needle_len);
+	case QGRAM_HORSPOOL:
+		return SearchInQGramHorspool(haystack, size, shared.qgram, needle, needle_len);
+	case BOYER_MOORE:
+		return SearchIn(haystack, size, shared.occ, shared.skip, needle, needle_len);
+	case TURBO:
+		return SearchInTurbo(haystack, size, shared.occ, shared.skip, needle, needle_len);
+	default: {
+		StreamBMH *ctx = (StreamBMH *) alloca(SBMH_SIZE(needle_len));
+		sbmh_init(ctx, NULL, needle, needle_len);
+		return sbmh_feed(ctx, &shared.sbmh_occ, needle, needle_len, haystack, size);
+	}
+	}
+}
+
+/* The CPUs that this process may run on, in order. */
+static vector<int> cpus;
+
+static void
+findCpus() {
+	#ifdef __linux__
+		cpu_set_t set;
+		if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+			for (int i = 0; i < CPU_SETSIZE; i++) {
+				if (CPU_ISSET(i, &set)) {
+					cpus.push_back(i);
+				}
+			}
+		}
+	#endif
+}
+
+/* Pins the calling thread to the index'th allowed CPU. There may be more
+ * threads than CPUs, in which case CPUs are shared.
+ */
+static void
+pinToCpu(unsigned int index) {
+	#ifdef __linux__
+		if (cpus.empty()) {
+			return;
+		}
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpus[index % cpus.size()], &set);
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	#else
+		(void) index;
+	#endif
+}
+
+static void
+worker(unsigned int index, Algorithm algorithm, volatile size_t *result) {
+	if (shared.pin) {
+		pinToCpu(index);
+	}
+	string private_haystack;
+	if (shared.private_haystacks) {
+		private_haystack = shared.haystack;
+	}
+	const string &data = shared.private_haystacks ? private_haystack : shared.haystack;
+	const size_t copy_buffer_size = 1024 * 1024;
+	vector<unsigned char> copy_buffer(copy_buffer_size);
+
+	shared.ready++;
+	while (!shared.go.load(memory_order_acquire)) {
+		std::this_thread::yield();
+	}
+	for (int i = 0; i < shared.iterations; i++) {
+		clobberMemory();
+		*result = runOnce(algorithm, data, &copy_buffer[0], copy_buffer_size);
+	}
+}
+
+/* Returns the aggregate throughput in GB/s. */
+static double
+measure(Algorithm algorithm, unsigned int threads) {
+	vector<thread> workers;
+	vector<size_t> results(threads);
+	shared.ready = 0;
+	shared.go = false;
+	for (unsigned int i = 0; i < threads; i++) {
+		workers.push_back(thread(worker, i, algorithm, &results[i]));
+	}
+	/* Start timing once all threads have copied their haystack. */
+	while (shared.ready.load() < threads) {
+		std::this_thread::yield();
+	}
+	unsigned long long t1 = getTime();
+	shared.go.store(true, memory_order_release);
+	for (unsigned int i = 0; i < threads; i++) {
+		workers[i].join();
+	}
+	unsigned long long t2 = getTime();
+	return double(threads) * shared.iterations * shared.haystack.size()
+		/ 1e9 / (max(1ull, t2 - t1) / 1000.0);
+}
+
+static unsigned char
+findRarestByte(const string &data) {
+	size_t counts[256] = { 0 };
+	for (size_t i = 0; i < data.size(); i++) {
+		counts[(unsigned char) data[i]]++;
+	}
+	unsigned int rarest = 0;
+	for (unsigned int i = 1; i < 256; i++) {
+		if (counts[i] < counts[rarest]) {
+			rarest = i;
+		}
+	}
+	return (unsigned char) rarest;
+}
+
+int
+main(int argc, char *argv[]) {
+	vector<const char *> args;
+	size_t megabytes = 64;
+	shared.private_haystacks = false;
+	shared.pin = false;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--private") == 0) {
+			shared.private_haystacks = true;
+		} else if (strcmp(argv[i], "--pin") == 0) {
+			shared.pin = true;
+		} else if (strncmp(argv[i], "--mb=", 5) == 0) {
+			megabytes = strtoul(argv[i] + 5, NULL, 10);
+		} else {
+			args.push_back(argv[i]);
+		}
+	}
+	const char *filename = (args.size() >= 1) ? args[0] : "benchmark_input/binary.dat";
+	shared.needle = (const unsigned char *) ((args.size() >= 2) ? args[1] : "I have control\n");
+	unsigned int max_threads = (args.size() >= 3) ? atoi(args[2])
+		: max(1u, thread::hardware_concurrency());
+	shared.iterations = (args.size() >= 4) ? atoi(args[3]) : 5;
+	shared.needle_len = strlen((const char *) shared.needle);
+
+	if (!readFile(filename, shared.haystack)) {
+		printf("Cannot open %s\n", filename);
+		return 1;
+	}
+	if (shared.haystack.size() > megabytes * 1024 * 1024) {
+		shared.haystack.resize(megabytes * 1024 * 1024);
+	}
+	shared.haystack.append(":");
+	shared.haystack.append((const char *) shared.needle);
+
+	shared.occ = CreateOccTable(shared.needle, shared.needle_len);
+	shared.skip = CreateSkipTable(shared.needle, shared.needle_len);
+	shared.qgram = CreateQGramTable(shared.needle, shared.needle_len);
+	sbmh_init(NULL, &shared.sbmh_occ, shared.needle, shared.needle_len);
+	shared.rare_byte = findRarestByte(shared.haystack);
+	if (shared.pin) {
+		findCpus();
+		if (cpus.empty()) {
+			printf("Cannot pin threads on this platform.\n");
+			shared.pin = false;
+		}
+	}
+
+	printf("# Aggregate GB/s, %d MB %s haystack%s, %d iterations per thread%s\n",
+		int(shared.haystack.size() >> 20),
+		shared.private_haystacks ? "private" : "shared",
+		shared.private_haystacks ? "s" : "",
+		shared.iterations, shared.pin ? ", pinned" : "");
+	printf("%-8s", "threads");
+	for (int a = 0; a < ALGORITHMS; a++) {
+		printf(" %10s", algorithm_names[a]);
+	}
+	printf("\n");
+
+	for (unsigned int threads = 1; threads <= max_threads; ) {
+		printf("%-8u", threads);
+		fflush(stdout);
+		for (int a = 0; a < ALGORITHMS; a++) {
+			printf(" %10.2f", measure(Algorithm(a), threads));
+			fflush(stdout);
+		}
+		printf("\n");
+		if (threads < max_threads && threads * 2 > max_threads) {
+			threads = max_threads;
+		} else {
+			threads *= 2;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,363 @@
+/*
+ * Generates reproducible benchmark inputs that look like real traffic.
+ *
+ * The same TYPE, SIZE and SEED always produce the same bytes, on any
+ * machine: the generator uses its own pseudo-random number generator
+ * (splitmix64) instead of rand() or <random> distributions, whose output
+ * differs between C libraries.
+ *
+ * Types:
+ *   json-logs       One JSON object per line, like structured server logs.
+ *   http-multipart  HTTP POST requests with multipart/form-data bodies.
+ *   english         Words of English text with Zipf-distributed frequencies.
+ *   dna             A, C, G and T, with GC-rich regions and tandem repeats.
+ *   compressed      Uniformly distributed bytes, like compressed or
+ *                   encrypted data.
+ *
+ * Optionally, NEEDLE is planted MATCHES_PER_MB times per MB at random
+ * positions, and a near miss of it (the needle with one byte changed) is
+ * planted NEAR_MISSES_PER_MB times per MB. Near misses make the search
+ * algorithms verify candidates without finding a match.
+ *
+ * Usage: ./generate_corpus TYPE SIZE SEED OUTPUT_FILE [NEEDLE MATCHES_PER_MB NEAR_MISSES_PER_MB]
+ */
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <stdint.h>
+
+using namespace std;
+
+class Random {
+private:
+	uint64_t state;
+
+public:
+	Random(uint64_t seed)
+		: state(seed)
+		{ }
+
+	uint64_t next() {
+		uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	}
+
+	/* Returns a number in [0, n). */
+	uint64_t below(uint64_t n) {
+		return next() % n;
+	}
+
+	/* Returns a number in [0, 1). */
+	double fraction() {
+		return (next() >> 11) * (1.0 / 9007199254740992.0);
+	}
+};
+
+static const char *common_words[] = {
+	"the", "of", "and", "to", "a", "in", "is", "it", "you", "that", "he", "was", "for",
+	"on", "are", "with", "as", "I", "his", "they", "be", "at", "one", "have", "this",
+	"from", "or", "had", "by", "not", "word", "but", "what", "some", "we", "can", "out",
+	"other", "were", "all", "there", "when", "up", "use", "your", "how", "said", "an",
+	"each", "she", "which", "do", "their", "time", "if", "will", "way", "about", "many",
+	"then", "them", "write", "would", "like", "so", "these", "her", "long", "make",
+	"thing", "see", "him", "two", "has", "look", "more", "day", "could", "go", "come",
+	"did", "number", "sound", "no", "most", "people", "my", "over", "know", "water",
+	"than", "call", "first", "who", "may", "down", "side", "been", "now", "find", "any",
+	"new", "work", "part", "take", "get", "place", "made", "live", "where", "after",
+	"back", "little", "only", "round", "man", "year", "came", "show", "every", "good",
+	"me", "give", "our", "under", "name", "very", "through", "just", "form", "sentence",
+	"great", "think", "say", "help", "low", "line", "differ", "turn", "cause", "much",
+	"mean", "before", "move", "right", "boy", "old", "too", "same", "tell", "does",
+	"set", "three", "want", "air", "well", "also", "play", "small", "end", "put", "home",
+	"read", "hand", "port", "large", "spell", "add", "even", "land", "here", "must",
+	"big", "high", "such", "follow", "act", "why", "ask", "men", "change", "went",
+	"light", "kind", "off", "need", "house", "picture", "try", "us", "again", "animal",
+	"point", "mother", "world", "near", "build", "self", "earth", "father", "head",
+	"stand", "own", "page", "should", "country", "found", "answer", "school", "grow",
+	"study", "still", "learn", "plant", "cover", "food", "sun", "four", "between",
+	"state", "keep", "eye", "never", "last", "let", "thought", "city", "tree", "cross",
+	"farm", "hard", "start", "might", "story", "saw", "far", "sea", "draw", "left",
+	"late", "run", "while", "press", "close", "night", "real", "life", "few", "north",
+	"control"
+};
+static const size_t common_words_count = sizeof(common_words) / sizeof(common_words[0]);
+
+/* Words of rank above the common words are made of syllables. */
+static const char *syllables[] = {
+	"ba", "ce", "di", "fo", "gu", "ha", "je", "ki", "lo", "mu", "na", "pe", "qui", "ro",
+	"su", "ta", "ve", "wi", "xo", "ya", "zu", "ran", "ter", "tion", "ing", "er", "al", "ous"
+};
+static const size_t syllables_count = sizeof(syllables) / sizeof(syllables[0]);
+
+class ZipfWords {
+private:
+	vector<string> words;
+	vector<double> cdf;
+
+public:
+	ZipfWords(Random &random, size_t vocabulary_size) {
+		double total = 0;
+		for (size_t rank = 0; rank < vocabulary_size; rank++) {
+			if (rank < common_words_count) {
+				words.push_back(common_words[rank]);
+			} else {
+				string word;
+				size_t count = 2 + random.below(3);
+				for (size_t i = 0; i < count; i++) {
+					word.append(syllables[random.below(syllables_count)]);
+				}
+				words.push_back(word);
+			}
+			total += 1.0 / (rank + 1);
+			cdf.push_back(total);
+		}
+		for (size_t i = 0; i < cdf.size(); i++) {
+			cdf[i] /= total;
+		}
+	}
+
+	const string &pick(Random &random) const {
+		size_t index = lower_bound(cdf.begin(), cdf.end(), random.fraction()) - cdf.begin();
+		return words[min(index, words.size() - 1)];
+	}
+};
+
+static void
+appendHex(Random &random, string &output, size_t digits) {
+	static const char hex[] = "0123456789abcdef";
+	for (size_t i = 0; i < digits; i++) {
+		output.push_back(hex[random.below(16)]);
+	}
+}
+
+static void
+appendNumber(string &output, uint64_t number) {
+	char buf[24];
+	snprintf(buf, sizeof(buf), "%llu", (unsigned long long) number);
+	output.append(buf);
+}
+
+static void
+appendSentence(Random &random, const ZipfWords &words, string &output, size_t word_count) {
+	for (size_t i = 0; i < word_count; i++) {
+		const string &word = words.pick(random);
+		if (i == 0) {
+			output.push_back(toupper(word[0]));
+			output.append(word, 1, string::npos);
+		} else {
+			output.push_back(' ');
+			output.append(word);
+		}
+	}
+	output.push_back('.');
+}
+
+static void
+generateJsonLogs(Random &random, string &output, size_t size) {
+	static const char *levels[] = { "DEBUG", "INFO", "INFO", "INFO", "INFO", "WARN", "ERROR" };
+	static const char *methods[] = { "GET", "GET", "GET", "POST", "PUT", "DELETE" };
+	static const char *resources[] = { "users", "orders", "products", "sessions", "carts", "search" };
+	ZipfWords words(random, 5000);
+	uint64_t timestamp = 1700000000000ULL;
+
+	while (output.size() < size) {
+		timestamp += random.below(50);
+		output.append("{\"ts\":");
+		appendNumber(output, timestamp);
+		output.append(",\"level\":\"");
+		output.append(levels[random.below(7)]);
+		output.append("\",\"service\":\"api-");
+		appendNumber(output, random.below(12));
+		output.append("\",\"request_id\":\"");
+		appendHex(random, output, 32);
+		output.append("\",\"method\":\"");
+		output.append(methods[random.below(6)]);
+		output.append("\",\"path\":\"/v1/");
+		output.append(resources[random.below(6)]);
+		output.push_back('/');
+		appendNumber(output, random.below(1000000));
+		output.append("\",\"status\":");
+		appendNumber(output, random.below(10) == 0 ? 500 + random.below(4) : 200 + random.below(5));
+		output.append(",\"latency_ms\":");
+		appendNumber(output, 1 + random.below(random.below(20) == 0 ? 5000 : 200));
+		output.append(",\"msg\":\"");
+		appendSentence(random, words, output, 4 + random.below(12));
+		output.append("\"}\n");
+	}
+}
+
+static void
+generateHttpMultipart(Random &random, string &output, size_t size) {
+	static const char *field_names[] = { "title", "description", "comment", "tags", "email" };
+	ZipfWords words(random, 5000);
+
+	while (output.size() < size) {
+		string boundary = "----------------------------";
+		appendHex(random, boundary, 24);
+
+		string body;
+		size_t parts = 1 + random.below(5);
+		for (size_t i = 0; i < parts; i++) {
+			body.append("--" + boundary + "\r\n");
+			if (random.below(3) == 0) {
+				body.append("Content-Disposition: form-data; name=\"file\"; filename=\"upload-");
+				appendHex(random, body, 8);
+				body.append(".bin\"\r\nContent-Type: application/octet-stream\r\n\r\n");
+				size_t len = 256 + random.below(16 * 1024);
+				for (size_t j = 0; j < len; j++) {
+					body.push_back((char) random.below(256));
+				}
+			} else {
+				body.append("Content-Disposition: form-data; name=\"");
+				body.append(field_names[random.below(5)]);
+				body.append("\"\r\n\r\n");
+				size_t sentences = 1 + random.below(6);
+				for (size_t j = 0; j < sentences; j++) {
+					appendSentence(random, words, body, 5 + random.below(15));
+					body.push_back(' ');
+				}
+			}
+			body.append("\r\n");
+		}
+		body.append("--" + boundary + "--\r\n");
+
+		output.append("POST /upload/");
+		appendNumber(output, random.below(100000));
+		output.append(" HTTP/1.1\r\nHost: www.example.com\r\n"
+			"User-Agent: Mozilla/5.0 (X11; Linux x86_64)\r\nAccept: */*\r\n"
+			"Cookie: session=");
+		appendHex(random, output, 40);
+		output.append("\r\nContent-Type: multipart/form-data; boundary=" + boundary + "\r\n");
+		output.append("Content-Length: ");
+		appendNumber(output, body.size());
+		output.append("\r\n\r\n");
+		output.append(body);
+	}
+}
+
+static void
+generateEnglish(Random &random, string &output, size_t size) {
+	ZipfWords words(random, 50000);
+	while (output.size() < size) {
+		size_t sentences = 1 + random.below(8);
+		for (size_t i = 0; i < sentences; i++) {
+			appendSentence(random, words, output, 3 + random.below(25));
+			output.push_back(i + 1 < sentences ? ' ' : '\n');
+		}
+		output.push_back('\n');
+	}
+}
+
+static void
+generateDna(Random &random, string &output, size_t size) {
+	static const char bases[] = "ACGT";
+	while (output.size() < size) {
+		if (random.below(20) == 0) {
+			/* A tandem repeat: a short unit repeated many times. */
+			string unit;
+			size_t unit_len = 1 + random.below(6);
+			for (size_t i = 0; i < unit_len; i++) {
+				unit.push_back(bases[random.below(4)]);
+			}
+			size_t repeats = 5 + random.below(60);
+			for (size_t i = 0; i < repeats; i++) {
+				output.append(unit);
+			}
+		} else {
+			/* A region with a GC content between 35% and 65%. */
+			double gc = 0.35 + 0.3 * random.fraction();
+			size_t len = 100 + random.below(2000);
+			for (size_t i = 0; i < len; i++) {
+				bool strong = random.fraction() < gc;
+				output.push_back(strong ? "GC"[random.below(2)] : "AT"[random.below(2)]);
+			}
+		}
+	}
+}
+
+static void
+generateCompressed(Random &random, string &output, size_t size) {
+	output.reserve(size + 8);
+	while (output.size() < size) {
+		/* Little-endian, so that a seed gives the same file on every host. */
+		uint64_t value = random.next();
+		for (int i = 0; i < 8; i++) {
+			output.push_back(char(value >> (8 * i)));
+		}
+	}
+}
+
+/* Overwrites 'count' random positions with the needle, or with a near miss
+ * of it if 'near_miss' is set.
+ */
+static void
+plant(Random &random, string &output, const string &needle, size_t count, bool near_miss) {
+	if (needle.empty() || needle.size() > output.size()) {
+		return;
+	}
+	for (size_t i = 0; i < count; i++) {
+		size_t pos = random.below(output.size() - needle.size() + 1);
+		output.replace(pos, needle.size(), needle);
+		if (near_miss) {
+			/* Change any byte but the last, so that the last byte check passes. */
+			size_t index = random.below(max<size_t>(1, needle.size() - 1));
+			output[pos + index] = (char) (output[pos + index] ^ (1 + random.below(255)));
+		}
+	}
+}
+
+int
+main(int argc, char *argv[]) {
+	if (argc < 5) {
+		fprintf(stderr, "Usage: %s TYPE SIZE SEED OUTPUT_FILE [NEEDLE MATCHES_PER_MB NEAR_MISSES_PER_MB]\n"
+			"Types: json-logs, http-multipart, english, dna, compressed\n", argv[0]);
+		return 2;
+	}
+	const string type = argv[1];
+	const size_t size = strtoull(argv[2], NULL, 10);
+	Random random(strtoull(argv[3], NULL, 10));
+	const char *filename = argv[4];
+	const string needle = (argc >= 6) ? argv[5] : "";
+	const double matches_per_mb = (argc >= 7) ? atof(argv[6]) : 0;
+	const double near_misses_per_mb = (argc >= 8) ? atof(argv[7]) : 0;
+
+	string output;
+	output.reserve(size + 64 * 1024);
+	if (type == "json-logs") {
+		generateJsonLogs(random, output, size);
+	} else if (type == "http-multipart") {
+		generateHttpMultipart(random, output, size);
+	} else if (type == "english") {
+		generateEnglish(random, output, size);
+	} else if (type == "dna") {
+		generateDna(random, output, size);
+	} else if (type == "compressed") {
+		generateCompressed(random, output, size);
+	} else {
+		fprintf(stderr, "Unknown type: %s\n", type.c_str());
+		return 2;
+	}
+	output.resize(size);
+
+	const double megabytes = size / (1024.0 * 1024.0);
+	plant(random, output, needle, size_t(llround(near_misses_per_mb * megabytes)), true);
+	plant(random, output, needle, size_t(llround(matches_per_mb * megabytes)), false);
+
+	FILE *f = fopen(filename, "wb");
+	if (f == NULL) {
+		perror(filename);
+		return 1;
+	}
+	if (fwrite(output.data(), 1, output.size(), f) != output.size() || fclose(f) != 0) {
+		perror(filename);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,316 @@
+/*
+ * Demonstrates the USDT trace points of SearchProbes.h without needing
+ * bpftrace, perf or root privileges.
+ *
+ * Tracers like bpftrace attach to a probe by reading its .note.stapsdt
+ * entry, replacing the probe's 'nop' with a breakpoint instruction, and
+ * decoding the arguments from the registers when the breakpoint is hit.
+ * This program does the same to itself: it reads the probe notes from its
+ * own executable, patches in 'int3' instructions, and handles the resulting
+ * SIGTRAPs. Because a probe is a 1-byte 'nop', execution simply continues
+ * after the breakpoint.
+ *
+ * It then runs a few searches and prints every probe that fired, with its
+ * arguments and, for return probes, the time since the matching entry probe.
+ * The breakpoint overhead (a few microseconds) is included in those times,
+ * as it is with real uprobes.
+ *
+ * Linux/x86-64 only. Must be compiled with -DSEARCH_PROBES.
+ *
+ * Usage: ./probe_demo
+ */
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <alloca.h>
+
+#include "benchmark_support.h"
+#include "Horspool.cpp"
+#include "BoyerMooreAndTurbo.cpp"
+#include "StreamBoyerMooreHorspool.h"
+
+#if defined(__linux__) && defined(__x86_64__) && defined(SEARCH_PROBES)
+
+#include <elf.h>
+#include <signal.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+
+using namespace std;
+
+struct Probe {
+	string name;
+	vector<string> args;
+	unsigned char *address;
+};
+
+struct Event {
+	const Probe *probe;
+	unsigned long long time;
+	unsigned int argc;
+	unsigned long long argv[4];
+	bool argv_known[4];
+};
+
+static vector<Probe> probes;
+static Event events[256];
+static volatile unsigned int event_count = 0;
+
+/* Defined by the probe notes; its address tells where the program was loaded. */
+extern "C" char stapsdt_base __asm__("_.stapsdt.base");
+
+static bool
+readProbes() {
+	string exe;
+	if (!readFile("/proc/self/exe", exe) || exe.size() < sizeof(Elf64_Ehdr)) {
+		return false;
+	}
+	const char *data = exe.data();
+	const Elf64_Ehdr *ehdr = (const Elf64_Ehdr *) data;
+	const Elf64_Shdr *shdrs = (const Elf64_Shdr *) (data + ehdr->e_shoff);
+	const char *shstrtab = data + shdrs[ehdr->e_shstrndx].sh_offset;
+
+	for (unsigned int i = 0; i < ehdr->e_shnum; i++) {
+		if (strcmp(shstrtab + shdrs[i].sh_name, ".note.stapsdt") != 0) {
+			continue;
+		}
+		size_t pos = shdrs[i].sh_offset;
+		const size_t end = pos + shdrs[i].sh_size;
+		while (pos + sizeof(Elf64_Nhdr) <= end) {
+			const Elf64_Nhdr *nhdr = (const Elf64_Nhdr *) (data + pos);
+			const char *name = data + pos + sizeof(Elf64_Nhdr);
+			const char *desc = name + ((nhdr->n_namesz + 3) & ~3u);
+			pos = (desc - data) + ((nhdr->n_descsz + 3) & ~3u);
+			if (nhdr->n_type != 3 || strcmp(name, "stapsdt") != 0) {
+				continue;
+			}
+
+			uint64_t pc, base;
+			memcpy(&pc, desc, 8);
+			memcpy(&base, desc + 8, 8);
+			const char *provider = desc + 24;
+			const char *probe_name = provider + strlen(provider) + 1;
+			const char *args = probe_name + strlen(probe_name) + 1;
+
+			Probe probe;
+			probe.name = string(provider) + ":" + probe_name;
+			probe.address = (unsigned char *) (pc + ((uintptr_t) &stapsdt_base - base));
+			const char *arg = args;
+			while (*arg != '\0') {
+				const char *space = strchr(arg, ' ');
+				size_t len = space ? size_t(space - arg) : strlen(arg);
+				probe.args.push_back(string(arg, len));
+				arg += len;
+				while (*arg == ' ') {
+					arg++;
+				}
+			}
+			probes.push_back(probe);
+		}
+	}
+	return true;
+}
+
+static int
+registerIndex(const char *name, size_t len) {
+	static const struct { const char *name; int index; } registers[] = {
+		{ "rax", REG_RAX }, { "rbx", REG_RBX }, { "rcx", REG_RCX }, { "rdx", REG_RDX },
+		{ "rsi", REG_RSI }, { "rdi", REG_RDI }, { "rbp", REG_RBP }, { "rsp", REG_RSP },
+		{ "r8", REG_R8 }, { "r9", REG_R9 }, { "r10", REG_R10 }, { "r11", REG_R11 },
+		{ "r12", REG_R12 }, { "r13", REG_R13 }, { "r14", REG_R14 }, { "r15", REG_R15 }
+	};
+	for (size_t i = 0; i < sizeof(registers) / sizeof(registers[0]); i++) {
+		if (strlen(registers[i].name) == len && memcmp(registers[i].name, name, len) == 0) {
+			return registers[i].index;
+		}
+	}
+	return -1;
+}
+
+/* Decodes an argument such as "8@%rdi", "8@$5" or "8@16(%rsp)". */
+static bool
+decodeArgument(const string &spec, const ucontext_t *uc, unsigned long long &value) {
+	const char *location = strchr(spec.c_str(), '@');
+	if (location == NULL) {
+		return false;
+	}
+	location++;
+	if (*location == '$') {
+		value = strtoull(location + 1, NULL, 10);
+		return true;
+	} else if (*location == '%') {
+		int reg = registerIndex(location + 1, strlen(location + 1));
+		if (reg < 0) {
+			return false;
+		}
+		value = uc->uc_mcontext.gregs[reg];
+		return true;
+	} else {
+		char *paren;
+		long offset = strtol(location, &paren, 10);
+		if (paren[0] != '(' || paren[1] != '%') {
+			return false;
+		}
+		const char *reg_name = paren + 2;
+		int reg = registerIndex(reg_name, strcspn(reg_name, ")"));
+		if (reg < 0) {
+			return false;
+		}
+		memcpy(&value, (const char *) uc->uc_mcontext.gregs[reg] + offset, 8);
+		return true;
+	}
+}
+
+static void
+onBreakpoint(int, siginfo_t *, void *context) {
+	ucontext_t *uc = (ucontext_t *) context;
+	/* RIP points past the int3, which replaced the probe's 'nop'. */
+	unsigned char *address = (unsigned char *) uc->uc_mcontext.gregs[REG_RIP] - 1;
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	for (size_t i = 0; i < probes.size(); i++) {
+		if (probes[i].address != address || event_count >= sizeof(events) / sizeof(Event)) {
+			continue;
+		}
+		Event &event = events[event_count];
+		event.probe = &probes[i];
+		event.time = (unsigned long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+		event.argc = std::min<size_t>(4, probes[i].args.size());
+		for (unsigned int a = 0; a < event.argc; a++) {
+			event.argv_known[a] = decodeArgument(probes[i].args[a], uc, event.argv[a]);
+		}
+		event_count = event_count + 1;
+		return;
+	}
+}
+
+static bool
+attachProbes() {
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_sigaction = onBreakpoint;
+	action.sa_flags = SA_SIGINFO;
+	sigaction(SIGTRAP, &action, NULL);
+
+	const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+	for (size_t i = 0; i < probes.size(); i++) {
+		unsigned char *address = probes[i].address;
+		if (*address != 0x90) {
+			printf("%s at %p is not a nop\n", probes[i].name.c_str(), (void *) address);
+			return false;
+		}
+		void *page = (void *) ((uintptr_t) address & ~(page_size - 1));
+		if (mprotect(page, page_size * 2, PROT_READ | PROT_WRITE | PROT_EXEC) != 0) {
+			perror("mprotect");
+			return false;
+		}
+		*address = 0xCC;
+	}
+	return true;
+}
+
+static void
+printEvents() {
+	for (unsigned int i = 0; i < event_count; i++) {
+		const Event &event = events[i];
+		printf("%-20s", event.probe->name.c_str());
+		for (unsigned int a = 0; a < event.argc; a++) {
+			if (event.argv_known[a] && event.argv[a] > 0xFFFFFFFFull) {
+				/* Most likely a pointer, such as the StreamBMH context. */
+				printf(" 0x%llx", event.argv[a]);
+			} else if (event.argv_known[a]) {
+				printf(" %llu", event.argv[a]);
+			} else {
+				printf(" ?");
+			}
+		}
+
+		/* Match return probes with the most recent entry probe. */
+		const string &name = event.probe->name;
+		if (name.size() > 7 && name.compare(name.size() - 7, 7, "_return") == 0) {
+			string entry = name.substr(0, name.size() - 7) + "_entry";
+			for (unsigned int j = i; j-- > 0; ) {
+				if (events[j].probe->name == entry) {
+					printf("   (%llu ns)", event.time - events[j].time);
+					break;
+				}
+			}
+		}
+		printf("\n");
+	}
+}
+
+int
+main() {
+	if (!readProbes() || probes.empty()) {
+		printf("No probes found; was this compiled with -DSEARCH_PROBES?\n");
+		return 1;
+	}
+	printf("Found %d probe sites:\n", (int) probes.size());
+	for (size_t i = 0; i < probes.size(); i++) {
+		printf("  %-20s", probes[i].name.c_str());
+		for (size_t a = 0; a < probes[i].args.size(); a++) {
+			printf(" %s", probes[i].args[a].c_str());
+		}
+		printf("\n");
+	}
+	if (!attachProbes()) {
+		return 1;
+	}
+
+	string haystack;
+	for (int i = 0; i < 2000; i++) {
+		haystack.append("Twinkle, twinkle, little bat! How I wonder what you're at!\n");
+	}
+	haystack.append("I have control\n");
+	const unsigned char *needle = (const unsigned char *) "I have control\n";
+	const size_t needle_len = strlen((const char *) needle);
+	const unsigned char *h = (const unsigned char *) haystack.data();
+
+	const occtable_type occ = CreateOccTable(needle, needle_len);
+	const skiptable_type skip = CreateSkipTable(needle, needle_len);
+	volatile size_t result;
+	result = SearchInHorspool(h, haystack.size(), occ, needle, needle_len);
+	result = SearchIn(h, haystack.size(), occ, skip, needle, needle_len);
+	result = SearchInTurbo(h, haystack.size(), occ, skip, needle, needle_len);
+	result = SearchInHorspool(h, 100, occ, needle, needle_len);
+	(void) result;
+
+	/* Feed the haystack in chunks of 10000 bytes and then in a few chunks
+	 * that split the needle, so that the lookbehind buffer is used.
+	 */
+	StreamBMH *ctx = (StreamBMH *) alloca(SBMH_SIZE(needle_len));
+	StreamBMH_Occ sbmh_occ;
+	sbmh_init(ctx, &sbmh_occ, needle, needle_len);
+	for (size_t pos = 0; pos < haystack.size() && !ctx->found; ) {
+		const size_t remaining = haystack.size() - pos;
+		size_t len;
+		if (remaining <= 30) {
+			len = std::min<size_t>(remaining, 5);
+		} else {
+			len = std::min<size_t>(remaining - 30, 10000);
+		}
+		sbmh_feed(ctx, &sbmh_occ, needle, needle_len, h + pos, len);
+		pos += len;
+	}
+
+	printf("\nFired probes (arguments, and latency for returns):\n");
+	printEvents();
+	return event_count > 0 ? 0 : 1;
+}
+
+#else
+
+int
+main() {
+	printf("probe_demo requires Linux/x86-64 and -DSEARCH_PROBES.\n");
+	return 1;
+}
+
+#endif